@@ -2,21 +2,31 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
+
 #include "config.h"
 #include "driver/twai.h"
 #include "firmware/update_handler.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "hal/can_hal.h"
 #include "oi_can.h"
 
 #include "managers/can_interval_manager.h"
+#include "managers/data_logger.h"
 #include "managers/device_connection.h"
 #include "managers/device_discovery.h"
+#include "managers/param_write_queue.h"
+#include "managers/sdo_operation_manager.h"
 #include "managers/spot_values_manager.h"
 #include "models/can_command.h"
 #include "models/can_event.h"
 #include "models/can_types.h"
 #include "protocols/sdo_protocol.h"
+#include "protocols/sdo_transaction_table.h"
+#include "utils/can_router.h"
 #include "utils/can_utils.h"
+#include "utils/deadline.h"
 #include "utils/string_utils.h"
 
 // External declarations for globals defined in main.cpp
@@ -25,20 +35,76 @@ extern QueueHandle_t canEventQueue;
 extern Config config;
 
 // CAN I/O queues
-QueueHandle_t canTxQueue = nullptr;
+QueueHandle_t canTxQueues[CAN_TX_PRIORITY_COUNT] = {};
 QueueHandle_t sdoResponseQueue = nullptr;
 
 #define DBG_OUTPUT_PORT Serial
 
+// Task handles (set in startCanTasks)
+static TaskHandle_t canTaskHandle = nullptr;
+static TaskHandle_t canRxTaskHandle = nullptr;
+static TaskHandle_t canTxTaskHandle = nullptr;
+
+// TWAI driver ownership. The RX task blocks inside the driver, so a reinstall first parks
+// it (pause request + handshake) and then holds the driver mutex to keep the TX task out.
+// The park comes first: the RX task takes the mutex too, and could not park while blocked on it.
+static SemaphoreHandle_t twaiDriverMutex = nullptr;
+static SemaphoreHandle_t rxTaskParked = nullptr;
+static SemaphoreHandle_t rxTaskResume = nullptr;
+static volatile bool rxTaskPauseRequested = false;
+static volatile bool twaiInstalled = false;
+
+// RX drain state (owned by the RX task)
+static CanRxStats rxStats;
+static bool rxBacklog = false;                     // Budget was hit - frames still waiting in the driver
+static twai_status_info_t lastDriverStatus = {};  // Driver counters at last poll (reset on reinstall)
+
+// Bus health (written by the RX task; reinstalls happen while it is parked)
+static CanBusStatus busStatus;
+static portMUX_TYPE busStatusMux = portMUX_INITIALIZER_UNLOCKED;
+static bool recoveryPending = false;  // Bus-off, waiting for the backoff before initiating recovery
+static uint32_t busOffAtMs = 0;      // Start of the current recovery backoff
+static uint32_t lastRecoveredMs = 0;
+
+// Installed driver configuration (guarded by busStatusMux for readers outside the CAN tasks)
+static CanFilterPlan activeFilter;
+static BaudRate activeBaud = Baud500k;
+static int activeTxPin = -1;
+static int activeRxPin = -1;
+
+// Alerts that change bus health. Arbitration loss, bus errors and TX failures are not
+// enabled - they can fire per frame on a bad bus - and are picked up from the counters.
+static const uint32_t BUS_HEALTH_ALERTS = TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED | TWAI_ALERT_ERR_PASS |
+                                          TWAI_ALERT_ABOVE_ERR_WARN | TWAI_ALERT_BELOW_ERR_WARN |
+                                          TWAI_ALERT_ERR_ACTIVE | TWAI_ALERT_RX_QUEUE_FULL |
+                                          TWAI_ALERT_RX_FIFO_OVERRUN;
+
+// TX class state (stats are written from producers and the TX task)
+static const UBaseType_t txQueueDepths[CAN_TX_PRIORITY_COUNT] = {
+    CAN_TX_CONTROL_QUEUE_SIZE, CAN_TX_BOOTLOADER_QUEUE_SIZE, CAN_TX_SDO_QUEUE_SIZE, CAN_TX_BACKGROUND_QUEUE_SIZE};
+static const char* const txClassNames[CAN_TX_PRIORITY_COUNT] = {"control", "bootloader", "sdo", "background"};
+static CanTxStats txStats[CAN_TX_PRIORITY_COUNT];
+static portMUX_TYPE txStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void initTwaiSync() {
+  if (twaiDriverMutex == nullptr) {
+    twaiDriverMutex = xSemaphoreCreateMutex();
+    rxTaskParked = xSemaphoreCreateBinary();
+    rxTaskResume = xSemaphoreCreateBinary();
+  }
+}
+
 // ============================================================================
 // Queue Initialization
 // ============================================================================
 
 void initCanQueues() {
-  if (canTxQueue == nullptr) {
-    canTxQueue = xQueueCreate(CAN_TX_QUEUE_SIZE, sizeof(twai_message_t));
-    if (canTxQueue == nullptr) {
-      DBG_OUTPUT_PORT.println("[CAN Task] Failed to create canTxQueue");
+  for (int i = 0; i < CAN_TX_PRIORITY_COUNT; i++) {
+    if (canTxQueues[i] == nullptr) {
+      canTxQueues[i] = xQueueCreate(txQueueDepths[i], sizeof(twai_message_t));
+      if (canTxQueues[i] == nullptr) {
+        DBG_OUTPUT_PORT.printf("[CAN Task] Failed to create %s TX queue\n", txClassNames[i]);
+      }
     }
   }
   if (sdoResponseQueue == nullptr) {
@@ -82,6 +148,34 @@ void handleStopScanCommand(const CANCommand& cmd) {
   xQueueSend(canEventQueue, &evt, 0);
 }
 
+static void sendDataLogStatus(bool error) {
+  DataLogger& logger = DataLogger::instance();
+  CANEvent evt;
+  evt.type = EVT_DATA_LOG_STATUS;
+  evt.data.dataLogStatus.active = logger.isActive();
+  evt.data.dataLogStatus.error = error || logger.hasWriteError();
+  evt.data.dataLogStatus.paramCount = logger.getParamCount();
+  evt.data.dataLogStatus.budgetBytes = logger.getBudget();
+  evt.data.dataLogStatus.samples = logger.getSamples();
+  evt.data.dataLogStatus.dropped = logger.getDropped();
+  evt.data.dataLogStatus.fileNumber = logger.getFileNumber();
+  xQueueSend(canEventQueue, &evt, 0);
+}
+
+// The logger only sees values the spot value stream reads: a log whose parameters are not all
+// monitored any more would go on looking active without samples, so it ends with an error
+static void checkDataLogSampling() {
+  DataLogger& logger = DataLogger::instance();
+  for (size_t column = 0; logger.isActive() && column < logger.getParamCount(); column++) {
+    if (!SpotValuesManager::instance().isWaitingForParam(logger.getParamIdAt(column))) {
+      DBG_OUTPUT_PORT.printf("[CAN Task] Parameter %d no longer monitored, stopping data log\n",
+                             logger.getParamIdAt(column));
+      logger.stop();
+      sendDataLogStatus(true);
+    }
+  }
+}
+
 void handleConnectCommand(const CANCommand& cmd) {
   DBG_OUTPUT_PORT.printf("[CAN Task] Connecting to node %d\n", cmd.data.connect.nodeId);
 
@@ -107,10 +201,18 @@ void handleConnectCommand(const CANCommand& cmd) {
     evt.data.spotValuesStatus.active = false;
     xQueueSend(canEventQueue, &evt, 0);
   }
+  if (DataLogger::instance().isActive()) {
+    DataLogger::instance().stop();
+    sendDataLogStatus(false);
+  }
 
   // Clear interval messages when switching devices
   CanIntervalManager::instance().clearAllIntervals();
 
+  // Operations and parameter writes still queued were meant for the previous device
+  SdoOperationManager::instance().cancelAll();
+  ParamWriteQueue::instance().clear();
+
   OICan::Init(cmd.data.connect.nodeId, config.getBaudRateEnum(), config.getCanTXPin(), config.getCanRXPin());
 }
 
@@ -119,6 +221,8 @@ void handleSetNodeIdCommand(const CANCommand& cmd) {
 
   // Clear interval messages when switching devices
   CanIntervalManager::instance().clearAllIntervals();
+  SdoOperationManager::instance().cancelAll();
+  ParamWriteQueue::instance().clear();
 
   OICan::Init(cmd.data.setNodeId.nodeId, config.getBaudRateEnum(), config.getCanTXPin(), config.getCanRXPin());
 
@@ -151,14 +255,17 @@ void handleSetDeviceNameCommand(const CANCommand& cmd) {
 
 void handleStartSpotValuesCommand(const CANCommand& cmd) {
   SpotValuesManager::instance().start(cmd.data.spotValues.interval, cmd.data.spotValues.paramIds,
-                                      cmd.data.spotValues.paramCount);
+                                      cmd.data.spotValues.periods, cmd.data.spotValues.paramCount,
+                                      cmd.data.spotValues.window);
 
   CANEvent evt;
   evt.type = EVT_SPOT_VALUES_STATUS;
   evt.data.spotValuesStatus.active = true;
   evt.data.spotValuesStatus.interval = cmd.data.spotValues.interval;
   evt.data.spotValuesStatus.paramCount = cmd.data.spotValues.paramCount;
+  evt.data.spotValuesStatus.window = SpotValuesManager::instance().getWindow();
   xQueueSend(canEventQueue, &evt, 0);
+  checkDataLogSampling();
 }
 
 void handleStopSpotValuesCommand(const CANCommand& cmd) {
@@ -168,6 +275,62 @@ void handleStopSpotValuesCommand(const CANCommand& cmd) {
   evt.type = EVT_SPOT_VALUES_STATUS;
   evt.data.spotValuesStatus.active = false;
   xQueueSend(canEventQueue, &evt, 0);
+  checkDataLogSampling();
+}
+
+void handleGetSpotHistoryCommand(const CANCommand& cmd) {
+  const SpotHistoryCommand& query = cmd.data.spotHistory;
+  uint32_t now = millis();
+  uint32_t toMs = query.toMs != 0 ? query.toMs : now;
+  uint32_t fromMs = query.fromMs;
+  if (query.durationMs != 0) {
+    fromMs = query.durationMs >= toMs ? 0 : toMs - query.durationMs;  // Longer than uptime: from boot
+  }
+
+  CANEvent evt;
+  evt.type = EVT_SPOT_HISTORY;
+  evt.requestId = cmd.requestId;
+  evt.clientId = cmd.clientId;
+  evt.data.spotHistory.historyJson = SpotValuesManager::instance().getHistory().query(
+      query.paramCount > 0 ? query.paramIds : nullptr, query.paramCount, fromMs, toMs, query.resolutionMs, now);
+  evt.data.spotHistory.success = evt.data.spotHistory.historyJson != nullptr;
+  if (xQueueSend(canEventQueue, &evt, pdMS_TO_TICKS(QUEUE_SEND_TIMEOUT_MS)) != pdTRUE) {
+    releaseEventPayload(evt);
+  }
+}
+
+void handleStartDataLogCommand(const CANCommand& cmd) {
+  const DataLogCommand& request = cmd.data.dataLog;
+  const int* paramIds = request.paramIds;
+  int paramCount = request.paramCount;
+
+  // Without a list, log what is being monitored
+  SpotValuesManager& spotMgr = SpotValuesManager::instance();
+  int monitored[MAX_PARAM_IDS];
+  if (paramCount == 0) {
+    for (size_t slot = 0; slot < spotMgr.getParamCount() && paramCount < MAX_PARAM_IDS; slot++) {
+      monitored[paramCount++] = spotMgr.getParamIdAt(slot);
+    }
+    paramIds = monitored;
+  }
+
+  // Parameters not monitored would never get a sample
+  for (int i = 0; i < paramCount; i++) {
+    if (!spotMgr.isWaitingForParam(paramIds[i])) {
+      DBG_OUTPUT_PORT.printf("[CAN Task] Cannot log parameter %d: not monitored\n", paramIds[i]);
+      sendDataLogStatus(true);
+      return;
+    }
+  }
+
+  bool started = DataLogger::instance().start(DeviceConnection::instance().getNodeId(), paramIds, paramCount,
+                                              request.budgetBytes);
+  sendDataLogStatus(!started);
+}
+
+void handleStopDataLogCommand(const CANCommand& cmd) {
+  DataLogger::instance().stop();
+  sendDataLogStatus(false);
 }
 
 void handleDeleteDeviceCommand(const CANCommand& cmd) {
@@ -264,16 +427,27 @@ void handleUpdateCanIoFlagsCommand(const CANCommand& cmd) {
 // Periodic Task Functions
 // ============================================================================
 
+void handleUpdateParamCommand(const CANCommand& cmd) {
+  if (!ParamWriteQueue::instance().enqueue(cmd.data.setValue.paramId, cmd.data.setValue.value)) {
+    CANEvent evt;
+    evt.type = EVT_VALUE_SET;
+    evt.data.valueSet.paramId = cmd.data.setValue.paramId;
+    evt.data.valueSet.value = cmd.data.setValue.value;
+    evt.data.valueSet.result = SET_COMM_ERROR;
+    xQueueSend(canEventQueue, &evt, 0);
+  }
+}
+
 void processSpotValuesSequence() {
   SpotValuesManager& spotMgr = SpotValuesManager::instance();
 
   if (spotMgr.isActive()) {
-    // Check if it's time to reload the queue
-    if ((millis() - spotMgr.getLastCollectionTime()) >= spotMgr.getInterval()) {
+    // Check if it's time to send the batch
+    if ((millis() - spotMgr.getLastCollectionTime()) >= spotMgr.getFlushInterval()) {
       spotMgr.updateLastCollectionTime(millis());
-      spotMgr.reloadQueue();
+      spotMgr.flushBatch();
     }
-    // Always process queue and responses
+    // Always send the reads that are due
     spotMgr.processQueue();
   }
 }
@@ -308,6 +482,15 @@ void dispatchCommand(const CANCommand& cmd) {
     case CMD_STOP_SPOT_VALUES:
       handleStopSpotValuesCommand(cmd);
       break;
+    case CMD_GET_SPOT_HISTORY:
+      handleGetSpotHistoryCommand(cmd);
+      break;
+    case CMD_START_DATA_LOG:
+      handleStartDataLogCommand(cmd);
+      break;
+    case CMD_STOP_DATA_LOG:
+      handleStopDataLogCommand(cmd);
+      break;
     case CMD_DELETE_DEVICE:
       handleDeleteDeviceCommand(cmd);
       break;
@@ -332,7 +515,10 @@ void dispatchCommand(const CANCommand& cmd) {
     case CMD_UPDATE_CANIO_FLAGS:
       handleUpdateCanIoFlagsCommand(cmd);
       break;
-    // Task 34: Commands handled via SDO protocol layer (not dispatched here)
+    case CMD_UPDATE_PARAM:
+      handleUpdateParamCommand(cmd);
+      break;
+    // Task 34: Device operations, run step by step by SdoOperationManager
     case CMD_SAVE_TO_FLASH:
     case CMD_LOAD_FROM_FLASH:
     case CMD_LOAD_DEFAULTS:
@@ -345,9 +531,10 @@ void dispatchCommand(const CANCommand& cmd) {
     case CMD_ADD_CAN_MAPPING:
     case CMD_REMOVE_CAN_MAPPING:
     case CMD_LIST_ERRORS:
-      // These commands are processed directly in oi_can via SDO protocol
-      // They use canTxQueue/sdoResponseQueue, not the command dispatch
-      DBG_OUTPUT_PORT.printf("[CAN Task] Command %d should use SDO protocol layer\n", cmd.type);
+    case CMD_IMPORT_CAN_MAP:
+    case CMD_SNAPSHOT_PARAMS:
+    case CMD_RESTORE_PARAMS:
+      OICan::StartOperation(cmd);
       break;
   }
 }
@@ -362,14 +549,34 @@ static bool configureTwaiDriver(BaudRate baud, int txPin, int rxPin, const twai_
                                     .rx_io = static_cast<gpio_num_t>(rxPin),
                                     .clkout_io = TWAI_IO_UNUSED,
                                     .bus_off_io = TWAI_IO_UNUSED,
-                                    .tx_queue_len = 30,
-                                    .rx_queue_len = 30,
-                                    .alerts_enabled = TWAI_ALERT_NONE,
+                                    .tx_queue_len = CAN_DRIVER_TX_QUEUE_LEN,
+                                    .rx_queue_len = CAN_DRIVER_RX_QUEUE_LEN,
+                                    .alerts_enabled = TWAI_ALERT_RX_DATA | BUS_HEALTH_ALERTS,
                                     .clkout_divider = 0,
                                     .intr_flags = 0};
 
-  twai_stop();
-  twai_driver_uninstall();
+  initTwaiSync();
+
+  // Park the RX task outside the driver before it goes away. Without the park the driver
+  // would be pulled from under it, so the reconfigure is abandoned instead.
+  bool parked = false;
+  if (canRxTaskHandle != nullptr && xTaskGetCurrentTaskHandle() != canRxTaskHandle) {
+    xSemaphoreTake(rxTaskParked, 0);  // A park left over from an abandoned request
+    rxTaskPauseRequested = true;
+    parked = xSemaphoreTake(rxTaskParked, pdMS_TO_TICKS(CAN_RX_ALERT_WAIT_MS * 2)) == pdTRUE;
+    if (!parked) {
+      rxTaskPauseRequested = false;
+      DBG_OUTPUT_PORT.println("[CAN Driver] RX task did not park in time, driver left as is");
+      return false;
+    }
+  }
+  xSemaphoreTake(twaiDriverMutex, portMAX_DELAY);
+
+  twaiInstalled = false;
+  canHalStop();
+  canHalUninstall();
+  lastDriverStatus = twai_status_info_t();
+  recoveryPending = false;
 
   twai_timing_config_t t_config;
   switch (baud) {
@@ -384,178 +591,415 @@ static bool configureTwaiDriver(BaudRate baud, int txPin, int rxPin, const twai_
       break;
   }
 
-  if (twai_driver_install(&g_config, &t_config, &filter) == ESP_OK) {
+  bool started = false;
+  if (canHalInstall(&g_config, &t_config, &filter) == ESP_OK) {
     DBG_OUTPUT_PORT.println("[CAN Driver] TWAI driver installed");
+    twaiInstalled = true;
+
+    if (canHalStart() == ESP_OK) {
+      DBG_OUTPUT_PORT.println("[CAN Driver] TWAI driver started");
+      started = true;
+    } else {
+      DBG_OUTPUT_PORT.println("[CAN Driver] Failed to start TWAI driver");
+    }
   } else {
     DBG_OUTPUT_PORT.println("[CAN Driver] Failed to install TWAI driver");
-    return false;
   }
 
-  if (twai_start() == ESP_OK) {
-    DBG_OUTPUT_PORT.println("[CAN Driver] TWAI driver started");
-    return true;
-  } else {
-    DBG_OUTPUT_PORT.println("[CAN Driver] Failed to start TWAI driver");
-    return false;
+  portENTER_CRITICAL(&busStatusMux);
+  busStatus.state = started ? CAN_BUS_ERROR_ACTIVE : CAN_BUS_STOPPED;
+  busStatus.txErrorCounter = 0;
+  busStatus.rxErrorCounter = 0;
+  portEXIT_CRITICAL(&busStatusMux);
+
+  xSemaphoreGive(twaiDriverMutex);
+  if (parked) {
+    rxTaskPauseRequested = false;
+    xSemaphoreGive(rxTaskResume);
   }
+  return started;
 }
 
-bool initCanBusScanning(BaudRate baud, int txPin, int rxPin) {
-  DBG_OUTPUT_PORT.println("[CAN Driver] Initializing CAN bus for scanning (SDO + bootloader filter)");
+static bool sameFilter(const twai_filter_config_t& a, const twai_filter_config_t& b) {
+  return a.acceptance_code == b.acceptance_code && a.acceptance_mask == b.acceptance_mask &&
+         a.single_filter == b.single_filter;
+}
+
+// Install the tightest filter for the given SDO responses plus every other routed ID
+// (bootloader, and any consumer registered with CanRouter::registerId). The TWAI filter
+// can only change with a reinstall, so a running driver that already has the planned
+// filter is left alone.
+static bool applyAcceptanceFilter(BaudRate baud, int txPin, int rxPin, CanIdRange sdoResponses) {
+  std::vector<CanIdRange> routed;
+  CanRouter::instance().getRoutedIds(routed);
+
+  std::vector<CanIdRange> wanted = {sdoResponses,
+                                    {BOOTLOADER_RESPONSE_ID, BOOTLOADER_RESPONSE_ID}};  // Routed once tasks start
+  for (const CanIdRange& range : routed) {
+    bool sdoRange = range.first >= SDO_RESPONSE_BASE_ID && range.last <= SDO_RESPONSE_MAX_ID;
+    if (!sdoRange) {
+      wanted.push_back(range);
+    }
+  }
+
+  CanFilterPlan plan = planAcceptanceFilter(wanted);
+  DBG_OUTPUT_PORT.printf("[CAN Filter] code 0x%08lX mask 0x%08lX: %u IDs wanted, %u accepted (%.1f%% false accepts)\n",
+                         (unsigned long)plan.config.acceptance_code, (unsigned long)plan.config.acceptance_mask,
+                         plan.wantedIds, plan.acceptedIds, plan.falseAcceptRatio * 100.0f);
+
+  CanBusState state = busStatus.state;
+  bool running = twaiInstalled && (state == CAN_BUS_ERROR_ACTIVE || state == CAN_BUS_ERROR_WARNING ||
+                                   state == CAN_BUS_ERROR_PASSIVE);
+  bool started = true;
+  if (running && baud == activeBaud && txPin == activeTxPin && rxPin == activeRxPin &&
+      sameFilter(plan.config, activeFilter.config)) {
+    DBG_OUTPUT_PORT.println("[CAN Driver] Filter unchanged, keeping the driver running");
+  } else {
+    started = configureTwaiDriver(baud, txPin, rxPin, plan.config);
+    activeBaud = baud;
+    activeTxPin = txPin;
+    activeRxPin = rxPin;
+  }
 
-  // Dual filter mode for standard 11-bit IDs:
-  // - Filter 0 (bits [31:21]): Bootloader response 0x7DE (exact match)
-  // - Filter 1 (bits [15:5]): SDO response range 0x580-0x5FF
-  //
-  // SDO range: 0x580-0x5FF has common prefix 0b1011 (upper 4 bits),
-  // lower 7 bits vary, so we mask those out
-  twai_filter_config_t filter = {.acceptance_code =
-                                     (uint32_t)(SDO_RESPONSE_BASE_ID << 5) | (uint32_t)(BOOTLOADER_RESPONSE_ID << 21),
-                                 .acceptance_mask = (uint32_t)(0x7F << 5) | 0x1F | (uint32_t)(0x1F << 16),
-                                 .single_filter = false};
+  portENTER_CRITICAL(&busStatusMux);
+  activeFilter = plan;
+  portEXIT_CRITICAL(&busStatusMux);
+  return started;
+}
 
-  return configureTwaiDriver(baud, txPin, rxPin, filter);
+bool initCanBusScanning(BaudRate baud, int txPin, int rxPin) {
+  DBG_OUTPUT_PORT.println("[CAN Driver] Initializing CAN bus for scanning (all SDO responses)");
+  return applyAcceptanceFilter(baud, txPin, rxPin, {SDO_RESPONSE_BASE_ID, SDO_RESPONSE_MAX_ID});
 }
 
 bool initCanBusForDevice(uint8_t nodeId, BaudRate baud, int txPin, int rxPin) {
   DBG_OUTPUT_PORT.printf("[CAN Driver] Initializing CAN bus for device (nodeId=%d)\n", nodeId);
-
   uint16_t id = SDO_RESPONSE_BASE_ID + nodeId;
+  return applyAcceptanceFilter(baud, txPin, rxPin, {id, id});
+}
 
-  twai_filter_config_t filter = {.acceptance_code = (uint32_t)(id << 5) | (uint32_t)(BOOTLOADER_RESPONSE_ID << 21),
-                                 .acceptance_mask = 0x001F001F,
-                                 .single_filter = false};
-
-  return configureTwaiDriver(baud, txPin, rxPin, filter);
+CanFilterPlan getCanFilterPlan() {
+  portENTER_CRITICAL(&busStatusMux);
+  CanFilterPlan plan = activeFilter;
+  portEXIT_CRITICAL(&busStatusMux);
+  return plan;
 }
 
 // ============================================================================
-// CAN TX Queue Processing
+// CAN TX Task
 // ============================================================================
 
-static void processTxQueueInternal(int maxFrames) {
+bool canTxEnqueue(const twai_message_t* frame, TickType_t timeout, CanTxPriority priority) {
+  if (priority >= CAN_TX_PRIORITY_COUNT || canTxQueues[priority] == nullptr) {
+    return false;
+  }
+
+  bool queued = xQueueSend(canTxQueues[priority], frame, timeout) == pdTRUE;
+  uint32_t depth = uxQueueMessagesWaiting(canTxQueues[priority]);
+
+  portENTER_CRITICAL(&txStatsMux);
+  CanTxStats& stats = txStats[priority];
+  if (queued) {
+    stats.queued++;
+    stats.highWater = std::max(stats.highWater, depth);
+  } else {
+    stats.dropped++;
+  }
+  portEXIT_CRITICAL(&txStatsMux);
+
+  if (queued) {
+    canTxTaskWake();
+  }
+  return queued;
+}
+
+const char* canTxClassName(CanTxPriority priority) {
+  return priority < CAN_TX_PRIORITY_COUNT ? txClassNames[priority] : "unknown";
+}
+
+CanTxStats getCanTxStats(CanTxPriority priority) {
+  CanTxStats stats;
+  if (priority < CAN_TX_PRIORITY_COUNT) {
+    portENTER_CRITICAL(&txStatsMux);
+    stats = txStats[priority];
+    portEXIT_CRITICAL(&txStatsMux);
+  }
+  return stats;
+}
+
+static bool txFramesQueued() {
+  for (int i = 0; i < CAN_TX_PRIORITY_COUNT; i++) {
+    if (uxQueueMessagesWaiting(canTxQueues[i]) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Take the next frame from the highest-priority non-empty class
+static bool dequeueNextTxFrame(twai_message_t* frame, CanTxPriority* priority) {
+  for (int i = 0; i < CAN_TX_PRIORITY_COUNT; i++) {
+    if (xQueueReceive(canTxQueues[i], frame, 0) == pdTRUE) {
+      *priority = (CanTxPriority)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Hand every queued frame to the driver, one frame at a time in priority order so a frame
+// queued in a higher class while a lower class is draining goes out next
+static void transmitQueuedFrames() {
   twai_message_t txframe;
+  CanTxPriority priority;
 
-  for (int i = 0; i < maxFrames; i++) {
-    if (xQueueReceive(canTxQueue, &txframe, 0) == pdTRUE) {
-      esp_err_t result = twai_transmit(&txframe, pdMS_TO_TICKS(10));
-      if (result != ESP_OK) {
-        DBG_OUTPUT_PORT.printf("[CAN TX] Failed to transmit frame ID 0x%lX: err=%d\n",
-                               (unsigned long)txframe.identifier, result);
-      }
-      printCanTx(&txframe);
+  while (dequeueNextTxFrame(&txframe, &priority)) {
+    xSemaphoreTake(twaiDriverMutex, portMAX_DELAY);
+    esp_err_t result = twaiInstalled ? canHalTransmit(&txframe, pdMS_TO_TICKS(10)) : ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(twaiDriverMutex);
+
+    portENTER_CRITICAL(&txStatsMux);
+    if (result == ESP_OK) {
+      txStats[priority].sent++;
     } else {
-      break;  // Queue empty
+      txStats[priority].failed++;
+    }
+    portEXIT_CRITICAL(&txStatsMux);
+
+    // Every frame fails while bus-off - the RX task already logged that
+    bool busOff = busStatus.state == CAN_BUS_OFF || busStatus.state == CAN_BUS_RECOVERING;
+    if (result != ESP_OK && !busOff) {
+      DBG_OUTPUT_PORT.printf("[CAN TX] Failed to transmit %s frame ID 0x%lX: err=%d\n", txClassNames[priority],
+                             (unsigned long)txframe.identifier, result);
     }
+    printCanTx(&txframe);
   }
 }
 
-void processTxQueue() {
-  // Process up to a few frames per iteration to avoid blocking
-  processTxQueueInternal(5);
+void canTxTaskWake() {
+  TaskHandle_t handle = canTxTaskHandle;
+  if (handle != nullptr && xTaskGetCurrentTaskHandle() != handle) {
+    xTaskNotifyGive(handle);
+  }
+}
+
+// Owns the transmit side: periodic interval/CAN-IO frames and everything posted to canTxQueues.
+// Runs above canTask so periodic timing does not depend on RX processing or JSON serialization.
+static void canTxTask(void* parameter) {
+  DBG_OUTPUT_PORT.println("[CAN TX] Started");
+
+  while (true) {
+    if (!txFramesQueued()) {
+      uint32_t waitMs = std::min((uint32_t)CAN_TASK_MAX_WAIT_MS,
+                                 CanIntervalManager::instance().getMsUntilNextSend(millis()));
+      ulTaskNotifyTake(pdTRUE, waitMs > 0 ? std::max(pdMS_TO_TICKS(waitMs), (TickType_t)1) : 0);
+    }
+
+    CanIntervalManager::instance().sendPendingMessages();
+    CanIntervalManager::instance().sendCanIoMessage();
+    transmitQueuedFrames();
+  }
 }
 
 // ============================================================================
 // CAN Message Reception and Processing
 // ============================================================================
 
-// Helper: Extract parameter ID and value from SDO response frame
-// Returns true if this is a valid parameter value response (index 0x21xx)
-static bool parseParamValueResponse(const twai_message_t& frame, int& outParamId, double& outValue) {
-  // Check for abort response
-  if (frame.data[0] == SDOProtocol::ABORT) {
-    return false;
+static void routeCanFrame(const twai_message_t& rxframe) {
+  printCanRx(&rxframe);
+
+  if (!CanRouter::instance().dispatch(rxframe)) {
+    DBG_OUTPUT_PORT.printf("Received unwanted frame %" PRIu32 "\r\n", rxframe.identifier);
+  }
+}
+
+// RX-task only: the RX task is parked during reinstalls, so no driver mutex is needed
+static bool receiveCanFrame(twai_message_t* frame) {
+  return twaiInstalled && canHalReceive(frame, 0) == ESP_OK;
+}
+
+// Fold the driver's cumulative counters into rxStats/busStatus and report new RX losses
+static void updateDriverCounters() {
+  twai_status_info_t status;
+  if (!twaiInstalled || canHalGetStatusInfo(&status) != ESP_OK) {
+    return;
   }
 
-  // Parse index and subindex
-  uint16_t index = frame.data[1] | (frame.data[2] << 8);
-  uint8_t subIndex = frame.data[3];
+  uint32_t missed = status.rx_missed_count - lastDriverStatus.rx_missed_count;
+  uint32_t overrun = status.rx_overrun_count - lastDriverStatus.rx_overrun_count;
 
-  // Check if this is a parameter value response (index 0x21xx range)
-  if ((index & 0xFF00) != (SDOProtocol::INDEX_PARAM_UID & 0xFF00)) {
-    return false;
+  portENTER_CRITICAL(&busStatusMux);
+  busStatus.txErrorCounter = status.tx_error_counter;
+  busStatus.rxErrorCounter = status.rx_error_counter;
+  busStatus.txFailed += status.tx_failed_count - lastDriverStatus.tx_failed_count;
+  busStatus.arbLost += status.arb_lost_count - lastDriverStatus.arb_lost_count;
+  busStatus.busErrors += status.bus_error_count - lastDriverStatus.bus_error_count;
+  portEXIT_CRITICAL(&busStatusMux);
+
+  lastDriverStatus = status;
+
+  if (missed > 0 || overrun > 0) {
+    rxStats.rxMissed += missed;
+    rxStats.rxOverrun += overrun;
+    DBG_OUTPUT_PORT.printf("[CAN RX] Lost frames: %lu missed, %lu overrun (totals %lu/%lu)\n", (unsigned long)missed,
+                           (unsigned long)overrun, (unsigned long)rxStats.rxMissed, (unsigned long)rxStats.rxOverrun);
+  }
+}
+
+static void receiveAndProcessCanMessages() {
+  twai_message_t rxframe;
+  int processed = 0;
+
+  // One RX alert may stand for several frames, so drain until empty or out of budget
+  while (processed < CAN_RX_BUDGET_PER_ITERATION && receiveCanFrame(&rxframe)) {
+    routeCanFrame(rxframe);
+    processed++;
+  }
+
+  rxStats.framesReceived += processed;
+  rxBacklog = (processed == CAN_RX_BUDGET_PER_ITERATION);
+  if (rxBacklog) {
+    rxStats.budgetExhausted++;
   }
 
-  // Reconstruct paramId from index and subindex
-  outParamId = ((index & 0xFF) << 8) | subIndex;
+  updateDriverCounters();
+}
+
+CanRxStats getCanRxStats() {
+  return rxStats;
+}
+
+// ============================================================================
+// Bus Health and Bus-Off Recovery
+// ============================================================================
 
-  // Extract value (signed fixed-point with scale of 32)
-  outValue = ((double)*(int32_t*)&frame.data[4]) / 32.0;
+const char* canBusStateName(CanBusState state) {
+  switch (state) {
+    case CAN_BUS_STOPPED:
+      return "stopped";
+    case CAN_BUS_ERROR_ACTIVE:
+      return "errorActive";
+    case CAN_BUS_ERROR_WARNING:
+      return "errorWarning";
+    case CAN_BUS_ERROR_PASSIVE:
+      return "errorPassive";
+    case CAN_BUS_OFF:
+      return "busOff";
+    case CAN_BUS_RECOVERING:
+      return "recovering";
+  }
+  return "unknown";
+}
 
-  return true;
+CanBusStatus getCanBusStatus() {
+  portENTER_CRITICAL(&busStatusMux);
+  CanBusStatus status = busStatus;
+  portEXIT_CRITICAL(&busStatusMux);
+  return status;
 }
 
-// Helper: Send value set event
-static void sendValueSetEvent(int paramId, double value, SetValueResult result) {
+static void setBusState(CanBusState state) {
+  portENTER_CRITICAL(&busStatusMux);
+  CanBusState previous = busStatus.state;
+  busStatus.state = state;
+  portEXIT_CRITICAL(&busStatusMux);
+
+  if (state == previous) {
+    return;
+  }
+
+  DBG_OUTPUT_PORT.printf("[CAN Bus] %s -> %s (TEC %lu, REC %lu)\n", canBusStateName(previous), canBusStateName(state),
+                         (unsigned long)busStatus.txErrorCounter, (unsigned long)busStatus.rxErrorCounter);
+
   CANEvent evt;
-  evt.type = EVT_VALUE_SET;
-  evt.data.valueSet.paramId = paramId;
-  evt.data.valueSet.value = value;
-  evt.data.valueSet.result = result;
+  evt.type = EVT_CAN_BUS_STATUS;
+  evt.requestId = 0;
+  evt.data.canBusStatus.state = state;
   xQueueSend(canEventQueue, &evt, 0);
 }
 
-void receiveAndProcessCanMessages() {
-  twai_message_t rxframe;
+// RX task: react to bus health alerts. Bus-off schedules a recovery after a backoff that
+// grows while bus-off keeps recurring shortly after recovering (e.g. a shorted bus or a
+// bitrate mismatch), so the controller does not hammer a broken bus.
+static void handleBusAlerts(uint32_t alerts) {
+  uint32_t now = millis();
+  updateDriverCounters();
+
+  if (alerts & TWAI_ALERT_BUS_OFF) {
+    uint32_t backoff = CAN_BUS_OFF_RECOVERY_MIN_MS;
+    if (busStatus.recoveries > 0 && now - lastRecoveredMs < CAN_BUS_OFF_STABLE_MS) {
+      backoff = std::min((uint32_t)CAN_BUS_OFF_RECOVERY_MAX_MS, std::max(backoff, busStatus.recoveryBackoffMs * 2));
+    }
 
-  if (twai_receive(&rxframe, 0) == ESP_OK) {
-    printCanRx(&rxframe);
-
-    if (rxframe.identifier == BOOTLOADER_RESPONSE_ID) {
-      FirmwareUpdateHandler::instance().processResponse(&rxframe);
-    } else if (rxframe.identifier >= SDO_RESPONSE_BASE_ID && rxframe.identifier <= SDO_RESPONSE_MAX_ID) {
-      uint8_t nodeId = rxframe.identifier & 0x7F;
-      DeviceDiscovery::instance().updateLastSeenByNodeId(nodeId, millis());
-
-      // Parse response info for routing
-      uint16_t respIndex = rxframe.data[1] | (rxframe.data[2] << 8);
-      uint8_t respSubIndex = rxframe.data[3];
-      bool isAbort = (rxframe.data[0] == SDOProtocol::ABORT);
-      uint32_t errorCode = isAbort ? *(uint32_t*)&rxframe.data[4] : 0;
-
-      // Priority 1: Check for pending async write response (uses INDEX_PARAM_UID 0x21xx)
-      // This is checked first since it won't interfere with JSON download (INDEX_STRINGS 0x5001)
-      int paramId;
-      double value;
-      SetValueResult result;
-      if (SDOProtocol::matchPendingWrite(respIndex, respSubIndex, isAbort, errorCode, paramId, value, result)) {
-        sendValueSetEvent(paramId, value, result);
-        return;  // Response consumed
-      }
+    portENTER_CRITICAL(&busStatusMux);
+    busStatus.busOffCount++;
+    busStatus.lastBusOffMs = now;
+    busStatus.recoveryBackoffMs = backoff;
+    portEXIT_CRITICAL(&busStatusMux);
+
+    recoveryPending = true;
+    busOffAtMs = now;
+    DBG_OUTPUT_PORT.printf("[CAN Bus] Bus-off #%lu, recovering in %lu ms\n", (unsigned long)busStatus.busOffCount,
+                           (unsigned long)backoff);
+    setBusState(CAN_BUS_OFF);
+  }
 
-      // Priority 2: If DeviceConnection is actively downloading JSON, route all responses there
-      if (DeviceConnection::instance().isDownloadingJson()) {
-        if (sdoResponseQueue != nullptr) {
-          xQueueSend(sdoResponseQueue, &rxframe, 0);
-        }
-        return;
-      }
+  if (alerts & TWAI_ALERT_BUS_RECOVERED) {
+    // The controller comes out of recovery stopped
+    xSemaphoreTake(twaiDriverMutex, portMAX_DELAY);
+    esp_err_t result = twaiInstalled ? canHalStart() : ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(twaiDriverMutex);
 
-      // Priority 3: Check if this is a spot value response - route directly to manager
-      if (parseParamValueResponse(rxframe, paramId, value) &&
-          SpotValuesManager::instance().isWaitingForParam(paramId)) {
-        // Route directly to spot values manager (does not go to sdoResponseQueue)
-        SpotValuesManager::instance().handleResponse(paramId, value);
-      } else {
-        // Route to SDO response queue for other operations (GetCanMappings, etc.)
-        if (sdoResponseQueue != nullptr) {
-          xQueueSend(sdoResponseQueue, &rxframe, 0);
-        }
-      }
-    } else {
-      DBG_OUTPUT_PORT.printf("Received unwanted frame %" PRIu32 "\r\n", rxframe.identifier);
+    portENTER_CRITICAL(&busStatusMux);
+    busStatus.recoveries++;
+    portEXIT_CRITICAL(&busStatusMux);
+
+    recoveryPending = false;
+    lastRecoveredMs = now;
+    if (result != ESP_OK) {
+      DBG_OUTPUT_PORT.printf("[CAN Bus] Restart after recovery failed: err=%d\n", result);
     }
+    setBusState(result == ESP_OK ? CAN_BUS_ERROR_ACTIVE : CAN_BUS_STOPPED);
+    return;
+  }
+
+  if (busStatus.state == CAN_BUS_OFF || busStatus.state == CAN_BUS_RECOVERING) {
+    return;  // Error level alerts during recovery say nothing new
+  }
+  if (alerts & TWAI_ALERT_ERR_PASS) {
+    setBusState(CAN_BUS_ERROR_PASSIVE);
+  } else if (alerts & TWAI_ALERT_ABOVE_ERR_WARN) {
+    setBusState(CAN_BUS_ERROR_WARNING);
+  } else if (alerts & (TWAI_ALERT_BELOW_ERR_WARN | TWAI_ALERT_ERR_ACTIVE)) {
+    setBusState(CAN_BUS_ERROR_ACTIVE);
   }
 }
 
-// Check for pending write timeouts (call from main task loop)
-void checkPendingWriteTimeouts() {
-  int paramId;
-  double value;
-  SetValueResult result;
-  if (SDOProtocol::checkPendingWriteTimeout(paramId, value, result)) {
-    sendValueSetEvent(paramId, value, result);
+// RX task: start the scheduled recovery once its backoff has passed
+static void serviceBusOffRecovery() {
+  if (!recoveryPending || msRemaining(busOffAtMs, busStatus.recoveryBackoffMs, millis()) > 0) {
+    return;
   }
+  recoveryPending = false;
+
+  xSemaphoreTake(twaiDriverMutex, portMAX_DELAY);
+  esp_err_t result = twaiInstalled ? canHalInitiateRecovery() : ESP_ERR_INVALID_STATE;
+  xSemaphoreGive(twaiDriverMutex);
+
+  if (result == ESP_OK) {
+    setBusState(CAN_BUS_RECOVERING);
+  } else {
+    DBG_OUTPUT_PORT.printf("[CAN Bus] Could not initiate recovery: err=%d\n", result);
+  }
+}
+
+// How long the RX task may block in canHalReadAlerts()
+static TickType_t rxAlertWaitTicks() {
+  uint32_t waitMs = CAN_RX_ALERT_WAIT_MS;
+  if (recoveryPending) {
+    waitMs = std::min(waitMs, msRemaining(busOffAtMs, busStatus.recoveryBackoffMs, millis()));
+  }
+  return std::max(pdMS_TO_TICKS(waitMs), (TickType_t)1);
 }
 
 void processFirmwareUpdateState() {
@@ -579,34 +1023,119 @@ void processFirmwareUpdateState() {
   }
 }
 
+// ============================================================================
+// CAN RX Task
+// ============================================================================
+
+// Blocks on TWAI alerts, drains the driver and dispatches frames through CanRouter.
+// Also owns bus health: tracks error states and drives bus-off recovery.
+// Handlers that touch manager state are deferred to canTask (see CanRouter::deferred).
+static void canRxTask(void* parameter) {
+  DBG_OUTPUT_PORT.println("[CAN RX] Started");
+
+  while (true) {
+    if (rxTaskPauseRequested) {
+      // Wait to be resumed, or for the request to be withdrawn if the reconfigure gave up
+      xSemaphoreTake(rxTaskResume, 0);  // A resume from a park that ended on withdrawal
+      xSemaphoreGive(rxTaskParked);
+      while (xSemaphoreTake(rxTaskResume, pdMS_TO_TICKS(CAN_RX_ALERT_WAIT_MS)) != pdTRUE && rxTaskPauseRequested) {
+      }
+      continue;
+    }
+
+    if (!twaiInstalled) {
+      vTaskDelay(pdMS_TO_TICKS(CAN_RX_ALERT_WAIT_MS));
+      continue;
+    }
+
+    // Out of budget last pass - keep draining, but let equal-priority tasks run in between
+    if (rxBacklog) {
+      taskYIELD();
+      receiveAndProcessCanMessages();
+      continue;
+    }
+
+    uint32_t alerts = 0;
+    if (canHalReadAlerts(&alerts, rxAlertWaitTicks()) == ESP_OK) {
+      if (alerts & BUS_HEALTH_ALERTS) {
+        handleBusAlerts(alerts);
+      }
+      if (alerts & TWAI_ALERT_RX_DATA) {
+        receiveAndProcessCanMessages();
+      }
+    }
+    serviceBusOffRecovery();
+  }
+}
+
 // ============================================================================
 // CAN Task Main Function
 // ============================================================================
 
+void canTaskWake() {
+  TaskHandle_t handle = canTaskHandle;
+  if (handle != nullptr && xTaskGetCurrentTaskHandle() != handle) {
+    xTaskNotifyGive(handle);
+  }
+}
+
+// How long canTask may sleep before some scheduler or state machine needs it again.
+// Commands, deferred RX frames and SDO responses wake it earlier via notification.
+static TickType_t computeWaitTicks() {
+  if (uxQueueMessagesWaiting(canCommandQueue) > 0 || CanRouter::instance().hasDeferred()) {
+    return 0;
+  }
+
+  uint32_t now = millis();
+  uint32_t waitMs = CAN_TASK_MAX_WAIT_MS;
+  waitMs = std::min(waitMs, SpotValuesManager::instance().getMsUntilNextWork(now));
+  waitMs = std::min(waitMs, DataLogger::instance().getMsUntilNextWork(now));
+  waitMs = std::min(waitMs, SdoTransactionTable::instance().getMsUntilNextTimeout(now));
+  waitMs = std::min(waitMs, SdoOperationManager::instance().getMsUntilNextWork(now));
+  waitMs = std::min(waitMs, ParamWriteQueue::instance().getMsUntilNextWork(now));
+  waitMs = std::min(waitMs, DeviceConnection::instance().getMsUntilNextAction(now));
+  waitMs = std::min(waitMs, DeviceDiscovery::instance().getMsUntilNextScanStep(now));
+
+  if (waitMs == 0) {
+    return 0;
+  }
+  TickType_t ticks = pdMS_TO_TICKS(waitMs);
+  return ticks > 0 ? ticks : 1;
+}
+
+// Manager task: commands, deferred RX handlers and the SDO state machines.
+// Frames it produces go through canTxQueues to the TX task.
 void canTask(void* parameter) {
   DBG_OUTPUT_PORT.println("[CAN Task] Started");
 
   CANCommand cmd;
 
   while (true) {
+    // Sleep until work arrives (command, routed frame) or the next deadline
+    ulTaskNotifyTake(pdTRUE, computeWaitTicks());
+
     // Process commands from queue
-    if (xQueueReceive(canCommandQueue, &cmd, 0) == pdTRUE) {
+    while (xQueueReceive(canCommandQueue, &cmd, 0) == pdTRUE) {
       dispatchCommand(cmd);
     }
 
-    // Process CAN TX queue (frames from SDO protocol layer)
-    processTxQueue();
+    // Frames routed to manager-owned handlers by the RX task
+    CanRouter::instance().processDeferred();
 
-    // Periodic tasks
-    processSpotValuesSequence();
-    CanIntervalManager::instance().sendPendingMessages();
-    CanIntervalManager::instance().sendCanIoMessage();
+    // Completions and timeouts of concurrent SDO reads/writes
+    SdoTransactionTable::instance().process(millis());
+
+    // Multi-step device operations (error log, CAN mappings, device commands)
+    SdoOperationManager::instance().process(millis());
+
+    // Interactive parameter writes
+    ParamWriteQueue::instance().process(millis());
 
-    // CAN message reception and routing
-    receiveAndProcessCanMessages();
+    // Spot values polling
+    processSpotValuesSequence();
 
-    // Check for pending async write timeouts
-    checkPendingWriteTimeouts();
+    // Hand buffered data log rows to the writer
+    DataLogger::instance().process(millis());
 
     // Device connection state machine
     DeviceConnection::instance().processConnection();
@@ -616,8 +1145,45 @@ void canTask(void* parameter) {
 
     // Firmware update state handling
     processFirmwareUpdateState();
-
-    // Small delay to prevent task starvation
-    vTaskDelay(pdMS_TO_TICKS(1));
   }
 }
+
+// Register every consumer of received frames (see CanRouter for dispatch order)
+static void initCanRoutes() {
+  FirmwareUpdateHandler::instance().registerCanRoutes();
+  SdoTransactionTable::instance().registerCanRoutes();
+  DeviceDiscovery::instance().registerCanRoutes();
+  DeviceConnection::instance().registerCanRoutes();
+  SpotValuesManager::instance().registerCanRoutes();
+
+  // Anything unclaimed goes to SDO callers waiting on sdoResponseQueue (scan, serial reads, etc.)
+  CanRouter::instance().setSdoFallback([](const twai_message_t& frame) {
+    if (sdoResponseQueue != nullptr) {
+      xQueueSend(sdoResponseQueue, &frame, 0);
+    }
+    canTaskWake();
+    return true;
+  });
+}
+
+void startCanTasks() {
+  initTwaiSync();
+  initCanRoutes();
+  DataLogger::instance().begin();
+
+#if CONFIG_FREERTOS_UNICORE
+  xTaskCreate(canTxTask, "CAN_TX", CAN_TX_TASK_STACK_SIZE, nullptr, CAN_TX_TASK_PRIORITY, &canTxTaskHandle);
+  xTaskCreate(canRxTask, "CAN_RX", CAN_RX_TASK_STACK_SIZE, nullptr, CAN_RX_TASK_PRIORITY, &canRxTaskHandle);
+  xTaskCreate(canTask, "CAN_Task", CAN_TASK_STACK_SIZE, nullptr, CAN_TASK_PRIORITY, &canTaskHandle);
+  DBG_OUTPUT_PORT.println("CAN tasks spawned (single-core mode)");
+#else
+  xTaskCreatePinnedToCore(canTxTask, "CAN_TX", CAN_TX_TASK_STACK_SIZE, nullptr, CAN_TX_TASK_PRIORITY,
+                          &canTxTaskHandle, CAN_TX_TASK_CORE);
+  xTaskCreatePinnedToCore(canRxTask, "CAN_RX", CAN_RX_TASK_STACK_SIZE, nullptr, CAN_RX_TASK_PRIORITY,
+                          &canRxTaskHandle, CAN_RX_TASK_CORE);
+  xTaskCreatePinnedToCore(canTask, "CAN_Task", CAN_TASK_STACK_SIZE, nullptr, CAN_TASK_PRIORITY, &canTaskHandle,
+                          CAN_TASK_CORE);
+  DBG_OUTPUT_PORT.printf("CAN tasks spawned (TX core %d, RX core %d, manager core %d)\n", CAN_TX_TASK_CORE,
+                         CAN_RX_TASK_CORE, CAN_TASK_CORE);
+#endif
+}
@@ -6,21 +6,137 @@
 #include "freertos/task.h"
 
 #include "models/can_types.h"
+#include "utils/can_filter_planner.h"
 
-// Queue sizes
-#define CAN_TX_QUEUE_SIZE 20
-#define SDO_RESPONSE_QUEUE_SIZE 10
+// Queue sizes (TX depth is per priority class)
+#define CAN_TX_CONTROL_QUEUE_SIZE 8
+#define CAN_TX_BOOTLOADER_QUEUE_SIZE 8
+#define CAN_TX_SDO_QUEUE_SIZE 20
+#define CAN_TX_BACKGROUND_QUEUE_SIZE 16
+#define SDO_RESPONSE_QUEUE_SIZE (SDO_BLOCK_UPLOAD_SIZE + 16)  // A whole block can arrive between canTask wakes
+
+// Segments per SDO block upload block (parameter JSON download). At most 0x3F, so a segment's
+// sequence byte never looks like an expedited response or abort to the SDO matchers.
+#define SDO_BLOCK_UPLOAD_SIZE 32
+
+// TWAI driver TX queue depth. Kept shallow so frames already handed to the driver cannot
+// delay a higher-priority class for long.
+#define CAN_DRIVER_TX_QUEUE_LEN 4
+
+// TWAI driver RX queue depth (frames buffered between RX task wakes)
+#define CAN_DRIVER_RX_QUEUE_LEN 64
+// Max frames routed per RX pass; the rest are picked up on the next pass without waiting
+// for another alert, yielding in between so a saturated bus cannot monopolise the core
+#define CAN_RX_BUDGET_PER_ITERATION 32
+
+// CAN tasks never sleep longer than this, even with nothing scheduled (safety net for
+// state changed from other tasks without a wake-up)
+#define CAN_TASK_MAX_WAIT_MS 100
+// How long the RX task blocks in canHalReadAlerts() before re-checking for a driver reinstall
+#define CAN_RX_ALERT_WAIT_MS 100
+
+// Bus-off recovery backoff: the first recovery starts CAN_BUS_OFF_RECOVERY_MIN_MS after
+// bus-off; each bus-off within CAN_BUS_OFF_STABLE_MS of the last recovery doubles the
+// delay, up to CAN_BUS_OFF_RECOVERY_MAX_MS
+#define CAN_BUS_OFF_RECOVERY_MIN_MS 100
+#define CAN_BUS_OFF_RECOVERY_MAX_MS 10000
+#define CAN_BUS_OFF_STABLE_MS 5000
+
+// Task layout (override via build_flags). TX runs highest so periodic control frames keep
+// their timing, RX next so the driver queue does not overflow, and the manager task
+// (commands, state machines, JSON) lowest. Core pinning is ignored on single-core chips.
+#ifndef CAN_TX_TASK_PRIORITY
+  #define CAN_TX_TASK_PRIORITY 5
+#endif
+#ifndef CAN_RX_TASK_PRIORITY
+  #define CAN_RX_TASK_PRIORITY 4
+#endif
+#ifndef CAN_TASK_PRIORITY
+  #define CAN_TASK_PRIORITY 1
+#endif
+#ifndef CAN_TX_TASK_CORE
+  #define CAN_TX_TASK_CORE 0
+#endif
+#ifndef CAN_RX_TASK_CORE
+  #define CAN_RX_TASK_CORE 0
+#endif
+#ifndef CAN_TASK_CORE
+  #define CAN_TASK_CORE 0
+#endif
+#define CAN_TX_TASK_STACK_SIZE 4096
+#define CAN_RX_TASK_STACK_SIZE 4096
+#define CAN_TASK_STACK_SIZE 8192
 
 // CAN I/O queues (created in initCanQueues)
-extern QueueHandle_t canTxQueue;        // Raw CAN frames to transmit
-extern QueueHandle_t sdoResponseQueue;  // SDO responses for oi_can/SDO protocol
+extern QueueHandle_t canTxQueues[CAN_TX_PRIORITY_COUNT];  // Raw CAN frames to transmit, one per class
+extern QueueHandle_t sdoResponseQueue;                     // SDO responses for oi_can/SDO protocol
 
 // Initialize CAN queues (call before starting canTask)
 void initCanQueues();
 
-// CAN processing task - runs independently on separate core
+// CAN manager task - commands, deferred RX handlers, SDO state machines
 void canTask(void* parameter);
 
+// Create the CAN TX, RX and manager tasks (call after initCanQueues)
+void startCanTasks();
+
+// Wake canTask / the TX task so newly queued work is handled immediately instead of at the
+// next deadline. Safe to call from any task; a no-op from the task itself or before it exists.
+void canTaskWake();
+void canTxTaskWake();
+
+// RX statistics. Driver counters are folded in across driver reinstalls.
+struct CanRxStats {
+  uint32_t framesReceived = 0;   // Frames taken from the driver
+  uint32_t rxMissed = 0;         // Frames lost because the driver RX queue was full
+  uint32_t rxOverrun = 0;        // Frames lost to hardware RX FIFO overrun
+  uint32_t budgetExhausted = 0;  // Iterations that stopped at CAN_RX_BUDGET_PER_ITERATION
+};
+CanRxStats getCanRxStats();
+
+// Queue a frame in its TX priority class (use canQueueTransmit() from can_queue.h)
+bool canTxEnqueue(const twai_message_t* frame, TickType_t timeout, CanTxPriority priority);
+
+// Per-class TX statistics
+struct CanTxStats {
+  uint32_t queued = 0;     // Frames accepted into the class queue
+  uint32_t sent = 0;       // Frames accepted by the driver
+  uint32_t dropped = 0;    // Frames rejected because the class queue stayed full
+  uint32_t failed = 0;     // Frames the driver refused (bus off, driver TX queue full, ...)
+  uint32_t highWater = 0;  // Deepest the class queue has been
+};
+CanTxStats getCanTxStats(CanTxPriority priority);
+const char* canTxClassName(CanTxPriority priority);
+
+// Controller error state, as reported by TWAI alerts
+enum CanBusState : uint8_t {
+  CAN_BUS_STOPPED,
+  CAN_BUS_ERROR_ACTIVE,
+  CAN_BUS_ERROR_WARNING,  // TEC or REC above 96
+  CAN_BUS_ERROR_PASSIVE,  // TEC or REC above 127
+  CAN_BUS_OFF,            // TEC above 255, waiting for the recovery backoff
+  CAN_BUS_RECOVERING      // Recovery initiated, waiting for 128 x 11 recessive bits
+};
+
+// Bus health. Driver counters are folded in across driver reinstalls.
+struct CanBusStatus {
+  CanBusState state = CAN_BUS_STOPPED;
+  uint32_t txErrorCounter = 0;     // TEC
+  uint32_t rxErrorCounter = 0;     // REC
+  uint32_t txFailed = 0;           // Frames the controller gave up on
+  uint32_t arbLost = 0;            // Arbitration losses
+  uint32_t busErrors = 0;          // Bit, stuff, form, CRC and ACK errors
+  uint32_t busOffCount = 0;        // Times the controller went bus-off
+  uint32_t recoveries = 0;         // Completed bus-off recoveries
+  uint32_t lastBusOffMs = 0;       // millis() of the last bus-off (0 = never)
+  uint32_t recoveryBackoffMs = 0;  // Delay used for the last recovery
+};
+CanBusStatus getCanBusStatus();
+const char* canBusStateName(CanBusState state);
+
 // TWAI driver initialization functions
-bool initCanBusScanning(BaudRate baud, int txPin, int rxPin);                   // Initialize for scanning (accept all)
+// Both plan the acceptance filter from the SDO responses needed plus the routed IDs, and
+// keep the driver running when the filter does not change.
+bool initCanBusScanning(BaudRate baud, int txPin, int rxPin);                   // Initialize for scanning (all SDO)
 bool initCanBusForDevice(uint8_t nodeId, BaudRate baud, int txPin, int rxPin);  // Initialize for specific device
+CanFilterPlan getCanFilterPlan();                                               // Acceptance filter currently installed
@@ -2,17 +2,23 @@
 
 #include <ArduinoJson.h>
 
+#include <algorithm>
+#include <cstring>
 #include <functional>
 #include <map>
 
+#include "can_task.h"
 #include "firmware/update_handler.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "status_led.h"
 
+#include "managers/data_logger.h"
 #include "managers/device_connection.h"
 #include "managers/spot_values_manager.h"
 #include "models/can_event.h"
+#include "models/spot_value_frame.h"
+#include "protocols/sdo_rtt_estimator.h"
 
 #define DBG_OUTPUT_PORT Serial
 
@@ -44,6 +50,15 @@ static void serializeScanProgress(const CANEvent& evt, JsonObject& data) {
   data["endNode"] = evt.data.scanProgress.endNode;
 }
 
+static void serializeJsonProgress(const CANEvent& evt, JsonObject& data) {
+  data["bytesReceived"] = evt.data.jsonProgress.bytesReceived;
+  data["totalBytes"] = evt.data.jsonProgress.totalBytes;
+  data["complete"] = evt.data.jsonProgress.complete;
+  data["mode"] = evt.data.jsonProgress.blockMode ? "block" : "segmented";
+  data["elapsedMs"] = evt.data.jsonProgress.elapsedMs;
+  data["roundTrips"] = evt.data.jsonProgress.roundTrips;
+}
+
 static void serializeConnected(const CANEvent& evt, JsonObject& data) {
   data["nodeId"] = evt.data.connected.nodeId;
   data["serial"] = evt.data.connected.serial;
@@ -64,14 +79,25 @@ static void serializeSpotValuesStatus(const CANEvent& evt, JsonObject& data) {
   if (evt.data.spotValuesStatus.active) {
     data["interval"] = evt.data.spotValuesStatus.interval;
     data["paramCount"] = evt.data.spotValuesStatus.paramCount;
+    data["window"] = evt.data.spotValuesStatus.window;
   }
 }
 
-static void serializeSpotValues(const CANEvent& evt, JsonObject& data) {
-  data["timestamp"] = evt.data.spotValues.timestamp;
-  JsonDocument valuesDoc;
-  deserializeJson(valuesDoc, evt.data.spotValues.valuesJson);
-  data["values"] = valuesDoc;
+static void serializeDataLogStatus(const CANEvent& evt, JsonObject& data) {
+  const DataLogStatusEvent& status = evt.data.dataLogStatus;
+  data["active"] = status.active;
+  data["error"] = status.error;
+  data["samples"] = status.samples;
+  data["dropped"] = status.dropped;
+  if (status.active) {
+    data["paramCount"] = status.paramCount;
+    data["budget"] = status.budgetBytes;
+  }
+  if (status.fileNumber != 0) {
+    char name[16];
+    DataLogger::formatFileName(name, sizeof(name), status.fileNumber);
+    data["file"] = name;
+  }
 }
 
 static void serializeDeviceNameSet(const CANEvent& evt, JsonObject& data) {
@@ -111,6 +137,12 @@ static void serializeCanIoIntervalStatus(const CANEvent& evt, JsonObject& data)
   }
 }
 
+static void serializeCanBusStatus(const CANEvent& evt, JsonObject& data) {
+  serializeCanStatus(data);
+  // The state this event reports, even if the bus has moved on since it was queued
+  data["state"] = canBusStateName((CanBusState)evt.data.canBusStatus.state);
+}
+
 static void serializeError(const CANEvent& evt, JsonObject& data) {
   data["message"] = evt.data.error.message;
 }
@@ -148,17 +180,19 @@ static const std::map<CANEventType, EventInfo> eventDispatch = {
     {EVT_DEVICE_DISCOVERED, {"deviceDiscovered", serializeDeviceDiscovered}},
     {EVT_SCAN_STATUS, {"scanStatus", serializeScanStatus}},
     {EVT_SCAN_PROGRESS, {"scanProgress", serializeScanProgress}},
+    {EVT_JSON_PROGRESS, {"jsonProgress", serializeJsonProgress}},
     {EVT_CONNECTED, {"connected", serializeConnected}},
     {EVT_NODE_ID_INFO, {"nodeIdInfo", serializeNodeIdInfo}},
     {EVT_NODE_ID_SET, {"nodeIdSet", serializeNodeIdSet}},
     {EVT_SPOT_VALUES_STATUS, {"spotValuesStatus", serializeSpotValuesStatus}},
-    {EVT_SPOT_VALUES, {"spotValues", serializeSpotValues}},
+    {EVT_DATA_LOG_STATUS, {"dataLogStatus", serializeDataLogStatus}},
     {EVT_DEVICE_NAME_SET, {"deviceNameSet", serializeDeviceNameSet}},
     {EVT_DEVICE_DELETED, {"deviceDeleted", serializeDeviceDeleted}},
     {EVT_DEVICE_RENAMED, {"deviceRenamed", serializeDeviceRenamed}},
     {EVT_CAN_MESSAGE_SENT, {"canMessageSent", serializeCanMessageSent}},
     {EVT_CAN_INTERVAL_STATUS, {"canIntervalStatus", serializeCanIntervalStatus}},
     {EVT_CANIO_INTERVAL_STATUS, {"canIoIntervalStatus", serializeCanIoIntervalStatus}},
+    {EVT_CAN_BUS_STATUS, {"canStatus", serializeCanBusStatus}},
     {EVT_VALUE_SET, {"paramUpdateResult", serializeValueSet}},
     {EVT_ERROR, {"error", serializeError}}};
 
@@ -176,6 +210,311 @@ const char* serializeEvent(const CANEvent& evt, JsonDocument& doc) {
   return info.eventName;
 }
 
+// Task 34: results of device operations. Each has a success and an error event (the names
+// the UI already listens for); the serializer fills in data and returns whether it succeeded.
+using ResultSerializer = bool (*)(const CANEvent&, JsonObject&);
+
+struct ResultInfo {
+  const char* successName;
+  const char* errorName;
+  const char* successMessage;  // data.message on success (nullptr = none)
+  const char* errorMessage;    // data.error on failure (nullptr = set by the serializer)
+  ResultSerializer serializer;
+};
+
+static bool serializeDeviceCommand(const CANEvent& evt, JsonObject& data) {
+  return evt.data.deviceCommand.success;
+}
+
+static bool serializeCanMapCleared(const CANEvent& evt, JsonObject& data) {
+  data["isRx"] = evt.data.canMapCleared.isRx;
+  data["removed"] = evt.data.canMapCleared.removedCount;
+  return evt.data.canMapCleared.success;
+}
+
+static bool serializeCanMappings(const CANEvent& evt, JsonObject& data) {
+  if (!evt.data.canMappingsReceived.success) {
+    return false;
+  }
+  const char* json = evt.data.canMappingsReceived.mappingsJson;
+  data["mappings"] = serialized(json != nullptr ? json : "[]");
+  return true;
+}
+
+static bool serializeMappingChange(SetValueResult result, const char* invalidText, JsonObject& data) {
+  bool success = result == SetValueResult::SET_OK;
+  data["success"] = success;
+  if (result == SetValueResult::SET_UNKNOWN_INDEX) {
+    data["error"] = invalidText;
+  } else if (result == SetValueResult::SET_COMM_ERROR) {
+    data["error"] = "Communication error";
+  } else if (!success) {
+    data["error"] = "Unknown error";
+  }
+  return success;
+}
+
+static bool serializeCanMappingAdded(const CANEvent& evt, JsonObject& data) {
+  return serializeMappingChange(evt.data.canMappingAdded.result, "Invalid mapping parameters", data);
+}
+
+static bool serializeCanMappingRemoved(const CANEvent& evt, JsonObject& data) {
+  return serializeMappingChange(evt.data.canMappingRemoved.result, "Invalid index or subindex", data);
+}
+
+static bool serializeCanMapImported(const CANEvent& evt, JsonObject& data) {
+  const CanMapImportedEvent& imported = evt.data.canMapImported;
+  data["added"] = imported.added;
+  data["removed"] = imported.removed;
+  if (!imported.success) {
+    data["restored"] = imported.restored;
+    data["error"] = imported.restored ? "Import failed, previous CAN map restored"
+                                      : "Import failed, CAN map may be incomplete";
+  }
+  return imported.success;
+}
+
+static bool serializeErrorsListed(const CANEvent& evt, JsonObject& data) {
+  if (!evt.data.errorsListed.success) {
+    return false;
+  }
+  const char* json = evt.data.errorsListed.errorsJson;
+  data["errors"] = serialized(json != nullptr ? json : "[]");
+  return true;
+}
+
+static bool serializeSpotHistory(const CANEvent& evt, JsonObject& data) {
+  if (!evt.data.spotHistory.success) {
+    return false;
+  }
+  data["history"] = serialized(evt.data.spotHistory.historyJson);
+  return true;
+}
+
+static bool serializeParamsSnapshot(const CANEvent& evt, JsonObject& data) {
+  data["count"] = evt.data.paramsSnapshot.count;
+  data["skipped"] = evt.data.paramsSnapshot.skipped;
+  return evt.data.paramsSnapshot.success;
+}
+
+static bool serializeParamsRestored(const CANEvent& evt, JsonObject& data) {
+  const ParamsRestoredEvent& restored = evt.data.paramsRestored;
+  if (!restored.found) {
+    data["error"] = "No parameter snapshot for this device";
+    return false;
+  }
+  data["written"] = restored.written;
+  data["failed"] = restored.failed;
+  const char* json = restored.failuresJson;
+  data["failures"] = serialized(json != nullptr ? json : "[]");
+  if (!restored.success) {
+    data["error"] = restored.failed > 0 ? "Some parameters were not restored" : "Communication error";
+  }
+  return restored.success;
+}
+
+static const std::map<CANEventType, ResultInfo> resultDispatch = {
+    {EVT_FLASH_SAVED,
+     {"saveToFlashSuccess", "saveToFlashError", "Parameters saved to flash", "Failed to save parameters",
+      serializeDeviceCommand}},
+    {EVT_FLASH_LOADED,
+     {"loadFromFlashSuccess", "loadFromFlashError", "Parameters loaded from flash", "Failed to load parameters",
+      serializeDeviceCommand}},
+    {EVT_DEFAULTS_LOADED,
+     {"loadDefaultsSuccess", "loadDefaultsError", "Default parameters loaded", "Failed to load defaults",
+      serializeDeviceCommand}},
+    {EVT_DEVICE_STARTED,
+     {"startDeviceSuccess", "startDeviceError", "Device started", "Failed to start device", serializeDeviceCommand}},
+    {EVT_DEVICE_STOPPED,
+     {"stopDeviceSuccess", "stopDeviceError", "Device stopped", "Failed to stop device", serializeDeviceCommand}},
+    {EVT_DEVICE_RESET,
+     {"deviceReset", "deviceResetError", "Device reset command sent", "Device busy or not connected",
+      serializeDeviceCommand}},
+    {EVT_CAN_MAP_CLEARED,
+     {"canMapCleared", "canMapClearError", nullptr, "Failed to clear CAN map", serializeCanMapCleared}},
+    {EVT_CAN_MAPPINGS_RECEIVED,
+     {"canMappingsData", "canMappingsError", nullptr, "Failed to read CAN mappings", serializeCanMappings}},
+    {EVT_CAN_MAPPING_ADDED, {"canMappingAdded", "canMappingError", nullptr, nullptr, serializeCanMappingAdded}},
+    {EVT_CAN_MAPPING_REMOVED, {"canMappingRemoved", "canMappingError", nullptr, nullptr, serializeCanMappingRemoved}},
+    {EVT_CAN_MAP_IMPORTED, {"canMapImported", "canMapImportError", nullptr, nullptr, serializeCanMapImported}},
+    {EVT_ERRORS_LISTED,
+     {"listErrorsSuccess", "listErrorsError", nullptr, "Failed to read error log", serializeErrorsListed}},
+    {EVT_SPOT_HISTORY,
+     {"spotValueHistory", "spotValueHistoryError", nullptr, "Not enough memory for the history", serializeSpotHistory}},
+    {EVT_PARAMS_SNAPSHOT,
+     {"paramsSnapshotSaved", "paramsSnapshotError", "Parameter snapshot saved", "Failed to snapshot parameters",
+      serializeParamsSnapshot}},
+    {EVT_PARAMS_RESTORED, {"paramsRestored", "paramsRestoreError", nullptr, nullptr, serializeParamsRestored}}};
+
+static bool serializeResult(const CANEvent& evt, JsonDocument& doc) {
+  auto it = resultDispatch.find(evt.type);
+  if (it == resultDispatch.end()) {
+    return false;
+  }
+
+  const ResultInfo& info = it->second;
+  JsonObject data = doc["data"].to<JsonObject>();
+  bool success = info.serializer(evt, data);
+  doc["event"] = success ? info.successName : info.errorName;
+  if (success && info.successMessage != nullptr) {
+    data["message"] = info.successMessage;
+  } else if (!success && info.errorMessage != nullptr) {
+    data["error"] = info.errorMessage;
+  }
+  return true;
+}
+
+static void serializeRttStats(const SdoRttStats& stats, JsonObject data) {
+  data["samples"] = stats.samples;
+  data["srttUs"] = stats.srttUs;
+  data["rttVarUs"] = stats.rttVarUs;
+  data["lastRttUs"] = stats.lastRttUs;
+  data["minRttUs"] = stats.minRttUs;
+  data["maxRttUs"] = stats.maxRttUs;
+  data["timeouts"] = stats.timeouts;
+  data["backoff"] = stats.backoff;
+  data["rtoMs"] = stats.rtoMs;
+}
+
+void serializeCanStatus(JsonObject& data) {
+  CanBusStatus bus = getCanBusStatus();
+  data["state"] = canBusStateName(bus.state);
+  data["tec"] = bus.txErrorCounter;
+  data["rec"] = bus.rxErrorCounter;
+  data["txFailed"] = bus.txFailed;
+  data["arbLost"] = bus.arbLost;
+  data["busErrors"] = bus.busErrors;
+  data["busOffCount"] = bus.busOffCount;
+  data["recoveries"] = bus.recoveries;
+  data["lastBusOffMs"] = bus.lastBusOffMs;
+  data["recoveryBackoffMs"] = bus.recoveryBackoffMs;
+
+  CanRxStats rx = getCanRxStats();
+  JsonObject rxData = data["rx"].to<JsonObject>();
+  rxData["received"] = rx.framesReceived;
+  rxData["missed"] = rx.rxMissed;
+  rxData["overrun"] = rx.rxOverrun;
+  rxData["budgetExhausted"] = rx.budgetExhausted;
+
+  CanFilterPlan filter = getCanFilterPlan();
+  JsonObject filterData = data["filter"].to<JsonObject>();
+  filterData["code"] = filter.config.acceptance_code;
+  filterData["mask"] = filter.config.acceptance_mask;
+  filterData["wantedIds"] = filter.wantedIds;
+  filterData["acceptedIds"] = filter.acceptedIds;
+  filterData["falseAcceptRatio"] = filter.falseAcceptRatio;
+
+  JsonObject txData = data["tx"].to<JsonObject>();
+  for (int priority = 0; priority < CAN_TX_PRIORITY_COUNT; priority++) {
+    CanTxStats tx = getCanTxStats((CanTxPriority)priority);
+    JsonObject txClass = txData[canTxClassName((CanTxPriority)priority)].to<JsonObject>();
+    txClass["queued"] = tx.queued;
+    txClass["sent"] = tx.sent;
+    txClass["dropped"] = tx.dropped;
+    txClass["failed"] = tx.failed;
+    txClass["highWater"] = tx.highWater;
+  }
+
+  // Round-trip estimates behind the SDO timeouts: bus-wide and for the connected node
+  JsonObject rttData = data["sdoRtt"].to<JsonObject>();
+  serializeRttStats(SdoRttEstimator::instance().getBusStats(), rttData["bus"].to<JsonObject>());
+  uint8_t nodeId = DeviceConnection::instance().getNodeId();
+  if (nodeId != 0) {
+    rttData["nodeId"] = nodeId;
+    serializeRttStats(SdoRttEstimator::instance().getStats(nodeId), rttData["node"].to<JsonObject>());
+  }
+}
+
+// Send to the client the event is for, or to everyone for unsolicited events
+static void sendEvent(AsyncWebSocket& ws, const CANEvent& evt, const String& output) {
+  if (evt.clientId == 0) {
+    ws.textAll(output);
+    return;
+  }
+
+  AsyncWebSocketClient* client = ws.client(evt.clientId);
+  if (client == nullptr) {
+    DBG_OUTPUT_PORT.printf("[EventProcessor] Client %lu gone, result dropped\n", (unsigned long)evt.clientId);
+    return;
+  }
+  client->text(output);
+}
+
+// Clients that receive spot values as binary frames (0 = free). Written by the WebSocket
+// handlers, read by processEvents() in the main loop.
+static const int MAX_BINARY_SPOT_CLIENTS = 8;  // ESPAsyncWebServer's DEFAULT_MAX_WS_CLIENTS
+static uint32_t binarySpotClients[MAX_BINARY_SPOT_CLIENTS];
+static portMUX_TYPE binarySpotClientsLock = portMUX_INITIALIZER_UNLOCKED;
+
+bool setSpotValuesBinary(uint32_t clientId, bool binary) {
+  bool done = !binary;
+  portENTER_CRITICAL(&binarySpotClientsLock);
+  for (int i = 0; i < MAX_BINARY_SPOT_CLIENTS; i++) {
+    if (binarySpotClients[i] == clientId) {
+      binarySpotClients[i] = 0;
+    }
+  }
+  for (int i = 0; binary && !done && i < MAX_BINARY_SPOT_CLIENTS; i++) {
+    if (binarySpotClients[i] == 0) {
+      binarySpotClients[i] = clientId;
+      done = true;
+    }
+  }
+  portEXIT_CRITICAL(&binarySpotClientsLock);
+  return done;
+}
+
+// The spotValues event for clients that did not ask for binary frames
+static String formatSpotValuesJson(const uint8_t* frame, size_t length) {
+  SpotValueFrameHeader header;
+  memcpy(&header, frame, sizeof(header));
+
+  JsonDocument doc;
+  doc["event"] = "spotValues";
+  JsonObject data = doc["data"].to<JsonObject>();
+  data["timestamp"] = header.timestamp;
+  JsonObject values = data["values"].to<JsonObject>();
+  const uint8_t* in = frame + sizeof(header);
+  for (uint16_t i = 0; i < header.count && in + sizeof(SpotValueFrameRecord) <= frame + length; i++) {
+    SpotValueFrameRecord record;
+    memcpy(&record, in, sizeof(record));
+    in += sizeof(record);
+    values[String(record.paramId)] = record.value / 32.0;
+  }
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+// Handle EVT_SPOT_VALUES - the frame packed in canTask goes out unchanged to binary clients,
+// everyone else gets JSON formatted from it once
+static void handleSpotValuesEvent(AsyncWebSocket& ws, const CANEvent& evt) {
+  uint32_t binaryClients[MAX_BINARY_SPOT_CLIENTS];
+  portENTER_CRITICAL(&binarySpotClientsLock);
+  memcpy(binaryClients, binarySpotClients, sizeof(binaryClients));
+  portEXIT_CRITICAL(&binarySpotClientsLock);
+
+  const uint8_t* frame = evt.data.spotValues.frame;
+  size_t length = evt.data.spotValues.frameLength;
+  String json;  // Formatted for the first JSON client
+  for (AsyncWebSocketClient& client : ws.getClients()) {
+    if (client.status() != WS_CONNECTED) {
+      continue;
+    }
+    uint32_t clientId = client.id();
+    if (std::find(binaryClients, binaryClients + MAX_BINARY_SPOT_CLIENTS, clientId) !=
+        binaryClients + MAX_BINARY_SPOT_CLIENTS) {
+      client.binary(frame, length);
+      continue;
+    }
+    if (json.isEmpty()) {
+      json = formatSpotValuesJson(frame, length);
+    }
+    client.text(json);
+  }
+}
+
 // Handle EVT_JSON_READY - sends to specific client
 static void handleJsonReadyEvent(AsyncWebSocket& ws, const CANEvent& evt) {
   uint32_t clientId = evt.data.jsonReady.clientId;
@@ -218,17 +557,17 @@ static void handleJsonReadyEvent(AsyncWebSocket& ws, const CANEvent& evt) {
                          json.length());
 
   // Merge with latest spot values
-  const auto& latestSpotValues = SpotValuesManager::instance().getLatestValues();
-  if (!latestSpotValues.empty()) {
+  SpotValuesManager& spotValues = SpotValuesManager::instance();
+  if (spotValues.isActive()) {
     JsonDocument paramsDoc;
     DeserializationError error = deserializeJson(paramsDoc, json);
     if (!error) {
-      for (const auto& pair : latestSpotValues) {
-        String paramId = String(pair.first);
+      spotValues.forEachLatestValue([&paramsDoc](int id, double value) {
+        String paramId = String(id);
         if (paramsDoc.containsKey(paramId)) {
-          paramsDoc[paramId]["value"] = pair.second;
+          paramsDoc[paramId]["value"] = value;
         }
-      }
+      });
       json = "";
       serializeJson(paramsDoc, json);
     }
@@ -255,17 +594,20 @@ void processEvents(AsyncWebSocket& ws) {
       handleJsonReadyEvent(ws, evt);
       continue;
     }
+    if (evt.type == EVT_SPOT_VALUES) {
+      handleSpotValuesEvent(ws, evt);
+      releaseEventPayload(evt);
+      continue;
+    }
 
     JsonDocument doc;
-
-    const char* eventName = serializeEvent(evt, doc);
-    if (eventName == nullptr) {
-      continue;  // Unknown event type, skip
+    bool known = serializeResult(evt, doc) || serializeEvent(evt, doc) != nullptr;
+    if (known) {
+      String output;
+      serializeJson(doc, output);
+      sendEvent(ws, evt, output);
     }
-
-    String output;
-    serializeJson(doc, output);
-    ws.textAll(output);
+    releaseEventPayload(evt);  // Unknown event types are skipped, but still own their payload
   }
 }
 
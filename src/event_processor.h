@@ -25,10 +25,24 @@ void processEvents(AsyncWebSocket& ws);
  */
 void processFirmwareProgress(AsyncWebSocket& ws);
 
+/**
+ * Choose how a client receives spot values: binary frames (models/spot_value_frame.h) or
+ * the JSON spotValues event (the default). Safe to call from the WebSocket handlers.
+ * Returns false if binary was asked for but every binary slot is taken.
+ */
+bool setSpotValuesBinary(uint32_t clientId, bool binary);
+
 /**
  * Serialize a single event to JSON and return the event name.
  * Returns empty string if event type is unknown.
  */
 const char* serializeEvent(const CANEvent& evt, JsonDocument& doc);
 
+/**
+ * Serialize a snapshot of CAN bus health: controller state, TEC/REC, bus-off and
+ * recovery counts, RX loss counters, the acceptance filter and per-class TX statistics.
+ * Shared by the canStatus event, the getCanStatus action and GET /can/status.
+ */
+void serializeCanStatus(JsonObject& data);
+
 }  // namespace EventProcessor
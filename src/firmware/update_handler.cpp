@@ -23,6 +23,7 @@
 
 #include "models/can_types.h"
 #include "utils/can_queue.h"
+#include "utils/can_router.h"
 #include "utils/can_utils.h"
 
 #define DBG_OUTPUT_PORT Serial
@@ -52,6 +53,14 @@ int FirmwareUpdateHandler::startUpdate(const String& fileName, uint8_t nodeId) {
   return totalPages;
 }
 
+void FirmwareUpdateHandler::registerCanRoutes() {
+  CanRouter& router = CanRouter::instance();
+  router.registerId(BOOTLOADER_RESPONSE_ID, router.deferred([this](const twai_message_t& frame) {
+    processResponse(&frame);
+    return true;
+  }));
+}
+
 void FirmwareUpdateHandler::processResponse(const twai_message_t* rxframe) {
   switch (state) {
     case SEND_MAGIC:
@@ -188,7 +197,7 @@ void FirmwareUpdateHandler::handleCrcResponse(const twai_message_t* rxframe) {
 }
 
 void FirmwareUpdateHandler::sendFrame(const twai_message_t& frame) {
-  canQueueTransmit(&frame, pdMS_TO_TICKS(10));
+  canQueueTransmit(&frame, pdMS_TO_TICKS(10), CAN_TX_BOOTLOADER);
   printCanTx(&frame);
 }
 
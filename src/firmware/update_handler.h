@@ -39,6 +39,9 @@ public:
   // Process incoming CAN response frame
   void processResponse(const twai_message_t* rxframe);
 
+  // Register bootloader response route with CanRouter
+  void registerCanRoutes();
+
   // Status queries
   bool isInProgress() const;
   int getCurrentPage() const;
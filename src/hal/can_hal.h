@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+
+/**
+ * Thin CAN controller HAL
+ *
+ * Mirrors the subset of the ESP-IDF TWAI driver used by can_task.cpp, keeping the TWAI
+ * frame and config types as the common vocabulary so the ESP32 backend stays a 1:1
+ * pass-through. Exactly one backend is linked per build (selected by build_src_filter):
+ *   can_hal_twai.cpp      - ESP32 TWAI controller (all ESP32 environments)
+ *   can_hal_sim.cpp       - in-process simulated bus with OpenInverter nodes (native)
+ *   can_hal_socketcan.cpp - Linux SocketCAN interface, e.g. vcan0 (native-socketcan)
+ *
+ * Threading rules are the TWAI driver's: install/uninstall must not race with blocked
+ * receive/read_alerts calls (can_task.cpp parks the RX task around reinstalls).
+ */
+esp_err_t canHalInstall(const twai_general_config_t* generalConfig, const twai_timing_config_t* timingConfig,
+                        const twai_filter_config_t* filterConfig);
+esp_err_t canHalUninstall();
+esp_err_t canHalStart();
+esp_err_t canHalStop();
+esp_err_t canHalTransmit(const twai_message_t* frame, TickType_t ticksToWait);
+esp_err_t canHalReceive(twai_message_t* frame, TickType_t ticksToWait);
+esp_err_t canHalReadAlerts(uint32_t* alerts, TickType_t ticksToWait);
+esp_err_t canHalGetStatusInfo(twai_status_info_t* status);
+esp_err_t canHalInitiateRecovery();  // Only valid while bus-off; BUS_RECOVERED alert when done
+
+#ifdef CAN_HAL_SOCKETCAN
+// SocketCAN interface in use: $OI_CAN_INTERFACE, else CAN_SOCKETCAN_INTERFACE (default vcan0)
+const char* canHalSocketCanInterface();
+#endif
@@ -0,0 +1,251 @@
+#include "can_hal.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "sim/sim_bus.h"
+
+// Native backend: a TWAI-like controller on the simulated bus. Mirrors the driver's
+// observable behaviour - bounded TX/RX queues, acceptance filter, alerts and counters.
+
+namespace {
+
+std::mutex controllerLock;
+std::condition_variable rxChanged;  // RX queue or alerts changed
+std::condition_variable txChanged;  // A host frame left the wire
+
+bool installed = false;
+twai_state_t state = TWAI_STATE_STOPPED;
+twai_general_config_t generalConfig;
+twai_filter_config_t filterConfig;
+std::deque<twai_message_t> rxQueue;
+uint32_t txInFlight = 0;
+uint32_t pendingAlerts = 0;
+twai_status_info_t counters;
+
+void raiseAlertLocked(uint32_t alert) {
+  pendingAlerts |= alert & generalConfig.alerts_enabled;
+}
+
+// Acceptance filter as implemented by the TWAI controller (mask bit 1 = don't care)
+bool filterMatches(uint32_t code, uint32_t mask, uint32_t value, uint32_t compareMask) {
+  return ((code ^ value) & ~mask & compareMask) == 0;
+}
+
+bool acceptFrame(const twai_message_t& frame) {
+  uint32_t code = filterConfig.acceptance_code;
+  uint32_t mask = filterConfig.acceptance_mask;
+
+  if (filterConfig.single_filter) {
+    if (frame.extd) {
+      uint32_t value = (frame.identifier << 3) | (frame.rtr << 2);
+      return filterMatches(code, mask, value, 0xFFFFFFFC);
+    }
+    uint32_t value = (frame.identifier << 21) | (frame.rtr << 20) | ((uint32_t)frame.data[0] << 8) | frame.data[1];
+    uint32_t compareMask = 0xFFF00000 | (frame.data_length_code > 0 ? 0xFF00 : 0) |
+                           (frame.data_length_code > 1 ? 0xFF : 0);
+    return filterMatches(code, mask, value, compareMask);
+  }
+
+  if (frame.extd) {
+    // Each half compares extended ID bits 28:13
+    uint32_t idBits = (frame.identifier >> 13) & 0xFFFF;
+    return filterMatches(code >> 16, mask >> 16, idBits, 0xFFFF) || filterMatches(code, mask, idBits, 0xFFFF);
+  }
+
+  // Filter 1: ID, RTR and the first data byte split over bits 19:16 and 3:0
+  uint32_t value1 = (frame.identifier << 21) | (frame.rtr << 20);
+  uint32_t compareMask1 = 0xFFF00000;
+  if (frame.data_length_code > 0) {
+    value1 |= ((uint32_t)(frame.data[0] >> 4) << 16) | (frame.data[0] & 0x0F);
+    compareMask1 |= 0x000F000F;
+  }
+  // Filter 2: ID and RTR in bits 15:4
+  uint32_t value2 = (frame.identifier << 5) | (frame.rtr << 4);
+  return filterMatches(code, mask, value1, compareMask1) || filterMatches(code, mask, value2, 0xFFF0);
+}
+
+void onBusReceive(const twai_message_t& frame) {
+  {
+    std::lock_guard<std::mutex> guard(controllerLock);
+    if (!installed || state != TWAI_STATE_RUNNING || !acceptFrame(frame)) {
+      return;
+    }
+    if (rxQueue.size() >= generalConfig.rx_queue_len) {
+      counters.rx_missed_count++;
+      raiseAlertLocked(TWAI_ALERT_RX_QUEUE_FULL);
+    } else {
+      rxQueue.push_back(frame);
+      raiseAlertLocked(TWAI_ALERT_RX_DATA);
+    }
+  }
+  rxChanged.notify_all();
+}
+
+void onBusTransmitDone(const twai_message_t& frame, bool ack) {
+  {
+    std::lock_guard<std::mutex> guard(controllerLock);
+    if (txInFlight > 0) {
+      txInFlight--;
+    }
+    if (ack) {
+      raiseAlertLocked(TWAI_ALERT_TX_SUCCESS);
+    } else {
+      counters.tx_failed_count++;
+      raiseAlertLocked(TWAI_ALERT_TX_FAILED);
+    }
+    if (txInFlight == 0) {
+      raiseAlertLocked(TWAI_ALERT_TX_IDLE);
+    }
+  }
+  txChanged.notify_all();
+  rxChanged.notify_all();
+}
+
+const SimBusHost busHost = {onBusReceive, onBusTransmitDone};
+
+template <typename Predicate>
+bool waitTicks(std::condition_variable& condition, std::unique_lock<std::mutex>& lock, TickType_t ticks,
+               Predicate predicate) {
+  if (ticks == portMAX_DELAY) {
+    condition.wait(lock, predicate);
+    return true;
+  }
+  return condition.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), predicate);
+}
+
+}  // namespace
+
+esp_err_t canHalInstall(const twai_general_config_t* general, const twai_timing_config_t* timing,
+                        const twai_filter_config_t* filter) {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (general->rx_queue_len == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  generalConfig = *general;
+  filterConfig = *filter;
+  rxQueue.clear();
+  txInFlight = 0;
+  pendingAlerts = 0;
+  counters = twai_status_info_t();
+  state = TWAI_STATE_STOPPED;
+  installed = true;
+
+  uint32_t quantaPerBit = 1 + timing->tseg_1 + timing->tseg_2;
+  simBusSetBitrate(80000000 / (timing->brp * quantaPerBit));
+  simBusSetHost(&busHost);
+  return ESP_OK;
+}
+
+esp_err_t canHalUninstall() {
+  {
+    std::lock_guard<std::mutex> guard(controllerLock);
+    if (!installed || state == TWAI_STATE_RUNNING) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    installed = false;
+    rxQueue.clear();
+  }
+  rxChanged.notify_all();  // Release anyone still blocked in receive/read alerts
+  return ESP_OK;
+}
+
+esp_err_t canHalStart() {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (!installed || state != TWAI_STATE_STOPPED) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  state = TWAI_STATE_RUNNING;
+  return ESP_OK;
+}
+
+esp_err_t canHalStop() {
+  {
+    std::lock_guard<std::mutex> guard(controllerLock);
+    if (!installed || state != TWAI_STATE_RUNNING) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    state = TWAI_STATE_STOPPED;
+  }
+  rxChanged.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t canHalTransmit(const twai_message_t* frame, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(controllerLock);
+  if (!installed || state != TWAI_STATE_RUNNING) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!waitTicks(txChanged, lock, ticksToWait, []() { return txInFlight < generalConfig.tx_queue_len; })) {
+    return ESP_ERR_TIMEOUT;
+  }
+  txInFlight++;
+  lock.unlock();
+
+  simBusTransmit(*frame);
+  return ESP_OK;
+}
+
+esp_err_t canHalReceive(twai_message_t* frame, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(controllerLock);
+  if (!installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!waitTicks(rxChanged, lock, ticksToWait, []() { return !rxQueue.empty() || !installed; })) {
+    return ESP_ERR_TIMEOUT;
+  }
+  if (!installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  *frame = rxQueue.front();
+  rxQueue.pop_front();
+  return ESP_OK;
+}
+
+esp_err_t canHalReadAlerts(uint32_t* alerts, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(controllerLock);
+  if (!installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!waitTicks(rxChanged, lock, ticksToWait, []() { return pendingAlerts != 0 || !installed; })) {
+    *alerts = 0;
+    return ESP_ERR_TIMEOUT;
+  }
+  *alerts = pendingAlerts;
+  pendingAlerts = 0;
+  return ESP_OK;
+}
+
+esp_err_t canHalGetStatusInfo(twai_status_info_t* status) {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (!installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  *status = counters;
+  status->state = state;
+  status->msgs_to_tx = txInFlight;
+  status->msgs_to_rx = rxQueue.size();
+  return ESP_OK;
+}
+
+esp_err_t canHalInitiateRecovery() {
+  {
+    std::lock_guard<std::mutex> guard(controllerLock);
+    if (!installed || state != TWAI_STATE_BUS_OFF) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    // The simulated bus has no error confinement to wait out - recovery is immediate
+    state = TWAI_STATE_STOPPED;
+    counters.tx_error_counter = 0;
+    counters.rx_error_counter = 0;
+    raiseAlertLocked(TWAI_ALERT_BUS_RECOVERED);
+  }
+  rxChanged.notify_all();
+  return ESP_OK;
+}
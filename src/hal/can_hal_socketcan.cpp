@@ -0,0 +1,347 @@
+#include "can_hal.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/can.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Linux backend: a CAN_RAW socket on a SocketCAN interface (vcan0 by default). Bitrate and
+// bus-off restart belong to the interface (`ip link set can0 type can bitrate 500000
+// restart-ms 100`); the timing config is ignored. Controller error frames are turned into
+// TWAI alerts and counters, kernel socket drops into rx_missed_count.
+
+#ifndef CAN_SOCKETCAN_INTERFACE
+  #define CAN_SOCKETCAN_INTERFACE "vcan0"
+#endif
+
+namespace {
+
+std::mutex controllerLock;  // Guards everything below except the socket I/O itself
+
+int canSocket = -1;
+twai_state_t state = TWAI_STATE_STOPPED;
+uint32_t alertsEnabled = 0;
+uint32_t pendingAlerts = 0;
+twai_status_info_t counters;
+
+void raiseAlertLocked(uint32_t alert) {
+  pendingAlerts |= alert & alertsEnabled;
+}
+
+// TWAI acceptance filters compare standard and extended frames against different bit
+// fields of the same code/mask, so each TWAI filter becomes one SocketCAN filter per format.
+// Data byte comparisons (single filter, standard frames) cannot be expressed and are dropped,
+// which only makes the socket accept more.
+void addFilter(std::vector<can_filter>& filters, uint32_t id, uint32_t careBits, bool extended) {
+  can_filter filter;
+  filter.can_id = id | (extended ? CAN_EFF_FLAG : 0);
+  filter.can_mask = careBits | CAN_EFF_FLAG;
+  filters.push_back(filter);
+}
+
+std::vector<can_filter> translateFilter(const twai_filter_config_t& config) {
+  std::vector<can_filter> filters;
+  uint32_t code = config.acceptance_code;
+  uint32_t care = ~config.acceptance_mask;
+
+  if (config.single_filter) {
+    addFilter(filters, (code >> 21) & CAN_SFF_MASK, (care >> 21) & CAN_SFF_MASK, false);
+    addFilter(filters, (code >> 3) & CAN_EFF_MASK, (care >> 3) & CAN_EFF_MASK, true);
+  } else {
+    addFilter(filters, (code >> 21) & CAN_SFF_MASK, (care >> 21) & CAN_SFF_MASK, false);
+    addFilter(filters, (code >> 5) & CAN_SFF_MASK, (care >> 5) & CAN_SFF_MASK, false);
+    // Extended frames: each half compares ID bits 28:13
+    addFilter(filters, ((code >> 16) & 0xFFFF) << 13, ((care >> 16) & 0xFFFF) << 13, true);
+    addFilter(filters, (code & 0xFFFF) << 13, (care & 0xFFFF) << 13, true);
+  }
+  return filters;
+}
+
+int ticksToPollMs(TickType_t ticks) {
+  return ticks == portMAX_DELAY ? -1 : (int)(ticks * portTICK_PERIOD_MS);
+}
+
+bool waitForSocket(short events, TickType_t ticks) {
+  pollfd pfd = {canSocket, events, 0};
+  return poll(&pfd, 1, ticksToPollMs(ticks)) > 0 && (pfd.revents & events);
+}
+
+// Controller state changes, error counters and lost arbitration reported as error frames
+void handleErrorFrame(const can_frame& frame) {
+  std::lock_guard<std::mutex> guard(controllerLock);
+
+  if (frame.can_id & CAN_ERR_BUSOFF) {
+    state = TWAI_STATE_BUS_OFF;
+    raiseAlertLocked(TWAI_ALERT_BUS_OFF);
+  }
+  if (frame.can_id & CAN_ERR_RESTARTED) {
+    // Like TWAI, the controller comes back stopped and the owner restarts it
+    state = TWAI_STATE_STOPPED;
+    raiseAlertLocked(TWAI_ALERT_BUS_RECOVERED);
+  }
+  if (frame.can_id & CAN_ERR_LOSTARB) {
+    counters.arb_lost_count++;
+    raiseAlertLocked(TWAI_ALERT_ARB_LOST);
+  }
+  if (frame.can_id & (CAN_ERR_PROT | CAN_ERR_ACK | CAN_ERR_TRX)) {
+    counters.bus_error_count++;
+    raiseAlertLocked(TWAI_ALERT_BUS_ERROR);
+  }
+  if (frame.can_id & CAN_ERR_CRTL) {
+    uint8_t status = frame.data[1];
+    if (status & (CAN_ERR_CRTL_RX_OVERFLOW | CAN_ERR_CRTL_TX_OVERFLOW)) {
+      counters.rx_overrun_count++;
+      raiseAlertLocked(TWAI_ALERT_RX_FIFO_OVERRUN);
+    }
+    if (status & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) {
+      raiseAlertLocked(TWAI_ALERT_ABOVE_ERR_WARN);
+    }
+    if (status & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) {
+      raiseAlertLocked(TWAI_ALERT_ERR_PASS);
+    }
+    if (status & CAN_ERR_CRTL_ACTIVE) {
+      raiseAlertLocked(TWAI_ALERT_ERR_ACTIVE);
+    }
+  }
+  if (frame.can_id & CAN_ERR_CNT) {
+    counters.tx_error_counter = frame.data[6];
+    counters.rx_error_counter = frame.data[7];
+  }
+}
+
+// Non-blocking read of one data frame. Error frames are consumed and folded into the
+// counters. Returns false when the socket is empty.
+bool readFrame(twai_message_t* out) {
+  while (true) {
+    can_frame frame;
+    char control[CMSG_SPACE(sizeof(uint32_t))];
+    iovec iov = {&frame, sizeof(frame)};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t bytes = recvmsg(canSocket, &msg, MSG_DONTWAIT);
+    if (bytes < (ssize_t)sizeof(frame)) {
+      return false;
+    }
+
+    // SO_RXQ_OVFL: frames the kernel dropped for this socket so far
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+        uint32_t dropped;
+        memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+        std::lock_guard<std::mutex> guard(controllerLock);
+        if (dropped != counters.rx_missed_count) {
+          counters.rx_missed_count = dropped;
+          raiseAlertLocked(TWAI_ALERT_RX_QUEUE_FULL);
+        }
+      }
+    }
+
+    if (frame.can_id & CAN_ERR_FLAG) {
+      handleErrorFrame(frame);
+      continue;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->extd = (frame.can_id & CAN_EFF_FLAG) ? 1 : 0;
+    out->rtr = (frame.can_id & CAN_RTR_FLAG) ? 1 : 0;
+    out->identifier = frame.can_id & (out->extd ? CAN_EFF_MASK : CAN_SFF_MASK);
+    out->data_length_code = frame.can_dlc > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : frame.can_dlc;
+    memcpy(out->data, frame.data, out->data_length_code);
+    return true;
+  }
+}
+
+}  // namespace
+
+const char* canHalSocketCanInterface() {
+  const char* name = getenv("OI_CAN_INTERFACE");
+  return name != nullptr && name[0] != '\0' ? name : CAN_SOCKETCAN_INTERFACE;
+}
+
+esp_err_t canHalInstall(const twai_general_config_t* generalConfig, const twai_timing_config_t* timingConfig,
+                        const twai_filter_config_t* filterConfig) {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (canSocket >= 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (fd < 0) {
+    return ESP_FAIL;
+  }
+
+  ifreq ifr = {};
+  strncpy(ifr.ifr_name, canHalSocketCanInterface(), IFNAMSIZ - 1);
+  if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+    close(fd);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  sockaddr_can addr = {};
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return ESP_FAIL;
+  }
+
+  if (filterConfig->acceptance_mask != 0xFFFFFFFF) {
+    std::vector<can_filter> filters = translateFilter(*filterConfig);
+    setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(can_filter));
+  }
+
+  can_err_mask_t errorMask = CAN_ERR_BUSOFF | CAN_ERR_RESTARTED | CAN_ERR_LOSTARB | CAN_ERR_PROT | CAN_ERR_ACK |
+                             CAN_ERR_TRX | CAN_ERR_CRTL | CAN_ERR_CNT;
+  setsockopt(fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &errorMask, sizeof(errorMask));
+
+  int enable = 1;
+  setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  canSocket = fd;
+  state = TWAI_STATE_STOPPED;
+  alertsEnabled = generalConfig->alerts_enabled;
+  pendingAlerts = 0;
+  counters = twai_status_info_t();
+  return ESP_OK;
+}
+
+esp_err_t canHalUninstall() {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (canSocket < 0 || state == TWAI_STATE_RUNNING) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  close(canSocket);
+  canSocket = -1;
+  return ESP_OK;
+}
+
+esp_err_t canHalStart() {
+  {
+    std::lock_guard<std::mutex> guard(controllerLock);
+    if (canSocket < 0 || state != TWAI_STATE_STOPPED) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    state = TWAI_STATE_RUNNING;
+  }
+
+  // Like the TWAI RX queue, start empty - drop anything that arrived while stopped
+  twai_message_t stale;
+  while (readFrame(&stale)) {
+  }
+  return ESP_OK;
+}
+
+esp_err_t canHalStop() {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (canSocket < 0 || state == TWAI_STATE_STOPPED) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  state = TWAI_STATE_STOPPED;
+  return ESP_OK;
+}
+
+esp_err_t canHalTransmit(const twai_message_t* frame, TickType_t ticksToWait) {
+  if (canSocket < 0 || state != TWAI_STATE_RUNNING) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  can_frame out = {};
+  out.can_id = frame->identifier & (frame->extd ? CAN_EFF_MASK : CAN_SFF_MASK);
+  out.can_id |= (frame->extd ? CAN_EFF_FLAG : 0) | (frame->rtr ? CAN_RTR_FLAG : 0);
+  out.can_dlc = frame->data_length_code > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : frame->data_length_code;
+  memcpy(out.data, frame->data, out.can_dlc);
+
+  // The interface TX queue (txqueuelen) stands in for the driver TX queue
+  ssize_t written = write(canSocket, &out, sizeof(out));
+  if (written < 0 && (errno == EAGAIN || errno == ENOBUFS) && waitForSocket(POLLOUT, ticksToWait)) {
+    written = write(canSocket, &out, sizeof(out));
+  }
+
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (written != (ssize_t)sizeof(out)) {
+    counters.tx_failed_count++;
+    raiseAlertLocked(TWAI_ALERT_TX_FAILED);
+    return (errno == EAGAIN || errno == ENOBUFS) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+  }
+  raiseAlertLocked(TWAI_ALERT_TX_SUCCESS | TWAI_ALERT_TX_IDLE);
+  return ESP_OK;
+}
+
+esp_err_t canHalReceive(twai_message_t* frame, TickType_t ticksToWait) {
+  if (canSocket < 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  do {
+    // Error frames are read whatever the state, or the kernel's restart report after bus-off
+    // would never be seen. Data frames only count while running; otherwise they are dropped
+    // as the controller would drop them.
+    while (readFrame(frame)) {
+      if (state == TWAI_STATE_RUNNING) {
+        return ESP_OK;
+      }
+    }
+  } while (ticksToWait > 0 && waitForSocket(POLLIN, ticksToWait));
+  return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t canHalReadAlerts(uint32_t* alerts, TickType_t ticksToWait) {
+  if (canSocket < 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // Data waiting in the socket is the RX_DATA alert; anything else was raised by the
+  // error frame, overflow and transmit paths
+  bool readable = waitForSocket(POLLIN, 0) || (pendingAlerts == 0 && waitForSocket(POLLIN, ticksToWait));
+
+  // Stopped, bus-off or recovering: nothing is received, so nobody would read the socket.
+  // Drain it here instead, so error frames (the restart among them) still raise their
+  // alerts and a readable socket does not look like RX_DATA forever.
+  if (readable && state != TWAI_STATE_RUNNING) {
+    twai_message_t dropped;
+    while (readFrame(&dropped)) {
+    }
+    readable = false;
+  }
+
+  std::lock_guard<std::mutex> guard(controllerLock);
+  *alerts = pendingAlerts | (readable ? alertsEnabled & TWAI_ALERT_RX_DATA : 0);
+  pendingAlerts = 0;
+  return *alerts != 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t canHalGetStatusInfo(twai_status_info_t* status) {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (canSocket < 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  *status = counters;
+  status->state = state;
+  return ESP_OK;
+}
+
+esp_err_t canHalInitiateRecovery() {
+  std::lock_guard<std::mutex> guard(controllerLock);
+  if (canSocket < 0 || state != TWAI_STATE_BUS_OFF) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  // The kernel restarts the interface itself (ip link ... restart-ms N) and reports it
+  // with a CAN_ERR_RESTARTED error frame; until then we are only waiting
+  state = TWAI_STATE_RECOVERING;
+  return ESP_OK;
+}
@@ -0,0 +1,40 @@
+#include "can_hal.h"
+
+// ESP32 backend: straight pass-through to the TWAI driver
+
+esp_err_t canHalInstall(const twai_general_config_t* generalConfig, const twai_timing_config_t* timingConfig,
+                        const twai_filter_config_t* filterConfig) {
+  return twai_driver_install(generalConfig, timingConfig, filterConfig);
+}
+
+esp_err_t canHalUninstall() {
+  return twai_driver_uninstall();
+}
+
+esp_err_t canHalStart() {
+  return twai_start();
+}
+
+esp_err_t canHalStop() {
+  return twai_stop();
+}
+
+esp_err_t canHalTransmit(const twai_message_t* frame, TickType_t ticksToWait) {
+  return twai_transmit(frame, ticksToWait);
+}
+
+esp_err_t canHalReceive(twai_message_t* frame, TickType_t ticksToWait) {
+  return twai_receive(frame, ticksToWait);
+}
+
+esp_err_t canHalReadAlerts(uint32_t* alerts, TickType_t ticksToWait) {
+  return twai_read_alerts(alerts, ticksToWait);
+}
+
+esp_err_t canHalGetStatusInfo(twai_status_info_t* status) {
+  return twai_get_status_info(status);
+}
+
+esp_err_t canHalInitiateRecovery() {
+  return twai_initiate_recovery();
+}
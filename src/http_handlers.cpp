@@ -4,12 +4,17 @@
 #include <ESPAsyncWebServer.h>
 #include <LittleFS.h>
 
+#include <memory>
+
 #include "config.h"
+#include "event_processor.h"
 #include "main.h"
 #include "oi_can.h"
 
 #include "managers/device_connection.h"
+#include "managers/data_logger.h"
 #include "managers/device_discovery.h"
+#include "utils/data_log_reader.h"
 
 // External references to globals from main.cpp
 extern AsyncWebSocket ws;
@@ -119,6 +124,95 @@ void handleDevices(AsyncWebServerRequest* request) {
   request->send(200, "application/json", result);
 }
 
+// Handle CAN bus status endpoint
+void handleCanStatus(AsyncWebServerRequest* request) {
+  JsonDocument doc;
+  JsonObject data = doc.to<JsonObject>();
+  EventProcessor::serializeCanStatus(data);
+
+  String result;
+  serializeJson(doc, result);
+  request->send(200, "application/json", result);
+}
+
+// List the data log files with the logger state and flash usage. LittleFS keeps directory
+// entries sorted by name, so the files come oldest first.
+void handleLogs(AsyncWebServerRequest* request) {
+  DataLogger& logger = DataLogger::instance();
+  JsonDocument doc;
+  doc["active"] = logger.isActive();
+  doc["totalBytes"] = LittleFS.totalBytes();
+  doc["usedBytes"] = LittleFS.usedBytes();
+
+  JsonArray files = doc["files"].to<JsonArray>();
+  File dir = LittleFS.open(DATA_LOG_DIR);
+  for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+    uint32_t number = DataLogger::fileNumberOf(entry.name());
+    if (number != 0) {
+      JsonObject file = files.add<JsonObject>();
+      file["name"] = entry.name();
+      file["size"] = entry.size();
+      file["writing"] = number == logger.getFileNumber();
+    }
+  }
+  dir.close();
+
+  String result;
+  serializeJson(doc, result);
+  request->send(200, "application/json", result);
+}
+
+// Stream a data log file: as stored, or with format=csv decoded to CSV, optionally limited
+// to from/to (device millis()). Neither loads the file into memory.
+void handleLogDownload(AsyncWebServerRequest* request) {
+  String name = request->arg("file");
+  String path = String(DATA_LOG_DIR "/") + name;
+  if (!DataLogger::isLogFileName(name.c_str()) || !LittleFS.exists(path)) {
+    request->send(404, "text/plain", "Log file not found");
+    return;
+  }
+
+  if (request->arg("format") != "csv") {
+    request->send(request->beginResponse(LittleFS, path, "application/octet-stream", true));
+    return;
+  }
+
+  uint32_t fromMs = request->hasArg("from") ? strtoul(request->arg("from").c_str(), nullptr, 10) : 0;
+  uint32_t toMs = request->hasArg("to") ? strtoul(request->arg("to").c_str(), nullptr, 10) : UINT32_MAX;
+  auto reader = std::make_shared<DataLogReader>(LittleFS.open(path, "r"), fromMs, toMs);
+  if (!reader->begin()) {
+    request->send(500, "text/plain", "Not a readable data log");
+    return;
+  }
+
+  // The reader lives as long as the response; each chunk decodes just enough rows to fill it
+  AsyncWebServerResponse* response = request->beginChunkedResponse(
+      "text/csv", [reader](uint8_t* buffer, size_t maxLen, size_t index) { return reader->read(buffer, maxLen); });
+  String csvName = name.substring(0, name.length() - 4) + ".csv";
+  response->addHeader("Content-Disposition", "attachment; filename=\"" + csvName + "\"");
+  request->send(response);
+}
+
+// Delete a data log file, other than the one being written
+void handleLogDelete(AsyncWebServerRequest* request) {
+  String name = request->arg("file");
+  uint32_t number = DataLogger::fileNumberOf(name.c_str());
+  if (number == 0) {
+    request->send(404, "text/plain", "Log file not found");
+    return;
+  }
+  if (number == DataLogger::instance().getFileNumber()) {
+    request->send(409, "text/plain", "Log file is being written");
+    return;
+  }
+
+  if (!LittleFS.remove(String(DATA_LOG_DIR "/") + name)) {
+    request->send(404, "text/plain", "Log file not found");
+    return;
+  }
+  request->send(200, "text/plain", "Log file deleted");
+}
+
 // Handle settings endpoint (GET and POST)
 void handleSettings(AsyncWebServerRequest* request) {
   // If query parameters are provided, update settings
@@ -252,6 +346,10 @@ void registerHttpRoutes(AsyncWebServer& server) {
   server.on("/version", HTTP_GET, handleVersion);
   server.on("/devices", HTTP_GET, handleDevices);
   server.on("/settings", HTTP_GET, handleSettings);
+  server.on("/can/status", HTTP_GET, handleCanStatus);
+  server.on("/logs/download", HTTP_GET, handleLogDownload);  // Before /logs, which also matches it
+  server.on("/logs", HTTP_GET, handleLogs);
+  server.on("/logs", HTTP_DELETE, handleLogDelete);
   server.on("/ota/upload", HTTP_POST, handleOtaUploadComplete, handleOtaUpload);
   server.onNotFound(handleFileRequest);
 }
@@ -23,6 +23,7 @@
 #include "managers/device_discovery.h"
 #include "models/can_event.h"
 #include "utils/can_hardware.h"
+#include "utils/can_queue_benchmark.h"
 #include "utils/string_utils.h"
 
 // ============================================================================
@@ -125,15 +126,12 @@ void setup(void) {
   // Note: JSON download progress callback removed - async download now uses
   // EVT_JSON_READY event for completion notification to specific client
 
-  // Initialize CAN queues and spawn CAN task
+  // Initialize CAN queues and spawn CAN tasks
   initCanQueues();
-#if CONFIG_FREERTOS_UNICORE
-  xTaskCreate(canTask, "CAN_Task", 8192, nullptr, 1, nullptr);
-  DBG_OUTPUT_PORT.println("CAN task spawned (single-core mode)");
-#else
-  xTaskCreatePinnedToCore(canTask, "CAN_Task", 8192, nullptr, 1, nullptr, 0);
-  DBG_OUTPUT_PORT.println("CAN task spawned on Core 0 (dual-core mode)");
+#ifdef CAN_QUEUE_BENCHMARK
+  runCanQueueBenchmark();
 #endif
+  startCanTasks();
 
   // WebSocket setup
   ws.onEvent(onWebSocketEvent);
@@ -2,6 +2,7 @@
 
 #include <ESPAsyncWebServer.h>
 
+#include "can_task.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "status_led.h"
@@ -53,6 +54,7 @@ inline void statusLEDOff() {
  */
 inline bool queueCanCommand(const CANCommand& cmd, const char* commandName) {
   if (xQueueSend(canCommandQueue, &cmd, pdMS_TO_TICKS(QUEUE_SEND_TIMEOUT_MS)) == pdTRUE) {
+    canTaskWake();
     DBG_OUTPUT_PORT.printf("[WebSocket] %s command queued\n", commandName);
     return true;
   } else {
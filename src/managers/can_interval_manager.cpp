@@ -2,8 +2,12 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
+
+#include "../can_task.h"
 #include "../oi_can.h"
 #include "../utils/can_io_utils.h"
+#include "../utils/deadline.h"
 
 #define DBG_OUTPUT_PORT Serial
 
@@ -25,12 +29,16 @@ CanIntervalManager::CanIntervalManager() {
   canIoInterval_.lastSentTime = 0;
   canIoInterval_.sequenceCounter = 0;
   canIoInterval_.useCrc = false;
+
+  mutex_ = xSemaphoreCreateMutex();
 }
 
 void CanIntervalManager::startInterval(const char* intervalId, uint32_t canId, const uint8_t* data, uint8_t dataLength,
                                        uint32_t intervalMs) {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+
   // Remove existing interval with same ID
-  stopInterval(intervalId);
+  stopIntervalLocked(intervalId);
 
   // Add new interval message
   IntervalCanMessage msg;
@@ -43,12 +51,20 @@ void CanIntervalManager::startInterval(const char* intervalId, uint32_t canId, c
   msg.intervalMs = intervalMs;
   msg.lastSentTime = millis();
   intervalMessages_.push_back(msg);
+  xSemaphoreGive(mutex_);
+  canTxTaskWake();  // Reschedule the TX task for the new deadline
 
   DBG_OUTPUT_PORT.printf("[CanIntervalManager] Started interval: ID=%s, CAN=0x%03lX, Interval=%lums\n", intervalId,
                          (unsigned long)canId, (unsigned long)intervalMs);
 }
 
 void CanIntervalManager::stopInterval(const char* intervalId) {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  stopIntervalLocked(intervalId);
+  xSemaphoreGive(mutex_);
+}
+
+void CanIntervalManager::stopIntervalLocked(const char* intervalId) {
   for (auto it = intervalMessages_.begin(); it != intervalMessages_.end();) {
     if (it->id == intervalId) {
       DBG_OUTPUT_PORT.printf("[CanIntervalManager] Stopped interval: ID=%s\n", intervalId);
@@ -60,22 +76,29 @@ void CanIntervalManager::stopInterval(const char* intervalId) {
 }
 
 void CanIntervalManager::clearAllIntervals() {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
   if (!intervalMessages_.empty()) {
     DBG_OUTPUT_PORT.printf("[CanIntervalManager] Clearing %d interval message(s)\n", intervalMessages_.size());
     intervalMessages_.clear();
   }
+  xSemaphoreGive(mutex_);
 }
 
 bool CanIntervalManager::hasInterval(const char* intervalId) const {
+  bool found = false;
+  xSemaphoreTake(mutex_, portMAX_DELAY);
   for (const auto& msg : intervalMessages_) {
     if (msg.id == intervalId) {
-      return true;
+      found = true;
+      break;
     }
   }
-  return false;
+  xSemaphoreGive(mutex_);
+  return found;
 }
 
 void CanIntervalManager::sendPendingMessages() {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
   uint32_t currentTime = millis();
   for (auto& msg : intervalMessages_) {
     if ((currentTime - msg.lastSentTime) >= msg.intervalMs) {
@@ -83,11 +106,13 @@ void CanIntervalManager::sendPendingMessages() {
       OICan::SendCanMessage(msg.canId, msg.data, msg.dataLength);
     }
   }
+  xSemaphoreGive(mutex_);
 }
 
 void CanIntervalManager::startCanIoInterval(uint32_t canId, uint16_t pot, uint16_t pot2, uint8_t canio,
                                             uint16_t cruisespeed, uint8_t regenpreset, uint32_t intervalMs,
                                             bool useCrc) {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
   canIoInterval_.active = true;
   canIoInterval_.canId = canId;
   canIoInterval_.pot = pot;
@@ -100,25 +125,34 @@ void CanIntervalManager::startCanIoInterval(uint32_t canId, uint16_t pot, uint16
   canIoInterval_.lastSentTime = millis();
   // Start with counter=1 to avoid matching the last message from a previous session
   canIoInterval_.sequenceCounter = 1;
+  xSemaphoreGive(mutex_);
+  canTxTaskWake();
 
   DBG_OUTPUT_PORT.printf("[CanIntervalManager] Started CAN IO interval: CAN=0x%03lX, canio=0x%02X, Interval=%lums\n",
-                         (unsigned long)canIoInterval_.canId, canIoInterval_.canio,
-                         (unsigned long)canIoInterval_.intervalMs);
+                         (unsigned long)canId, canio, (unsigned long)intervalMs);
 }
 
 void CanIntervalManager::stopCanIoInterval() {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
   canIoInterval_.active = false;
+  xSemaphoreGive(mutex_);
   DBG_OUTPUT_PORT.println("[CanIntervalManager] Stopped CAN IO interval");
 }
 
 void CanIntervalManager::updateCanIoFlags(uint16_t pot, uint16_t pot2, uint8_t canio, uint16_t cruisespeed,
                                           uint8_t regenpreset) {
-  if (canIoInterval_.active) {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  bool active = canIoInterval_.active;
+  if (active) {
     canIoInterval_.pot = pot;
     canIoInterval_.pot2 = pot2;
     canIoInterval_.canio = canio;
     canIoInterval_.cruisespeed = cruisespeed;
     canIoInterval_.regenpreset = regenpreset;
+  }
+  xSemaphoreGive(mutex_);
+
+  if (active) {
     DBG_OUTPUT_PORT.printf("[CanIntervalManager] Updated CAN IO flags (canio=0x%02X)\n", canio);
   } else {
     DBG_OUTPUT_PORT.println("[CanIntervalManager] Ignoring update - CAN IO interval not active");
@@ -126,7 +160,9 @@ void CanIntervalManager::updateCanIoFlags(uint16_t pot, uint16_t pot2, uint8_t c
 }
 
 void CanIntervalManager::sendCanIoMessage() {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
   if (!canIoInterval_.active) {
+    xSemaphoreGive(mutex_);
     return;
   }
 
@@ -146,4 +182,18 @@ void CanIntervalManager::sendCanIoMessage() {
     // Increment sequence counter (0-3)
     canIoInterval_.sequenceCounter = (canIoInterval_.sequenceCounter + 1) & 0x03;
   }
+  xSemaphoreGive(mutex_);
+}
+
+uint32_t CanIntervalManager::getMsUntilNextSend(uint32_t now) const {
+  xSemaphoreTake(mutex_, portMAX_DELAY);
+  uint32_t waitMs = NO_DEADLINE;
+  for (const auto& msg : intervalMessages_) {
+    waitMs = std::min(waitMs, msRemaining(msg.lastSentTime, msg.intervalMs, now));
+  }
+  if (canIoInterval_.active) {
+    waitMs = std::min(waitMs, msRemaining(canIoInterval_.lastSentTime, canIoInterval_.intervalMs, now));
+  }
+  xSemaphoreGive(mutex_);
+  return waitMs;
 }
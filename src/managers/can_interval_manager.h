@@ -4,12 +4,16 @@
 #include <string>
 #include <vector>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
 #include "../models/interval_messages.h"
 
 /**
  * Manages periodic CAN message sending - both generic interval messages
  * and the specialized CAN IO interval protocol.
  * Uses singleton pattern since there's only one set of active intervals.
+ * Configured from canTask, sent from the CAN TX task - all state is mutex-protected.
  */
 class CanIntervalManager {
 public:
@@ -38,11 +42,17 @@ public:
   // Send CAN IO message if interval elapsed (called from CAN task loop)
   void sendCanIoMessage();
 
+  // Milliseconds until the next interval or CAN IO message is due (NO_DEADLINE if none active)
+  uint32_t getMsUntilNextSend(uint32_t now) const;
+
 private:
   CanIntervalManager();
   CanIntervalManager(const CanIntervalManager&) = delete;
   CanIntervalManager& operator=(const CanIntervalManager&) = delete;
 
+  void stopIntervalLocked(const char* intervalId);
+
   std::vector<IntervalCanMessage> intervalMessages_;
   CanIoInterval canIoInterval_;
+  SemaphoreHandle_t mutex_ = nullptr;
 };
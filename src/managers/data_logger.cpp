@@ -0,0 +1,376 @@
+#include "data_logger.h"
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "../models/can_types.h"
+#include "../utils/deadline.h"
+
+#define DBG_OUTPUT_PORT Serial
+
+DataLogger& DataLogger::instance() {
+  static DataLogger instance;
+  return instance;
+}
+
+bool DataLogger::begin() {
+  if (messages_ != nullptr) {
+    return true;
+  }
+
+  // Every block plus an open and a close fit, so canTask never waits on the writer
+  messages_ = xQueueCreate(DATA_LOG_BLOCK_COUNT + 2, sizeof(WriterMessage));
+  freeBlocks_ = xQueueCreate(DATA_LOG_BLOCK_COUNT, sizeof(Block*));
+  if (messages_ == nullptr || freeBlocks_ == nullptr) {
+    DBG_OUTPUT_PORT.println("[DataLog] Failed to create queues");
+    return false;
+  }
+  return xTaskCreate(writerTask, "DataLog", DATA_LOG_TASK_STACK_SIZE, this, DATA_LOG_TASK_PRIORITY, nullptr) == pdPASS;
+}
+
+// ============================================================================
+// canTask side
+// ============================================================================
+
+bool DataLogger::start(uint8_t nodeId, const int* paramIds, int paramCount, uint32_t budgetBytes) {
+  if (messages_ == nullptr) {
+    return false;
+  }
+  if (active_) {
+    stop();
+  }
+
+  // The blocks are allocated on first use and kept: 8 KB is cheap next to fragmenting the heap
+  if (pool_ == nullptr) {
+    pool_ = (Block*)malloc(DATA_LOG_BLOCK_COUNT * sizeof(Block));
+    if (pool_ == nullptr) {
+      return false;
+    }
+    for (int i = 0; i < DATA_LOG_BLOCK_COUNT; i++) {
+      Block* block = &pool_[i];
+      xQueueSend(freeBlocks_, &block, 0);
+    }
+  }
+
+  columns_.assign(paramIds, paramCount > MAX_PARAM_IDS ? MAX_PARAM_IDS : paramCount);
+  if (columns_.size() == 0) {
+    return false;
+  }
+
+  // The writer takes the parameter IDs for the file header in a block. Blocks still being
+  // written for the previous log come back shortly.
+  Block* block = nullptr;
+  if (xQueueReceive(freeBlocks_, &block, pdMS_TO_TICKS(QUEUE_SEND_TIMEOUT_MS)) != pdTRUE) {
+    columns_.clear();
+    return false;
+  }
+  block->count = columns_.size();
+  block->length = block->count * sizeof(uint16_t);
+  block->timeMs = millis();
+  for (size_t column = 0; column < columns_.size(); column++) {
+    uint16_t paramId = columns_.paramIdAt(column);
+    memcpy(block->data + column * sizeof(uint16_t), &paramId, sizeof(paramId));
+  }
+
+  WriterMessage message = {MSG_OPEN, nodeId, budgetBytes, block};
+  if (xQueueSend(messages_, &message, pdMS_TO_TICKS(QUEUE_SEND_TIMEOUT_MS)) != pdTRUE) {
+    xQueueSend(freeBlocks_, &block, 0);
+    columns_.clear();
+    return false;
+  }
+  budget_ = budgetBytes;
+
+  previous_.assign(columns_.size(), 0);
+  current_ = nullptr;
+  samples_ = 0;
+  dropped_ = 0;
+  active_ = true;
+  DBG_OUTPUT_PORT.printf("[DataLog] Logging %u parameters of node %d\n", (unsigned)columns_.size(), nodeId);
+  return true;
+}
+
+void DataLogger::stop() {
+  if (!active_) {
+    return;
+  }
+  submitBlock();
+  WriterMessage message = {MSG_CLOSE, 0, 0, nullptr};
+  xQueueSend(messages_, &message, pdMS_TO_TICKS(QUEUE_SEND_TIMEOUT_MS));
+  columns_.clear();
+  active_ = false;
+  DBG_OUTPUT_PORT.printf("[DataLog] Stopped: %u samples, %u dropped\n", (unsigned)samples_, (unsigned)dropped_);
+}
+
+bool DataLogger::takeBlock(uint32_t timeMs) {
+  if (xQueueReceive(freeBlocks_, &current_, 0) != pdTRUE) {
+    current_ = nullptr;
+    return false;
+  }
+  current_->count = 0;
+  current_->length = 0;
+  current_->timeMs = timeMs;
+  lastRowMs_ = timeMs;
+  std::fill(previous_.begin(), previous_.end(), 0);
+  return true;
+}
+
+void DataLogger::submitBlock() {
+  if (current_ == nullptr) {
+    return;
+  }
+  WriterMessage message = {MSG_DATA, 0, 0, current_};
+  if (xQueueSend(messages_, &message, 0) != pdTRUE) {
+    dropped_ += current_->count;
+    xQueueSend(freeBlocks_, &current_, 0);
+  }
+  current_ = nullptr;
+}
+
+void DataLogger::record(int paramId, int32_t value, uint32_t timeMs) {
+  if (!active_) {
+    return;
+  }
+  int column = columns_.find(paramId);
+  if (column < 0) {
+    return;
+  }
+
+  if (current_ != nullptr && DATA_LOG_BLOCK_SIZE - current_->length < DATA_LOG_MAX_ROW_BYTES) {
+    submitBlock();
+  }
+  if (current_ == nullptr && !takeBlock(timeMs)) {
+    dropped_++;  // The writer is behind and every block is waiting for it
+    return;
+  }
+
+  // Rows are in arrival order, so time only moves forward
+  uint32_t deltaMs = (int32_t)(timeMs - lastRowMs_) > 0 ? timeMs - lastRowMs_ : 0;
+  lastRowMs_ += deltaMs;
+  uint8_t* out = current_->data + current_->length;
+  size_t length = dataLogPutVarint(out, column);
+  length += dataLogPutVarint(out + length, deltaMs);
+  length += dataLogPutVarint(out + length, dataLogZigzag((int32_t)((uint32_t)value - (uint32_t)previous_[column])));
+  previous_[column] = value;
+  current_->length += length;
+  current_->count++;
+  samples_++;
+}
+
+void DataLogger::process(uint32_t now) {
+  if (current_ != nullptr && msRemaining(current_->timeMs, DATA_LOG_FLUSH_MS, now) == 0) {
+    submitBlock();
+  }
+}
+
+uint32_t DataLogger::getMsUntilNextWork(uint32_t now) const {
+  return current_ != nullptr ? msRemaining(current_->timeMs, DATA_LOG_FLUSH_MS, now) : NO_DEADLINE;
+}
+
+void DataLogger::formatFileName(char* out, size_t size, uint32_t number) {
+  snprintf(out, size, "log%05u.oil", (unsigned)number);
+}
+
+bool DataLogger::isLogFileName(const char* name) {
+  return fileNumberOf(name) != 0;
+}
+
+uint32_t DataLogger::fileNumberOf(const char* name) {
+  unsigned number = 0;
+  int length = 0;
+  if (sscanf(name, "log%5u.oil%n", &number, &length) != 1 || length != 12 || name[length] != '\0') {
+    return 0;
+  }
+  return number;
+}
+
+// ============================================================================
+// Writer task
+// ============================================================================
+
+void DataLogger::writerTask(void* parameter) {
+  DataLogger* logger = (DataLogger*)parameter;
+
+  // Continue numbering after the files already there
+  LittleFS.mkdir(DATA_LOG_DIR);
+  File dir = LittleFS.open(DATA_LOG_DIR);
+  for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+    logger->lastNumber_ = std::max(logger->lastNumber_, fileNumberOf(entry.name()));
+  }
+  dir.close();
+
+  WriterMessage message;
+  while (true) {
+    if (xQueueReceive(logger->messages_, &message, portMAX_DELAY) == pdTRUE) {
+      logger->handleMessage(message);
+      if (message.block != nullptr) {
+        xQueueSend(logger->freeBlocks_, &message.block, 0);
+      }
+    }
+  }
+}
+
+void DataLogger::handleMessage(const WriterMessage& message) {
+  switch (message.type) {
+    case MSG_OPEN:
+      closeFile();
+      fileNodeId_ = message.nodeId;
+      fileStartMs_ = message.block->timeMs;
+      fileBudget_ = message.budgetBytes;
+      fileParamIds_.resize(message.block->count);
+      memcpy(fileParamIds_.data(), message.block->data, message.block->length);
+      writeError_ = !openFile();
+      break;
+    case MSG_DATA:
+      writeDataBlock(*message.block);
+      break;
+    case MSG_CLOSE:
+      closeFile();
+      fileParamIds_.clear();
+      break;
+  }
+}
+
+bool DataLogger::openFile() {
+  char name[16];
+  char path[32];
+  formatFileName(name, sizeof(name), lastNumber_ + 1);
+  snprintf(path, sizeof(path), DATA_LOG_DIR "/%s", name);
+  file_ = LittleFS.open(path, "w");
+  if (!file_) {
+    DBG_OUTPUT_PORT.printf("[DataLog] Failed to create %s\n", path);
+    return false;
+  }
+  lastNumber_++;
+
+  DataLogFileHeader header = {DATA_LOG_MAGIC, DATA_LOG_VERSION, fileNodeId_, (uint16_t)fileParamIds_.size(),
+                              fileStartMs_, lastNumber_};
+  size_t idsLength = fileParamIds_.size() * sizeof(uint16_t);
+  file_.write((const uint8_t*)&header, sizeof(header));
+  file_.write((const uint8_t*)fileParamIds_.data(), idsLength);
+  fileSize_ = sizeof(header) + idsLength;
+  lastIndexOffset_ = 0;
+  pendingIndex_.clear();
+  fileNumber_ = lastNumber_;
+
+  enforceBudget();
+  return true;
+}
+
+void DataLogger::closeFile() {
+  if (!file_) {
+    return;
+  }
+  writeIndexBlock();
+  DataLogTrailer trailer = {lastIndexOffset_, DATA_LOG_TRAILER_MAGIC};
+  file_.write((const uint8_t*)&trailer, sizeof(trailer));
+  file_.close();
+  fileNumber_ = 0;
+}
+
+void DataLogger::writeDataBlock(const Block& block) {
+  if (fileParamIds_.empty()) {
+    return;  // Logging stopped; a block left over from before
+  }
+
+  // Room for the block, its index entry's index block and the trailer, or a new file
+  size_t needed = 2 * sizeof(DataLogBlockHeader) + block.length + sizeof(uint32_t) +
+                  (pendingIndex_.size() + 1) * sizeof(DataLogIndexEntry) + sizeof(DataLogTrailer);
+  if (file_ && fileSize_ + needed > DATA_LOG_FILE_MAX_BYTES) {
+    closeFile();
+  }
+  if (!file_) {
+    if (!openFile()) {
+      writeError_ = true;
+      dropped_ += block.count;
+      return;
+    }
+  } else if (LittleFS.totalBytes() - LittleFS.usedBytes() < DATA_LOG_FREE_RESERVE) {
+    // Something else filled the partition: older logs go first, the reserve is not for logs
+    enforceBudget();
+    if (LittleFS.totalBytes() - LittleFS.usedBytes() < DATA_LOG_FREE_RESERVE / 2) {
+      writeError_ = true;
+      dropped_ += block.count;
+      return;
+    }
+  }
+
+  DataLogBlockHeader header = {DATA_LOG_BLOCK_DATA, 0, block.count, block.timeMs, block.length};
+  uint32_t offset = fileSize_;
+  if (file_.write((const uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+      file_.write(block.data, block.length) != block.length) {
+    // Flash full: this file ends here, the next block tries a new one after cleaning up
+    DBG_OUTPUT_PORT.println("[DataLog] Write failed");
+    writeError_ = true;
+    dropped_ += block.count;
+    file_.close();
+    fileNumber_ = 0;
+    return;
+  }
+  file_.flush();
+  fileSize_ += sizeof(header) + block.length;
+  writeError_ = false;
+
+  pendingIndex_.push_back({block.timeMs, offset});
+  if (pendingIndex_.size() >= DATA_LOG_INDEX_INTERVAL) {
+    writeIndexBlock();
+  }
+}
+
+void DataLogger::writeIndexBlock() {
+  if (pendingIndex_.empty()) {
+    return;
+  }
+  uint32_t length = sizeof(uint32_t) + pendingIndex_.size() * sizeof(DataLogIndexEntry);
+  DataLogBlockHeader header = {DATA_LOG_BLOCK_INDEX, 0, (uint16_t)pendingIndex_.size(), pendingIndex_.back().timeMs,
+                               length};
+  uint32_t offset = fileSize_;
+  file_.write((const uint8_t*)&header, sizeof(header));
+  file_.write((const uint8_t*)&lastIndexOffset_, sizeof(lastIndexOffset_));
+  file_.write((const uint8_t*)pendingIndex_.data(), pendingIndex_.size() * sizeof(DataLogIndexEntry));
+  file_.flush();
+  fileSize_ += sizeof(header) + length;
+  lastIndexOffset_ = offset;
+  pendingIndex_.clear();
+}
+
+void DataLogger::enforceBudget() {
+  struct LogFile {
+    uint32_t number;
+    uint32_t size;
+  };
+  std::vector<LogFile> files;
+  uint64_t total = 0;
+  File dir = LittleFS.open(DATA_LOG_DIR);
+  for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+    uint32_t number = fileNumberOf(entry.name());
+    if (number != 0 && number != fileNumber_) {
+      files.push_back({number, (uint32_t)entry.size()});
+      total += entry.size();
+    }
+  }
+  dir.close();
+  std::sort(files.begin(), files.end(), [](const LogFile& a, const LogFile& b) { return a.number < b.number; });
+
+  // The file being written grows to at most DATA_LOG_FILE_MAX_BYTES; the others make way for it
+  size_t growth = DATA_LOG_FILE_MAX_BYTES - std::min<size_t>(fileSize_, DATA_LOG_FILE_MAX_BYTES);
+  for (const LogFile& oldest : files) {
+    bool overBudget = total + DATA_LOG_FILE_MAX_BYTES > fileBudget_;
+    bool lowOnSpace = LittleFS.totalBytes() - LittleFS.usedBytes() < growth + DATA_LOG_FREE_RESERVE;
+    if (!overBudget && !lowOnSpace) {
+      break;
+    }
+    char name[16];
+    char path[32];
+    formatFileName(name, sizeof(name), oldest.number);
+    snprintf(path, sizeof(path), DATA_LOG_DIR "/%s", name);
+    if (LittleFS.remove(path)) {
+      DBG_OUTPUT_PORT.printf("[DataLog] Deleted %s to make room\n", path);
+      total -= oldest.size;
+    }
+  }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include "managers/spot_value_slots.h"
+#include "models/data_log_format.h"
+
+#define DATA_LOG_DIR "/logs"
+#define DATA_LOG_BLOCK_COUNT 4     // Blocks filling or waiting for the writer
+#define DATA_LOG_FLUSH_MS 5000     // A block that has rows is written at least this often
+#define DATA_LOG_INDEX_INTERVAL 8  // Data blocks per index block
+#define DATA_LOG_FILE_MAX_BYTES 131072
+// Total size of the log files. The oldest files are deleted to stay within it, and to keep
+// DATA_LOG_FREE_RESERVE free for the web app, device caches and firmware uploads.
+#define DATA_LOG_BUDGET_DEFAULT 1048576
+#define DATA_LOG_BUDGET_MIN 262144
+#define DATA_LOG_FREE_RESERVE 131072
+
+#ifndef DATA_LOG_TASK_PRIORITY
+  #define DATA_LOG_TASK_PRIORITY 1
+#endif
+#define DATA_LOG_TASK_STACK_SIZE 4096
+
+/**
+ * Logs spot values to LittleFS (format in models/data_log_format.h), so drives can be
+ * recorded and downloaded later.
+ *
+ * The logger samples the values the spot value stream reads, so it only logs parameters
+ * being monitored; canTask refuses others and stops the log with an error once one of its
+ * parameters is no longer monitored. Every value of a logged parameter is one row: its column,
+ * the time since the previous row and the change since the column's previous value, as
+ * varints. Fixed-point values that hold still or creep cost about three bytes a row.
+ *
+ * canTask encodes rows into RAM blocks and hands full blocks (or every DATA_LOG_FLUSH_MS)
+ * to a writer task, so flash writes never stall the bus. If the writer falls behind and
+ * no block is free, samples are dropped and counted. The writer appends the blocks, an
+ * index block every DATA_LOG_INDEX_INTERVAL, starts a new file at
+ * DATA_LOG_FILE_MAX_BYTES, and deletes the oldest files to stay within the budget.
+ */
+class DataLogger {
+public:
+  static DataLogger& instance();
+
+  // Create the writer task (call once at startup)
+  bool begin();
+
+  // canTask side. paramIds: parameters to log (all distinct ones kept, up to MAX_PARAM_IDS)
+  bool start(uint8_t nodeId, const int* paramIds, int paramCount, uint32_t budgetBytes);
+  void stop();  // Writes what is buffered and closes the file
+  bool isActive() const { return active_; }
+  size_t getParamCount() const { return columns_.size(); }
+  int getParamIdAt(size_t column) const { return columns_.paramIdAt(column); }
+  uint32_t getBudget() const { return budget_; }
+
+  // value is fixed-point, scaled by 32 as on the wire
+  void record(int paramId, int32_t value, uint32_t timeMs);
+  void process(uint32_t now);                       // Hand over a block due for writing
+  uint32_t getMsUntilNextWork(uint32_t now) const;  // NO_DEADLINE when nothing is buffered
+
+  // Statistics (any task)
+  uint32_t getSamples() const { return samples_; }
+  uint32_t getDropped() const { return dropped_; }
+  uint32_t getFileNumber() const { return fileNumber_; }  // File being written, 0 if none
+  bool hasWriteError() const { return writeError_; }
+
+  // Log file names are "log" and a five-digit number, ".oil" (path: DATA_LOG_DIR "/" name)
+  static void formatFileName(char* out, size_t size, uint32_t number);
+  static bool isLogFileName(const char* name);
+  static uint32_t fileNumberOf(const char* name);  // 0 if not a log file name
+
+private:
+  DataLogger() {}
+  DataLogger(const DataLogger&) = delete;
+  DataLogger& operator=(const DataLogger&) = delete;
+
+  struct Block {
+    uint16_t count;   // Rows (or parameter IDs when opening a file)
+    uint16_t length;  // Bytes used in data
+    uint32_t timeMs;  // First row
+    uint8_t data[DATA_LOG_BLOCK_SIZE];
+  };
+
+  enum MessageType : uint8_t { MSG_OPEN, MSG_DATA, MSG_CLOSE };
+
+  struct WriterMessage {
+    MessageType type;
+    uint8_t nodeId;        // MSG_OPEN
+    uint32_t budgetBytes;  // MSG_OPEN
+    Block* block;          // Returned to freeBlocks_ once written (nullptr for MSG_CLOSE)
+  };
+
+  bool takeBlock(uint32_t timeMs);
+  void submitBlock();
+
+  // Writer task
+  static void writerTask(void* parameter);
+  void handleMessage(const WriterMessage& message);
+  bool openFile();
+  void closeFile();
+  void writeDataBlock(const Block& block);
+  void writeIndexBlock();
+  void enforceBudget();
+
+  // Shared between the tasks
+  QueueHandle_t messages_ = nullptr;
+  QueueHandle_t freeBlocks_ = nullptr;
+  Block* pool_ = nullptr;
+  volatile uint32_t samples_ = 0;
+  volatile uint32_t dropped_ = 0;
+  volatile uint32_t fileNumber_ = 0;
+  volatile bool writeError_ = false;
+
+  // canTask
+  bool active_ = false;
+  uint32_t budget_ = DATA_LOG_BUDGET_DEFAULT;
+  SpotValueSlots columns_;         // Only the slot index is used: it is the column
+  std::vector<int32_t> previous_;  // Last value of each column in the current block
+  Block* current_ = nullptr;
+  uint32_t lastRowMs_ = 0;
+
+  // Writer task
+  File file_;
+  std::vector<uint16_t> fileParamIds_;
+  uint8_t fileNodeId_ = 0;
+  uint32_t fileStartMs_ = 0;
+  uint32_t fileBudget_ = DATA_LOG_BUDGET_DEFAULT;
+  uint32_t fileSize_ = 0;
+  uint32_t lastNumber_ = 0;  // Highest file number on flash
+  uint32_t lastIndexOffset_ = 0;
+  std::vector<DataLogIndexEntry> pendingIndex_;
+};
@@ -21,11 +21,16 @@
 
 #include <Arduino.h>
 
+#include <cstring>
+
 #include "can_task.h"
 #include "device_discovery.h"
 
 #include "models/can_event.h"
 #include "protocols/sdo_protocol.h"
+#include "protocols/sdo_rtt_estimator.h"
+#include "utils/can_router.h"
+#include "utils/deadline.h"
 
 // External queue for events
 extern QueueHandle_t canEventQueue;
@@ -133,6 +138,47 @@ void DeviceConnection::markParameterRequestSent() {
   lastParamRequestTime_ = micros();
 }
 
+uint32_t DeviceConnection::responseTimeoutMs() const {
+  return SdoRttEstimator::instance().getTimeoutMs(nodeId_);
+}
+
+bool DeviceConnection::hasResponseTimedOut(unsigned long currentTime) const {
+  return currentTime - requestSentTime_ >= responseTimeoutMs();
+}
+
+void DeviceConnection::markRequestSent(unsigned long currentTime) {
+  requestSentTime_ = currentTime;
+  requestSentUs_ = micros();
+}
+
+// Karn's algorithm: the answer to a repeated request may belong to an earlier copy, so it is no sample
+void DeviceConnection::sampleRoundTrip() {
+  if (!requestRepeated_) {
+    SdoRttEstimator::instance().addSample(nodeId_, micros() - requestSentUs_);
+  }
+  requestRepeated_ = false;
+}
+
+void DeviceConnection::noteResponseTimeout() {
+  SdoRttEstimator::instance().onTimeout(nodeId_);
+  requestRepeated_ = true;
+}
+
+void DeviceConnection::registerCanRoutes() {
+  // Segmented upload responses carry data instead of index/subindex, so while a
+  // download is running every SDO response that no matcher claimed goes to it
+  CanRouter::instance().setSdoCapture([this](const twai_message_t& frame) {
+    if (!isDownloadingJson()) {
+      return false;
+    }
+    if (sdoResponseQueue != nullptr) {
+      xQueueSend(sdoResponseQueue, &frame, 0);
+    }
+    canTaskWake();
+    return true;
+  });
+}
+
 // Start JSON download (called when browser requests JSON)
 void DeviceConnection::startJsonDownload() {
   if (state_ != IDLE) {
@@ -140,10 +186,7 @@ void DeviceConnection::startJsonDownload() {
     return;
   }
 
-  jsonReceiveBuffer_ = "";
-  jsonTotalSize_ = 0;
-  toggleBit_ = false;
-  setState(JSON_INIT_SENDING);
+  beginJsonDownload();
 }
 
 // Start JSON download for a specific client (non-blocking)
@@ -155,12 +198,175 @@ bool DeviceConnection::startJsonDownloadAsync(uint32_t clientId) {
 
   jsonRequestClientId_ = clientId;
   clearJsonCache();
+  beginJsonDownload();
+  DBG_OUTPUT_PORT.printf("[DeviceConnection] Started async JSON download for client %lu\n", (unsigned long)clientId);
+  canTaskWake();  // Called from the WebSocket task - kick the state machine now
+  return true;
+}
+
+void DeviceConnection::beginJsonDownload() {
   jsonReceiveBuffer_ = "";
   jsonTotalSize_ = 0;
   toggleBit_ = false;
-  setState(JSON_INIT_SENDING);
-  DBG_OUTPUT_PORT.printf("[DeviceConnection] Started async JSON download for client %lu\n", (unsigned long)clientId);
-  return true;
+  jsonStats_ = JsonDownloadStats();
+  jsonStartTime_ = millis();
+  lastProgressTime_ = jsonStartTime_ - JSON_PROGRESS_INTERVAL_MS;  // First progress event goes out at once
+
+  bool tryBlock = blockUploadEnabled_ && blockUnsupportedNode_ != nodeId_;
+  setState(tryBlock ? JSON_BLOCK_INIT_SENDING : JSON_INIT_SENDING);
+}
+
+void DeviceConnection::appendJsonData(const uint8_t* data, int length) {
+  if (xSemaphoreTake(jsonBufferMutex_, pdMS_TO_TICKS(50)) == pdTRUE) {
+    for (int i = 0; i < length; i++) {
+      jsonReceiveBuffer_ += (char)data[i];
+    }
+    xSemaphoreGive(jsonBufferMutex_);
+  }
+}
+
+void DeviceConnection::postJsonProgress(bool complete) {
+  unsigned long now = millis();
+  if (!complete && now - lastProgressTime_ < JSON_PROGRESS_INTERVAL_MS) {
+    return;
+  }
+  lastProgressTime_ = now;
+
+  // Only canTask writes the buffer, so it can read the length without the mutex
+  int bytesReceived = jsonReceiveBuffer_.length();
+  if (jsonProgressCallback_) {
+    jsonProgressCallback_(bytesReceived);
+  }
+
+  if (canEventQueue != nullptr) {
+    CANEvent evt;
+    evt.type = EVT_JSON_PROGRESS;
+    evt.data.jsonProgress.clientId = jsonRequestClientId_;
+    evt.data.jsonProgress.bytesReceived = bytesReceived;
+    evt.data.jsonProgress.totalBytes = jsonTotalSize_;
+    evt.data.jsonProgress.complete = complete;
+    evt.data.jsonProgress.blockMode = jsonStats_.blockMode;
+    evt.data.jsonProgress.elapsedMs = now - jsonStartTime_;
+    evt.data.jsonProgress.roundTrips = jsonStats_.roundTrips;
+    xQueueSend(canEventQueue, &evt, 0);
+  }
+}
+
+void DeviceConnection::fallBackToSegmented(const char* reason, bool nodeUnsupported) {
+  DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] Block upload %s, falling back to segmented upload\r\n", reason);
+  if (nodeUnsupported) {
+    blockUnsupportedNode_ = nodeId_;  // Don't probe again until the next connect
+  }
+
+  if (xSemaphoreTake(jsonBufferMutex_, pdMS_TO_TICKS(50)) == pdTRUE) {
+    jsonReceiveBuffer_ = "";
+    xSemaphoreGive(jsonBufferMutex_);
+  }
+  jsonTotalSize_ = 0;
+  toggleBit_ = false;
+  jsonStats_.blockMode = false;
+  jsonStats_.fellBack = true;
+  state_ = JSON_INIT_SENDING;
+}
+
+// Acknowledge the last in-order segment; the node continues (or resends) from the one after it
+void DeviceConnection::ackBlock(unsigned long currentTime) {
+  SDOProtocol::sendBlockUploadCommand(nodeId_, SDOProtocol::BLOCK_UPLOAD_ACK, blockSequence_, SDO_BLOCK_UPLOAD_SIZE);
+  jsonStats_.roundTrips++;
+  requestSentTime_ = currentTime;
+}
+
+void DeviceConnection::processBlockSegments(unsigned long currentTime) {
+  twai_message_t rxframe;
+
+  // Drain everything queued - a whole block can arrive between two canTask wakes
+  while (state_ == JSON_BLOCK_RECEIVING && SDOProtocol::waitForResponse(&rxframe, 0)) {
+    if (rxframe.identifier != (uint32_t)(SDO_RESPONSE_BASE_ID + nodeId_)) {
+      continue;
+    }
+
+    uint8_t command = rxframe.data[0];
+    if (command == SDOProtocol::ABORT) {
+      uint16_t rxIndex = rxframe.data[1] | (rxframe.data[2] << 8);
+      if (rxIndex == SDOProtocol::INDEX_STRINGS) {
+        fallBackToSegmented("aborted by node", false);
+      }
+      continue;
+    }
+
+    uint8_t sequence = command & ~SDOProtocol::BLOCK_LAST_SEGMENT;
+    bool last = (command & SDOProtocol::BLOCK_LAST_SEGMENT) != 0;
+    if (sequence == 0 || sequence > SDO_BLOCK_UPLOAD_SIZE) {
+      continue;  // Not a block segment (e.g. another SDO response captured during the download)
+    }
+
+    bool inOrder = sequence == blockSequence_ + 1;
+    if (inOrder) {
+      blockSequence_ = sequence;
+      blockTimeouts_ = 0;
+      requestSentTime_ = currentTime;
+      if (last) {
+        memcpy(blockLastSegment_, &rxframe.data[1], sizeof(blockLastSegment_));
+      } else {
+        appendJsonData(&rxframe.data[1], 7);
+      }
+    } else if (sequence <= blockSequence_ || (!last && sequence != SDO_BLOCK_UPLOAD_SIZE)) {
+      continue;  // Duplicate, or past a gap that the ack at the end of the block repairs
+    } else {
+      jsonStats_.retransmits++;  // Block ended with segments missing; the ack asks for them again
+    }
+
+    // End of block (or of the data): acknowledge what arrived in order
+    if (last || sequence == SDO_BLOCK_UPLOAD_SIZE) {
+      ackBlock(currentTime);
+      if (inOrder && last) {
+        state_ = JSON_BLOCK_END_WAITING;
+      } else {
+        blockSequence_ = 0;
+      }
+      postJsonProgress(false);
+    }
+  }
+}
+
+void DeviceConnection::finishJsonDownload() {
+  bool parseSuccess = false;
+  if (xSemaphoreTake(jsonBufferMutex_, pdMS_TO_TICKS(50)) == pdTRUE) {
+    DBG_OUTPUT_PORT.println("[OBTAIN_JSON] Download complete");
+    DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] JSON size: %d bytes\r\n", jsonReceiveBuffer_.length());
+
+    // Parse JSON
+    DeserializationError error = deserializeJson(cachedParamJson_, jsonReceiveBuffer_);
+    if (error) {
+      DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] Parse error: %s\r\n", error.c_str());
+    } else {
+      DBG_OUTPUT_PORT.println("[OBTAIN_JSON] Parsed successfully");
+      parseSuccess = true;
+    }
+    jsonStats_.bytes = jsonReceiveBuffer_.length();
+    xSemaphoreGive(jsonBufferMutex_);
+  }
+
+  jsonStats_.durationMs = millis() - jsonStartTime_;
+  DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] %lu bytes in %lu ms via %s upload%s: %lu round trips, %lu retransmits\r\n",
+                         (unsigned long)jsonStats_.bytes, (unsigned long)jsonStats_.durationMs,
+                         jsonStats_.blockMode ? "block" : "segmented", jsonStats_.fellBack ? " (fallback)" : "",
+                         (unsigned long)jsonStats_.roundTrips, (unsigned long)jsonStats_.retransmits);
+  postJsonProgress(true);
+
+  // Send JSON ready event if a client requested it
+  if (jsonRequestClientId_ != 0 && canEventQueue != nullptr) {
+    CANEvent evt;
+    evt.type = EVT_JSON_READY;
+    evt.data.jsonReady.clientId = jsonRequestClientId_;
+    evt.data.jsonReady.nodeId = nodeId_;
+    evt.data.jsonReady.success = parseSuccess;
+    xQueueSend(canEventQueue, &evt, 0);
+    DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] Sent JSON ready event for client %lu\n", (unsigned long)jsonRequestClientId_);
+    jsonRequestClientId_ = 0;  // Clear after sending
+  }
+
+  setState(IDLE);
 }
 
 // Start serial acquisition (used after device reset)
@@ -196,7 +402,7 @@ void DeviceConnection::processConnection() {
 
       // Send request for current serial part
       SDOProtocol::requestElement(nodeId_, SDOProtocol::INDEX_SERIAL, currentSerialPart_);
-      requestSentTime_ = currentTime;
+      markRequestSent(currentTime);
       state_ = SERIAL_WAITING;
       break;
 
@@ -213,6 +419,7 @@ void DeviceConnection::processConnection() {
         // Validate response is for serial index
         uint16_t rxIndex = rxframe.data[1] | (rxframe.data[2] << 8);
         if (rxIndex == SDOProtocol::INDEX_SERIAL && rxframe.data[3] == currentSerialPart_) {
+          sampleRoundTrip();
           setSerialPart(currentSerialPart_, *(uint32_t*)&rxframe.data[4]);
           currentSerialPart_++;
 
@@ -237,8 +444,9 @@ void DeviceConnection::processConnection() {
             }
           }
         }
-      } else if ((currentTime - requestSentTime_) >= SDO_TIMEOUT_MS) {
+      } else if (hasResponseTimedOut(currentTime)) {
         // Timeout - retry or error
+        noteResponseTimeout();
         if (hasStateTimedOut(CONNECTION_TIMEOUT_MS)) {
           DBG_OUTPUT_PORT.println("[DeviceConnection] Connection timeout");
           setState(ERROR);
@@ -258,7 +466,8 @@ void DeviceConnection::processConnection() {
 
       // Send initiate upload request for strings index
       SDOProtocol::requestElement(nodeId_, SDOProtocol::INDEX_STRINGS, 0);
-      requestSentTime_ = currentTime;
+      markRequestSent(currentTime);
+      jsonStats_.roundTrips++;
       state_ = JSON_INIT_WAITING;
       break;
 
@@ -273,30 +482,30 @@ void DeviceConnection::processConnection() {
         // Check for initiate upload response
         if ((rxframe.data[0] & SDOProtocol::READ) == SDOProtocol::READ) {
           DBG_OUTPUT_PORT.println("[OBTAIN_JSON] Initiate upload response received");
+          sampleRoundTrip();
 
           if (rxframe.data[0] & SDOProtocol::SIZE_SPECIFIED) {
             jsonTotalSize_ = *(uint32_t*)&rxframe.data[4];
             DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] Total size: %d bytes\r\n", jsonTotalSize_);
-
-            if (jsonProgressCallback_) {
-              jsonProgressCallback_(0);
-            }
           } else {
             jsonTotalSize_ = 0;
           }
+          postJsonProgress(false);
 
           // Request first segment
           state_ = JSON_SEGMENT_SENDING;
         }
-      } else if ((currentTime - requestSentTime_) >= SDO_TIMEOUT_MS) {
+      } else if (hasResponseTimedOut(currentTime)) {
         DBG_OUTPUT_PORT.println("[DeviceConnection] JSON init timeout");
+        noteResponseTimeout();
         setState(ERROR);
       }
       break;
 
     case JSON_SEGMENT_SENDING:
       SDOProtocol::requestNextSegment(nodeId_, toggleBit_);
-      requestSentTime_ = currentTime;
+      markRequestSent(currentTime);
+      jsonStats_.roundTrips++;
       state_ = JSON_SEGMENT_WAITING;
       break;
 
@@ -310,61 +519,152 @@ void DeviceConnection::processConnection() {
 
         // Check for last segment
         if ((rxframe.data[0] & SDOProtocol::SIZE_SPECIFIED) && (rxframe.data[0] & SDOProtocol::READ) == 0) {
-          // Last segment - protect buffer access
-          bool parseSuccess = false;
-          if (xSemaphoreTake(jsonBufferMutex_, pdMS_TO_TICKS(50)) == pdTRUE) {
-            int size = 7 - ((rxframe.data[0] >> 1) & 0x7);
-            for (int i = 0; i < size; i++) {
-              jsonReceiveBuffer_ += (char)rxframe.data[1 + i];
-            }
-
-            DBG_OUTPUT_PORT.println("[OBTAIN_JSON] Download complete");
-            DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] JSON size: %d bytes\r\n", jsonReceiveBuffer_.length());
-
-            // Parse JSON
-            DeserializationError error = deserializeJson(cachedParamJson_, jsonReceiveBuffer_);
-            if (error) {
-              DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] Parse error: %s\r\n", error.c_str());
-            } else {
-              DBG_OUTPUT_PORT.println("[OBTAIN_JSON] Parsed successfully");
-              parseSuccess = true;
-            }
-            xSemaphoreGive(jsonBufferMutex_);
-          }
-
-          // Send JSON ready event if a client requested it
-          if (jsonRequestClientId_ != 0 && canEventQueue != nullptr) {
-            CANEvent evt;
-            evt.type = EVT_JSON_READY;
-            evt.data.jsonReady.clientId = jsonRequestClientId_;
-            evt.data.jsonReady.nodeId = nodeId_;
-            evt.data.jsonReady.success = parseSuccess;
-            xQueueSend(canEventQueue, &evt, 0);
-            DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] Sent JSON ready event for client %lu\n",
-                                   (unsigned long)jsonRequestClientId_);
-            jsonRequestClientId_ = 0;  // Clear after sending
-          }
-
-          setState(IDLE);
+          int size = 7 - ((rxframe.data[0] >> 1) & 0x7);
+          sampleRoundTrip();
+          appendJsonData(&rxframe.data[1], size);
+          finishJsonDownload();
         }
         // Normal segment
         else if ((rxframe.data[0] & 0xE0) == 0 && rxframe.data[0] == (toggleBit_ << 4)) {
-          // Protect buffer access
-          if (xSemaphoreTake(jsonBufferMutex_, pdMS_TO_TICKS(50)) == pdTRUE) {
-            for (int i = 0; i < 7; i++) {
-              jsonReceiveBuffer_ += (char)rxframe.data[1 + i];
-            }
-            xSemaphoreGive(jsonBufferMutex_);
-          }
+          sampleRoundTrip();
+          appendJsonData(&rxframe.data[1], 7);
           toggleBit_ = !toggleBit_;
           state_ = JSON_SEGMENT_SENDING;
+          postJsonProgress(false);
         }
-      } else if ((currentTime - requestSentTime_) >= SDO_TIMEOUT_MS) {
+      } else if (hasResponseTimedOut(currentTime)) {
         // Timeout - retry
         DBG_OUTPUT_PORT.println("[DeviceConnection] JSON segment timeout, retrying");
+        noteResponseTimeout();
+        jsonStats_.retransmits++;
         state_ = JSON_SEGMENT_SENDING;
       }
       break;
+
+    // =====================================================================
+    // JSON download via SDO block upload
+    // =====================================================================
+    case JSON_BLOCK_INIT_SENDING:
+      SDOProtocol::clearPendingResponses();
+      SDOProtocol::requestBlockUpload(nodeId_, SDOProtocol::INDEX_STRINGS, 0, SDO_BLOCK_UPLOAD_SIZE);
+      markRequestSent(currentTime);
+      jsonStats_.roundTrips++;
+      state_ = JSON_BLOCK_INIT_WAITING;
+      break;
+
+    case JSON_BLOCK_INIT_WAITING:
+      if (SDOProtocol::waitForResponse(&rxframe, 0)) {
+        uint16_t rxIndex = rxframe.data[1] | (rxframe.data[2] << 8);
+        if (rxIndex != SDOProtocol::INDEX_STRINGS || rxframe.data[3] != 0) {
+          break;  // Not ours
+        }
+
+        // Initiate response: scs 6, subcommand 0
+        uint8_t command = rxframe.data[0];
+        if ((command & 0xE1) == SDOProtocol::RESPONSE_BLOCK_UPLOAD) {
+          sampleRoundTrip();
+          blockCrc_ = (command & SDOProtocol::BLOCK_CRC_SUPPORTED) != 0;
+          jsonTotalSize_ = (command & SDOProtocol::BLOCK_SIZE_INDICATED) ? *(uint32_t*)&rxframe.data[4] : 0;
+          DBG_OUTPUT_PORT.printf("[OBTAIN_JSON] Block upload accepted, total size: %d bytes\r\n", jsonTotalSize_);
+
+          jsonStats_.blockMode = true;
+          blockSequence_ = 0;
+          blockTimeouts_ = 0;
+          SDOProtocol::sendBlockUploadCommand(nodeId_, SDOProtocol::BLOCK_UPLOAD_START);
+          requestSentTime_ = currentTime;
+          state_ = JSON_BLOCK_RECEIVING;
+          postJsonProgress(false);
+        } else {
+          // Abort (or any other answer): the node only does segmented transfers
+          fallBackToSegmented("not supported by node", true);
+        }
+      } else if (hasResponseTimedOut(currentTime)) {
+        fallBackToSegmented("not answered", true);
+      }
+      break;
+
+    case JSON_BLOCK_RECEIVING:
+      processBlockSegments(currentTime);
+      if (state_ == JSON_BLOCK_RECEIVING && hasResponseTimedOut(currentTime)) {
+        // Rest of the block lost: acknowledge what we have so the node resends from there
+        SdoRttEstimator::instance().onTimeout(nodeId_);
+        if (++blockTimeouts_ > BLOCK_MAX_TIMEOUTS) {
+          SDOProtocol::abortTransfer(nodeId_, SDOProtocol::INDEX_STRINGS, 0, SDOProtocol::ERR_GENERAL);
+          fallBackToSegmented("timed out", false);
+          break;
+        }
+        jsonStats_.retransmits++;
+        ackBlock(currentTime);
+        blockSequence_ = 0;
+      }
+      break;
+
+    case JSON_BLOCK_END_WAITING:
+      if (SDOProtocol::waitForResponse(&rxframe, 0)) {
+        uint8_t command = rxframe.data[0];
+        if (rxframe.identifier != (uint32_t)(SDO_RESPONSE_BASE_ID + nodeId_)) {
+          break;
+        }
+        if (command == SDOProtocol::ABORT) {
+          fallBackToSegmented("aborted by node", false);
+          break;
+        }
+        if ((command & 0xE3) != (SDOProtocol::RESPONSE_BLOCK_UPLOAD | SDOProtocol::BLOCK_UPLOAD_END)) {
+          break;  // Leftover segment of a resent block
+        }
+
+        // End frame: bits 4:2 count the unused bytes of the held last segment
+        int unused = (command >> 2) & 0x7;
+        appendJsonData(blockLastSegment_, 7 - unused);
+
+        if (blockCrc_) {
+          uint16_t expected = rxframe.data[1] | (rxframe.data[2] << 8);
+          uint16_t crc = 0;
+          if (xSemaphoreTake(jsonBufferMutex_, pdMS_TO_TICKS(50)) == pdTRUE) {
+            crc = SDOProtocol::blockCrc((const uint8_t*)jsonReceiveBuffer_.c_str(), jsonReceiveBuffer_.length());
+            xSemaphoreGive(jsonBufferMutex_);
+          }
+          if (crc != expected) {
+            SDOProtocol::abortTransfer(nodeId_, SDOProtocol::INDEX_STRINGS, 0, SDOProtocol::ERR_CRC);
+            fallBackToSegmented("CRC mismatch", false);
+            break;
+          }
+        }
+
+        SDOProtocol::sendBlockUploadCommand(nodeId_, SDOProtocol::BLOCK_UPLOAD_END);
+        finishJsonDownload();
+      } else if (hasResponseTimedOut(currentTime)) {
+        // Final ack lost - send it again
+        SdoRttEstimator::instance().onTimeout(nodeId_);
+        if (++blockTimeouts_ > BLOCK_MAX_TIMEOUTS) {
+          SDOProtocol::abortTransfer(nodeId_, SDOProtocol::INDEX_STRINGS, 0, SDOProtocol::ERR_GENERAL);
+          fallBackToSegmented("timed out", false);
+          break;
+        }
+        jsonStats_.retransmits++;
+        ackBlock(currentTime);
+      }
+      break;
+  }
+}
+
+uint32_t DeviceConnection::getMsUntilNextAction(uint32_t now) const {
+  switch (state_) {
+    case SERIAL_SENDING:
+    case JSON_INIT_SENDING:
+    case JSON_SEGMENT_SENDING:
+    case JSON_BLOCK_INIT_SENDING:
+      return 0;
+    case SERIAL_WAITING:
+    case JSON_INIT_WAITING:
+    case JSON_SEGMENT_WAITING:
+    case JSON_BLOCK_INIT_WAITING:
+    case JSON_BLOCK_RECEIVING:
+    case JSON_BLOCK_END_WAITING:
+      // Responses wake the CAN task on their own; this only bounds the timeout check
+      return msRemaining(requestSentTime_, responseTimeoutMs(), now);
+    default:
+      return NO_DEADLINE;
   }
 }
 
@@ -402,6 +702,7 @@ bool DeviceConnection::connectToDevice(uint8_t nodeId, BaudRate baud, int txPin,
   nodeId_ = nodeId;
   currentSerialPart_ = 0;
   toggleBit_ = false;
+  blockUnsupportedNode_ = 0;  // Probe block upload again (firmware may have changed)
   setState(SERIAL_SENDING);  // Start the serial acquisition state machine
   DBG_OUTPUT_PORT.printf("Connecting to node %d...\n", nodeId);
   return true;
@@ -35,6 +35,16 @@ typedef void (*ConnectionReadyCallback)(uint8_t nodeId, const char* serial);
 typedef void (*JsonDownloadProgressCallback)(int bytesReceived);
 typedef void (*JsonStreamCallback)(const char* chunk, int chunkSize, bool isComplete);
 
+// Outcome of the last parameter JSON download, for comparing block and segmented upload
+struct JsonDownloadStats {
+  bool blockMode = false;    // Finished via SDO block upload (false: segmented)
+  bool fellBack = false;     // Block upload was tried first and given up on
+  uint32_t bytes = 0;
+  uint32_t durationMs = 0;   // Download request to parsed JSON
+  uint32_t roundTrips = 0;   // Request/response exchanges (segment requests, block acks)
+  uint32_t retransmits = 0;  // Segments or blocks asked for again after a timeout or gap
+};
+
 /**
  * Manages the connection state and JSON cache for a single CAN device.
  * Uses singleton pattern since only one device connection is active at a time.
@@ -52,7 +62,12 @@ public:
     JSON_INIT_SENDING,     // Sending JSON initiate request
     JSON_INIT_WAITING,     // Waiting for JSON initiate response
     JSON_SEGMENT_SENDING,  // Sending segment request
-    JSON_SEGMENT_WAITING   // Waiting for segment response
+    JSON_SEGMENT_WAITING,  // Waiting for segment response
+    // JSON download via SDO block upload (falls back to the segmented states above)
+    JSON_BLOCK_INIT_SENDING,  // Sending block upload initiate request
+    JSON_BLOCK_INIT_WAITING,  // Waiting for block upload initiate response
+    JSON_BLOCK_RECEIVING,     // Receiving the segments of a block
+    JSON_BLOCK_END_WAITING    // Last segment acknowledged, waiting for the end frame
   };
 
   // Singleton access
@@ -68,10 +83,7 @@ public:
   void setState(State newState);
   State getState() const { return state_; }
   bool isIdle() const { return state_ == IDLE; }
-  bool isDownloadingJson() const {
-    return state_ == JSON_INIT_SENDING || state_ == JSON_INIT_WAITING || state_ == JSON_SEGMENT_SENDING ||
-           state_ == JSON_SEGMENT_WAITING;
-  }
+  bool isDownloadingJson() const { return state_ >= JSON_INIT_SENDING && state_ <= JSON_BLOCK_END_WAITING; }
   bool isAcquiringSerial() const { return state_ == SERIAL_SENDING || state_ == SERIAL_WAITING; }
 
   void setCanPins(int txPin, int rxPin) {
@@ -123,6 +135,11 @@ public:
 
   void clearJsonCache();
 
+  // Block upload is tried first unless disabled here or the node has already refused it
+  void setBlockUploadEnabled(bool enabled) { blockUploadEnabled_ = enabled; }
+  bool isBlockUploadEnabled() const { return blockUploadEnabled_; }
+  const JsonDownloadStats& getJsonDownloadStats() const { return jsonStats_; }
+
   // Callbacks
   void setConnectionReadyCallback(ConnectionReadyCallback callback) { connectionReadyCallback_ = callback; }
   void setJsonProgressCallback(JsonDownloadProgressCallback callback) { jsonProgressCallback_ = callback; }
@@ -140,6 +157,12 @@ public:
   // Non-blocking state machine processing (called from can_task loop)
   void processConnection();
 
+  // Register the JSON download capture with CanRouter
+  void registerCanRoutes();
+
+  // Milliseconds until processConnection() has work (0 = now, NO_DEADLINE = idle)
+  uint32_t getMsUntilNextAction(uint32_t now) const;
+
   // Start JSON download (called when browser requests JSON)
   void startJsonDownload();
 
@@ -156,6 +179,22 @@ private:
   DeviceConnection(const DeviceConnection&) = delete;
   DeviceConnection& operator=(const DeviceConnection&) = delete;
 
+  // Adaptive response timeout (SdoRttEstimator) and RTT sampling of the current request
+  uint32_t responseTimeoutMs() const;
+  bool hasResponseTimedOut(unsigned long currentTime) const;
+  void markRequestSent(unsigned long currentTime);
+  void sampleRoundTrip();
+  void noteResponseTimeout();
+
+  // JSON download helpers (canTask)
+  void beginJsonDownload();
+  void appendJsonData(const uint8_t* data, int length);
+  void processBlockSegments(unsigned long currentTime);
+  void ackBlock(unsigned long currentTime);
+  void fallBackToSegmented(const char* reason, bool nodeUnsupported);
+  void finishJsonDownload();
+  void postJsonProgress(bool complete);
+
   // Connection state
   uint8_t nodeId_ = 0;
   BaudRate baudRate_ = Baud500k;
@@ -187,9 +226,25 @@ private:
   bool toggleBit_ = false;
   uint8_t currentSerialPart_ = 0;      // Current serial part being requested (0-3)
   unsigned long requestSentTime_ = 0;  // When we sent the current request
+  uint32_t requestSentUs_ = 0;         // Same, for RTT samples
+  bool requestRepeated_ = false;       // Current request is a retry (not sampled)
   File file_;                          // Used during firmware update
 
+  // SDO block upload
+  bool blockUploadEnabled_ = true;
+  uint8_t blockUnsupportedNode_ = 0;   // Node that refused block upload since the last connect
+  bool blockCrc_ = false;              // Node sends a CRC in the end frame
+  uint8_t blockSequence_ = 0;          // Last in-order segment of the current block
+  uint8_t blockTimeouts_ = 0;          // Consecutive acks sent without progress
+  uint8_t blockLastSegment_[7] = {0};  // Held until the end frame says how much of it is data
+
+  // JSON download metrics
+  JsonDownloadStats jsonStats_;
+  unsigned long jsonStartTime_ = 0;
+  unsigned long lastProgressTime_ = 0;
+
   // Constants
-  static const unsigned long SDO_TIMEOUT_MS = 100;          // Timeout for SDO response
-  static const unsigned long CONNECTION_TIMEOUT_MS = 5000;  // Overall connection timeout
+  static const unsigned long CONNECTION_TIMEOUT_MS = 5000;     // Overall connection timeout
+  static const unsigned long JSON_PROGRESS_INTERVAL_MS = 100;  // Min spacing of jsonProgress events
+  static const uint8_t BLOCK_MAX_TIMEOUTS = 5;                 // Block upload timeouts before falling back
 };
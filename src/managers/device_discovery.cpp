@@ -28,7 +28,10 @@
 
 #include "models/can_types.h"
 #include "protocols/sdo_protocol.h"
+#include "protocols/sdo_rtt_estimator.h"
 #include "utils/can_queue.h"
+#include "utils/can_router.h"
+#include "utils/deadline.h"
 
 #define DBG_OUTPUT_PORT Serial
 
@@ -122,14 +125,17 @@ bool DeviceDiscovery::requestDeviceSerial(uint8_t nodeId, uint32_t serialParts[4
       return false;
     }
 
+    // Absent nodes are expected to time out, so only answers feed the RTT estimate
+    uint32_t sentUs = micros();
     twai_message_t rxframe;
-    if (!SDOProtocol::waitForResponse(&rxframe, pdMS_TO_TICKS(100))) {
+    if (!SDOProtocol::waitForResponse(&rxframe, SDOProtocol::responseTimeout(nodeId))) {
       return false;
     }
 
     if (!isValidSerialResponse(rxframe, nodeId, part)) {
       return false;
     }
+    SdoRttEstimator::instance().addSample(nodeId, micros() - sentUs);
 
     serialParts[part] = *(uint32_t*)&rxframe.data[4];
   }
@@ -281,14 +287,18 @@ void DeviceDiscovery::processScan() {
       tx_frame.data[6] = 0;
       tx_frame.data[7] = 0;
 
-      canQueueTransmit(&tx_frame, pdMS_TO_TICKS(10));
+      canQueueTransmit(&tx_frame, pdMS_TO_TICKS(10), CAN_TX_BACKGROUND);
 
       // Notify scan progress when starting a new node (first serial part)
       if (currentSerialPart == 0 && progressCallback) {
         progressCallback(currentNode, scanStart, scanEnd);
       }
 
+      // Nodes never seen before get the bus-wide RTO; their timeouts are expected and
+      // don't back it off
       requestSentTime = currentTime;
+      requestSentUs = micros();
+      scanTimeoutMs = SdoRttEstimator::instance().getTimeoutMs(currentNode);
       scanState = ScanState::WAITING;
       break;
     }
@@ -297,7 +307,9 @@ void DeviceDiscovery::processScan() {
       // Non-blocking check for response
       twai_message_t rxframe;
       if (SDOProtocol::waitForResponse(&rxframe, 0)) {  // timeout=0 for non-blocking
+        uint8_t probedNode = currentNode;
         if (handleScanResponse(rxframe, currentTime)) {
+          SdoRttEstimator::instance().addSample(probedNode, micros() - requestSentUs);
           // Valid response handled
           if (currentSerialPart > 0) {
             // More parts to fetch - continue immediately (no delay)
@@ -313,7 +325,7 @@ void DeviceDiscovery::processScan() {
           lastScanTime = currentTime;
           scanState = ScanState::IDLE;
         }
-      } else if ((currentTime - requestSentTime) >= SCAN_TIMEOUT_MS) {
+      } else if ((currentTime - requestSentTime) >= scanTimeoutMs) {
         // Timeout - move to next node
         advanceToNextNode();
         lastScanTime = currentTime;
@@ -325,6 +337,30 @@ void DeviceDiscovery::processScan() {
   }
 }
 
+// Time until processScan() needs to run again (for the CAN task's wait timeout)
+uint32_t DeviceDiscovery::getMsUntilNextScanStep(uint32_t now) const {
+  if (!scanActive || !DeviceConnection::instance().isIdle()) {
+    return NO_DEADLINE;
+  }
+
+  switch (scanState) {
+    case ScanState::IDLE:
+      return msRemaining(lastScanTime, SCAN_DELAY_MS, now);
+    case ScanState::WAITING:
+      return msRemaining(requestSentTime, scanTimeoutMs, now);
+    default:
+      return 0;
+  }
+}
+
+void DeviceDiscovery::registerCanRoutes() {
+  CanRouter& router = CanRouter::instance();
+  router.addSdoObserver(router.deferred([this](const twai_message_t& frame) {
+    updateLastSeenByNodeId(frame.identifier & 0x7F, millis());
+    return true;
+  }));
+}
+
 // Set discovery callback
 void DeviceDiscovery::setDiscoveryCallback(DiscoveryCallback cb) {
   discoveryCallback = cb;
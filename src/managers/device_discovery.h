@@ -59,6 +59,7 @@ public:
   void stopContinuousScan();
   bool isScanActive() const;
   void processScan();  // Called from main loop
+  uint32_t getMsUntilNextScanStep(uint32_t now) const;  // NO_DEADLINE when not scanning
 
   // Callbacks
   void setDiscoveryCallback(DiscoveryCallback cb);
@@ -69,6 +70,7 @@ public:
   void addOrUpdateDevice(const char* serial, uint8_t nodeId, const char* name = nullptr, uint32_t lastSeen = 0);
   void updateLastSeen(const char* serial, uint32_t lastSeen);
   void updateLastSeenByNodeId(uint8_t nodeId, uint32_t lastSeen);
+  void registerCanRoutes();  // Passive heartbeat from every SDO response
   const std::map<String, Device>& getDevices() const;
 
   // Device persistence
@@ -91,6 +93,8 @@ private:
   uint32_t currentSerial[4];
   unsigned long lastScanTime = 0;
   unsigned long requestSentTime = 0;  // When we sent the current request
+  uint32_t requestSentUs = 0;         // Same, for RTT samples
+  uint32_t scanTimeoutMs = 0;         // RTO of the probed node when the request went out
 
   // Throttle passive heartbeat updates to prevent flooding WebSocket
   static const unsigned long PASSIVE_HEARTBEAT_THROTTLE_MS = 1000;  // Update at most once per second
@@ -111,6 +115,5 @@ private:
   bool requestDeviceSerial(uint8_t nodeId, uint32_t serialParts[4]);
 
   // Constants
-  static const unsigned long SCAN_DELAY_MS = 20;    // Delay between node probes
-  static const unsigned long SCAN_TIMEOUT_MS = 50;  // Timeout for scan response
+  static const unsigned long SCAN_DELAY_MS = 20;  // Delay between node probes
 };
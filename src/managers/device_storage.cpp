@@ -2,6 +2,8 @@
 
 #include <LittleFS.h>
 
+#include <cstring>
+
 #include "device_cache.h"
 
 #define DBG_OUTPUT_PORT Serial
@@ -65,6 +67,91 @@ bool DeviceStorage::removeJsonCache(const String& serial) {
   return false;
 }
 
+// Parameter snapshot file: magic, version, entry count, then a 16-bit param ID and 32-bit raw
+// value per entry, all little endian
+static const uint32_t SNAPSHOT_MAGIC = 0x5350494F;  // "OIPS"
+static const uint16_t SNAPSHOT_VERSION = 1;
+static const size_t SNAPSHOT_HEADER_SIZE = 8;
+static const size_t SNAPSHOT_ENTRY_SIZE = 6;
+
+// Save a parameter snapshot, replacing the previous one only once the new one is written
+bool DeviceStorage::saveParamSnapshot(const String& serial, const std::vector<ParamSnapshotEntry>& entries) {
+  if (entries.size() > 0xFFFF) {
+    return false;
+  }
+
+  std::vector<uint8_t> buffer(SNAPSHOT_HEADER_SIZE + entries.size() * SNAPSHOT_ENTRY_SIZE);
+  uint16_t count = entries.size();
+  memcpy(&buffer[0], &SNAPSHOT_MAGIC, 4);
+  memcpy(&buffer[4], &SNAPSHOT_VERSION, 2);
+  memcpy(&buffer[6], &count, 2);
+  uint8_t* out = &buffer[SNAPSHOT_HEADER_SIZE];
+  for (const ParamSnapshotEntry& entry : entries) {
+    memcpy(out, &entry.paramId, 2);
+    memcpy(out + 2, &entry.value, 4);
+    out += SNAPSHOT_ENTRY_SIZE;
+  }
+
+  String filename = getSnapshotFileName(serial);
+  String tempName = filename + ".tmp";
+  File file = LittleFS.open(tempName.c_str(), "w");
+  if (!file) {
+    return false;
+  }
+  size_t written = file.write(buffer.data(), buffer.size());
+  file.close();
+
+  if (written != buffer.size()) {
+    LittleFS.remove(tempName.c_str());
+    return false;
+  }
+  LittleFS.remove(filename.c_str());
+  return LittleFS.rename(tempName.c_str(), filename.c_str());
+}
+
+// Load a parameter snapshot; false if there is none or it is damaged
+bool DeviceStorage::loadParamSnapshot(const String& serial, std::vector<ParamSnapshotEntry>& entries) {
+  String filename = getSnapshotFileName(serial);
+  if (!LittleFS.exists(filename.c_str())) {
+    return false;
+  }
+
+  File file = LittleFS.open(filename.c_str(), "r");
+  if (!file) {
+    return false;
+  }
+
+  uint8_t header[SNAPSHOT_HEADER_SIZE];
+  uint32_t magic = 0;
+  uint16_t version = 0;
+  uint16_t count = 0;
+  if (file.read(header, sizeof(header)) == sizeof(header)) {
+    memcpy(&magic, &header[0], 4);
+    memcpy(&version, &header[4], 2);
+    memcpy(&count, &header[6], 2);
+  }
+  if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION ||
+      file.size() != SNAPSHOT_HEADER_SIZE + count * SNAPSHOT_ENTRY_SIZE) {
+    DBG_OUTPUT_PORT.printf("Parameter snapshot %s is invalid\r\n", filename.c_str());
+    file.close();
+    return false;
+  }
+
+  std::vector<uint8_t> buffer(count * SNAPSHOT_ENTRY_SIZE);
+  bool complete = file.read(buffer.data(), buffer.size()) == buffer.size();
+  file.close();
+  if (!complete) {
+    return false;
+  }
+
+  entries.resize(count);
+  for (uint16_t i = 0; i < count; i++) {
+    memcpy(&entries[i].paramId, &buffer[i * SNAPSHOT_ENTRY_SIZE], 2);
+    memcpy(&entries[i].value, &buffer[i * SNAPSHOT_ENTRY_SIZE + 2], 4);
+  }
+  return true;
+}
+
 // Get the JSON cache filename for a device serial number
 String DeviceStorage::getJsonFileName(const String& serial) {
   // Extract the last part of the serial (after the last colon)
@@ -72,3 +159,10 @@ String DeviceStorage::getJsonFileName(const String& serial) {
   String serialPart = (lastColon >= 0) ? serial.substring(lastColon + 1) : serial;
   return "/" + serialPart + ".json";
 }
+
+// Get the parameter snapshot filename for a device serial number
+String DeviceStorage::getSnapshotFileName(const String& serial) {
+  int lastColon = serial.lastIndexOf(':');
+  String serialPart = (lastColon >= 0) ? serial.substring(lastColon + 1) : serial;
+  return "/" + serialPart + ".params";
+}
@@ -2,6 +2,14 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
+#include <vector>
+
+// One parameter of a snapshot: its ID and raw value (fixed-point x32, as sent over SDO)
+struct ParamSnapshotEntry {
+  uint16_t paramId;
+  int32_t value;
+};
+
 // Device storage manager for handling device list and JSON cache file operations
 class DeviceStorage {
 public:
@@ -14,6 +22,11 @@ public:
   static bool hasJsonCache(const String& serial);
   static bool removeJsonCache(const String& serial);
 
+  // Parameter snapshot operations (<serial>.params)
+  static bool saveParamSnapshot(const String& serial, const std::vector<ParamSnapshotEntry>& entries);
+  static bool loadParamSnapshot(const String& serial, std::vector<ParamSnapshotEntry>& entries);
+
   // Utility
   static String getJsonFileName(const String& serial);
+  static String getSnapshotFileName(const String& serial);
 };
@@ -0,0 +1,128 @@
+#include "param_write_queue.h"
+
+#include <Arduino.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "managers/device_connection.h"
+#include "models/can_event.h"
+#include "protocols/sdo_protocol.h"
+#include "utils/deadline.h"
+
+#define DBG_OUTPUT_PORT Serial
+
+extern QueueHandle_t canEventQueue;
+
+ParamWriteQueue& ParamWriteQueue::instance() {
+  static ParamWriteQueue instance;
+  return instance;
+}
+
+ParamWriteQueue::Entry* ParamWriteQueue::find(int paramId) {
+  for (Entry& entry : entries_) {
+    if (entry.paramId == paramId) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+bool ParamWriteQueue::enqueue(int paramId, double value) {
+  Entry* entry = find(paramId);
+  if (entry == nullptr) {
+    if (entries_.size() >= PARAM_WRITE_QUEUE_SIZE) {
+      DBG_OUTPUT_PORT.printf("[ParamWrite] Queue full, update of %d refused\n", paramId);
+      return false;
+    }
+    entries_.push_back({paramId, value, 0, true, false, 0});
+    return true;
+  }
+
+  if (entry->waiting) {
+    entry->coalesced++;
+  }
+  entry->value = value;
+  entry->waiting = true;
+  return true;
+}
+
+void ParamWriteQueue::process(uint32_t now) {
+  if (retryPending_ && msRemaining(retryStartMs_, PARAM_WRITE_RETRY_MS, now) > 0) {
+    return;
+  }
+  retryPending_ = false;
+
+  uint8_t nodeId = DeviceConnection::instance().getNodeId();
+  uint32_t generation = generation_;
+  for (Entry& entry : entries_) {
+    if (inFlight_ >= PARAM_WRITE_WINDOW) {
+      return;
+    }
+    if (!entry.waiting || entry.inFlight) {
+      continue;
+    }
+
+    int paramId = entry.paramId;
+    auto onComplete = [this, generation, paramId](const SdoCompletion& completion) {
+      if (generation == generation_) {
+        onWriteDone(paramId, completion);
+      }
+    };
+    uint16_t index = SDOProtocol::INDEX_PARAM_UID | (paramId >> 8);
+    uint32_t data = (uint32_t)(int32_t)(entry.value * 32);
+    if (!SdoTransactionTable::instance().startWrite(nodeId, index, paramId & 0xFF, data, onComplete)) {
+      retryPending_ = true;  // Table full, or the key is busy with another writer
+      retryStartMs_ = now;
+      return;
+    }
+    entry.inFlightValue = entry.value;
+    entry.waiting = false;
+    entry.inFlight = true;
+    inFlight_++;
+  }
+}
+
+// Runs in canTask from SdoTransactionTable::process()
+void ParamWriteQueue::onWriteDone(int paramId, const SdoCompletion& completion) {
+  inFlight_--;
+  Entry* entry = find(paramId);
+  if (entry == nullptr) {
+    return;
+  }
+  entry->inFlight = false;
+  if (entry->waiting) {
+    return;  // Superseded; the newer value goes out on the next process()
+  }
+
+  CANEvent evt;
+  evt.type = EVT_VALUE_SET;
+  evt.data.valueSet.paramId = paramId;
+  evt.data.valueSet.value = entry->inFlightValue;
+  evt.data.valueSet.result = SDOProtocol::toSetValueResult(completion);
+  if (entry->coalesced > 0) {
+    DBG_OUTPUT_PORT.printf("[ParamWrite] %d = %.2f (%u updates coalesced)\n", paramId, entry->inFlightValue,
+                           (unsigned)entry->coalesced);
+  }
+  entries_.erase(entries_.begin() + (entry - entries_.data()));
+  xQueueSend(canEventQueue, &evt, 0);
+}
+
+uint32_t ParamWriteQueue::getMsUntilNextWork(uint32_t now) const {
+  if (inFlight_ >= PARAM_WRITE_WINDOW) {
+    return NO_DEADLINE;  // The transaction table's timeouts cover the writes in flight
+  }
+  for (const Entry& entry : entries_) {
+    if (entry.waiting && !entry.inFlight) {
+      return retryPending_ ? msRemaining(retryStartMs_, PARAM_WRITE_RETRY_MS, now) : 0;
+    }
+  }
+  return NO_DEADLINE;
+}
+
+void ParamWriteQueue::clear() {
+  entries_.clear();
+  generation_++;
+  inFlight_ = 0;
+  retryPending_ = false;
+}
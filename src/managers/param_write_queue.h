@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "models/can_types.h"
+#include "protocols/sdo_transaction_table.h"
+
+// Parameters with a write queued or in flight at once
+#define PARAM_WRITE_QUEUE_SIZE 16
+// Writes kept in flight (leaves table slots for device operations)
+#define PARAM_WRITE_WINDOW 2
+// Retry delay when a write cannot be queued (transaction table or TX queue full)
+#define PARAM_WRITE_RETRY_MS 5
+
+/**
+ * Interactive parameter writes (updateParam) for the connected node, owned by canTask.
+ *
+ * Each parameter has at most one write in flight and one value waiting behind it; a new
+ * value replaces the waiting one, so dragging a slider costs one write per round trip
+ * instead of one per message. Writes to different parameters are pipelined next to spot
+ * value polling, which keeps running.
+ *
+ * Only the last write of a burst is reported: EVT_VALUE_SET carries the value the node
+ * ended up with (or the reason it refused it) once nothing newer is waiting.
+ */
+class ParamWriteQueue {
+public:
+  static ParamWriteQueue& instance();
+
+  // canTask: set paramId to value, replacing a value still waiting for that parameter.
+  // False if too many parameters are queued.
+  bool enqueue(int paramId, double value);
+
+  // canTask: issue waiting writes
+  void process(uint32_t now);
+  uint32_t getMsUntilNextWork(uint32_t now) const;  // NO_DEADLINE when nothing can be issued
+
+  // Drop queued writes and ignore those in flight (e.g. when switching devices)
+  void clear();
+
+private:
+  ParamWriteQueue() = default;
+  ParamWriteQueue(const ParamWriteQueue&) = delete;
+  ParamWriteQueue& operator=(const ParamWriteQueue&) = delete;
+
+  struct Entry {
+    int paramId;
+    double value;          // Latest value requested
+    double inFlightValue;  // Value of the write in flight
+    bool waiting;          // value not written yet
+    bool inFlight;
+    uint16_t coalesced;    // Values replaced before they were written
+  };
+
+  Entry* find(int paramId);
+  void onWriteDone(int paramId, const SdoCompletion& completion);
+
+  std::vector<Entry> entries_;
+  uint32_t generation_ = 0;    // Bumped by clear(); completions of older writes are ignored
+  uint8_t inFlight_ = 0;       // Writes issued, completion not handled yet
+  bool retryPending_ = false;  // Last attempt to queue a write failed
+  uint32_t retryStartMs_ = 0;  // Time of that attempt
+};
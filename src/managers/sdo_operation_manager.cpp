@@ -0,0 +1,223 @@
+#include "sdo_operation_manager.h"
+
+#include <Arduino.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "managers/device_connection.h"
+#include "utils/deadline.h"
+
+#define DBG_OUTPUT_PORT Serial
+
+extern QueueHandle_t canEventQueue;
+
+void SdoOperation::read(uint16_t index, uint8_t subIndex) {
+  steps_.push_back({STEP_READ, index, subIndex, 0, SDO_TIMEOUT_ADAPTIVE});
+}
+
+void SdoOperation::write(uint16_t index, uint8_t subIndex, uint32_t value, uint32_t timeoutMs) {
+  steps_.push_back({STEP_WRITE, index, subIndex, value, timeoutMs});
+}
+
+void SdoOperation::wait(uint32_t ms) {
+  steps_.push_back({STEP_WAIT, 0, 0, 0, ms});
+}
+
+void SdoOperation::finish(bool success) {
+  steps_.clear();
+  finished_ = true;
+  success_ = success;
+}
+
+void SdoOperation::resumeChild(SdoOperation& child, const SdoCompletion* last) {
+  child.resume(last);
+  steps_.insert(steps_.end(), child.steps_.begin(), child.steps_.end());
+  child.steps_.clear();
+}
+
+SdoOperationManager& SdoOperationManager::instance() {
+  static SdoOperationManager instance;
+  return instance;
+}
+
+bool SdoOperationManager::submit(std::unique_ptr<SdoOperation> operation, const CANCommand& cmd) {
+  Entry entry;
+  entry.operation = std::move(operation);
+  entry.requestId = cmd.requestId;
+  entry.clientId = cmd.clientId;
+
+  const char* refusal = nullptr;
+  if (!DeviceConnection::instance().isIdle()) {
+    refusal = "device busy";
+  } else if (queue_.size() >= SDO_OPERATION_QUEUE_SIZE) {
+    refusal = "too many operations queued";
+  }
+
+  if (refusal != nullptr) {
+    DBG_OUTPUT_PORT.printf("[SdoOperation] %s refused: %s\n", entry.operation->name(), refusal);
+    entry.operation->abandon();
+    postResult(entry);
+    return false;
+  }
+
+  queue_.push_back(std::move(entry));
+  return true;
+}
+
+// Let the running operation queue further steps (or finish)
+void SdoOperationManager::advance(const SdoCompletion* last) {
+  SdoOperation& operation = *active_.operation;
+  operation.resume(last);
+
+  if (!operation.isFinished() && operation.steps_.empty() && inFlight_ == 0) {
+    DBG_OUTPUT_PORT.printf("[SdoOperation] %s queued no step, ending it\n", operation.name());
+    operation.finish(false);
+  }
+}
+
+bool SdoOperationManager::issueStep(const SdoOperation::Step& step) {
+  uint32_t generation = generation_;
+
+  // Runs in canTask (SdoTransactionTable::process); handled by the next process() call
+  auto onComplete = [this, generation](const SdoCompletion& completion) {
+    if (generation == generation_) {
+      completions_.push_back(completion);
+    }
+  };
+
+  SdoTransactionTable& table = SdoTransactionTable::instance();
+  return step.kind == SdoOperation::STEP_READ
+             ? table.startRead(nodeId_, step.index, step.subIndex, onComplete, step.timeoutMs)
+             : table.startWrite(nodeId_, step.index, step.subIndex, step.value, onComplete, step.timeoutMs);
+}
+
+// Forget the running operation and anything it still has in flight
+void SdoOperationManager::endActive() {
+  active_.operation.reset();
+  generation_++;
+  inFlight_ = 0;
+  completions_.clear();
+  waitStarted_ = false;
+  retryPending_ = false;
+}
+
+void SdoOperationManager::process(uint32_t now) {
+  while (true) {
+    if (active_.operation != nullptr && active_.operation->isFinished()) {
+      postResult(active_);
+      endActive();
+    }
+
+    if (active_.operation == nullptr) {
+      if (queue_.empty()) {
+        return;
+      }
+      active_ = std::move(queue_.front());
+      queue_.pop_front();
+      nodeId_ = DeviceConnection::instance().getNodeId();
+      DBG_OUTPUT_PORT.printf("[SdoOperation] Starting %s on node %d\n", active_.operation->name(), nodeId_);
+      advance(nullptr);
+      continue;
+    }
+
+    if (!completions_.empty()) {
+      SdoCompletion completion = completions_.front();
+      completions_.pop_front();
+      inFlight_--;
+      advance(&completion);
+      continue;
+    }
+
+    std::deque<SdoOperation::Step>& steps = active_.operation->steps_;
+    if (steps.empty()) {
+      return;  // Waiting for steps in flight
+    }
+
+    const SdoOperation::Step& step = steps.front();
+    if (step.kind == SdoOperation::STEP_WAIT) {
+      if (inFlight_ > 0) {
+        return;
+      }
+      if (!waitStarted_) {
+        waitStarted_ = true;
+        stepStartMs_ = now;
+      }
+      if (msRemaining(stepStartMs_, step.timeoutMs, now) > 0) {
+        return;
+      }
+      steps.pop_front();
+      waitStarted_ = false;
+      advance(nullptr);
+      continue;
+    }
+
+    if (inFlight_ >= SDO_OPERATION_WINDOW ||
+        (retryPending_ && msRemaining(stepStartMs_, SDO_OPERATION_RETRY_MS, now) > 0)) {
+      return;
+    }
+    if (!issueStep(step)) {
+      retryPending_ = true;
+      stepStartMs_ = now;
+      return;
+    }
+    steps.pop_front();
+    inFlight_++;
+    retryPending_ = false;
+  }
+}
+
+uint32_t SdoOperationManager::getMsUntilNextWork(uint32_t now) const {
+  if (active_.operation == nullptr) {
+    return queue_.empty() ? NO_DEADLINE : 0;
+  }
+  if (active_.operation->isFinished() || !completions_.empty()) {
+    return 0;
+  }
+
+  const std::deque<SdoOperation::Step>& steps = active_.operation->steps_;
+  if (steps.empty()) {
+    return NO_DEADLINE;  // The transaction table's timeouts cover the steps in flight
+  }
+  if (steps.front().kind == SdoOperation::STEP_WAIT) {
+    if (inFlight_ > 0) {
+      return NO_DEADLINE;
+    }
+    return waitStarted_ ? msRemaining(stepStartMs_, steps.front().timeoutMs, now) : 0;
+  }
+  if (inFlight_ >= SDO_OPERATION_WINDOW) {
+    return NO_DEADLINE;
+  }
+  return retryPending_ ? msRemaining(stepStartMs_, SDO_OPERATION_RETRY_MS, now) : 0;
+}
+
+void SdoOperationManager::cancelAll() {
+  if (active_.operation != nullptr) {
+    DBG_OUTPUT_PORT.printf("[SdoOperation] Cancelling %s\n", active_.operation->name());
+    active_.operation->abandon();
+    postResult(active_);
+    endActive();  // A completion still in the transaction table is ignored
+  }
+  for (Entry& entry : queue_) {
+    entry.operation->abandon();
+    postResult(entry);
+  }
+  queue_.clear();
+}
+
+void SdoOperationManager::postResult(Entry& entry) {
+  CANEvent evt;
+  evt.type = entry.operation->getResultType();
+  evt.requestId = entry.requestId;
+  evt.clientId = entry.clientId;
+  entry.operation->buildResult(evt);
+
+  DBG_OUTPUT_PORT.printf("[SdoOperation] %s %s\n", entry.operation->name(),
+                         entry.operation->succeeded() ? "done" : "failed");
+
+  // A lost result would leave the client waiting, so give the event processor a moment
+  if (xQueueSend(canEventQueue, &evt, pdMS_TO_TICKS(QUEUE_SEND_TIMEOUT_MS)) != pdTRUE) {
+    DBG_OUTPUT_PORT.printf("[SdoOperation] Event queue full, %s result dropped\n", entry.operation->name());
+    releaseEventPayload(evt);
+  }
+}
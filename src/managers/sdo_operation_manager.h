@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include "models/can_command.h"
+#include "models/can_event.h"
+#include "protocols/sdo_transaction_table.h"
+
+// Operations waiting behind the running one
+#define SDO_OPERATION_QUEUE_SIZE 8
+// Retry delay when a step's request cannot be queued (transaction table or TX queue full)
+#define SDO_OPERATION_RETRY_MS 5
+// Reads/writes one operation keeps in flight (leaves table slots for spot values)
+#define SDO_OPERATION_WINDOW 4
+
+/**
+ * A multi-step SDO exchange with the connected node (error log read, mapping dump, ...),
+ * written as a resumable state machine instead of a loop around blocking waits.
+ *
+ * resume() is called once to start and again each time one of its steps has finished;
+ * it queues further steps with read()/write()/wait() or ends the operation with finish().
+ * buildResult() then fills in the result event.
+ *
+ * Steps are issued in the order queued. Up to SDO_OPERATION_WINDOW reads and writes are in
+ * flight at once (each to a different index/subindex) and may complete in any order; a
+ * wait step starts once everything before it has completed. Steps still in flight when the
+ * operation finishes are dropped.
+ */
+class SdoOperation {
+public:
+  explicit SdoOperation(CANEventType resultType) : resultType_(resultType) {}
+  virtual ~SdoOperation() = default;
+
+  virtual const char* name() const = 0;
+
+  // Advance after a step. last is the outcome of a read/write step, nullptr on the first
+  // call and after a wait step.
+  virtual void resume(const SdoCompletion* last) = 0;
+
+  // Fill in evt.data (type, requestId and clientId are already set)
+  virtual void buildResult(CANEvent& evt) = 0;
+
+  // Give up without running (device busy, queue full, cancelled)
+  void abandon() { finish(false); }
+
+  CANEventType getResultType() const { return resultType_; }
+  bool isFinished() const { return finished_; }
+  bool succeeded() const { return success_; }
+
+protected:
+  void read(uint16_t index, uint8_t subIndex);
+  void write(uint16_t index, uint8_t subIndex, uint32_t value, uint32_t timeoutMs = SDO_TIMEOUT_ADAPTIVE);
+  void wait(uint32_t ms);
+  void finish(bool success);
+
+  // Run another operation as a stage of this one: resume it and take over the steps it
+  // queued. Pass it the completions of its steps until it has finished.
+  void resumeChild(SdoOperation& child, const SdoCompletion* last);
+
+private:
+  friend class SdoOperationManager;
+
+  enum StepKind : uint8_t { STEP_NONE, STEP_READ, STEP_WRITE, STEP_WAIT };
+
+  struct Step {
+    StepKind kind = STEP_NONE;
+    uint16_t index = 0;
+    uint8_t subIndex = 0;
+    uint32_t value = 0;
+    uint32_t timeoutMs = 0;  // Transaction timeout, or the delay of a wait step
+  };
+
+  CANEventType resultType_;
+  std::deque<Step> steps_;  // Queued, not issued yet
+  bool finished_ = false;
+  bool success_ = false;
+};
+
+/**
+ * Runs SdoOperations for the connected node from canTask, one at a time in submission order.
+ *
+ * Each step is an SdoTransactionTable transaction, so a long operation only occupies a few
+ * table slots and canTask keeps serving spot values, interval frames and scans in between.
+ * When an operation finishes its result event goes to canEventQueue, tagged with the
+ * requestId and clientId of the command that started it.
+ */
+class SdoOperationManager {
+public:
+  static SdoOperationManager& instance();
+
+  // canTask: queue an operation. If it cannot run (device busy, queue full) its failure
+  // result is posted right away. False in that case.
+  bool submit(std::unique_ptr<SdoOperation> operation, const CANCommand& cmd);
+
+  // canTask: start queued operations and advance the running one
+  void process(uint32_t now);
+  uint32_t getMsUntilNextWork(uint32_t now) const;  // NO_DEADLINE when idle
+
+  bool isBusy() const { return active_.operation != nullptr || !queue_.empty(); }
+
+  // Fail the running and queued operations (e.g. when switching devices)
+  void cancelAll();
+
+private:
+  SdoOperationManager() = default;
+  SdoOperationManager(const SdoOperationManager&) = delete;
+  SdoOperationManager& operator=(const SdoOperationManager&) = delete;
+
+  struct Entry {
+    std::unique_ptr<SdoOperation> operation;  // Null when no operation is running
+    uint32_t requestId = 0;
+    uint32_t clientId = 0;
+  };
+
+  void advance(const SdoCompletion* last);
+  bool issueStep(const SdoOperation::Step& step);
+  void endActive();
+  void postResult(Entry& entry);
+
+  std::deque<Entry> queue_;
+  Entry active_;
+  uint8_t nodeId_ = 0;                     // Node the running operation talks to
+  uint32_t generation_ = 0;                // Bumped per operation; completions of older ones are ignored
+  uint8_t inFlight_ = 0;                   // Reads/writes issued, completion not handled yet
+  std::deque<SdoCompletion> completions_;  // Outcomes not passed to resume() yet
+  bool waitStarted_ = false;               // Wait step at the head of the queue is running
+  bool retryPending_ = false;              // Last attempt to queue a step's request failed
+  uint32_t stepStartMs_ = 0;               // Wait step start, or last failed attempt to queue a step
+};
@@ -0,0 +1,292 @@
+#include "spot_value_history.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const uint32_t SpotValueHistory::TIER_MS[SpotValueHistory::TIER_COUNT] = {1000, 10000};
+
+// Worst-case characters per number: sign, 10 digits and a comma
+static const size_t MAX_NUMBER_CHARS = 12;
+
+void SpotValueHistory::Tier::add(int32_t value, uint32_t number) {
+  if (count > 0 && number != open) {
+    close();
+  }
+  if (count == 0) {
+    if (!hasClosed) {
+      first = number;
+    }
+    open = number;
+    sum = 0;
+    min = value;
+    max = value;
+  }
+  sum += value;
+  min = value < min ? value : min;
+  max = value > max ? value : max;
+  count++;
+}
+
+void SpotValueHistory::Tier::close() {
+  size_t size = ring.size();
+  // Buckets skipped since the last one closed had no samples
+  if (hasClosed && open > newest + 1) {
+    uint32_t gap = open - newest - 1 > size ? open - size : newest + 1;
+    for (uint32_t number = gap; number < open; number++) {
+      ring[number % size] = {1, 0, 0};
+    }
+  }
+  ring[open % size] = {min, max, (int32_t)(sum / (int64_t)count)};
+  newest = open;
+  hasClosed = true;
+  count = 0;
+}
+
+bool SpotValueHistory::Tier::get(uint32_t number, Bucket& bucket) const {
+  if (count > 0 && number == open) {
+    bucket = {min, max, (int32_t)(sum / (int64_t)count)};
+    return true;
+  }
+  size_t size = ring.size();
+  if (!hasClosed || number > newest || number < first || newest - number >= size) {
+    return false;
+  }
+  bucket = ring[number % size];
+  return bucket.min <= bucket.max;
+}
+
+void SpotValueHistory::Tier::resize(size_t entries) {
+  std::vector<Bucket> old;
+  old.swap(ring);
+  ring.assign(entries, {1, 0, 0});
+  if (!hasClosed) {
+    return;
+  }
+
+  // Keep the newest buckets that still fit
+  uint32_t keep = newest - first + 1;
+  keep = keep > old.size() ? old.size() : keep;
+  keep = keep > entries ? entries : keep;
+  first = newest - keep + 1;
+  for (uint32_t number = first; number <= newest; number++) {
+    ring[number % entries] = old[number % old.size()];
+  }
+}
+
+void SpotValueHistory::Series::resize(size_t entries) {
+  std::vector<Sample> old;
+  old.swap(raw);
+  raw.resize(entries);
+
+  // Copy the newest samples, oldest first
+  size_t keep = rawCount > entries ? entries : rawCount;
+  size_t from = (rawNext + old.size() - keep) % (old.empty() ? 1 : old.size());
+  for (size_t i = 0; i < keep; i++) {
+    raw[i] = old[(from + i) % old.size()];
+  }
+  rawCount = keep;
+  rawNext = keep % entries;
+
+  for (Tier& tier : tiers) {
+    tier.resize(entries);
+  }
+}
+
+void SpotValueHistory::track(uint8_t nodeId, const SpotValueSlots& slots) {
+  if (nodeId != nodeId_) {
+    series_.clear();  // Another device: its parameter IDs mean something else
+    nodeId_ = nodeId;
+  }
+
+  size_t count = slots.size();
+  size_t entries = 0;
+  if (count > 0) {
+    size_t perEntry = sizeof(Sample) + TIER_COUNT * sizeof(Bucket);
+    entries = SPOT_HISTORY_BUDGET_BYTES / (count * perEntry);
+    entries = entries < SPOT_HISTORY_MIN_ENTRIES ? SPOT_HISTORY_MIN_ENTRIES : entries;
+    entries = entries > SPOT_HISTORY_MAX_ENTRIES ? SPOT_HISTORY_MAX_ENTRIES : entries;
+  }
+
+  std::vector<Series> tracked(count);
+  for (size_t slot = 0; slot < count; slot++) {
+    Series& series = tracked[slot];
+    series.paramId = slots.paramIdAt(slot);
+    for (Series& old : series_) {
+      if (old.paramId == series.paramId && !old.raw.empty()) {
+        series = std::move(old);
+        break;
+      }
+    }
+    series.resize(entries);
+  }
+  series_.swap(tracked);
+  entries_ = entries;
+}
+
+void SpotValueHistory::clear() {
+  series_.clear();
+  entries_ = 0;
+}
+
+void SpotValueHistory::record(int slot, int32_t value, uint32_t timeMs) {
+  Series& series = series_[slot];
+  series.raw[series.rawNext] = {timeMs, value};
+  series.rawNext = (series.rawNext + 1) % series.raw.size();
+  series.rawCount += series.rawCount < series.raw.size();
+  for (int tier = 0; tier < TIER_COUNT; tier++) {
+    series.tiers[tier].add(value, timeMs / TIER_MS[tier]);
+  }
+}
+
+bool SpotValueHistory::isWanted(const Series& series, const int* paramIds, int count) {
+  bool wanted = paramIds == nullptr;
+  for (int i = 0; !wanted && i < count; i++) {
+    wanted = paramIds[i] == series.paramId;
+  }
+  return wanted;
+}
+
+size_t SpotValueHistory::countRaw(const Series& series, uint32_t fromMs, uint32_t toMs) {
+  size_t inRange = 0;
+  for (size_t i = 0; i < series.rawCount; i++) {
+    inRange += series.raw[i].timeMs - fromMs <= toMs - fromMs;
+  }
+  return inRange;
+}
+
+bool SpotValueHistory::getBucketRange(const Tier& history, uint32_t length, uint32_t fromMs, uint32_t toMs,
+                                      uint32_t& first, uint32_t& last) const {
+  last = history.count > 0 ? history.open : history.newest;
+  first = history.hasClosed ? history.first : history.open;
+  if (last - first >= entries_) {
+    first = last - entries_ + 1;
+  }
+  first = fromMs / length > first ? fromMs / length : first;
+  last = toMs / length < last ? toMs / length : last;
+  return (history.count > 0 || history.hasClosed) && first <= last;
+}
+
+// Appends to a buffer sized up front for the worst case
+struct HistoryWriter {
+  char* buffer;
+  size_t size;
+  size_t length = 0;
+
+  void text(const char* value) {
+    size_t n = strlen(value);
+    if (length + n < size) {
+      memcpy(buffer + length, value, n);
+      length += n;
+    }
+  }
+
+  void number(int64_t value) {
+    char digits[24];
+    snprintf(digits, sizeof(digits), "%" PRId64, value);
+    text(digits);
+  }
+
+  void separator(bool first) {
+    if (!first) {
+      text(",");
+    }
+  }
+};
+
+char* SpotValueHistory::query(const int* paramIds, int count, uint32_t fromMs, uint32_t toMs, uint32_t resolutionMs,
+                              uint32_t nowMs) const {
+  // Raw samples, or the finest tier at least as coarse as asked for (the coarsest at most)
+  int tier = resolutionMs > 0 ? 0 : -1;
+  while (tier >= 0 && tier < TIER_COUNT - 1 && TIER_MS[tier] < resolutionMs) {
+    tier++;
+  }
+
+  // Size the buffer for what is in range: two numbers per raw sample, three per bucket,
+  // plus the keys around them
+  size_t size = 128;
+  for (const Series& series : series_) {
+    if (!isWanted(series, paramIds, count)) {
+      continue;
+    }
+    size_t values = 0;
+    uint32_t first;
+    uint32_t last;
+    if (tier < 0) {
+      values = 2 * countRaw(series, fromMs, toMs);
+    } else if (getBucketRange(series.tiers[tier], TIER_MS[tier], fromMs, toMs, first, last)) {
+      values = 3 * ((size_t)(last - first) + 1);
+    }
+    size += 64 + values * MAX_NUMBER_CHARS;
+  }
+  HistoryWriter out{(char*)malloc(size), size};
+  if (out.buffer == nullptr) {
+    return nullptr;
+  }
+
+  out.text("{\"now\":");
+  out.number(nowMs);
+  out.text(",\"resolution\":");
+  out.number(tier < 0 ? 0 : TIER_MS[tier]);
+  out.text(",\"scale\":32,\"series\":[");
+
+  bool firstSeries = true;
+  for (const Series& series : series_) {
+    if (!isWanted(series, paramIds, count)) {
+      continue;
+    }
+
+    out.separator(firstSeries);
+    firstSeries = false;
+    out.text("{\"id\":");
+    out.number(series.paramId);
+
+    if (tier < 0) {
+      // Raw samples in the range, oldest first
+      size_t oldest = (series.rawNext + series.raw.size() - series.rawCount) % series.raw.size();
+      for (int column = 0; column < 2; column++) {
+        out.text(column == 0 ? ",\"t\":[" : "],\"v\":[");
+        bool firstValue = true;
+        for (size_t i = 0; i < series.rawCount; i++) {
+          const Sample& sample = series.raw[(oldest + i) % series.raw.size()];
+          if (sample.timeMs - fromMs <= toMs - fromMs) {
+            out.separator(firstValue);
+            firstValue = false;
+            out.number(column == 0 ? sample.timeMs : sample.value);
+          }
+        }
+      }
+      out.text("]}");
+      continue;
+    }
+
+    const Tier& history = series.tiers[tier];
+    uint32_t length = TIER_MS[tier];
+    uint32_t first;
+    uint32_t last;
+    bool empty = !getBucketRange(history, length, fromMs, toMs, first, last);
+
+    out.text(",\"start\":");
+    out.number(empty ? 0 : (uint64_t)first * length);
+    const char* columns[] = {",\"min\":[", "],\"max\":[", "],\"mean\":["};
+    for (int column = 0; column < 3; column++) {
+      out.text(columns[column]);
+      for (uint32_t number = first; !empty && number <= last; number++) {
+        out.separator(number == first);
+        Bucket bucket;
+        if (!history.get(number, bucket)) {
+          out.text("null");
+        } else {
+          out.number(column == 0 ? bucket.min : column == 1 ? bucket.max : bucket.mean);
+        }
+      }
+    }
+    out.text("]}");
+  }
+  out.text("]}");
+
+  out.buffer[out.length] = '\0';
+  char* json = (char*)realloc(out.buffer, out.length + 1);
+  return json != nullptr ? json : out.buffer;
+}
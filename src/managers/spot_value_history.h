@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "managers/spot_value_slots.h"
+
+// RAM shared by every series. Each series gets the same number of entries in every ring,
+// so the fewer parameters are monitored, the further back each one reaches.
+#define SPOT_HISTORY_BUDGET_BYTES 49152
+#define SPOT_HISTORY_MIN_ENTRIES 8
+#define SPOT_HISTORY_MAX_ENTRIES 600
+
+/**
+ * Recent history of the monitored spot values, so a client that connects or opens a chart
+ * late can draw the last minutes at once instead of waiting for live samples.
+ *
+ * Every parameter has a ring of raw samples and, per tier (1 s and 10 s), a ring of
+ * min/max/mean buckets. Buckets are keyed by their number (time / tier length), so a gap
+ * in the samples is a gap in the history rather than a bucket spanning it.
+ *
+ * Series are indexed by spot value slot. track() re-keys them when monitoring restarts and
+ * keeps the history of parameters that are still monitored on the same node, so restarting
+ * the stream (a browser reconnecting, say) does not lose it. Owned by canTask.
+ */
+class SpotValueHistory {
+public:
+  static const int TIER_COUNT = 2;
+  static const uint32_t TIER_MS[TIER_COUNT];
+
+  // One series per slot; forgets parameters no longer monitored and resizes the rest
+  void track(uint8_t nodeId, const SpotValueSlots& slots);
+  void clear();
+
+  // value is fixed-point, scaled by 32 as on the wire
+  void record(int slot, int32_t value, uint32_t timeMs);
+
+  size_t entriesPerRing() const { return entries_; }
+
+  // JSON object for getSpotValueHistory (malloc'd, caller frees; nullptr if out of memory):
+  // {"now","resolution","scale","series":[...]}. resolutionMs 0 gives raw samples
+  // ({"id","t":[],"v":[]}); otherwise the finest tier at least that coarse
+  // ({"id","start","min":[],"max":[],"mean":[]}, null for a bucket without samples).
+  // Values are fixed-point (divide by scale). paramIds == nullptr: every series.
+  char* query(const int* paramIds, int count, uint32_t fromMs, uint32_t toMs, uint32_t resolutionMs,
+              uint32_t nowMs) const;
+
+private:
+  struct Sample {
+    uint32_t timeMs;
+    int32_t value;
+  };
+
+  struct Bucket {
+    int32_t min;  // min > max: no samples
+    int32_t max;
+    int32_t mean;
+  };
+
+  struct Tier {
+    std::vector<Bucket> ring;  // Closed buckets, at number % size
+    bool hasClosed = false;
+    uint32_t first = 0;   // Oldest bucket number recorded
+    uint32_t newest = 0;  // Newest closed bucket number
+
+    // Bucket still filling
+    uint32_t open = 0;
+    uint32_t count = 0;  // 0: none open
+    int64_t sum = 0;
+    int32_t min = 0;
+    int32_t max = 0;
+
+    void add(int32_t value, uint32_t number);
+    void close();
+    bool get(uint32_t number, Bucket& bucket) const;
+    void resize(size_t entries);
+  };
+
+  struct Series {
+    int paramId = 0;
+    std::vector<Sample> raw;  // Ring, oldest at rawNext once full
+    size_t rawNext = 0;
+    size_t rawCount = 0;
+    Tier tiers[TIER_COUNT];
+
+    void resize(size_t entries);
+  };
+
+  static bool isWanted(const Series& series, const int* paramIds, int count);
+  static size_t countRaw(const Series& series, uint32_t fromMs, uint32_t toMs);
+  // Bucket numbers of the tier held in the range (clipped to one ring's worth); false if none
+  bool getBucketRange(const Tier& history, uint32_t length, uint32_t fromMs, uint32_t toMs, uint32_t& first,
+                      uint32_t& last) const;
+
+  std::vector<Series> series_;  // Indexed by slot
+  size_t entries_ = 0;
+  uint8_t nodeId_ = 0;
+};
@@ -0,0 +1,69 @@
+#include "spot_value_slots.h"
+
+void SpotValueSlots::assign(const int* paramIds, int count) {
+  paramIds_.clear();
+
+  // At most half full keeps probe sequences short
+  size_t buckets = 4;
+  uint8_t bits = 2;
+  while (buckets < (size_t)count * 2) {
+    buckets *= 2;
+    bits++;
+  }
+  index_.assign(buckets, EMPTY);
+  shift_ = 32 - bits;
+
+  for (int i = 0; i < count && paramIds_.size() < EMPTY; i++) {
+    if (find(paramIds[i]) >= 0) {
+      continue;  // Listed twice
+    }
+    uint32_t bucket = bucketOf(paramIds[i]);
+    while (index_[bucket] != EMPTY) {
+      bucket = (bucket + 1) & (buckets - 1);
+    }
+    index_[bucket] = paramIds_.size();
+    paramIds_.push_back(paramIds[i]);
+  }
+
+  values_.assign(paramIds_.size(), 0.0);
+  timestamps_.assign(paramIds_.size(), 0);
+  valueGen_.assign(paramIds_.size(), 0);
+  batchGen_.assign(paramIds_.size(), 0);
+  valueGeneration_++;
+  clearBatch();
+}
+
+void SpotValueSlots::clear() {
+  assign(nullptr, 0);
+}
+
+int SpotValueSlots::find(int paramId) const {
+  if (index_.empty()) {
+    return -1;
+  }
+  uint32_t mask = index_.size() - 1;
+  for (uint32_t bucket = bucketOf(paramId);; bucket = (bucket + 1) & mask) {
+    uint16_t slot = index_[bucket];
+    if (slot == EMPTY) {
+      return -1;
+    }
+    if (paramIds_[slot] == paramId) {
+      return slot;
+    }
+  }
+}
+
+void SpotValueSlots::store(int slot, double value, uint32_t timestampMs) {
+  values_[slot] = value;
+  timestamps_[slot] = timestampMs;
+  valueGen_[slot] = valueGeneration_;
+  if (batchGen_[slot] != batchGeneration_) {
+    batchGen_[slot] = batchGeneration_;
+    batchCount_++;
+  }
+}
+
+void SpotValueSlots::clearBatch() {
+  batchGeneration_++;
+  batchCount_ = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Storage for the monitored spot values, one slot per parameter.
+ *
+ * A parameter ID maps to its slot through a small open-addressing table (Fibonacci hash,
+ * linear probing, at most half full), so routing a response is a hash and usually one
+ * probe. Values and timestamps live in contiguous arrays indexed by slot, and membership
+ * in the current batch is a per-slot generation number: clearing the batch is one
+ * increment, and storing a value never allocates.
+ *
+ * Owned by canTask; assign() is the only call that allocates.
+ */
+class SpotValueSlots {
+public:
+  // One slot per distinct ID, in the order given; forgets all values
+  void assign(const int* paramIds, int count);
+  void clear();
+
+  size_t size() const { return paramIds_.size(); }
+  int find(int paramId) const;  // Slot of paramId, -1 if not monitored
+  int paramIdAt(int slot) const { return paramIds_[slot]; }
+
+  // Record a value for the slot; it joins the current batch
+  void store(int slot, double value, uint32_t timestampMs);
+
+  bool hasValue(int slot) const { return valueGen_[slot] == valueGeneration_; }
+  double valueAt(int slot) const { return values_[slot]; }
+  uint32_t timestampAt(int slot) const { return timestamps_[slot]; }
+
+  // Values stored since the last clearBatch()
+  bool inBatch(int slot) const { return batchGen_[slot] == batchGeneration_; }
+  size_t batchSize() const { return batchCount_; }
+  void clearBatch();
+
+private:
+  static constexpr uint16_t EMPTY = 0xFFFF;
+
+  uint32_t bucketOf(int paramId) const { return ((uint32_t)paramId * 2654435761u) >> shift_; }
+
+  std::vector<int> paramIds_;
+  std::vector<uint16_t> index_;  // Hash buckets: slot, or EMPTY
+  uint8_t shift_ = 32;           // 32 - log2(index_.size())
+  std::vector<double> values_;
+  std::vector<uint32_t> timestamps_;
+  std::vector<uint32_t> valueGen_;  // == valueGeneration_: slot has a value
+  std::vector<uint32_t> batchGen_;  // == batchGeneration_: slot is in the current batch
+  uint32_t valueGeneration_ = 1;
+  uint32_t batchGeneration_ = 1;
+  size_t batchCount_ = 0;
+};
@@ -1,113 +1,288 @@
 #include "spot_values_manager.h"
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
-#include "../main.h"
 #include "../models/can_event.h"
-#include "../oi_can.h"
+#include "../models/spot_value_frame.h"
+#include "../protocols/sdo_protocol.h"
+#include "../utils/can_router.h"
+#include "../utils/deadline.h"
+#include "data_logger.h"
 #include "device_connection.h"
 
+// External queue for events
+extern QueueHandle_t canEventQueue;
+
 SpotValuesManager& SpotValuesManager::instance() {
   static SpotValuesManager instance;
   return instance;
 }
 
-SpotValuesManager::SpotValuesManager() {}
-
-void SpotValuesManager::setParamIds(const std::vector<int>& paramIds) {
-  paramIds_ = paramIds;
+SpotValuesManager::SpotValuesManager() {
+  latestMutex_ = xSemaphoreCreateMutex();
 }
 
-void SpotValuesManager::start(uint32_t intervalMs, const int* paramIds, int paramCount) {
+void SpotValuesManager::start(uint32_t intervalMs, const int* paramIds, const uint16_t* periods, int paramCount,
+                              uint8_t window) {
   interval_ = intervalMs;
-  paramIds_.clear();
+  setWindow(window);
+  slots_.assign(paramIds, paramCount);
+  publishLatest();  // The previous stream's values are forgotten
+  history_.track(DeviceConnection::instance().getNodeId(), slots_);
+  inFlight_ = 0;
+  generation_++;
+  lagMs_ = 0;
+  lastLagMs_ = 0;
+
+  // A parameter listed twice keeps its shorter period
+  schedule_.assign(slots_.size(), {0, 0, false});
   for (int i = 0; i < paramCount; i++) {
-    paramIds_.push_back(paramIds[i]);
+    uint32_t period = periods != nullptr && periods[i] != 0 ? periods[i] : intervalMs;
+    SlotSchedule& entry = schedule_[slots_.find(paramIds[i])];
+    if (entry.periodMs == 0 || period < entry.periodMs) {
+      entry.periodMs = period;
+    }
+  }
+
+  // Phase the parameters of each period evenly across it, so reads are spread out from
+  // the start rather than all falling due together
+  uint32_t now = millis();
+  flushInterval_ = intervalMs;
+  for (size_t slot = 0; slot < schedule_.size(); slot++) {
+    uint32_t period = schedule_[slot].periodMs;
+    size_t rank = 0;
+    size_t peers = 0;
+    for (size_t other = 0; other < schedule_.size(); other++) {
+      if (schedule_[other].periodMs == period) {
+        rank += other < slot;
+        peers++;
+      }
+    }
+    schedule_[slot].dueMs = now + (uint32_t)((uint64_t)period * rank / peers);
+    flushInterval_ = period < flushInterval_ ? period : flushInterval_;
   }
-  lastCollectionTime_ = millis();
-  reloadQueue();
+
+  lastCollectionTime_ = now;
 }
 
 void SpotValuesManager::stop() {
   // Flush any remaining batched values before stopping
   flushBatch();
 
-  paramIds_.clear();
-  requestQueue_.clear();
-  latestValues_.clear();
-  batch_.clear();
+  slots_.clear();
+  publishLatest();
+  schedule_.clear();
+  inFlight_ = 0;
+  generation_++;
+}
+
+void SpotValuesManager::setWindow(uint8_t window) {
+  if (window < 1) {
+    window = 1;
+  }
+  window_ = window > SPOT_VALUES_WINDOW_MAX ? SPOT_VALUES_WINDOW_MAX : window;
 }
 
 void SpotValuesManager::processQueue() {
-  // Try to send one request from queue (if rate limit allows)
-  // NOTE: Does NOT consume responses - responses are routed by CAN task via handleResponse()
-  if (!requestQueue_.empty()) {
-    int paramId = requestQueue_.front();
-
-    // Try to send request (non-blocking, respects rate limit)
-    if (OICan::RequestValue(paramId)) {
-      // Request sent successfully, remove from queue
-      requestQueue_.pop_front();
+  // NOTE: Does NOT consume responses - SdoTransactionTable hands them to handleReadDone()
+  uint32_t now = millis();
+  if (!DeviceConnection::instance().isIdle()) {
+    return;  // Reads already sent finish; nothing new while the connection is busy
+  }
+
+  // The window bounds what the device has to buffer, so no extra pacing between requests
+  uint8_t nodeId = DeviceConnection::instance().getNodeId();
+  uint16_t generation = generation_;
+  while (inFlight_ < window_) {
+    int slot = nextDueSlot(now);
+    if (slot < 0) {
+      break;
+    }
+    int paramId = slots_.paramIdAt(slot);
+    uint16_t index = SDOProtocol::INDEX_PARAM_UID | (paramId >> 8);
+
+    // Small enough for std::function to hold without allocating
+    uint16_t readSlot = slot;
+    auto onComplete = [this, generation, readSlot](const SdoCompletion& completion) {
+      handleReadDone(generation, readSlot, completion);
+    };
+
+    // Polling traffic - must not delay control frames or interactive requests
+    if (!SdoTransactionTable::instance().startRead(nodeId, index, paramId & 0xFF, onComplete, SDO_TIMEOUT_ADAPTIVE,
+                                                   CAN_TX_BACKGROUND)) {
+      break;  // TX queue or table full, or the entry busy with another reader: try next iteration
+    }
+    inFlight_++;
+
+    // Keep the phase while on time; a read that fell a whole period behind starts afresh
+    // instead of catching up in a burst
+    SlotSchedule& entry = schedule_[slot];
+    uint32_t lag = now - entry.dueMs;
+    lagMs_ = lag > lagMs_ ? lag : lagMs_;
+    entry.inFlight = true;
+    entry.dueMs += entry.periodMs;
+    if (msUntil(entry.dueMs, now) == 0) {
+      entry.dueMs = now + entry.periodMs;
     }
-    // If request failed (rate limit or TX queue full), leave it in queue and try next iteration
   }
 }
 
-bool SpotValuesManager::isWaitingForParam(int paramId) const {
+int SpotValuesManager::nextDueSlot(uint32_t now) const {
+  // Earliest deadline first: a read is released at dueMs and should be done a period later
+  int best = -1;
+  uint32_t bestDeadline = 0;
+  for (size_t slot = 0; slot < schedule_.size(); slot++) {
+    const SlotSchedule& entry = schedule_[slot];
+    if (entry.inFlight || msUntil(entry.dueMs, now) != 0) {
+      continue;
+    }
+    uint32_t deadline = entry.dueMs + entry.periodMs;
+    if (best < 0 || (int32_t)(deadline - bestDeadline) < 0) {
+      best = slot;
+      bestDeadline = deadline;
+    }
+  }
+  return best;
+}
+
+void SpotValuesManager::handleReadDone(uint16_t generation, uint16_t slot, const SdoCompletion& completion) {
+  if (generation != generation_) {
+    return;  // Sent before the stream restarted or stopped; the slot may be someone else's now
+  }
+  schedule_[slot].inFlight = false;
+  inFlight_--;
+  if (completion.status == SDO_TIMEOUT) {
+    requestTimeouts_++;  // The table already fed it to SdoRttEstimator
+  } else if (completion.status == SDO_OK) {
+    storeValue(slot, (int32_t)completion.data);  // Signed fixed-point with scale of 32
+  }
+  // An abort only frees the window slot
+}
+
+void SpotValuesManager::storeValue(int slot, int32_t value) {
+  uint32_t now = millis();
+  slots_.store(slot, value / 32.0, now);
+  history_.record(slot, value, now);
+  DataLogger::instance().record(slots_.paramIdAt(slot), value, now);
+}
+
+void SpotValuesManager::registerCanRoutes() {
+  CanRouter& router = CanRouter::instance();
+  router.registerSdoIndexBlock(SDOProtocol::INDEX_PARAM_UID >> 8, router.deferred([this](const twai_message_t& frame) {
+    // Our reads are matched by SdoTransactionTable; what reaches here answered one it
+    // already timed out. The value is still fresh.
+    uint16_t index = frame.data[1] | (frame.data[2] << 8);
+    int slot = slots_.find(((index & 0xFF) << 8) | frame.data[3]);
+    if (slot < 0 || frame.data[0] == SDOProtocol::ABORT) {
+      return false;  // Someone else asked for it (falls through to sdoResponseQueue)
+    }
+    storeValue(slot, *(int32_t*)&frame.data[4]);
+    return true;
+  }));
+}
+
+uint32_t SpotValuesManager::getMsUntilNextWork(uint32_t now) const {
   if (!isActive()) {
-    return false;
+    return NO_DEADLINE;
   }
-  // Check if this paramId is one we're monitoring
-  for (int id : paramIds_) {
-    if (id == paramId) {
-      return true;
+
+  // Timeouts of the reads in flight are SdoTransactionTable's deadlines
+  uint32_t waitMs = msRemaining(lastCollectionTime_, flushInterval_, now);
+  if (inFlight_ < window_ && DeviceConnection::instance().isIdle()) {
+    for (const SlotSchedule& entry : schedule_) {
+      if (!entry.inFlight) {
+        // At least 1: anything due now was sent this tick unless the TX queue was full
+        uint32_t remaining = std::max<uint32_t>(msUntil(entry.dueMs, now), 1);
+        waitMs = remaining < waitMs ? remaining : waitMs;
+      }
     }
   }
-  return false;
+  return waitMs;
 }
 
-void SpotValuesManager::handleResponse(int paramId, double value) {
-  // Add to batch (map auto-replaces if param already exists)
-  batch_[paramId] = value;
-  // Also update persistent cache for getParamValues
-  latestValues_[paramId] = value;
+bool SpotValuesManager::isWaitingForParam(int paramId) const {
+  return slots_.find(paramId) >= 0;
 }
 
-void SpotValuesManager::reloadQueue() {
-  if (!DeviceConnection::instance().isIdle()) {
-    return;
+void SpotValuesManager::handleResponse(int paramId, double value) {
+  int slot = slots_.find(paramId);
+  if (slot >= 0) {
+    storeValue(slot, (int32_t)std::lround(value * 32.0));
   }
+}
 
-  // Flush any accumulated values from previous cycle at user-requested interval
-  flushBatch();
+void SpotValuesManager::forEachLatestValue(const std::function<void(int paramId, double value)>& visit) const {
+  // Copied so the visitor runs unlocked; canTask may be swapping in the next snapshot
+  std::vector<LatestValue> latest;
+  if (xSemaphoreTake(latestMutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
+    latest = latest_;
+    xSemaphoreGive(latestMutex_);
+  }
+  for (const LatestValue& entry : latest) {
+    visit(entry.paramId, entry.value);
+  }
+}
 
-  // Clear existing queue and reload with all parameters
-  requestQueue_.clear();
-  for (int paramId : paramIds_) {
-    requestQueue_.push_back(paramId);
+void SpotValuesManager::publishLatest() {
+  // Built and freed outside the lock; only the swap is under it
+  std::vector<LatestValue> latest;
+  latest.reserve(slots_.size());
+  for (size_t slot = 0; slot < slots_.size(); slot++) {
+    if (slots_.hasValue(slot)) {
+      latest.push_back({slots_.paramIdAt(slot), slots_.valueAt(slot)});
+    }
+  }
+  if (xSemaphoreTake(latestMutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
+    latest_.swap(latest);
+    xSemaphoreGive(latestMutex_);
   }
 }
 
 void SpotValuesManager::flushBatch() {
-  if (batch_.empty()) {
+  lastLagMs_ = lagMs_;
+  lagMs_ = 0;
+
+  size_t count = slots_.batchSize();
+  if (count == 0) {
     return;
   }
+  publishLatest();  // Only stored values change it, and every one joins the batch
 
-  // Build event with all accumulated values
-  CANEvent evt;
-  evt.type = EVT_SPOT_VALUES;
-  evt.data.spotValues.timestamp = millis();
+  // Pack the batch into the binary frame here; the event processor sends it as is and
+  // only formats JSON for clients that did not ask for binary
+  size_t length = sizeof(SpotValueFrameHeader) + count * sizeof(SpotValueFrameRecord);
+  uint8_t* frame = (uint8_t*)malloc(length);
+  if (frame == nullptr) {
+    slots_.clearBatch();
+    return;
+  }
 
-  // Build JSON string with all batched values
-  JsonDocument doc;
-  for (const auto& pair : batch_) {
-    doc[String(pair.first)] = pair.second;
+  uint32_t now = millis();
+  SpotValueFrameHeader header = {SPOT_VALUE_FRAME_TYPE, SPOT_VALUE_FRAME_VERSION, (uint16_t)count, now};
+  memcpy(frame, &header, sizeof(header));
+  uint8_t* out = frame + sizeof(header);
+  for (size_t slot = 0; slot < slots_.size(); slot++) {
+    if (!slots_.inBatch(slot)) {
+      continue;
+    }
+    uint32_t age = now - slots_.timestampAt(slot);
+    SpotValueFrameRecord record = {(uint16_t)slots_.paramIdAt(slot), (uint16_t)(age > 0xFFFF ? 0xFFFF : age),
+                                   (int32_t)std::lround(slots_.valueAt(slot) * 32.0)};
+    memcpy(out, &record, sizeof(record));
+    out += sizeof(record);
   }
-  serializeJson(doc, evt.data.spotValues.valuesJson);
 
-  xQueueSend(canEventQueue, &evt, 0);
+  CANEvent evt;
+  evt.type = EVT_SPOT_VALUES;
+  evt.data.spotValues.frame = frame;
+  evt.data.spotValues.frameLength = length;
+  if (xQueueSend(canEventQueue, &evt, 0) != pdTRUE) {
+    releaseEventPayload(evt);  // Stale by the next batch anyway
+  }
 
-  // Clear the batch
-  batch_.clear();
+  // Start the next batch
+  slots_.clearBatch();
 }
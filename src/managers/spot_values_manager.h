@@ -1,14 +1,39 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <deque>
-#include <map>
+#include <functional>
 #include <vector>
 
+#include "freertos/semphr.h"
+#include "managers/spot_value_history.h"
+#include "managers/spot_value_slots.h"
+#include "models/can_types.h"
+#include "protocols/sdo_transaction_table.h"
+
 /**
  * Manages spot values streaming - collecting parameter values at regular intervals
- * and batching them for WebSocket broadcast.
+ * and batching them for WebSocket broadcast as binary frames (models/spot_value_frame.h).
  * Uses singleton pattern since only one spot values session is active at a time.
+ *
+ * Each parameter is read at its own period (the interval unless given one). Reads are
+ * scheduled earliest deadline first, and parameters sharing a period start evenly phased
+ * across it, so the request rate on the bus stays flat instead of bursting the whole list
+ * once per interval. Batches flush every interval, or every shortest period if that is
+ * sooner, so no sample is overwritten before it is sent.
+ *
+ * Reads are pipelined: up to window_ requests are outstanding in SdoTransactionTable, and
+ * each response, abort or timeout (the node's RTO, see SdoRttEstimator) frees a slot for
+ * the next due parameter. Going through the table keeps one request per entry on the bus,
+ * so an abort always reaches the reader it belongs to. Every answered read is an RTT
+ * sample for the node.
+ *
+ * Values are kept in SpotValueSlots, indexed by slot. Every value is also recorded in
+ * SpotValueHistory, which outlives stop() so a restarted stream keeps its history, and
+ * passed to DataLogger, which logs it if the parameter is being logged.
+ *
+ * Everything above belongs to canTask. Other tasks only see the latest values through a
+ * copy published on every flush (forEachLatestValue).
  */
 class SpotValuesManager {
 public:
@@ -18,44 +43,89 @@ public:
   // Configuration
   void setInterval(uint32_t intervalMs) { interval_ = intervalMs; }
   uint32_t getInterval() const { return interval_; }
+  uint32_t getFlushInterval() const { return flushInterval_; }
 
-  void setParamIds(const std::vector<int>& paramIds);
-  const std::vector<int>& getParamIds() const { return paramIds_; }
-  size_t getParamCount() const { return paramIds_.size(); }
+  size_t getParamCount() const { return slots_.size(); }
+  int getParamIdAt(size_t slot) const { return slots_.paramIdAt(slot); }
 
   // State management
-  bool isActive() const { return !paramIds_.empty(); }
-  void start(uint32_t intervalMs, const int* paramIds, int paramCount);
+  bool isActive() const { return slots_.size() > 0; }
+  // periods: read period of each parameter in ms, 0 (or periods == nullptr) = intervalMs
+  void start(uint32_t intervalMs, const int* paramIds, const uint16_t* periods, int paramCount,
+             uint8_t window = SPOT_VALUES_WINDOW_DEFAULT);
   void stop();
 
+  // Reads kept in flight (1..SPOT_VALUES_WINDOW_MAX)
+  void setWindow(uint8_t window);
+  uint8_t getWindow() const { return window_; }
+
   // Processing (called from CAN task)
-  void processQueue();  // Send pending requests (does NOT consume responses)
-  void reloadQueue();   // Reload request queue at interval boundaries
+  void processQueue();  // Expire stale reads and send due ones (does NOT consume responses)
   void flushBatch();    // Send accumulated values to event queue
 
+  // Milliseconds until processQueue() or the next flush has work (NO_DEADLINE when inactive)
+  uint32_t getMsUntilNextWork(uint32_t now) const;
+
   // Response routing (called by CAN task when SDO response received)
+  void registerCanRoutes();  // Claims late parameter value responses (index 0x21xx)
   bool isWaitingForParam(int paramId) const;
   void handleResponse(int paramId, double value);
 
-  // Batch access (for getParamValues to merge latest values)
-  const std::map<int, double>& getLatestValues() const { return latestValues_; }
+  // Latest value of each monitored parameter that has one, as of the last flush (for
+  // getParamValues). Safe from any task: visits a copy of the published snapshot
+  void forEachLatestValue(const std::function<void(int paramId, double value)>& visit) const;
+
+  // Recent values of the monitored parameters (for getSpotValueHistory)
+  const SpotValueHistory& getHistory() const { return history_; }
 
   // Time tracking
   uint32_t getLastCollectionTime() const { return lastCollectionTime_; }
   void updateLastCollectionTime(uint32_t time) { lastCollectionTime_ = time; }
 
+  // Pipeline statistics
+  uint32_t getLastLagMs() const { return lastLagMs_; }  // Latest read sent furthest past its due time, per flush
+  uint32_t getRequestTimeouts() const { return requestTimeouts_; }
+
 private:
   SpotValuesManager();
   SpotValuesManager(const SpotValuesManager&) = delete;
   SpotValuesManager& operator=(const SpotValuesManager&) = delete;
 
+  struct SlotSchedule {
+    uint32_t periodMs;
+    uint32_t dueMs;  // Next read falls due (absolute millis())
+    bool inFlight;
+  };
+
+  // Runs in canTask from SdoTransactionTable::process()
+  void handleReadDone(uint16_t generation, uint16_t slot, const SdoCompletion& completion);
+  void storeValue(int slot, int32_t value);
+  int nextDueSlot(uint32_t now) const;  // Released slot with the earliest deadline, -1 if none
+  void publishLatest();                 // Replace the snapshot with the values in slots_
+
   // Configuration
-  std::vector<int> paramIds_;
-  uint32_t interval_ = 1000;  // Default 1000ms
+  SpotValueSlots slots_;                // Monitored parameters with their latest and batched values
+  std::vector<SlotSchedule> schedule_;  // Indexed by slot
+  SpotValueHistory history_;
+  uint32_t interval_ = 1000;            // Default 1000ms
+  uint32_t flushInterval_ = 1000;       // min(interval_, shortest period)
 
   // State
   uint32_t lastCollectionTime_ = 0;
-  std::deque<int> requestQueue_;        // Queue of pending parameter requests
-  std::map<int, double> batch_;         // Accumulated values for current cycle
-  std::map<int, double> latestValues_;  // Persistent cache of latest values
+  uint8_t inFlight_ = 0;     // Reads sent and not answered yet (at most window_)
+  uint16_t generation_ = 0;  // Bumped by start() and stop(); older completions are ignored
+
+  // Pipeline
+  uint8_t window_ = SPOT_VALUES_WINDOW_DEFAULT;
+  uint32_t lagMs_ = 0;  // Since the last flush
+  uint32_t lastLagMs_ = 0;
+  uint32_t requestTimeouts_ = 0;
+
+  // Snapshot for other tasks
+  struct LatestValue {
+    int paramId;
+    double value;
+  };
+  std::vector<LatestValue> latest_;
+  SemaphoreHandle_t latestMutex_ = nullptr;  // Protects latest_
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdlib>
 
 #include "can_types.h"
 
@@ -27,8 +28,25 @@ struct SetDeviceNameCommand {
 
 struct SpotValuesCommand {
   int paramIds[MAX_PARAM_IDS];
+  uint16_t periods[MAX_PARAM_IDS];  // Read period of each parameter in ms (0 = interval)
   int paramCount;
-  uint32_t interval;
+  uint32_t interval;  // Batch interval, and the period of parameters without one
+  uint8_t window;  // Reads in flight (1..SPOT_VALUES_WINDOW_MAX)
+};
+
+struct SpotHistoryCommand {
+  int paramIds[MAX_PARAM_IDS];
+  int paramCount;         // 0 = every parameter with history
+  uint32_t fromMs;        // Range in device millis(), as in the spot value timestamps
+  uint32_t toMs;          // 0 = now
+  uint32_t durationMs;    // If not 0, the range is the last durationMs instead
+  uint32_t resolutionMs;  // 0 = raw samples, else the finest tier at least this coarse
+};
+
+struct DataLogCommand {
+  int paramIds[MAX_PARAM_IDS];
+  int paramCount;        // 0 = the parameters monitored as spot values
+  uint32_t budgetBytes;  // Total size of the log files (DATA_LOG_BUDGET_MIN or more)
 };
 
 struct DeleteDeviceCommand {
@@ -88,6 +106,10 @@ struct SetValueCommand {
   double value;  // Value to set
 };
 
+struct GetCanMappingsCommand {
+  bool refresh;  // Read the map from the device even if it is cached
+};
+
 struct ClearCanMapCommand {
   bool isRx;  // true = clear RX mappings, false = clear TX mappings
 };
@@ -107,16 +129,38 @@ struct RemoveCanMappingCommand {
   uint8_t subIndex;  // SDO subindex
 };
 
+// Mappings accepted by one import
+#define MAX_CAN_MAP_IMPORT 256
+
+// Mapping sets do not fit the union, so the array is heap-allocated (malloc) and owned by the
+// command: OICan::StartOperation() takes it over, whoever drops the command calls
+// releaseCommandPayload()
+struct ImportCanMapCommand {
+  CanMappingData* mappings;  // The complete map the device should end up with
+  uint16_t count;
+};
+
+struct ListErrorsCommand {
+  bool incremental;  // Re-read only error log slots that changed since the last listing
+};
+
+struct RestoreParamsCommand {
+  char serial[50];  // Device whose snapshot to write (empty = the connected device)
+};
+
 // Command message structure
 struct CANCommand {
   CANCommandType type;
-  uint32_t requestId;  // Unique ID for matching async responses (0 = no response expected)
+  uint32_t requestId = 0;  // Unique ID for matching async responses (0 = no response expected)
+  uint32_t clientId = 0;   // WebSocket client that sent it; its result events go only there (0 = broadcast)
   union {
     ScanCommand scan;
     ConnectCommand connect;
     SetNodeIdCommand setNodeId;
     SetDeviceNameCommand setDeviceName;
     SpotValuesCommand spotValues;
+    SpotHistoryCommand spotHistory;
+    DataLogCommand dataLog;
     DeleteDeviceCommand deleteDevice;
     RenameDeviceCommand renameDevice;
     SendCanMessageCommand sendCanMessage;
@@ -127,8 +171,20 @@ struct CANCommand {
     // Task 34: Device commands
     StartDeviceCommand startDevice;
     SetValueCommand setValue;
+    GetCanMappingsCommand getCanMappings;
     ClearCanMapCommand clearCanMap;
     AddCanMappingCommand addCanMapping;
     RemoveCanMappingCommand removeCanMapping;
+    ListErrorsCommand listErrors;
+    ImportCanMapCommand importCanMap;
+    RestoreParamsCommand restoreParams;
   } data;
 };
+
+// Free the heap payload of a command that will not be executed
+inline void releaseCommandPayload(CANCommand& cmd) {
+  if (cmd.type == CMD_IMPORT_CAN_MAP) {
+    free(cmd.data.importCanMap.mappings);
+    cmd.data.importCanMap.mappings = nullptr;
+  }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdlib>
 
 #include "can_types.h"
 
@@ -27,6 +28,9 @@ struct JsonProgressEvent {
   int bytesReceived;
   int totalBytes;
   bool complete;
+  bool blockMode;       // SDO block upload (false: segmented)
+  uint32_t elapsedMs;   // Since the download started
+  uint32_t roundTrips;  // Request/response exchanges so far
 };
 
 struct JsonReadyEvent {
@@ -54,11 +58,12 @@ struct SpotValuesStatusEvent {
   bool active;
   uint32_t interval;
   int paramCount;
+  uint8_t window;
 };
 
 struct SpotValuesEvent {
-  uint32_t timestamp;
-  char valuesJson[1024];  // JSON string of values
+  uint8_t* frame;        // Binary frame (see spot_value_frame.h), heap-allocated like the JSON payloads below
+  uint16_t frameLength;  // Bytes in frame
 };
 
 struct DeviceNameSetEvent {
@@ -98,6 +103,10 @@ struct CanIoIntervalStatusEvent {
   uint32_t intervalMs;
 };
 
+struct CanBusStatusEvent {
+  uint8_t state;  // CanBusState the bus just entered
+};
+
 // Task 34: Device command event structures
 
 struct DeviceCommandEvent {
@@ -113,11 +122,28 @@ struct ValueSetEvent {
 struct CanMapClearedEvent {
   bool success;
   bool isRx;
+  int removedCount;
+};
+
+struct CanMapImportedEvent {
+  bool success;
+  bool restored;     // Failed, but the device map is as it was before the import
+  uint16_t added;    // Mappings written
+  uint16_t removed;  // Mapping messages removed
 };
 
+struct ParamsSnapshotEvent {
+  bool success;
+  uint16_t count;    // Parameters saved
+  uint16_t skipped;  // Parameters the node refused to read
+};
+
+// Mapping dumps and error logs have no useful size limit, so their JSON is heap-allocated
+// (malloc) and owned by the event: whoever takes it off the queue calls releaseEventPayload()
+
 struct CanMappingsReceivedEvent {
   bool success;
-  char mappingsJson[2048];  // JSON string of mappings
+  char* mappingsJson;  // JSON array of mappings (nullptr on failure)
 };
 
 struct CanMappingAddedEvent {
@@ -130,13 +156,37 @@ struct CanMappingRemovedEvent {
 
 struct ErrorsListedEvent {
   bool success;
-  char errorsJson[1024];  // JSON string of errors
+  char* errorsJson;  // JSON array of errors (nullptr on failure)
+};
+
+struct SpotHistoryEvent {
+  bool success;
+  char* historyJson;  // JSON object, see SpotValueHistory::query() (nullptr on failure)
+};
+
+struct DataLogStatusEvent {
+  bool active;
+  bool error;  // Failed to start, or the last write failed
+  int paramCount;
+  uint32_t budgetBytes;
+  uint32_t samples;
+  uint32_t dropped;  // Samples lost because the writer fell behind or flash was full
+  uint32_t fileNumber;
+};
+
+struct ParamsRestoredEvent {
+  bool success;
+  bool found;          // A snapshot was found for the device
+  uint16_t written;    // Parameters written
+  uint16_t failed;     // Parameters the node refused
+  char* failuresJson;  // JSON array of the refused parameters (nullptr if none)
 };
 
 // Event message structure
 struct CANEvent {
   CANEventType type;
-  uint32_t requestId;  // Matches requestId from command (0 = unsolicited event)
+  uint32_t requestId = 0;  // Matches requestId from command (0 = unsolicited event)
+  uint32_t clientId = 0;   // WebSocket client the event is for (0 = broadcast)
   union {
     DeviceDiscoveredEvent deviceDiscovered;
     ScanStatusEvent scanStatus;
@@ -155,6 +205,7 @@ struct CANEvent {
     CanMessageSentEvent canMessageSent;
     CanIntervalStatusEvent canIntervalStatus;
     CanIoIntervalStatusEvent canIoIntervalStatus;
+    CanBusStatusEvent canBusStatus;
     // Task 34: Device command events
     DeviceCommandEvent deviceCommand;  // For save/load/start/stop/reset
     ValueSetEvent valueSet;
@@ -163,5 +214,30 @@ struct CANEvent {
     CanMappingAddedEvent canMappingAdded;
     CanMappingRemovedEvent canMappingRemoved;
     ErrorsListedEvent errorsListed;
+    CanMapImportedEvent canMapImported;
+    ParamsSnapshotEvent paramsSnapshot;
+    ParamsRestoredEvent paramsRestored;
+    SpotHistoryEvent spotHistory;
+    DataLogStatusEvent dataLogStatus;
   } data;
 };
+
+// Free the heap payload of an event taken off (or never put on) canEventQueue
+inline void releaseEventPayload(CANEvent& evt) {
+  if (evt.type == EVT_CAN_MAPPINGS_RECEIVED) {
+    free(evt.data.canMappingsReceived.mappingsJson);
+    evt.data.canMappingsReceived.mappingsJson = nullptr;
+  } else if (evt.type == EVT_ERRORS_LISTED) {
+    free(evt.data.errorsListed.errorsJson);
+    evt.data.errorsListed.errorsJson = nullptr;
+  } else if (evt.type == EVT_PARAMS_RESTORED) {
+    free(evt.data.paramsRestored.failuresJson);
+    evt.data.paramsRestored.failuresJson = nullptr;
+  } else if (evt.type == EVT_SPOT_VALUES) {
+    free(evt.data.spotValues.frame);
+    evt.data.spotValues.frame = nullptr;
+  } else if (evt.type == EVT_SPOT_HISTORY) {
+    free(evt.data.spotHistory.historyJson);
+    evt.data.spotHistory.historyJson = nullptr;
+  }
+}
@@ -6,6 +6,13 @@
 #define MAX_PARAM_IDS 100
 #define SPOT_VALUES_INTERVAL_MIN_MS 100
 #define SPOT_VALUES_INTERVAL_MAX_MS 10000
+// Spot value reads kept in flight at once. The OpenInverter SDO server answers from a small
+// receive FIFO, so the window stays well below its depth.
+#define SPOT_VALUES_WINDOW_DEFAULT 4
+#define SPOT_VALUES_WINDOW_MAX 8
+// Per-parameter spot value read periods (SpotValuesCommand::periods)
+#define SPOT_VALUES_PERIOD_MIN_MS 50
+#define SPOT_VALUES_PERIOD_MAX_MS 60000
 #define CAN_INTERVAL_MIN_MS 10
 #define CAN_INTERVAL_MAX_MS 60000
 #define CAN_IO_INTERVAL_MIN_MS 10
@@ -26,9 +33,24 @@
 #define CAN_IO_CRUISE_MASK 0x3FFF  // 14 bits for cruise speed
 #define CAN_IO_REGEN_MASK 0xFF     // 8 bits for regen preset
 
+// Inclusive range of standard (11-bit) CAN IDs
+struct CanIdRange {
+  uint16_t first;
+  uint16_t last;
+};
+
 // CAN baud rates
 enum BaudRate { Baud125k, Baud250k, Baud500k };
 
+// TX priority classes, highest first. The TX task always sends from the highest non-empty class.
+enum CanTxPriority : uint8_t {
+  CAN_TX_CONTROL,     // Periodic interval / CAN-IO frames and user-sent frames
+  CAN_TX_BOOTLOADER,  // Firmware update frames
+  CAN_TX_SDO,         // Interactive SDO requests (parameters, commands, JSON download)
+  CAN_TX_BACKGROUND,  // Spot value polling and scan probes
+  CAN_TX_PRIORITY_COUNT
+};
+
 // Command types for CAN task
 enum CANCommandType {
   CMD_START_SCAN,
@@ -39,6 +61,9 @@ enum CANCommandType {
   CMD_GET_NODE_ID,
   CMD_START_SPOT_VALUES,
   CMD_STOP_SPOT_VALUES,
+  CMD_GET_SPOT_HISTORY,
+  CMD_START_DATA_LOG,
+  CMD_STOP_DATA_LOG,
   CMD_DELETE_DEVICE,
   CMD_RENAME_DEVICE,
   CMD_SEND_CAN_MESSAGE,
@@ -47,6 +72,7 @@ enum CANCommandType {
   CMD_START_CANIO_INTERVAL,
   CMD_STOP_CANIO_INTERVAL,
   CMD_UPDATE_CANIO_FLAGS,
+  CMD_UPDATE_PARAM,  // Coalesced write (ParamWriteQueue), uses SetValueCommand
   // Device commands (Task 34)
   CMD_SAVE_TO_FLASH,
   CMD_LOAD_FROM_FLASH,
@@ -59,7 +85,10 @@ enum CANCommandType {
   CMD_GET_CAN_MAPPINGS,
   CMD_ADD_CAN_MAPPING,
   CMD_REMOVE_CAN_MAPPING,
-  CMD_LIST_ERRORS
+  CMD_LIST_ERRORS,
+  CMD_IMPORT_CAN_MAP,
+  CMD_SNAPSHOT_PARAMS,
+  CMD_RESTORE_PARAMS
 };
 
 // Event types from CAN task
@@ -74,6 +103,8 @@ enum CANEventType {
   EVT_NODE_ID_SET,
   EVT_SPOT_VALUES_STATUS,
   EVT_SPOT_VALUES,
+  EVT_SPOT_HISTORY,
+  EVT_DATA_LOG_STATUS,
   EVT_DEVICE_NAME_SET,
   EVT_ERROR,
   EVT_DEVICE_DELETED,
@@ -81,6 +112,7 @@ enum CANEventType {
   EVT_CAN_MESSAGE_SENT,
   EVT_CAN_INTERVAL_STATUS,
   EVT_CANIO_INTERVAL_STATUS,
+  EVT_CAN_BUS_STATUS,
   // Task 34: Device command events
   EVT_FLASH_SAVED,
   EVT_FLASH_LOADED,
@@ -93,10 +125,13 @@ enum CANEventType {
   EVT_CAN_MAPPINGS_RECEIVED,
   EVT_CAN_MAPPING_ADDED,
   EVT_CAN_MAPPING_REMOVED,
-  EVT_ERRORS_LISTED
+  EVT_ERRORS_LISTED,
+  EVT_CAN_MAP_IMPORTED,
+  EVT_PARAMS_SNAPSHOT,
+  EVT_PARAMS_RESTORED
 };
 
-// SetValue result codes (matches OICan::SetResult)
+// Result codes of parameter writes and CAN mapping changes
 enum SetValueResult { SET_OK, SET_UNKNOWN_INDEX, SET_VALUE_OUT_OF_RANGE, SET_COMM_ERROR };
 
 // CAN mapping data structure (used during mapping retrieval)
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Data log file (DataLogger), little-endian:
+//
+//   DataLogFileHeader, then paramCount uint16 parameter IDs
+//   Blocks, each a DataLogBlockHeader and length bytes of payload:
+//     'D' data:  count rows of varint(column), varint(ms since the previous row),
+//                varint(zigzag(value - previous value of the column)). Time starts at
+//                timeMs and every previous value at 0, so each block decodes on its own.
+//     'I' index: uint32 offset of the previous index block (0: none), then count
+//                DataLogIndexEntry, one per data block since it
+//   DataLogTrailer, once the file was closed cleanly
+//
+// A column is the position of the parameter in the header's ID list. Values are
+// fixed-point, scaled by 32 as on the wire. Times are device millis().
+#define DATA_LOG_MAGIC 0x474C494F          // "OILG"
+#define DATA_LOG_TRAILER_MAGIC 0x454C494F  // "OILE"
+#define DATA_LOG_VERSION 1
+#define DATA_LOG_BLOCK_DATA 'D'
+#define DATA_LOG_BLOCK_INDEX 'I'
+#define DATA_LOG_BLOCK_SIZE 2048  // Most payload bytes of a data block
+
+struct __attribute__((packed)) DataLogFileHeader {
+  uint32_t magic;  // DATA_LOG_MAGIC
+  uint8_t version;
+  uint8_t nodeId;
+  uint16_t paramCount;
+  uint32_t startMs;  // millis() when logging started
+  uint32_t fileNumber;
+};
+
+struct __attribute__((packed)) DataLogBlockHeader {
+  uint8_t type;  // DATA_LOG_BLOCK_DATA or DATA_LOG_BLOCK_INDEX
+  uint8_t reserved;
+  uint16_t count;   // Rows, or index entries
+  uint32_t timeMs;  // Data: time the row times count from. Index: time of its newest entry
+  uint32_t length;  // Payload bytes that follow
+};
+
+struct __attribute__((packed)) DataLogIndexEntry {
+  uint32_t timeMs;  // Of the data block
+  uint32_t offset;  // Of its header in the file
+};
+
+struct __attribute__((packed)) DataLogTrailer {
+  uint32_t lastIndexOffset;
+  uint32_t magic;  // DATA_LOG_TRAILER_MAGIC
+};
+
+static_assert(sizeof(DataLogFileHeader) == 16, "Data log file header must be 16 bytes");
+static_assert(sizeof(DataLogBlockHeader) == 12, "Data log block header must be 12 bytes");
+static_assert(sizeof(DataLogIndexEntry) == 8, "Data log index entry must be 8 bytes");
+static_assert(sizeof(DataLogTrailer) == 8, "Data log trailer must be 8 bytes");
+
+// Longest row: a 2-byte column and two 5-byte varints
+#define DATA_LOG_MAX_ROW_BYTES 12
+
+inline size_t dataLogPutVarint(uint8_t* out, uint32_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+// Bytes consumed, 0 if the varint runs past end or is longer than 5 bytes
+inline size_t dataLogGetVarint(const uint8_t* in, const uint8_t* end, uint32_t& value) {
+  value = 0;
+  for (size_t length = 0; length < 5 && in + length < end; length++) {
+    value |= (uint32_t)(in[length] & 0x7F) << (7 * length);
+    if ((in[length] & 0x80) == 0) {
+      return length + 1;
+    }
+  }
+  return 0;
+}
+
+inline uint32_t dataLogZigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t dataLogUnzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
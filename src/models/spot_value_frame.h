@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary spot value frame, sent as one WebSocket binary message to clients that asked for
+// it with setSpotValuesFormat. Little-endian: a header, then one record per value.
+#define SPOT_VALUE_FRAME_TYPE 0x01  // header.type of a spot value batch
+#define SPOT_VALUE_FRAME_VERSION 1
+
+struct __attribute__((packed)) SpotValueFrameHeader {
+  uint8_t type;        // SPOT_VALUE_FRAME_TYPE
+  uint8_t version;     // SPOT_VALUE_FRAME_VERSION
+  uint16_t count;      // Records that follow
+  uint32_t timestamp;  // millis() when the batch was flushed
+};
+
+struct __attribute__((packed)) SpotValueFrameRecord {
+  uint16_t paramId;
+  uint16_t ageMs;  // Batch timestamp minus the time the value arrived (saturates at 0xFFFF)
+  int32_t value;   // Fixed-point, scaled by 32 as on the wire
+};
+
+static_assert(sizeof(SpotValueFrameHeader) == 8, "Spot value frame header must be 8 bytes");
+static_assert(sizeof(SpotValueFrameRecord) == 8, "Spot value frame record must be 8 bytes");
@@ -0,0 +1,156 @@
+// Host build: Arduino core, LittleFS and EEPROM runtime
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <LittleFS.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+HardwareSerial Serial;
+LittleFSClass LittleFS;
+EEPROMClass EEPROM;
+
+static const auto startTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - startTime)
+      .count();
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - startTime)
+      .count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+size_t Print::printf(const char* format, ...) {
+  char stackBuffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return 0;
+  }
+  if ((size_t)length < sizeof(stackBuffer)) {
+    return write((const uint8_t*)stackBuffer, length);
+  }
+
+  std::string heapBuffer(length + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&heapBuffer[0], heapBuffer.size(), format, args);
+  va_end(args);
+  return write((const uint8_t*)heapBuffer.data(), length);
+}
+
+// ============================================================================
+// LittleFS
+// ============================================================================
+
+bool LittleFSClass::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+  if (root_.empty()) {
+    const char* envRoot = getenv("OI_NATIVE_FS_ROOT");
+    root_ = envRoot != nullptr ? envRoot : "littlefs";
+  }
+  ::mkdir(root_.c_str(), 0755);
+  return true;
+}
+
+std::string LittleFSClass::hostPath(const char* path) const {
+  std::string root = root_.empty() ? "littlefs" : root_;
+  return root + (path[0] == '/' ? "" : "/") + path;
+}
+
+File LittleFSClass::open(const char* path, const char* mode) {
+  if (mode[0] == 'r') {
+    DIR* dir = opendir(hostPath(path).c_str());
+    if (dir != nullptr) {
+      return File(dir, path, hostPath(path));
+    }
+  }
+  std::string fopenMode = mode;
+  if (fopenMode.find('b') == std::string::npos) {
+    fopenMode += 'b';
+  }
+  FILE* file = fopen(hostPath(path).c_str(), fopenMode.c_str());
+  return file != nullptr ? File(file, path) : File();
+}
+
+bool LittleFSClass::exists(const char* path) {
+  struct stat info;
+  return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool LittleFSClass::remove(const char* path) {
+  return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool LittleFSClass::rename(const char* from, const char* to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool LittleFSClass::mkdir(const char* path) {
+  return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+static size_t directoryBytes(const std::string& path) {
+  size_t total = 0;
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return 0;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    struct stat info;
+    if (name == "." || name == ".." || stat((path + "/" + name).c_str(), &info) != 0) {
+      continue;
+    }
+    total += S_ISDIR(info.st_mode) ? directoryBytes(path + "/" + name) : (size_t)info.st_size;
+  }
+  closedir(dir);
+  return total;
+}
+
+size_t LittleFSClass::usedBytes() {
+  return directoryBytes(root_.empty() ? "littlefs" : root_);
+}
+
+fs::File fs::File::openNextFile() {
+  while (dir_ != nullptr) {
+    struct dirent* entry = readdir(dir_.get());
+    if (entry == nullptr) {
+      break;
+    }
+    std::string name = entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+    std::string path = path_ + (path_.empty() || path_.back() != '/' ? "/" : "") + name;
+    std::string host = hostPath_ + "/" + name;
+    if (DIR* dir = opendir(host.c_str())) {
+      return File(dir, path, host);
+    }
+    if (FILE* file = fopen(host.c_str(), "rb")) {
+      return File(file, path);
+    }
+  }
+  return File();
+}
@@ -0,0 +1,238 @@
+// Host build: FreeRTOS tasks, queues, semaphores and notifications on std::thread
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct NativeTask {
+  std::string name;
+  UBaseType_t priority = 0;
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t notifyCount = 0;
+};
+
+struct NativeQueue {
+  size_t length;
+  size_t itemSize;
+  std::mutex lock;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+// Thrown by vTaskDelete(nullptr) to unwind the calling task's thread
+struct NativeTaskExit {};
+
+static thread_local NativeTask* currentTask = nullptr;
+
+// Wait on a condition with FreeRTOS tick semantics (0 = poll, portMAX_DELAY = forever)
+template <typename Predicate>
+static bool waitFor(std::condition_variable& condition, std::unique_lock<std::mutex>& lock, TickType_t ticks,
+                    Predicate predicate) {
+  if (ticks == portMAX_DELAY) {
+    condition.wait(lock, predicate);
+    return true;
+  }
+  return condition.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), predicate);
+}
+
+// ============================================================================
+// Tasks
+// ============================================================================
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* createdTask) {
+  NativeTask* task = new NativeTask();
+  task->name = name != nullptr ? name : "";
+  task->priority = priority;
+  if (createdTask != nullptr) {
+    *createdTask = task;
+  }
+
+  std::thread([task, function, parameter]() {
+    currentTask = task;
+    try {
+      function(parameter);
+    } catch (const NativeTaskExit&) {
+    }
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* createdTask, BaseType_t coreId) {
+  return xTaskCreate(function, name, stackDepth, parameter, priority, createdTask);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == currentTask) {
+    throw NativeTaskExit();
+  }
+  // Deleting another task is not supported on the host - threads cannot be killed safely
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+void taskYIELD() {
+  std::this_thread::yield();
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(millis() / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  // Threads not created through xTaskCreate (e.g. main) get a handle on first use
+  if (currentTask == nullptr) {
+    currentTask = new NativeTask();
+    currentTask->name = "main";
+    currentTask->priority = 1;
+  }
+  return currentTask;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+  return task != nullptr ? task->priority : xTaskGetCurrentTaskHandle()->priority;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  {
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notifyCount++;
+  }
+  task->notified.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  NativeTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->lock);
+  waitFor(task->notified, lock, ticksToWait, [task]() { return task->notifyCount > 0; });
+
+  uint32_t count = task->notifyCount;
+  if (count > 0) {
+    task->notifyCount = clearCountOnExit ? 0 : count - 1;
+  }
+  return count;
+}
+
+// ============================================================================
+// Queues
+// ============================================================================
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  if (length == 0) {
+    return nullptr;
+  }
+  NativeQueue* queue = new NativeQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait, bool toFront) {
+  std::unique_lock<std::mutex> lock(queue->lock);
+  if (!waitFor(queue->notFull, lock, ticksToWait, [queue]() { return queue->items.size() < queue->length; })) {
+    return pdFALSE;
+  }
+
+  std::vector<uint8_t> copy(queue->itemSize);
+  if (queue->itemSize > 0) {
+    memcpy(copy.data(), item, queue->itemSize);
+  }
+  if (toFront) {
+    queue->items.push_front(std::move(copy));
+  } else {
+    queue->items.push_back(std::move(copy));
+  }
+  lock.unlock();
+  queue->notEmpty.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  return queueSend(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(queue->lock);
+  if (!waitFor(queue->notEmpty, lock, ticksToWait, [queue]() { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+
+  if (queue->itemSize > 0) {
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+  }
+  queue->items.pop_front();
+  lock.unlock();
+  queue->notFull.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+  }
+  queue->notFull.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> guard(queue->lock);
+  return queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> guard(queue->lock);
+  return queue->length - queue->items.size();
+}
+
+// ============================================================================
+// Semaphores
+// ============================================================================
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+  xSemaphoreGive(mutex);  // Mutexes start available
+  return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+  return xQueueReceive(semaphore, nullptr, ticksToWait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  return xQueueSend(semaphore, nullptr, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  vQueueDelete(semaphore);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Host build: RAM-backed EEPROM (settings fall back to defaults on every run)
+
+#include <Arduino.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class EEPROMClass {
+public:
+  bool begin(size_t size) {
+    data_.assign(size, 0xFF);
+    return true;
+  }
+  template <typename T> T& get(int address, T& value) {
+    if (address >= 0 && address + sizeof(T) <= data_.size()) {
+      memcpy(&value, &data_[address], sizeof(T));
+    }
+    return value;
+  }
+  template <typename T> const T& put(int address, const T& value) {
+    if (address >= 0 && address + sizeof(T) <= data_.size()) {
+      memcpy(&data_[address], &value, sizeof(T));
+    }
+    return value;
+  }
+  bool commit() { return true; }
+
+private:
+  std::vector<uint8_t> data_;
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,88 @@
+#pragma once
+
+// Host build: LittleFS files map onto a directory on the host (see LittleFS.h)
+
+#include <dirent.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+public:
+  File() {}
+  File(FILE* file, const std::string& path) : file_(file, fclose), path_(path) {}
+  File(DIR* dir, const std::string& path, const std::string& hostPath)
+      : dir_(dir, closedir), path_(path), hostPath_(hostPath) {}
+
+  explicit operator bool() const { return file_ != nullptr || dir_ != nullptr; }
+  bool isDirectory() const { return dir_ != nullptr; }
+  File openNextFile();  // Next entry of a directory, an empty File at the end
+
+  size_t write(uint8_t c) override { return file_ && fputc(c, file_.get()) != EOF ? 1 : 0; }
+  size_t write(const uint8_t* buffer, size_t size) override { return file_ ? fwrite(buffer, 1, size, file_.get()) : 0; }
+  using Print::write;
+  void flush() override {
+    if (file_) {
+      fflush(file_.get());
+    }
+  }
+
+  int available() override { return file_ ? (int)(size() - position()) : 0; }
+  int read() override { return file_ ? fgetc(file_.get()) : -1; }
+  int peek() override {
+    if (!file_) {
+      return -1;
+    }
+    int c = fgetc(file_.get());
+    if (c != EOF) {
+      ungetc(c, file_.get());
+    }
+    return c;
+  }
+  size_t read(uint8_t* buffer, size_t size) { return file_ ? fread(buffer, 1, size, file_.get()) : 0; }
+
+  bool seek(uint32_t position, SeekMode mode = SeekSet) {
+    return file_ && fseek(file_.get(), (long)position, (int)mode) == 0;
+  }
+  size_t position() const { return file_ ? (size_t)ftell(file_.get()) : 0; }
+  size_t size() const {
+    if (!file_) {
+      return 0;
+    }
+    long current = ftell(file_.get());
+    fseek(file_.get(), 0, SEEK_END);
+    long end = ftell(file_.get());
+    fseek(file_.get(), current, SEEK_SET);
+    return (size_t)end;
+  }
+  const char* path() const { return path_.c_str(); }
+  const char* name() const {
+    size_t slash = path_.find_last_of('/');
+    return slash == std::string::npos ? path_.c_str() : path_.c_str() + slash + 1;
+  }
+  void close() {
+    file_.reset();
+    dir_.reset();
+  }
+
+private:
+  std::shared_ptr<FILE> file_;
+  std::shared_ptr<DIR> dir_;
+  std::string path_;
+  std::string hostPath_;  // Directories only
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
@@ -0,0 +1,35 @@
+#pragma once
+
+// Host build: LittleFS rooted at a host directory (default ./littlefs, override with
+// setRoot() or the OI_NATIVE_FS_ROOT environment variable). totalBytes() is the size of the
+// device partition, so free space behaves as on the device.
+
+#include <string>
+
+#include "FS.h"
+
+class LittleFSClass {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs");
+  void setRoot(const char* root) { root_ = root; }
+
+  File open(const char* path, const char* mode = "r");
+  File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  bool mkdir(const char* path);
+
+  size_t totalBytes() { return 0x1F0000; }
+  size_t usedBytes();  // Sizes of the files under the root
+
+private:
+  std::string hostPath(const char* path) const;
+
+  std::string root_;
+};
+
+extern LittleFSClass LittleFS;
@@ -0,0 +1,132 @@
+#pragma once
+
+// Host build: Arduino String on top of std::string (only what the firmware uses)
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+class String {
+public:
+  String() {}
+  String(const char* str) : str_(str != nullptr ? str : "") {}
+  String(const std::string& str) : str_(str) {}
+  String(char c) : str_(1, c) {}
+  String(int value) : str_(std::to_string(value)) {}
+  String(unsigned int value) : str_(std::to_string(value)) {}
+  String(long value) : str_(std::to_string(value)) {}
+  String(unsigned long value) : str_(std::to_string(value)) {}
+  String(long long value) : str_(std::to_string(value)) {}
+  String(unsigned long long value) : str_(std::to_string(value)) {}
+  String(double value, unsigned int decimals = 2) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, value);
+    str_ = buf;
+  }
+
+  String& operator=(const char* str) {
+    str_ = str != nullptr ? str : "";
+    return *this;
+  }
+
+  const char* c_str() const { return str_.c_str(); }
+  unsigned int length() const { return (unsigned int)str_.length(); }
+  bool isEmpty() const { return str_.empty(); }
+  bool reserve(unsigned int size) {
+    str_.reserve(size);
+    return true;
+  }
+  char charAt(unsigned int index) const { return index < str_.length() ? str_[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  bool concat(const String& str) {
+    str_ += str.str_;
+    return true;
+  }
+  bool concat(const char* str) {
+    if (str != nullptr) {
+      str_ += str;
+    }
+    return true;
+  }
+  bool concat(const char* str, unsigned int length) {
+    str_.append(str, length);
+    return true;
+  }
+  bool concat(char c) {
+    str_ += c;
+    return true;
+  }
+  String& operator+=(const String& str) {
+    concat(str);
+    return *this;
+  }
+  String& operator+=(const char* str) {
+    concat(str);
+    return *this;
+  }
+  String& operator+=(char c) {
+    concat(c);
+    return *this;
+  }
+  String& operator+=(int value) { return *this += String(value); }
+  String& operator+=(unsigned long value) { return *this += String(value); }
+
+  bool equals(const String& other) const { return str_ == other.str_; }
+  bool operator==(const String& other) const { return str_ == other.str_; }
+  bool operator==(const char* other) const { return other != nullptr && str_ == other; }
+  bool operator!=(const String& other) const { return str_ != other.str_; }
+  bool operator!=(const char* other) const { return !(*this == other); }
+  bool operator<(const String& other) const { return str_ < other.str_; }
+
+  bool startsWith(const String& prefix) const { return str_.compare(0, prefix.str_.length(), prefix.str_) == 0; }
+  bool endsWith(const String& suffix) const {
+    return str_.length() >= suffix.str_.length() &&
+           str_.compare(str_.length() - suffix.str_.length(), suffix.str_.length(), suffix.str_) == 0;
+  }
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t pos = str_.find(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  int indexOf(const String& str, unsigned int from = 0) const {
+    size_t pos = str_.find(str.str_, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  int lastIndexOf(char c) const {
+    size_t pos = str_.rfind(c);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  String substring(unsigned int from) const { return from < str_.length() ? String(str_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < to && from < str_.length() ? String(str_.substr(from, to - from)) : String();
+  }
+  void trim() {
+    size_t first = str_.find_first_not_of(" \t\r\n");
+    size_t last = str_.find_last_not_of(" \t\r\n");
+    str_ = first == std::string::npos ? "" : str_.substr(first, last - first + 1);
+  }
+  long toInt() const { return strtol(str_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(str_.c_str(), nullptr); }
+  double toDouble() const { return strtod(str_.c_str(), nullptr); }
+
+private:
+  std::string str_;
+};
+
+inline String operator+(const String& lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+inline String operator+(const String& lhs, const char* rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+inline String operator+(const char* lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Host build: FreeRTOS API subset on std::thread / std::mutex / std::condition_variable.
+// One tick is one millisecond. Task priorities and core affinity are recorded but not
+// enforced - every task is an ordinary host thread.
+
+#include <cstdint>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdTRUE ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define CONFIG_FREERTOS_UNICORE 1
+
+#define IRAM_ATTR
+
+// Critical sections become a recursive mutex per spinlock
+struct portMUX_TYPE {
+  std::recursive_mutex lock;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) {
+  mux->lock.lock();
+}
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) {
+  mux->lock.unlock();
+}
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
@@ -22,12 +22,15 @@
 
 #include <ArduinoJson.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <functional>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <FS.h>
-#include <StreamUtils.h>
 
 #include "driver/gpio.h"
 #include "driver/twai.h"
@@ -37,6 +40,9 @@
 #include "managers/device_connection.h"
 #include "managers/device_discovery.h"
 #include "managers/device_storage.h"
+#include "managers/sdo_operation_manager.h"
+#include "models/can_command.h"
+#include "models/can_event.h"
 #include "models/can_types.h"
 #include "protocols/sdo_protocol.h"
 #include "utils/can_queue.h"
@@ -66,7 +72,8 @@ bool RequestValue(int paramId) {
   uint16_t index = SDOProtocol::INDEX_PARAM_UID | (paramId >> 8);
   uint8_t subIndex = paramId & 0xFF;
 
-  bool success = SDOProtocol::requestElementNonBlocking(conn.getNodeId(), index, subIndex);
+  // Polling traffic - must not delay control frames or interactive requests
+  bool success = SDOProtocol::requestElementNonBlocking(conn.getNodeId(), index, subIndex, CAN_TX_BACKGROUND);
 
   if (success) {
     conn.markParameterRequestSent();
@@ -124,386 +131,767 @@ String GetRawJson(uint8_t nodeId) {
   return GetRawJson();
 }
 
-// Callback type for receiving parameter values during iteration
-typedef std::function<void(const char* key, int id, double value)> ParameterValueCallback;
-
-// Helper: Iterate through cached parameters and fetch current values
-// Returns number of failed requests (0 = all succeeded)
-static int iterateParameterValues(ParameterValueCallback callback) {
-  if (conn.getCachedJson().isNull() || conn.getCachedJson().size() == 0) {
-    DBG_OUTPUT_PORT.println("No parameter JSON in memory");
-    return -1;  // Error: no cached JSON
+// ============================================================================
+// Device operations
+//
+// Multi-step SDO exchanges, written as SdoOperation state machines and run by
+// SdoOperationManager in canTask. Each step is one transaction, so canTask keeps serving
+// spot values, interval frames and scans while a long error log or mapping dump is read.
+// ============================================================================
+
+// Helper: Serialize a result document into a heap buffer owned by the event
+static char* serializeToHeap(const JsonDocument& doc) {
+  size_t length = measureJson(doc);
+  char* json = (char*)malloc(length + 1);
+  if (json == nullptr) {
+    DBG_OUTPUT_PORT.printf("Out of memory for %u byte result\n", (unsigned)length);
+    return nullptr;
   }
+  serializeJson(doc, json, length + 1);
+  return json;
+}
 
-  JsonObject root = conn.getCachedJson().as<JsonObject>();
-  twai_message_t rxframe;
-  int failed = 0;
+// Helper: Parse 24-bit signed fixed-point gain from the data of an SDO response
+static float parseGain(uint32_t data) {
+  // Extract 24-bit signed value and convert to float
+  int32_t gainFixedPoint = (int32_t)((data & 0xFFFFFF) << 8);
+  gainFixedPoint >>= 8;  // Sign-extend
+  return gainFixedPoint / 1000.0f;
+}
 
-  SDOProtocol::clearPendingResponses();
+// Helper: Pack (param ID, position, length) into the data of a mapping write
+static uint32_t packParamPositionLength(uint32_t paramId, uint8_t position, int8_t length) {
+  return paramId | ((uint32_t)position << 16) | ((uint32_t)(uint8_t)length << 24);
+}
 
-  for (JsonPair kv : root) {
-    int id = kv.value()["id"].as<int>();
+// Helper: Pack gain (24-bit signed, x1000) and offset into the data of a mapping write
+static uint32_t packGainOffset(float gain, int8_t offset) {
+  int32_t gainScaled = (int32_t)lroundf(gain * 1000) & 0xFFFFFF;
+  return (uint32_t)gainScaled | ((uint32_t)(uint8_t)offset << 24);
+}
 
-    if (id > 0) {
-      SDOProtocol::requestElement(conn.getNodeId(), SDOProtocol::INDEX_PARAM_UID | (id >> 8), id & 0xff);
+// Helper: Append one mapping to the result array
+static void addMappingJson(JsonArray& mappings, const CanMappingData& m) {
+  JsonObject obj = mappings.add<JsonObject>();
+  obj["isrx"] = m.isRx;
+  obj["id"] = m.cobId;
+  obj["paramid"] = m.paramId;
+  obj["position"] = m.position;
+  obj["length"] = m.length;
+  obj["gain"] = m.gain;
+  obj["offset"] = m.offset;
+  obj["index"] = m.sdoIndex;
+  obj["subindex"] = m.sdoSubIndex;
+}
 
-      if (SDOProtocol::waitForResponse(&rxframe, pdMS_TO_TICKS(10)) && rxframe.data[3] == (id & 0xFF)) {
-        callback(kv.key().c_str(), id, extractParameterValue(rxframe));
-      } else {
-        failed++;
-      }
-    }
-  }
+// Mappings as of the last dump, so repeated requests cost no bus traffic. Operations that
+// change the map (add, remove, clear, load from flash, reset) invalidate it.
+static String canMapSerial;  // Device canMapCache was read from (empty = no valid cache)
+static std::vector<CanMappingData> canMapCache;
 
-  return failed;
+static void invalidateCanMapCache() {
+  canMapSerial = "";
 }
 
-bool SendJson(WiFiClient client) {
-  if (!conn.isIdle())
-    return false;
-
-  JsonDocument doc;
+// Reads all CAN mappings, TX (0x3100+) and RX (0x3180+). Each message is its COB ID at
+// subindex 0 followed by pairs of (param ID, position, length) and (gain, offset) entries;
+// an abort on a COB ID ends the direction, an abort on an item ends the message.
+//
+// Reads are pipelined and matched to their message by index and subindex. Each direction and
+// each message found so far is a cursor with up to MAP_READ_LOOKAHEAD reads in flight, which
+// keeps the reads wasted past an end small. Served from the cache unless refresh is set.
+class GetCanMappingsOperation : public SdoOperation {
+public:
+  explicit GetCanMappingsOperation(bool refresh) : SdoOperation(EVT_CAN_MAPPINGS_RECEIVED), refresh_(refresh) {}
+
+  const char* name() const override { return "GetCanMappings"; }
+
+  const std::vector<CanMappingData>& getMappings() const { return mappings_; }
+
+  void resume(const SdoCompletion* last) override {
+    if (last == nullptr) {
+      if (!refresh_ && !canMapSerial.isEmpty() && canMapSerial == conn.getSerial()) {
+        DBG_OUTPUT_PORT.printf("CAN mappings from cache (%u)\n", (unsigned)canMapCache.size());
+        mappings_ = canMapCache;
+        finish(true);
+        return;
+      }
+      directions_[0] = {0, MAX_MESSAGES, 0};
+      directions_[1] = {0, MAX_MESSAGES, 0};
+      queueReads();
+      return;
+    }
 
-  int failed = iterateParameterValues([&doc](const char* key, int id, double value) { doc[key]["value"] = value; });
+    outstanding_--;
+    if (last->status == SDO_TIMEOUT) {
+      DBG_OUTPUT_PORT.printf("Mapping read 0x%04X/%d timed out\n", last->index, last->subIndex);
+      finish(false);
+      return;
+    }
 
-  if (failed < 0)
-    return false;  // No cached JSON
+    handleResponse(*last);
+    queueReads();
+    if (outstanding_ == 0) {
+      collectMappings();
+      canMapSerial = conn.getSerial();
+      canMapCache = mappings_;
+      finish(true);
+    }
+  }
 
-  if (failed < 5) {
-    WriteBufferingStream bufferedWifiClient{client, 1000};
-    serializeJson(doc, bufferedWifiClient);
+  void buildResult(CANEvent& evt) override {
+    evt.data.canMappingsReceived.success = succeeded();
+    evt.data.canMappingsReceived.mappingsJson = nullptr;
+    if (succeeded()) {
+      JsonDocument doc;
+      JsonArray mappings = doc.to<JsonArray>();
+      for (const CanMappingData& m : mappings_) {
+        addMappingJson(mappings, m);
+      }
+      evt.data.canMappingsReceived.mappingsJson = serializeToHeap(doc);
+    }
   }
-  return failed < 5;
-}
 
-// Callback type for receiving individual CAN mapping items
-typedef std::function<void(const CanMappingData& mapping)> CanMappingCallback;
+private:
+  static const uint8_t MAX_MESSAGES = 0x80;     // Per direction
+  static const uint8_t MAX_SUBINDEX = 100;      // Safety limit on items per message
+  static const uint8_t MAP_READ_LOOKAHEAD = 2;  // Reads in flight per cursor
 
-// Helper: Parse 24-bit signed fixed-point gain from SDO response
-static float parseGainFromResponse(const twai_message_t& frame) {
-  // Extract 24-bit signed value and convert to float
-  int32_t gainFixedPoint = ((*(uint32_t*)&frame.data[4]) & 0xFFFFFF) << 8;
-  gainFixedPoint >>= 8;  // Sign-extend
-  return gainFixedPoint / 1000.0f;
-}
+  struct Cursor {
+    uint8_t next;      // Next position (message number or subindex) to read
+    uint8_t end;       // First position the node aborted on
+    uint8_t inFlight;  // Reads queued, completion not seen yet
+  };
 
-// Helper: Request SDO element and wait for non-abort response
-// Returns true if got valid response, false on timeout or abort
-static bool requestMappingElement(uint16_t index, uint8_t subIndex, twai_message_t& response) {
-  SDOProtocol::requestElement(conn.getNodeId(), index, subIndex);
-  if (!SDOProtocol::waitForResponse(&response, pdMS_TO_TICKS(10))) {
-    return false;  // Timeout
-  }
-  return response.data[0] != SDOProtocol::ABORT;
-}
+  struct MessageRead {
+    bool isRx;
+    uint32_t cobId;
+    Cursor items;
+    std::vector<uint32_t> data;  // By subindex
+  };
 
-// Helper: Retrieve all mappings for one direction (TX or RX)
-// Returns true to continue to next direction, false to stop
-static bool retrieveMappingsForDirection(bool isRx, uint16_t baseIndex, CanMappingCallback callback) {
-  twai_message_t rxframe;
-  uint16_t index = baseIndex;
-  const int MAX_ITEMS_PER_MESSAGE = 100;
+  static uint16_t baseIndex(bool isRx) { return isRx ? SDOProtocol::INDEX_MAP_RD + 0x80 : SDOProtocol::INDEX_MAP_RD; }
 
-  while (true) {
-    // Request COB ID (subindex 0)
-    if (!requestMappingElement(index, 0, rxframe)) {
-      return true;  // No more messages in this direction, continue to next
-    }
+  // Message read ahead of its direction's end
+  bool isPastEnd(uint16_t index, bool isRx) const { return index - baseIndex(isRx) >= directions_[isRx].end; }
 
-    int cobId = *(int32_t*)&rxframe.data[4];
-    uint8_t subIndex = 1;
+  static bool take(Cursor& cursor, uint8_t& position) {
+    if (cursor.next >= cursor.end || cursor.inFlight >= MAP_READ_LOOKAHEAD) {
+      return false;
+    }
+    position = cursor.next++;
+    cursor.inFlight++;
+    return true;
+  }
 
-    // Collect all items in this message
-    while (subIndex < MAX_ITEMS_PER_MESSAGE) {
-      // Request param ID, position, length
-      if (!requestMappingElement(index, subIndex, rxframe)) {
-        DBG_OUTPUT_PORT.println("Mapping received, moving to next");
-        break;  // Move to next message
+  // Top up the reads in flight, one per cursor per round
+  void queueReads() {
+    bool queued = true;
+    while (queued && outstanding_ < SDO_OPERATION_WINDOW) {
+      queued = false;
+      uint8_t position;
+      for (bool isRx : {false, true}) {
+        if (outstanding_ < SDO_OPERATION_WINDOW && take(directions_[isRx], position)) {
+          read(baseIndex(isRx) + position, 0);
+          outstanding_++;
+          queued = true;
+        }
       }
-
-      int paramId = *(uint16_t*)&rxframe.data[4];
-      int position = rxframe.data[6];
-      int length = (int8_t)rxframe.data[7];
-      subIndex++;
-
-      // Request gain and offset
-      if (!requestMappingElement(index, subIndex, rxframe)) {
-        return false;  // Unexpected abort
+      for (auto& entry : messages_) {
+        MessageRead& message = entry.second;
+        if (isPastEnd(entry.first, message.isRx)) {
+          continue;
+        }
+        if (outstanding_ < SDO_OPERATION_WINDOW && take(message.items, position)) {
+          message.data.resize(position + 1);
+          read(entry.first, position);
+          outstanding_++;
+          queued = true;
+        }
       }
+    }
+  }
 
-      float gain = parseGainFromResponse(rxframe);
-      int offset = (int8_t)rxframe.data[7];
-
-      DBG_OUTPUT_PORT.printf("can %s %d %d %d %d %f %d\r\n", isRx ? "rx" : "tx", paramId, cobId, position, length, gain,
-                             offset);
-
-      // Call callback with mapping data
-      callback({isRx, cobId, paramId, position, length, gain, offset, index, subIndex});
+  void handleResponse(const SdoCompletion& response) {
+    bool aborted = response.status == SDO_ABORTED;
 
-      subIndex++;
+    if (response.subIndex == 0) {
+      bool isRx = response.index >= baseIndex(true);
+      Cursor& direction = directions_[isRx];
+      uint8_t message = response.index - baseIndex(isRx);
+      direction.inFlight--;
+      if (message >= direction.end) {
+        return;
+      }
+      if (aborted) {
+        direction.end = message;  // No more messages in this direction
+      } else {
+        messages_[response.index] = {isRx, response.data, {1, MAX_SUBINDEX, 0}, {}};
+      }
+      return;
     }
 
-    index++;  // Move to next message
+    auto it = messages_.find(response.index);
+    if (it == messages_.end()) {
+      return;
+    }
+    MessageRead& message = it->second;
+    message.items.inFlight--;
+    if (response.subIndex >= message.items.end) {
+      return;
+    }
+    if (aborted) {
+      message.items.end = response.subIndex;  // Last item of the message
+    } else {
+      message.data[response.subIndex] = response.data;
+    }
   }
-}
 
-// Main function: Retrieve all CAN mappings (TX then RX) via callback
-static bool retrieveCanMappings(CanMappingCallback callback) {
-  if (!conn.isIdle()) {
-    DBG_OUTPUT_PORT.println("retrieveCanMappings called while not DeviceConnection::IDLE, ignoring");
-    return false;
+  void collectMappings() {
+    for (const auto& entry : messages_) {
+      const MessageRead& message = entry.second;
+      if (isPastEnd(entry.first, message.isRx)) {
+        continue;
+      }
+
+      // Items are complete up to the subindex the node aborted on
+      for (int gainIndex = 2; gainIndex < message.items.end; gainIndex += 2) {
+        uint32_t paramPositionLength = message.data[gainIndex - 1];
+        uint32_t gainOffset = message.data[gainIndex];
+        CanMappingData m = {message.isRx,
+                            (int)message.cobId,
+                            (int)(paramPositionLength & 0xFFFF),
+                            (int)((paramPositionLength >> 16) & 0xFF),
+                            (int8_t)(paramPositionLength >> 24),
+                            parseGain(gainOffset),
+                            (int8_t)(gainOffset >> 24),
+                            entry.first,
+                            gainIndex};
+        DBG_OUTPUT_PORT.printf("can %s %d %d %d %d %f %d\r\n", m.isRx ? "rx" : "tx", m.paramId, m.cobId, m.position,
+                               m.length, m.gain, m.offset);
+        mappings_.push_back(m);
+      }
+    }
+    DBG_OUTPUT_PORT.printf("Read %u CAN mappings\n", (unsigned)mappings_.size());
   }
 
-  SDOProtocol::clearPendingResponses();
+  bool refresh_;
+  Cursor directions_[2] = {};                 // TX, RX: message numbers
+  std::map<uint16_t, MessageRead> messages_;  // By SDO read index
+  int outstanding_ = 0;                       // Reads queued, completion not seen yet
+  std::vector<CanMappingData> mappings_;
+};
 
-  // Retrieve TX mappings (0x3100+)
-  retrieveMappingsForDirection(false, SDOProtocol::INDEX_MAP_RD, callback);
+// Writes a new mapping: COB ID, then (param ID, position, length), then (gain, offset)
+class AddCanMappingOperation : public SdoOperation {
+public:
+  explicit AddCanMappingOperation(const AddCanMappingCommand& mapping)
+      : SdoOperation(EVT_CAN_MAPPING_ADDED), mapping_(mapping) {}
 
-  // Retrieve RX mappings (0x3180+)
-  DBG_OUTPUT_PORT.println("Getting RX items");
-  retrieveMappingsForDirection(true, SDOProtocol::INDEX_MAP_RD + 0x80, callback);
+  const char* name() const override { return "AddCanMapping"; }
 
-  return true;
-}
+  void resume(const SdoCompletion* last) override {
+    uint16_t index = mapping_.isRx ? SDOProtocol::INDEX_MAP_RX : SDOProtocol::INDEX_MAP_TX;
 
-// Helper: Retrieve CAN mappings and return as JsonDocument
-static bool retrieveCanMappingsAsJson(JsonDocument& doc) {
-  return retrieveCanMappings([&doc](const CanMappingData& m) {
-    JsonObject obj = doc.add<JsonObject>();
-    obj["isrx"] = m.isRx;
-    obj["id"] = m.cobId;
-    obj["paramid"] = m.paramId;
-    obj["position"] = m.position;
-    obj["length"] = m.length;
-    obj["gain"] = m.gain;
-    obj["offset"] = m.offset;
-    obj["index"] = m.sdoIndex;
-    obj["subindex"] = m.sdoSubIndex;
-  });
-}
+    if (last != nullptr && last->status != SDO_OK) {
+      DBG_OUTPUT_PORT.println("Mapping failed");
+      finish(false);
+      return;
+    }
 
-String GetCanMapping() {
-  JsonDocument doc;
+    switch (written_++) {
+      case 0:
+        invalidateCanMapCache();
+        write(index, 0, mapping_.canId);  // Send CAN Id
+        break;
+      case 1: {
+        DBG_OUTPUT_PORT.println("Sent COB Id");
+        write(index, 1, packParamPositionLength(mapping_.paramId, mapping_.position, mapping_.length));
+        break;
+      }
+      case 2: {
+        DBG_OUTPUT_PORT.println("Sent position and length");
+        write(index, 2, packGainOffset(mapping_.gain, mapping_.offset));
+        break;
+      }
+      default:
+        DBG_OUTPUT_PORT.println("Sent gain and offset -> map successful");
+        finish(true);
+        break;
+    }
+  }
 
-  if (!retrieveCanMappingsAsJson(doc)) {
-    return "[]";
+  void buildResult(CANEvent& evt) override {
+    evt.data.canMappingAdded.result = succeeded() ? SET_OK : SET_COMM_ERROR;
   }
 
-  String result;
-  serializeJson(doc, result);
-  return result;
-}
+private:
+  AddCanMappingCommand mapping_;
+  int written_ = 0;  // Entries written so far
+};
+
+// Removes a whole mapping message by writing 0 to its COB ID
+class RemoveCanMappingOperation : public SdoOperation {
+public:
+  explicit RemoveCanMappingOperation(const RemoveCanMappingCommand& mapping)
+      : SdoOperation(EVT_CAN_MAPPING_REMOVED), readIndex_(mapping.index) {}
+
+  const char* name() const override { return "RemoveCanMapping"; }
+
+  void resume(const SdoCompletion* last) override {
+    if (last == nullptr) {
+      // The index from GetCanMappings is a read index (0x3100+ for TX, 0x3180+ for RX);
+      // writing 0 to its subindex 0 removes the entire mapping
+      if (readIndex_ < SDOProtocol::INDEX_MAP_RD) {
+        DBG_OUTPUT_PORT.printf("Remove: Invalid index 0x%lX\n", (unsigned long)readIndex_);
+        result_ = SET_UNKNOWN_INDEX;
+        finish(false);
+        return;
+      }
+      bool isRx = readIndex_ >= (uint32_t)SDOProtocol::INDEX_MAP_RD + 0x80;
+      DBG_OUTPUT_PORT.printf("Removing %s mapping at index 0x%lX, subindex 0\n", isRx ? "RX" : "TX",
+                             (unsigned long)readIndex_);
+      invalidateCanMapCache();
+      write(readIndex_, 0, 0U);
+      return;
+    }
 
-void SendCanMapping(WiFiClient client) {
-  JsonDocument doc;
+    if (last->status == SDO_OK) {
+      DBG_OUTPUT_PORT.println("Item removed");
+      result_ = SET_OK;
+    } else if (last->status == SDO_ABORTED) {
+      DBG_OUTPUT_PORT.println("Invalid item index/subindex");
+      result_ = SET_UNKNOWN_INDEX;
+    } else {
+      DBG_OUTPUT_PORT.println("Comm Error");
+      result_ = SET_COMM_ERROR;
+    }
+    finish(result_ == SET_OK);
+  }
 
-  if (retrieveCanMappingsAsJson(doc)) {
-    WriteBufferingStream bufferedWifiClient{client, 1000};
-    serializeJson(doc, bufferedWifiClient);
+  void buildResult(CANEvent& evt) override {
+    evt.data.canMappingRemoved.result = succeeded() ? SET_OK : result_;
   }
-}
 
-SetResult AddCanMapping(String json) {
-  if (!conn.isIdle())
-    return CommError;
+private:
+  uint32_t readIndex_;
+  SetValueResult result_ = SET_COMM_ERROR;
+};
+
+// Removes every mapping of one direction by deleting the first message until the node aborts
+class ClearCanMapOperation : public SdoOperation {
+public:
+  explicit ClearCanMapOperation(bool isRx) : SdoOperation(EVT_CAN_MAP_CLEARED), isRx_(isRx) {}
+
+  const char* name() const override { return "ClearCanMap"; }
+
+  void resume(const SdoCompletion* last) override {
+    const char* direction = isRx_ ? "RX" : "TX";
+
+    if (last == nullptr) {
+      DBG_OUTPUT_PORT.printf("Clearing all %s CAN mappings\n", direction);
+      invalidateCanMapCache();
+    } else if (last->status == SDO_ABORTED) {
+      // Abort means no more entries to delete
+      DBG_OUTPUT_PORT.printf("All %s mappings cleared (%d removed)\n", direction, removedCount_);
+      finish(true);
+      return;
+    } else if (last->status == SDO_TIMEOUT) {
+      DBG_OUTPUT_PORT.printf("Communication timeout while clearing %s mappings\n", direction);
+      finish(false);
+      return;
+    } else {
+      removedCount_++;
+      DBG_OUTPUT_PORT.printf("Removed %s mapping #%d\n", direction, removedCount_);
+    }
 
-  JsonDocument doc;
-  twai_message_t rxframe;
+    if (removedCount_ >= MAX_ITERATIONS) {
+      // Probably a bug
+      DBG_OUTPUT_PORT.printf("Warning: Hit maximum iterations (%d) while clearing %s mappings\n", MAX_ITERATIONS,
+                             direction);
+      finish(false);
+      return;
+    }
 
-  deserializeJson(doc, json);
+    // Write 0 to the first mapping slot (index 0x3100 or 0x3180, subindex 0)
+    write(isRx_ ? SDOProtocol::INDEX_MAP_RD + 0x80 : SDOProtocol::INDEX_MAP_RD, 0, 0U);
+  }
 
-  if (doc["isrx"].isNull() || doc["id"].isNull() || doc["paramid"].isNull() || doc["position"].isNull() ||
-      doc["length"].isNull() || doc["gain"].isNull() || doc["offset"].isNull()) {
-    DBG_OUTPUT_PORT.println("Add: Missing argument");
-    return UnknownIndex;
+  void buildResult(CANEvent& evt) override {
+    evt.data.canMapCleared.success = succeeded();
+    evt.data.canMapCleared.isRx = isRx_;
+    evt.data.canMapCleared.removedCount = removedCount_;
   }
 
-  int index = doc["isrx"] ? SDOProtocol::INDEX_MAP_RX : SDOProtocol::INDEX_MAP_TX;
+private:
+  static const int MAX_ITERATIONS = 100;  // Safety limit to prevent infinite loops
+
+  bool isRx_;
+  int removedCount_ = 0;
+};
+
+// Makes the device's CAN map match a given set of mappings. The current map is read first
+// and only the difference is written: a message whose items are all wanted is kept (and
+// extended), any other message is removed and its wanted items are added again.
+//
+// Removals go out together, highest index first so the ones still queued keep their index.
+// Adds run per direction, one mapping at a time with its three writes in flight together;
+// the next mapping reuses the same index/subindex keys, so it waits for them. If a write
+// fails, every direction touched is cleared and the original mappings are written back.
+class ImportCanMapOperation : public SdoOperation {
+public:
+  explicit ImportCanMapOperation(std::vector<CanMappingData> mappings)
+      : SdoOperation(EVT_CAN_MAP_IMPORTED), wanted_(std::move(mappings)), reader_(true) {}
+
+  const char* name() const override { return "ImportCanMap"; }
+
+  void resume(const SdoCompletion* last) override {
+    if (phase_ == PHASE_READ) {
+      resumeChild(reader_, last);
+      if (reader_.isFinished()) {
+        startChanges();
+      }
+      return;
+    }
 
-  SDOProtocol::clearPendingResponses();
-  SDOProtocol::setValue(conn.getNodeId(), index, 0, (uint32_t)doc["id"]);  // Send CAN Id
+    outstanding_--;
+    switch (phase_) {
+      case PHASE_REMOVE:
+        if (last->status == SDO_OK) {
+          removed_++;
+        } else {
+          failed_ = true;
+        }
+        if (outstanding_ == 0 && failed_) {
+          startRollback();
+        } else if (outstanding_ == 0) {
+          startAdds(wantedAdds_);
+        }
+        break;
+
+      case PHASE_ADD:
+      case PHASE_RESTORE:
+        handleAddResponse(*last);
+        break;
+
+      case PHASE_CLEAR:
+        if (last->status == SDO_OK) {
+          writeClear(last->index);  // Next message moved into the first slot
+        } else if (last->status == SDO_TIMEOUT) {
+          failed_ = true;
+        }
+        if (outstanding_ == 0) {
+          if (failed_) {
+            DBG_OUTPUT_PORT.println("CAN map import: rollback failed while clearing");
+            finish(false);
+          } else {
+            startAdds(restoreAdds_);
+          }
+        }
+        break;
 
-  if (SDOProtocol::waitForResponse(&rxframe, pdMS_TO_TICKS(10))) {
-    DBG_OUTPUT_PORT.println("Sent COB Id");
+      default:
+        break;
+    }
+  }
 
-    uint32_t paramId = doc["paramid"].as<uint32_t>();
-    uint32_t position = doc["position"].as<uint32_t>();
-    int32_t length = doc["length"].as<int32_t>();
-    uint32_t paramPositionLength = paramId | (position << 16) | (length << 24);
+  void buildResult(CANEvent& evt) override {
+    evt.data.canMapImported.success = succeeded();
+    evt.data.canMapImported.restored = !succeeded() && restored_;
+    evt.data.canMapImported.added = added_;
+    evt.data.canMapImported.removed = removed_;
+  }
 
-    SDOProtocol::setValue(conn.getNodeId(), index, 1, paramPositionLength);
-    if (rxframe.data[0] != SDOProtocol::ABORT && SDOProtocol::waitForResponse(&rxframe, pdMS_TO_TICKS(10))) {
-      DBG_OUTPUT_PORT.println("Sent position and length");
+private:
+  enum Phase : uint8_t {
+    PHASE_READ,     // Reading the current map
+    PHASE_REMOVE,   // Removing unwanted messages
+    PHASE_ADD,      // Adding missing mappings
+    PHASE_CLEAR,    // Rollback: clearing the directions touched
+    PHASE_RESTORE   // Rollback: writing the original mappings back
+  };
+
+  struct AddLane {
+    std::vector<CanMappingData> mappings;
+    size_t next = 0;
+    uint8_t pending = 0;  // Writes of the current mapping still in flight
+  };
+
+  static bool sameMapping(const CanMappingData& a, const CanMappingData& b) {
+    return a.isRx == b.isRx && a.cobId == b.cobId &&
+           packParamPositionLength(a.paramId, a.position, a.length) ==
+               packParamPositionLength(b.paramId, b.position, b.length) &&
+           packGainOffset(a.gain, a.offset) == packGainOffset(b.gain, b.offset);
+  }
 
-      int32_t gainScaled = (int32_t)(doc["gain"].as<double>() * 1000) & 0xFFFFFF;
-      int32_t offset = doc["offset"].as<int32_t>();
-      uint32_t gainOffset = (uint32_t)gainScaled | (offset << 24);
+  // Work out which messages to remove and which mappings to add
+  void plan() {
+    std::vector<bool> used(wanted_.size(), false);
+    std::vector<size_t> matched;
 
-      SDOProtocol::setValue(conn.getNodeId(), index, 2, gainOffset);
+    size_t first = 0;
+    while (first < original_.size()) {
+      size_t end = first;
+      while (end < original_.size() && original_[end].sdoIndex == original_[first].sdoIndex) {
+        end++;
+      }
 
-      if (rxframe.data[0] != SDOProtocol::ABORT && SDOProtocol::waitForResponse(&rxframe, pdMS_TO_TICKS(10))) {
-        if (rxframe.data[0] != SDOProtocol::ABORT) {
-          DBG_OUTPUT_PORT.println("Sent gain and offset -> map successful");
-          return Ok;
+      // Keep the message if each of its items matches a different wanted mapping
+      matched.clear();
+      for (size_t i = first; i < end && matched.size() == i - first; i++) {
+        for (size_t j = 0; j < wanted_.size(); j++) {
+          if (!used[j] && sameMapping(wanted_[j], original_[i])) {
+            used[j] = true;
+            matched.push_back(j);
+            break;
+          }
+        }
+      }
+      if (matched.size() != end - first) {
+        for (size_t j : matched) {
+          used[j] = false;
         }
+        removals_.push_back(original_[first].sdoIndex);
       }
+      first = end;
     }
-  }
 
-  DBG_OUTPUT_PORT.println("Mapping failed");
+    for (size_t j = 0; j < wanted_.size(); j++) {
+      if (!used[j]) {
+        wantedAdds_.push_back(wanted_[j]);
+      }
+    }
+    std::sort(removals_.begin(), removals_.end(), [](int a, int b) { return a > b; });
+  }
 
-  return CommError;
-}
+  void startChanges() {
+    if (!reader_.succeeded()) {
+      DBG_OUTPUT_PORT.println("CAN map import: could not read the current map");
+      restored_ = true;  // Nothing written yet
+      finish(false);
+      return;
+    }
 
-SetResult RemoveCanMapping(String json) {
-  if (!conn.isIdle())
-    return CommError;
+    invalidateCanMapCache();
+    original_ = reader_.getMappings();
+    plan();
+    DBG_OUTPUT_PORT.printf("CAN map import: %u wanted, %u present, removing %u messages, adding %u mappings\n",
+                           (unsigned)wanted_.size(), (unsigned)original_.size(), (unsigned)removals_.size(),
+                           (unsigned)wantedAdds_.size());
+
+    phase_ = PHASE_REMOVE;
+    for (int index : removals_) {
+      touched_[index >= SDOProtocol::INDEX_MAP_RD + 0x80] = true;
+      write(index, 0, 0U);
+      outstanding_++;
+    }
+    if (outstanding_ == 0) {
+      startAdds(wantedAdds_);
+    }
+  }
 
-  JsonDocument doc;
-  deserializeJson(doc, json);
+  void startAdds(const std::vector<CanMappingData>& mappings) {
+    phase_ = phase_ == PHASE_CLEAR ? PHASE_RESTORE : PHASE_ADD;
+    for (AddLane& lane : lanes_) {
+      lane = AddLane();
+    }
+    for (const CanMappingData& m : mappings) {
+      lanes_[m.isRx].mappings.push_back(m);
+    }
+    queueAdd(false);
+    queueAdd(true);
+    if (outstanding_ == 0) {
+      finishAdds();
+    }
+  }
 
-  if (doc["index"].isNull() || doc["subindex"].isNull()) {
-    DBG_OUTPUT_PORT.println("Remove: Missing argument");
+  void queueAdd(bool isRx) {
+    AddLane& lane = lanes_[isRx];
+    if (lane.next >= lane.mappings.size()) {
+      return;
+    }
 
-    return UnknownIndex;
+    const CanMappingData& m = lane.mappings[lane.next++];
+    uint16_t index = isRx ? SDOProtocol::INDEX_MAP_RX : SDOProtocol::INDEX_MAP_TX;
+    touched_[isRx] = true;
+    write(index, 0, (uint32_t)m.cobId);
+    write(index, 1, packParamPositionLength(m.paramId, m.position, m.length));
+    write(index, 2, packGainOffset(m.gain, m.offset));
+    lane.pending = 3;
+    outstanding_ += 3;
   }
 
-  // The index from GetCanMapping is a read index (0x3100+ for TX, 0x3180+ for RX)
-  // To remove a mapping, we need to determine if it's TX or RX and write to the correct base index
-  uint32_t readIndex = doc["index"].as<uint32_t>();
-  uint32_t writeIndex;
-  bool isRx;
+  void handleAddResponse(const SdoCompletion& response) {
+    bool isRx = response.index == SDOProtocol::INDEX_MAP_RX;
+    AddLane& lane = lanes_[isRx];
+    lane.pending--;
+    if (response.status != SDO_OK) {
+      failed_ = true;
+    } else if (lane.pending == 0 && !failed_) {
+      if (phase_ == PHASE_ADD) {
+        added_++;
+      }
+      queueAdd(isRx);
+    }
 
-  if (readIndex >= SDOProtocol::INDEX_MAP_RD + 0x80) {
-    // RX mapping (read index 0x3180+)
-    writeIndex = readIndex;  // Use the read index directly for removal
-    isRx = true;
-  } else if (readIndex >= SDOProtocol::INDEX_MAP_RD) {
-    // TX mapping (read index 0x3100+)
-    writeIndex = readIndex;  // Use the read index directly for removal
-    isRx = false;
-  } else {
-    DBG_OUTPUT_PORT.printf("Remove: Invalid index 0x%lX\n", (unsigned long)readIndex);
-    return UnknownIndex;
+    if (outstanding_ == 0) {
+      finishAdds();
+    }
   }
 
-  DBG_OUTPUT_PORT.printf("Removing %s mapping at index 0x%lX, subindex 0\n", isRx ? "RX" : "TX",
-                         (unsigned long)writeIndex);
+  void finishAdds() {
+    if (phase_ == PHASE_RESTORE) {
+      restored_ = !failed_;
+      DBG_OUTPUT_PORT.printf("CAN map import: rollback %s\n", restored_ ? "done" : "failed");
+      finish(false);
+    } else if (failed_) {
+      startRollback();
+    } else {
+      DBG_OUTPUT_PORT.printf("CAN map import done (%d removed, %d added)\n", removed_, added_);
+      finish(true);
+    }
+  }
 
-  // Write 0 to subindex 0 (COB ID) to remove the entire mapping
-  twai_message_t rxframe;
-  if (SDOProtocol::writeAndWait(conn.getNodeId(), writeIndex, 0, 0U, &rxframe)) {
-    DBG_OUTPUT_PORT.println("Item removed");
-    return Ok;
+  // Clear the directions touched, then write their original mappings back
+  void startRollback() {
+    DBG_OUTPUT_PORT.println("CAN map import failed, restoring the previous map");
+    phase_ = PHASE_CLEAR;
+    failed_ = false;
+    for (const CanMappingData& m : original_) {
+      if (touched_[m.isRx]) {
+        restoreAdds_.push_back(m);
+      }
+    }
+    for (bool isRx : {false, true}) {
+      if (touched_[isRx]) {
+        writeClear(isRx ? SDOProtocol::INDEX_MAP_RD + 0x80 : SDOProtocol::INDEX_MAP_RD);
+      }
+    }
   }
 
-  // writeAndWait returns false on timeout or abort
-  if (rxframe.data[0] == SDOProtocol::ABORT) {
-    DBG_OUTPUT_PORT.println("Invalid item index/subindex");
-    return UnknownIndex;
+  // Remove the first message of a direction; the node aborts once there is none left
+  void writeClear(uint16_t index) {
+    bool isRx = index >= SDOProtocol::INDEX_MAP_RD + 0x80;
+    if (clearWrites_[isRx]++ >= MAX_CLEAR_WRITES) {
+      failed_ = true;
+      return;
+    }
+    write(index, 0, 0U);
+    outstanding_++;
   }
 
-  DBG_OUTPUT_PORT.println("Comm Error");
-  return CommError;
-}
+  static const int MAX_CLEAR_WRITES = 100;
+
+  std::vector<CanMappingData> wanted_;
+  GetCanMappingsOperation reader_;
+  Phase phase_ = PHASE_READ;
+  std::vector<CanMappingData> original_;     // Map before the import
+  std::vector<int> removals_;                // Read indices of messages to remove, highest first
+  std::vector<CanMappingData> wantedAdds_;   // Mappings to add
+  std::vector<CanMappingData> restoreAdds_;  // Rollback: original mappings of the directions touched
+  AddLane lanes_[2];                         // TX, RX
+  bool touched_[2] = {false, false};         // Direction written to
+  int clearWrites_[2] = {0, 0};
+  int outstanding_ = 0;  // Writes queued, completion not seen yet
+  bool failed_ = false;
+  bool restored_ = false;
+  uint16_t added_ = 0;
+  uint16_t removed_ = 0;
+};
+
+class SetValueOperation : public SdoOperation {
+public:
+  explicit SetValueOperation(const SetValueCommand& setValue)
+      : SdoOperation(EVT_VALUE_SET), paramId_(setValue.paramId), value_(setValue.value) {}
+
+  const char* name() const override { return "SetValue"; }
+
+  void resume(const SdoCompletion* last) override {
+    if (last == nullptr) {
+      write(SDOProtocol::INDEX_PARAM_UID | (paramId_ >> 8), paramId_ & 0xFF, (uint32_t)(value_ * 32));
+      return;
+    }
+    result_ = SDOProtocol::toSetValueResult(*last);
+    finish(result_ == SET_OK);
+  }
 
-bool ClearCanMap(bool isRx, ClearMapProgressCallback onProgress) {
-  if (!conn.isIdle())
-    return false;
+  void buildResult(CANEvent& evt) override {
+    evt.data.valueSet.paramId = paramId_;
+    evt.data.valueSet.value = value_;
+    evt.data.valueSet.result = result_;
+  }
 
-  twai_message_t rxframe;
-  int baseIndex = isRx ? (SDOProtocol::INDEX_MAP_RD + 0x80) : SDOProtocol::INDEX_MAP_RD;
-  int removedCount = 0;
-  const int MAX_ITERATIONS = 100;  // Safety limit to prevent infinite loops
+private:
+  int paramId_;
+  double value_;
+  SetValueResult result_ = SET_COMM_ERROR;
+};
 
-  DBG_OUTPUT_PORT.printf("Clearing all %s CAN mappings\n", isRx ? "RX" : "TX");
-  SDOProtocol::clearPendingResponses();
+// Helper: Timeout for device command acknowledgments. The node answers only after carrying
+// the command out (e.g. a flash write), so this is a fixed timeout, not the RTO.
+static const uint32_t DEVICE_COMMAND_TIMEOUT_MS = 200;
 
-  // Repeatedly delete the first entry (index + 0, subindex 0) until we get an abort
-  for (int i = 0; i < MAX_ITERATIONS; i++) {
-    // Write 0 to the first mapping slot (index 0x3100 or 0x3180, subindex 0)
-    SDOProtocol::setValue(conn.getNodeId(), baseIndex, 0, 0U);
+// Save/load/defaults/start/stop: one command write, acknowledged when done
+class DeviceCommandOperation : public SdoOperation {
+public:
+  DeviceCommandOperation(const char* name, CANEventType resultType, uint8_t command, uint32_t value = 0)
+      : SdoOperation(resultType), name_(name), command_(command), value_(value) {}
 
-    if (SDOProtocol::waitForResponse(&rxframe, pdMS_TO_TICKS(10))) {
-      if (rxframe.data[0] == SDOProtocol::ABORT) {
-        // Abort means no more entries to delete
-        DBG_OUTPUT_PORT.printf("All %s mappings cleared (%d removed)\n", isRx ? "RX" : "TX", removedCount);
-        return true;
-      } else {
-        // Successfully removed one entry
-        removedCount++;
-        DBG_OUTPUT_PORT.printf("Removed %s mapping #%d\n", isRx ? "RX" : "TX", removedCount);
+  const char* name() const override { return name_; }
 
-        // Notify progress callback if provided
-        if (onProgress) {
-          onProgress(removedCount);
-        }
+  void resume(const SdoCompletion* last) override {
+    if (last == nullptr) {
+      if (command_ == SDOProtocol::CMD_LOAD) {
+        invalidateCanMapCache();  // Loads the stored map along with the parameters
       }
+      write(SDOProtocol::INDEX_COMMANDS, command_, value_, DEVICE_COMMAND_TIMEOUT_MS);
     } else {
-      // Communication timeout
-      DBG_OUTPUT_PORT.printf("Communication timeout while clearing %s mappings\n", isRx ? "RX" : "TX");
-      return false;
-    }
-  }
-
-  // Hit maximum iterations - probably a bug
-  DBG_OUTPUT_PORT.printf("Warning: Hit maximum iterations (%d) while clearing %s mappings\n", MAX_ITERATIONS,
-                         isRx ? "RX" : "TX");
-  return false;
-}
-
-SetResult SetValue(int paramId, double value) {
-  if (!conn.isIdle())
-    return CommError;
-
-  twai_message_t rxframe;
-  uint16_t index = SDOProtocol::INDEX_PARAM_UID | (paramId >> 8);
-  uint8_t subIndex = paramId & 0xFF;
-
-  if (!SDOProtocol::writeAndWait(conn.getNodeId(), index, subIndex, (uint32_t)(value * 32), &rxframe)) {
-    // Check if we got a response but it was an abort
-    if (rxframe.data[0] == SDOProtocol::ABORT) {
-      if (*(uint32_t*)&rxframe.data[4] == SDOProtocol::ERR_RANGE)
-        return ValueOutOfRange;
-      else
-        return UnknownIndex;
+      finish(last->status == SDO_OK);
     }
-    return CommError;
   }
 
-  return Ok;
-}
+  void buildResult(CANEvent& evt) override { evt.data.deviceCommand.success = succeeded(); }
 
-// Helper: Send a device command and wait for acknowledgment
-static const int DEVICE_COMMAND_TIMEOUT_MS = 200;
+private:
+  const char* name_;
+  uint8_t command_;
+  uint32_t value_;
+};
 
-static bool sendDeviceCommand(uint8_t cmd, uint32_t value = 0) {
-  if (!conn.isIdle())
-    return false;
+// Time the device needs to start resetting before its serial is read again
+static const uint32_t DEVICE_RESET_DELAY_MS = 500;
 
-  return SDOProtocol::writeAndWait(conn.getNodeId(), SDOProtocol::INDEX_COMMANDS, cmd, value,
-                                   pdMS_TO_TICKS(DEVICE_COMMAND_TIMEOUT_MS));
-}
+// Sends the reset command, waits for the device to go down and re-acquires its serial.
+// The device resets without acknowledging, so the write normally times out; its timeout is
+// the reset delay and, being explicit, does not count against the node's RTT estimate.
+class ResetDeviceOperation : public SdoOperation {
+public:
+  ResetDeviceOperation() : SdoOperation(EVT_DEVICE_RESET) {}
 
-bool SaveToFlash() {
-  return sendDeviceCommand(SDOProtocol::CMD_SAVE);
-}
+  const char* name() const override { return "ResetDevice"; }
 
-bool LoadFromFlash() {
-  return sendDeviceCommand(SDOProtocol::CMD_LOAD);
-}
+  void resume(const SdoCompletion* last) override {
+    if (!sent_) {
+      sent_ = true;
+      invalidateCanMapCache();  // Unsaved mapping changes are lost
+      write(SDOProtocol::INDEX_COMMANDS, SDOProtocol::CMD_RESET, 1U, DEVICE_RESET_DELAY_MS);
+      return;
+    }
+    if (last != nullptr && last->elapsedMs < DEVICE_RESET_DELAY_MS) {
+      wait(DEVICE_RESET_DELAY_MS - last->elapsedMs);  // Acknowledged before going down
+      return;
+    }
 
-bool LoadDefaults() {
-  return sendDeviceCommand(SDOProtocol::CMD_DEFAULTS);
-}
+    DBG_OUTPUT_PORT.println("Device reset command sent");
+    conn.startSerialAcquisition();
+    finish(true);
+  }
 
-bool StartDevice(uint32_t mode) {
-  return sendDeviceCommand(SDOProtocol::CMD_START, mode);
-}
+  void buildResult(CANEvent& evt) override { evt.data.deviceCommand.success = succeeded(); }
 
-bool StopDevice() {
-  return sendDeviceCommand(SDOProtocol::CMD_STOP);
-}
+private:
+  bool sent_ = false;
+};
 
 // Helper: Build error description map from parameter JSON
 static std::map<int, String> buildErrorDescriptionMap() {
@@ -535,21 +923,6 @@ static int determineTickDuration() {
   return tickDurationMs;
 }
 
-// Helper: Request error data (timestamp and number) for a specific index
-static bool requestErrorAtIndex(uint8_t index, uint32_t& errorTime, uint32_t& errorNum) {
-  // Request error timestamp
-  if (!SDOProtocol::requestValue(conn.getNodeId(), SDOProtocol::INDEX_ERROR_TIME, index, &errorTime)) {
-    return false;
-  }
-
-  // Request error number
-  if (!SDOProtocol::requestValue(conn.getNodeId(), SDOProtocol::INDEX_ERROR_NUM, index, &errorNum)) {
-    return false;
-  }
-
-  return true;
-}
-
 // Helper: Create JSON object for an error entry
 static void createErrorJsonObject(JsonArray& errors, uint8_t index, uint32_t errorNum, uint32_t errorTime,
                                   int tickDurationMs, const std::map<int, String>& errorDescriptions) {
@@ -571,41 +944,362 @@ static void createErrorJsonObject(JsonArray& errors, uint8_t index, uint32_t err
                          errorObj["description"].as<const char*>());
 }
 
-String ListErrors() {
-  if (!conn.isIdle()) {
-    DBG_OUTPUT_PORT.println("ListErrors called while not DeviceConnection::IDLE, ignoring");
-    return "[]";
+// Error log slot contents as of the last listing
+struct ErrorLogSlot {
+  uint32_t errorTime;
+  uint32_t errorNum;
+};
+
+static String errorLogSerial;  // Device errorLogSlots was read from
+static std::vector<ErrorLogSlot> errorLogSlots;
+
+// Reads the error log (slots 0-254) up to the first slot the node aborts on. Timestamps are
+// read pipelined and matched to their slot by subindex; a slot's error number is read once
+// its timestamp is in. An incremental listing reuses the cached error number of every slot
+// whose timestamp has not changed, so an unchanged log costs one read per slot.
+class ListErrorsOperation : public SdoOperation {
+public:
+  explicit ListErrorsOperation(bool incremental) : SdoOperation(EVT_ERRORS_LISTED), incremental_(incremental) {}
+
+  const char* name() const override { return "ListErrors"; }
+
+  void resume(const SdoCompletion* last) override {
+    if (last == nullptr) {
+      if (incremental_ && errorLogSerial == conn.getSerial()) {
+        cached_ = errorLogSlots;
+      }
+      for (int i = 0; i < SDO_OPERATION_WINDOW; i++) {
+        readNextTime();
+      }
+      return;
+    }
+
+    outstanding_--;
+    if (last->status == SDO_TIMEOUT) {
+      DBG_OUTPUT_PORT.printf("Error log read at slot %d timed out\n", last->subIndex);
+      finish(false);
+      return;
+    }
+
+    uint8_t slot = last->subIndex;
+    if (slot < end_) {
+      if (last->status == SDO_ABORTED) {
+        end_ = slot;  // Reads of later slots still in flight are ignored
+      } else if (last->index == SDOProtocol::INDEX_ERROR_TIME) {
+        slots_[slot].errorTime = last->data;
+        if (slot < cached_.size() && cached_[slot].errorTime == last->data) {
+          slots_[slot].errorNum = cached_[slot].errorNum;
+        } else {
+          queueRead(SDOProtocol::INDEX_ERROR_NUM, slot);
+          numbersRead_++;
+        }
+        readNextTime();
+      } else {
+        slots_[slot].errorNum = last->data;
+      }
+    }
+
+    if (outstanding_ == 0) {
+      finish(true);
+    }
   }
 
-  JsonDocument doc;
-  JsonArray errors = doc.to<JsonArray>();
+  void buildResult(CANEvent& evt) override {
+    evt.data.errorsListed.success = succeeded();
+    evt.data.errorsListed.errorsJson = nullptr;
+    if (!succeeded()) {
+      return;
+    }
+
+    slots_.resize(end_ < slots_.size() ? end_ : slots_.size());
+    std::map<int, String> errorDescriptions = buildErrorDescriptionMap();
+    int tickDurationMs = determineTickDuration();
+    JsonDocument doc;
+    JsonArray errors = doc.to<JsonArray>();
+    for (size_t i = 0; i < slots_.size(); i++) {
+      if (slots_[i].errorNum != 0) {
+        createErrorJsonObject(errors, i, slots_[i].errorNum, slots_[i].errorTime, tickDurationMs, errorDescriptions);
+      }
+    }
+    DBG_OUTPUT_PORT.printf("Retrieved %u errors from %u slots (%u error numbers read)\n", (unsigned)errors.size(),
+                           (unsigned)slots_.size(), (unsigned)numbersRead_);
 
-  // Build error description map and determine tick duration
-  std::map<int, String> errorDescriptions = buildErrorDescriptionMap();
-  int tickDurationMs = determineTickDuration();
-  DBG_OUTPUT_PORT.printf("Retrieving error log (tick duration: %dms)\n", tickDurationMs);
+    errorLogSerial = conn.getSerial();
+    errorLogSlots = slots_;
+    evt.data.errorsListed.errorsJson = serializeToHeap(doc);
+  }
 
-  // Iterate through error indices (0-254)
-  for (uint8_t i = 0; i < 255; i++) {
-    uint32_t errorTime = 0;
-    uint32_t errorNum = 0;
+private:
+  static const uint16_t ERROR_SLOT_COUNT = 255;
 
-    // Request error data for this index
-    if (!requestErrorAtIndex(i, errorTime, errorNum)) {
-      DBG_OUTPUT_PORT.printf("Reached end of error log at index %d\n", i);
-      break;
+  void queueRead(uint16_t index, uint8_t slot) {
+    read(index, slot);
+    outstanding_++;
+  }
+
+  void readNextTime() {
+    if (slots_.size() < end_) {
+      slots_.push_back({0, 0});
+      queueRead(SDOProtocol::INDEX_ERROR_TIME, slots_.size() - 1);
     }
+  }
 
-    // If we have valid error data, add it to the result
-    if (errorNum != 0) {
-      createErrorJsonObject(errors, i, errorNum, errorTime, tickDurationMs, errorDescriptions);
+  bool incremental_;
+  std::vector<ErrorLogSlot> cached_;  // Slots of the previous listing (incremental only)
+  std::vector<ErrorLogSlot> slots_;   // One per timestamp read queued
+  uint16_t end_ = ERROR_SLOT_COUNT;   // First slot the node aborted on
+  int outstanding_ = 0;               // Reads queued, completion not seen yet
+  uint16_t numbersRead_ = 0;
+};
+
+// Helper: IDs of the writable parameters in the cached schema (spot values are left out)
+static std::vector<uint16_t> collectParamIds() {
+  std::vector<uint16_t> paramIds;
+  JsonObject params = conn.getCachedJson().as<JsonObject>();
+  for (JsonPair kv : params) {
+    JsonObject param = kv.value().as<JsonObject>();
+    if (param["isparam"] | false) {
+      paramIds.push_back(param["id"].as<uint16_t>());
     }
   }
+  return paramIds;
+}
 
-  String result;
-  serializeJson(doc, result);
-  DBG_OUTPUT_PORT.printf("Retrieved %d errors\n", errors.size());
-  return result;
+// Helper: Parameter names by ID from the cached schema
+static std::map<int, String> buildParamNameMap() {
+  std::map<int, String> names;
+  JsonObject params = conn.getCachedJson().as<JsonObject>();
+  for (JsonPair kv : params) {
+    names[kv.value()["id"].as<int>()] = kv.key().c_str();
+  }
+  return names;
+}
+
+static const char* describeSetValueResult(SetValueResult result) {
+  switch (result) {
+    case SET_OK:
+      return "OK";
+    case SET_VALUE_OUT_OF_RANGE:
+      return "Value out of range";
+    case SET_UNKNOWN_INDEX:
+      return "Unknown parameter ID";
+    case SET_COMM_ERROR:
+    default:
+      return "Communication error";
+  }
+}
+
+// Helper: Parameter ID addressed by a parameter read or write
+static uint16_t paramIdOf(const SdoCompletion& completion) {
+  return ((completion.index & 0xFF) << 8) | completion.subIndex;
+}
+
+// Reads every parameter of the cached schema and saves the values as the device's snapshot
+// (DeviceStorage). All reads are queued at once and pipelined; a parameter the node refuses
+// to read is skipped, a timeout fails the snapshot and keeps the previous one.
+class SnapshotParamsOperation : public SdoOperation {
+public:
+  explicit SnapshotParamsOperation(std::vector<uint16_t> paramIds)
+      : SdoOperation(EVT_PARAMS_SNAPSHOT), paramIds_(std::move(paramIds)) {}
+
+  const char* name() const override { return "SnapshotParams"; }
+
+  void resume(const SdoCompletion* last) override {
+    if (last == nullptr) {
+      if (paramIds_.empty()) {
+        DBG_OUTPUT_PORT.println("Parameter snapshot: no parameters in the schema");
+        finish(false);
+        return;
+      }
+      serial_ = conn.getSerial();
+      for (uint16_t paramId : paramIds_) {
+        read(SDOProtocol::INDEX_PARAM_UID | (paramId >> 8), paramId & 0xFF);
+      }
+      outstanding_ = paramIds_.size();
+      return;
+    }
+
+    outstanding_--;
+    if (last->status == SDO_TIMEOUT) {
+      DBG_OUTPUT_PORT.printf("Parameter snapshot: read of %u timed out\n", paramIdOf(*last));
+      finish(false);
+      return;
+    }
+    if (last->status == SDO_ABORTED) {
+      skipped_++;
+    } else {
+      entries_.push_back({paramIdOf(*last), (int32_t)last->data});
+    }
+
+    if (outstanding_ == 0) {
+      std::sort(entries_.begin(), entries_.end(),
+                [](const ParamSnapshotEntry& a, const ParamSnapshotEntry& b) { return a.paramId < b.paramId; });
+      bool saved = DeviceStorage::saveParamSnapshot(serial_, entries_);
+      DBG_OUTPUT_PORT.printf("Parameter snapshot of %s: %u saved, %u skipped%s\n", serial_.c_str(),
+                             (unsigned)entries_.size(), (unsigned)skipped_, saved ? "" : " (write failed)");
+      finish(saved);
+    }
+  }
+
+  void buildResult(CANEvent& evt) override {
+    evt.data.paramsSnapshot.success = succeeded();
+    evt.data.paramsSnapshot.count = entries_.size();
+    evt.data.paramsSnapshot.skipped = skipped_;
+  }
+
+private:
+  std::vector<uint16_t> paramIds_;
+  String serial_;
+  std::vector<ParamSnapshotEntry> entries_;
+  int outstanding_ = 0;  // Reads queued, completion not seen yet
+  uint16_t skipped_ = 0;
+};
+
+// Writes a parameter snapshot back to the connected node. All writes are queued at once and
+// pipelined; each parameter the node refuses is reported, a timeout ends the restore.
+class RestoreParamsOperation : public SdoOperation {
+public:
+  RestoreParamsOperation(std::vector<ParamSnapshotEntry> entries, bool found)
+      : SdoOperation(EVT_PARAMS_RESTORED), entries_(std::move(entries)), found_(found) {}
+
+  const char* name() const override { return "RestoreParams"; }
+
+  void resume(const SdoCompletion* last) override {
+    if (last == nullptr) {
+      if (!found_) {
+        finish(false);
+        return;
+      }
+      for (const ParamSnapshotEntry& entry : entries_) {
+        write(SDOProtocol::INDEX_PARAM_UID | (entry.paramId >> 8), entry.paramId & 0xFF, (uint32_t)entry.value);
+      }
+      outstanding_ = entries_.size();
+      if (outstanding_ == 0) {
+        finish(true);
+      }
+      return;
+    }
+
+    outstanding_--;
+    SetValueResult result = SDOProtocol::toSetValueResult(*last);
+    if (result == SET_OK) {
+      written_++;
+    } else {
+      failures_.push_back({paramIdOf(*last), result});
+    }
+
+    if (last->status == SDO_TIMEOUT) {
+      DBG_OUTPUT_PORT.printf("Parameter restore: write of %u timed out\n", paramIdOf(*last));
+      finish(false);
+    } else if (outstanding_ == 0) {
+      DBG_OUTPUT_PORT.printf("Parameter restore: %u written, %u refused\n", (unsigned)written_,
+                             (unsigned)failures_.size());
+      finish(failures_.empty());
+    }
+  }
+
+  void buildResult(CANEvent& evt) override {
+    ParamsRestoredEvent& restored = evt.data.paramsRestored;
+    restored.success = succeeded();
+    restored.found = found_;
+    restored.written = written_;
+    restored.failed = failures_.size();
+    restored.failuresJson = nullptr;
+    if (failures_.empty()) {
+      return;
+    }
+
+    std::map<int, String> names = buildParamNameMap();
+    JsonDocument doc;
+    JsonArray failures = doc.to<JsonArray>();
+    for (const Failure& failure : failures_) {
+      JsonObject obj = failures.add<JsonObject>();
+      obj["id"] = failure.paramId;
+      if (names.count(failure.paramId) > 0) {
+        obj["name"] = names.at(failure.paramId);
+      }
+      obj["error"] = describeSetValueResult(failure.result);
+    }
+    restored.failuresJson = serializeToHeap(doc);
+  }
+
+private:
+  struct Failure {
+    uint16_t paramId;
+    SetValueResult result;
+  };
+
+  std::vector<ParamSnapshotEntry> entries_;
+  bool found_;
+  std::vector<Failure> failures_;
+  int outstanding_ = 0;  // Writes queued, completion not seen yet
+  uint16_t written_ = 0;
+};
+
+bool StartOperation(const CANCommand& cmd) {
+  std::unique_ptr<SdoOperation> operation;
+
+  switch (cmd.type) {
+    case CMD_SAVE_TO_FLASH:
+      operation.reset(new DeviceCommandOperation("SaveToFlash", EVT_FLASH_SAVED, SDOProtocol::CMD_SAVE));
+      break;
+    case CMD_LOAD_FROM_FLASH:
+      operation.reset(new DeviceCommandOperation("LoadFromFlash", EVT_FLASH_LOADED, SDOProtocol::CMD_LOAD));
+      break;
+    case CMD_LOAD_DEFAULTS:
+      operation.reset(new DeviceCommandOperation("LoadDefaults", EVT_DEFAULTS_LOADED, SDOProtocol::CMD_DEFAULTS));
+      break;
+    case CMD_START_DEVICE:
+      operation.reset(new DeviceCommandOperation("StartDevice", EVT_DEVICE_STARTED, SDOProtocol::CMD_START,
+                                                 cmd.data.startDevice.mode));
+      break;
+    case CMD_STOP_DEVICE:
+      operation.reset(new DeviceCommandOperation("StopDevice", EVT_DEVICE_STOPPED, SDOProtocol::CMD_STOP));
+      break;
+    case CMD_RESET_DEVICE:
+      operation.reset(new ResetDeviceOperation());
+      break;
+    case CMD_SET_VALUE:
+      operation.reset(new SetValueOperation(cmd.data.setValue));
+      break;
+    case CMD_CLEAR_CAN_MAP:
+      operation.reset(new ClearCanMapOperation(cmd.data.clearCanMap.isRx));
+      break;
+    case CMD_GET_CAN_MAPPINGS:
+      operation.reset(new GetCanMappingsOperation(cmd.data.getCanMappings.refresh));
+      break;
+    case CMD_ADD_CAN_MAPPING:
+      operation.reset(new AddCanMappingOperation(cmd.data.addCanMapping));
+      break;
+    case CMD_REMOVE_CAN_MAPPING:
+      operation.reset(new RemoveCanMappingOperation(cmd.data.removeCanMapping));
+      break;
+    case CMD_LIST_ERRORS:
+      operation.reset(new ListErrorsOperation(cmd.data.listErrors.incremental));
+      break;
+    case CMD_IMPORT_CAN_MAP: {
+      const ImportCanMapCommand& import = cmd.data.importCanMap;
+      std::vector<CanMappingData> mappings(import.mappings, import.mappings + import.count);
+      free(import.mappings);
+      operation.reset(new ImportCanMapOperation(std::move(mappings)));
+      break;
+    }
+    case CMD_SNAPSHOT_PARAMS:
+      operation.reset(new SnapshotParamsOperation(collectParamIds()));
+      break;
+    case CMD_RESTORE_PARAMS: {
+      const char* serial = cmd.data.restoreParams.serial;
+      std::vector<ParamSnapshotEntry> entries;
+      bool found = DeviceStorage::loadParamSnapshot(serial[0] != '\0' ? String(serial) : conn.getSerial(), entries);
+      operation.reset(new RestoreParamsOperation(std::move(entries), found));
+      break;
+    }
+    default:
+      DBG_OUTPUT_PORT.printf("Command %d is not a device operation\n", cmd.type);
+      return false;
+  }
+
+  return SdoOperationManager::instance().submit(std::move(operation), cmd);
 }
 
 bool SendCanMessage(uint32_t canId, const uint8_t* data, uint8_t dataLength) {
@@ -627,8 +1321,8 @@ bool SendCanMessage(uint32_t canId, const uint8_t* data, uint8_t dataLength) {
     frame.data[i] = 0;
   }
 
-  // Send the message via TX queue
-  if (canQueueTransmit(&frame, pdMS_TO_TICKS(10))) {
+  // Send the message via the control TX class (interval, CAN-IO and user frames)
+  if (canQueueTransmit(&frame, pdMS_TO_TICKS(10), CAN_TX_CONTROL)) {
     DBG_OUTPUT_PORT.printf("Sent CAN message: ID=0x%03lX, Len=%d\n", (unsigned long)canId, dataLength);
     return true;
   } else {
@@ -675,7 +1369,8 @@ static bool streamParameterValues(const std::vector<int>& ids, int samples, Stre
 
     // Collect all responses for this sample
     int itemIdx = 0;
-    while (SDOProtocol::waitForResponse(&rxframe, pdMS_TO_TICKS(10))) {
+    // Several requests outstanding, so the wait is bounded by the RTO but not sampled
+    while (SDOProtocol::waitForResponse(&rxframe, SDOProtocol::responseTimeout(conn.getNodeId()))) {
       double value = 0;
       if (rxframe.data[0] != 0x80) {
         int receivedItem = (rxframe.data[1] << 8) + rxframe.data[3];
@@ -790,23 +1485,6 @@ bool ReloadJson(uint8_t nodeId) {
   }
 }
 
-bool ResetDevice() {
-  if (!conn.isIdle())
-    return false;
-
-  // Send reset command to the device
-  SDOProtocol::setValue(conn.getNodeId(), SDOProtocol::INDEX_COMMANDS, SDOProtocol::CMD_RESET, 1U);
-
-  DBG_OUTPUT_PORT.println("Device reset command sent");
-
-  // The device will reset immediately and won't send an acknowledgment
-  // After a short delay, trigger serial re-acquisition
-  delay(500);  // Give device time to start resetting
-  conn.startSerialAcquisition();
-
-  return true;
-}
-
 // Device management functions
 
 String ScanDevices(uint8_t startNodeId, uint8_t endNodeId) {
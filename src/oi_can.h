@@ -20,17 +20,13 @@
  */
 #pragma once
 
-#include <WiFiClient.h>
-
-#include <functional>
+#include <Arduino.h>
 
+#include "models/can_command.h"
 #include "models/can_types.h"
 
 namespace OICan {
 
-// Callback type for ClearCanMap progress
-typedef std::function<void(int removedCount)> ClearMapProgressCallback;
-enum SetResult { Ok, UnknownIndex, ValueOutOfRange, CommError };
 // BaudRate is defined in models/can_types.h
 using ::Baud125k;
 using ::Baud250k;
@@ -39,32 +35,23 @@ using ::BaudRate;
 
 void InitCAN(BaudRate baud, int txPin, int rxPin);               // Initialize CAN bus only
 void Init(uint8_t nodeId, BaudRate baud, int txPin, int rxPin);  // Initialize and connect to device
-bool SendJson(WiFiClient c);
 String GetRawJson();                // Get parameter JSON from currently connected device
 String GetRawJson(uint8_t nodeId);  // Get parameter JSON from specific device by nodeId
-void SendCanMapping(WiFiClient c);
-String GetCanMapping();  // Get CAN mappings as JSON string
-SetResult AddCanMapping(String json);
-SetResult RemoveCanMapping(String json);
-SetResult SetValue(int paramId, double value);
 bool RequestValue(int paramId);  // Send SDO request without waiting (async, non-blocking with rate limiting, returns
                                  // false if TX queue full)
 bool TryGetValueResponse(int& outParamId, double& outValue, int timeoutMs);  // Try to receive response (async)
 void SetParameterRequestRateLimit(
     unsigned long intervalUs);  // Configure minimum interval between parameter requests (default: 500us)
-bool SaveToFlash();
-bool LoadFromFlash();
-bool LoadDefaults();
-bool StartDevice(uint32_t mode = 0);
-bool StopDevice();
-bool ClearCanMap(bool isRx, ClearMapProgressCallback onProgress = nullptr);
-String ListErrors();
+// Device operations (save/load/defaults/start/stop/reset, SetValue, CAN map get/add/remove/clear/import,
+// ListErrors, parameter snapshot/restore) run as resumable state machines in canTask (see
+// SdoOperationManager). canTask only; the result event is tagged with cmd.requestId and
+// cmd.clientId. False if refused (the failure result is still posted).
+bool StartOperation(const CANCommand& cmd);
 bool SendCanMessage(uint32_t canId, const uint8_t* data, uint8_t dataLength);  // Send arbitrary CAN message
 String StreamValues(String paramIds, int samples);
 int StartUpdate(String fileName);
 bool ReloadJson();                // Reload JSON for currently connected device
 bool ReloadJson(uint8_t nodeId);  // Reload JSON for specific device by nodeId
-bool ResetDevice();
 
 // Device management functions
 String ScanDevices(uint8_t startNodeId, uint8_t endNodeId);
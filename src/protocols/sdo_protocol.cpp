@@ -25,20 +25,12 @@
 #include "Arduino.h"
 
 #include "models/can_types.h"
+#include "protocols/sdo_rtt_estimator.h"
+#include "protocols/sdo_transaction_table.h"
 #include "utils/can_queue.h"
 
 namespace SDOProtocol {
 
-// Pending write tracking for async response matching
-static struct {
-  bool active = false;
-  uint16_t index = 0;
-  uint8_t subIndex = 0;
-  int paramId = 0;
-  double value = 0;
-  uint32_t timestamp = 0;
-} pendingWrite;
-
 // SDO Request/Response Constants
 const uint8_t REQUEST_DOWNLOAD = (1 << 5);
 const uint8_t REQUEST_UPLOAD = (2 << 5);
@@ -54,10 +46,22 @@ const uint8_t ABORT = 0x80;
 const uint8_t WRITE_REPLY = RESPONSE_DOWNLOAD;
 const uint8_t READ_REPLY = (RESPONSE_UPLOAD | EXPEDITED | SIZE_SPECIFIED);
 
+// SDO Block Upload Constants
+const uint8_t REQUEST_BLOCK_UPLOAD = (5 << 5);
+const uint8_t RESPONSE_BLOCK_UPLOAD = (6 << 5);
+const uint8_t BLOCK_CRC_SUPPORTED = (1 << 2);
+const uint8_t BLOCK_SIZE_INDICATED = (1 << 1);
+const uint8_t BLOCK_UPLOAD_END = 1;
+const uint8_t BLOCK_UPLOAD_ACK = 2;
+const uint8_t BLOCK_UPLOAD_START = 3;
+const uint8_t BLOCK_LAST_SEGMENT = 0x80;
+
 // SDO Error Codes
 const uint32_t ERR_INVIDX = 0x06020000;
 const uint32_t ERR_RANGE = 0x06090030;
 const uint32_t ERR_GENERAL = 0x08000000;
+const uint32_t ERR_COMMAND = 0x05040001;
+const uint32_t ERR_CRC = 0x05040004;
 
 // SDO Indexes
 const uint16_t INDEX_PARAMS = 0x2000;
@@ -98,7 +102,7 @@ void requestElement(uint8_t nodeId, uint16_t index, uint8_t subIndex) {
   canQueueTransmit(&tx_frame, pdMS_TO_TICKS(10));
 }
 
-bool requestElementNonBlocking(uint8_t nodeId, uint16_t index, uint8_t subIndex) {
+bool requestElementNonBlocking(uint8_t nodeId, uint16_t index, uint8_t subIndex, CanTxPriority priority) {
   twai_message_t tx_frame;
   tx_frame.extd = false;
   tx_frame.identifier = SDO_REQUEST_BASE_ID | nodeId;
@@ -113,7 +117,7 @@ bool requestElementNonBlocking(uint8_t nodeId, uint16_t index, uint8_t subIndex)
   tx_frame.data[7] = 0;
 
   // Non-blocking transmit (timeout = 0)
-  return canQueueTransmit(&tx_frame, 0);
+  return canQueueTransmit(&tx_frame, 0, priority);
 }
 
 void setValue(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value) {
@@ -147,167 +151,89 @@ void requestNextSegment(uint8_t nodeId, bool toggleBit) {
   canQueueTransmit(&tx_frame, pdMS_TO_TICKS(10));
 }
 
-bool waitForResponse(twai_message_t* response, TickType_t timeout) {
-  return canQueueReceive(response, timeout);
-}
+void abortTransfer(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t abortCode) {
+  twai_message_t tx_frame;
+  tx_frame.extd = false;
+  tx_frame.identifier = SDO_REQUEST_BASE_ID | nodeId;
+  tx_frame.data_length_code = 8;
+  tx_frame.data[0] = ABORT;
+  tx_frame.data[1] = index & 0xFF;
+  tx_frame.data[2] = index >> 8;
+  tx_frame.data[3] = subIndex;
+  *(uint32_t*)&tx_frame.data[4] = abortCode;
 
-void clearPendingResponses() {
-  canQueueClearResponses();
+  canQueueTransmit(&tx_frame, pdMS_TO_TICKS(10));
 }
 
-// SDO Write-and-Wait Helpers
-
-bool writeAndWait(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value, twai_message_t* response,
-                  TickType_t timeout) {
-  // Note: Spot value responses are now routed directly to SpotValuesManager,
-  // but other SDO responses may still appear (device connection, scan, etc.)
-  // We loop through responses looking for one that matches our index/subindex
-  setValue(nodeId, index, subIndex, value);
-
-  TickType_t startTick = xTaskGetTickCount();
-  TickType_t remainingTimeout = timeout;
-
-  while (remainingTimeout > 0) {
-    if (!waitForResponse(response, remainingTimeout)) {
-      // Timeout - zero-initialize so caller can distinguish timeout from abort
-      memset(response, 0, sizeof(twai_message_t));
-      return false;
-    }
-
-    // Check if this response matches our request (same index/subindex)
-    uint16_t respIndex = response->data[1] | (response->data[2] << 8);
-    uint8_t respSubIndex = response->data[3];
-
-    if (respIndex == index && respSubIndex == subIndex) {
-      // This response is for our request
-      return response->data[0] != ABORT;
-    }
-
-    // Response was for a different request, keep waiting
-    // Update remaining timeout
-    TickType_t elapsed = xTaskGetTickCount() - startTick;
-    remainingTimeout = (elapsed < timeout) ? (timeout - elapsed) : 0;
-  }
+// SDO Block Upload Functions
 
-  // Timeout while waiting for matching response
-  memset(response, 0, sizeof(twai_message_t));
-  return false;
-}
+void requestBlockUpload(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint8_t blockSize) {
+  twai_message_t tx_frame;
+  tx_frame.extd = false;
+  tx_frame.identifier = SDO_REQUEST_BASE_ID | nodeId;
+  tx_frame.data_length_code = 8;
+  tx_frame.data[0] = REQUEST_BLOCK_UPLOAD | BLOCK_CRC_SUPPORTED;
+  tx_frame.data[1] = index & 0xFF;
+  tx_frame.data[2] = index >> 8;
+  tx_frame.data[3] = subIndex;
+  tx_frame.data[4] = blockSize;
+  tx_frame.data[5] = 0;  // Protocol switch threshold: never switch to segmented
+  tx_frame.data[6] = 0;
+  tx_frame.data[7] = 0;
 
-bool writeAndWait(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value, TickType_t timeout) {
-  twai_message_t response;
-  return writeAndWait(nodeId, index, subIndex, value, &response, timeout);
+  canQueueTransmit(&tx_frame, pdMS_TO_TICKS(10));
 }
 
-// SDO Request-and-Wait Helpers
-
-bool requestAndWait(uint8_t nodeId, uint16_t index, uint8_t subIndex, twai_message_t* response, TickType_t timeout) {
-  clearPendingResponses();
-  requestElement(nodeId, index, subIndex);
-
-  if (!waitForResponse(response, timeout)) {
-    // Zero-initialize on timeout so caller can distinguish timeout from abort
-    memset(response, 0, sizeof(twai_message_t));
-    return false;
-  }
+void sendBlockUploadCommand(uint8_t nodeId, uint8_t subCommand, uint8_t ackSequence, uint8_t blockSize) {
+  twai_message_t tx_frame;
+  tx_frame.extd = false;
+  tx_frame.identifier = SDO_REQUEST_BASE_ID | nodeId;
+  tx_frame.data_length_code = 8;
+  tx_frame.data[0] = REQUEST_BLOCK_UPLOAD | subCommand;
+  tx_frame.data[1] = ackSequence;
+  tx_frame.data[2] = blockSize;
+  tx_frame.data[3] = 0;
+  tx_frame.data[4] = 0;
+  tx_frame.data[5] = 0;
+  tx_frame.data[6] = 0;
+  tx_frame.data[7] = 0;
 
-  return response->data[0] != ABORT;
+  canQueueTransmit(&tx_frame, pdMS_TO_TICKS(10));
 }
 
-bool requestValue(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t* outValue, TickType_t timeout) {
-  twai_message_t response;
-
-  if (!requestAndWait(nodeId, index, subIndex, &response, timeout)) {
-    return false;
+uint16_t blockCrc(const uint8_t* data, size_t length, uint16_t crc) {
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
   }
-
-  *outValue = *(uint32_t*)&response.data[4];
-  return true;
+  return crc;
 }
 
-// Async write support - non-blocking parameter updates
-
-bool setValueAsync(uint8_t nodeId, int paramId, double value) {
-  if (pendingWrite.active) {
-    return false;  // Already have a pending write
-  }
-
-  uint16_t index = INDEX_PARAM_UID | (paramId >> 8);
-  uint8_t subIndex = paramId & 0xFF;
-
-  // Register the pending write
-  pendingWrite.active = true;
-  pendingWrite.index = index;
-  pendingWrite.subIndex = subIndex;
-  pendingWrite.paramId = paramId;
-  pendingWrite.value = value;
-  pendingWrite.timestamp = millis();
-
-  Serial.printf("[SDO] setValueAsync: nodeId=%d, paramId=%d, index=0x%04X, subIndex=%d, value=%.2f\n", nodeId, paramId,
-                index, subIndex, value);
-
-  // Send the write (non-blocking)
-  setValue(nodeId, index, subIndex, (uint32_t)(value * 32));
-  return true;
+bool waitForResponse(twai_message_t* response, TickType_t timeout) {
+  return canQueueReceive(response, timeout);
 }
 
-bool hasPendingWrite() {
-  return pendingWrite.active;
+void clearPendingResponses() {
+  canQueueClearResponses();
 }
 
-bool matchPendingWrite(uint16_t respIndex, uint8_t respSubIndex, bool isAbort, uint32_t errorCode, int& outParamId,
-                       double& outValue, SetValueResult& outResult) {
-  if (!pendingWrite.active) {
-    return false;
-  }
-
-  Serial.printf("[SDO] matchPendingWrite: resp=0x%04X/%d, pending=0x%04X/%d, isAbort=%d\n", respIndex, respSubIndex,
-                pendingWrite.index, pendingWrite.subIndex, isAbort);
-
-  // Check if response matches our pending write
-  if (respIndex != pendingWrite.index || respSubIndex != pendingWrite.subIndex) {
-    return false;
-  }
-
-  // Match found - extract info and clear pending
-  outParamId = pendingWrite.paramId;
-  outValue = pendingWrite.value;
-
-  if (isAbort) {
-    if (errorCode == ERR_RANGE) {
-      outResult = SetValueResult::SET_VALUE_OUT_OF_RANGE;
-    } else {
-      outResult = SetValueResult::SET_UNKNOWN_INDEX;
-    }
-  } else {
-    outResult = SetValueResult::SET_OK;
-  }
-
-  pendingWrite.active = false;
-  return true;
+// Bound on the wait for a node's response: its current RTO (SdoRttEstimator)
+TickType_t responseTimeout(uint8_t nodeId) {
+  return SdoRttEstimator::instance().getTimeoutTicks(nodeId);
 }
 
-bool checkPendingWriteTimeout(int& outParamId, double& outValue, SetValueResult& outResult) {
-  if (!pendingWrite.active) {
-    return false;
+SetValueResult toSetValueResult(const SdoCompletion& completion) {
+  switch (completion.status) {
+    case SDO_OK:
+      return SetValueResult::SET_OK;
+    case SDO_ABORTED:
+      return completion.data == ERR_RANGE ? SetValueResult::SET_VALUE_OUT_OF_RANGE : SetValueResult::SET_UNKNOWN_INDEX;
+    case SDO_TIMEOUT:
+    default:
+      return SetValueResult::SET_COMM_ERROR;
   }
-
-  const uint32_t TIMEOUT_MS = 500;
-  if ((millis() - pendingWrite.timestamp) >= TIMEOUT_MS) {
-    Serial.printf("[SDO] Pending write TIMEOUT: paramId=%d, index=0x%04X, subIndex=%d\n", pendingWrite.paramId,
-                  pendingWrite.index, pendingWrite.subIndex);
-    outParamId = pendingWrite.paramId;
-    outValue = pendingWrite.value;
-    outResult = SetValueResult::SET_COMM_ERROR;
-    pendingWrite.active = false;
-    return true;
-  }
-
-  return false;
-}
-
-void clearPendingWrite() {
-  pendingWrite.active = false;
 }
 
 }  // namespace SDOProtocol
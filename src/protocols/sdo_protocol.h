@@ -20,11 +20,14 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "driver/twai.h"
 #include "models/can_types.h"
 
+struct SdoCompletion;
+
 namespace SDOProtocol {
 
 // SDO Request/Response Constants
@@ -42,10 +45,22 @@ extern const uint8_t ABORT;
 extern const uint8_t WRITE_REPLY;
 extern const uint8_t READ_REPLY;
 
+// SDO Block Upload Constants (CiA 301)
+extern const uint8_t REQUEST_BLOCK_UPLOAD;   // Client command specifier 5
+extern const uint8_t RESPONSE_BLOCK_UPLOAD;  // Server command specifier 6
+extern const uint8_t BLOCK_CRC_SUPPORTED;
+extern const uint8_t BLOCK_SIZE_INDICATED;
+extern const uint8_t BLOCK_UPLOAD_END;    // Subcommands in bits 1:0
+extern const uint8_t BLOCK_UPLOAD_ACK;
+extern const uint8_t BLOCK_UPLOAD_START;
+extern const uint8_t BLOCK_LAST_SEGMENT;  // Set in the sequence byte of the final segment
+
 // SDO Error Codes
 extern const uint32_t ERR_INVIDX;
 extern const uint32_t ERR_RANGE;
 extern const uint32_t ERR_GENERAL;
+extern const uint32_t ERR_COMMAND;
+extern const uint32_t ERR_CRC;
 
 // SDO Indexes
 extern const uint16_t INDEX_PARAMS;
@@ -69,41 +84,27 @@ extern const uint8_t CMD_STOP;
 
 // SDO Request Functions
 void requestElement(uint8_t nodeId, uint16_t index, uint8_t subIndex);
-bool requestElementNonBlocking(uint8_t nodeId, uint16_t index, uint8_t subIndex);
+bool requestElementNonBlocking(uint8_t nodeId, uint16_t index, uint8_t subIndex, CanTxPriority priority = CAN_TX_SDO);
 void setValue(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value);
 void requestNextSegment(uint8_t nodeId, bool toggleBit);
+void abortTransfer(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t abortCode);
+
+// SDO Block Upload Functions
+// Initiate with CRC support and the number of segments the node may send per block
+void requestBlockUpload(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint8_t blockSize);
+// Start, end response, or ack of the last in-order segment (the node resends the rest)
+void sendBlockUploadCommand(uint8_t nodeId, uint8_t subCommand, uint8_t ackSequence = 0, uint8_t blockSize = 0);
+// CRC-16/XMODEM (polynomial 0x1021, initial 0) as used by block transfers; chainable
+uint16_t blockCrc(const uint8_t* data, size_t length, uint16_t crc = 0);
 
 // SDO Response Functions (queue-based)
 bool waitForResponse(twai_message_t* response, TickType_t timeout);
 void clearPendingResponses();
 
-// SDO Write-and-Wait Helpers
-// Combines: clearPendingResponses, setValue, waitForResponse, check for ABORT
-// Returns true if write succeeded (response received and not aborted)
-bool writeAndWait(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value,
-                  TickType_t timeout = pdMS_TO_TICKS(10));
-
-// Version that also returns the response frame for error code inspection
-bool writeAndWait(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value, twai_message_t* response,
-                  TickType_t timeout = pdMS_TO_TICKS(10));
-
-// SDO Request-and-Wait Helpers
-// Combines: clearPendingResponses, requestElement, waitForResponse, check for ABORT
-// Returns true if read succeeded (response received and not aborted)
-bool requestAndWait(uint8_t nodeId, uint16_t index, uint8_t subIndex, twai_message_t* response,
-                    TickType_t timeout = pdMS_TO_TICKS(10));
-
-// Convenience version that extracts the 32-bit value directly
-bool requestValue(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t* outValue,
-                  TickType_t timeout = pdMS_TO_TICKS(10));
+// Bound on the wait for nodeId's response: its current RTO (SdoRttEstimator)
+TickType_t responseTimeout(uint8_t nodeId);
 
-// Async write support - non-blocking parameter updates
-// The CAN task monitors for responses and fires events when matched
-bool setValueAsync(uint8_t nodeId, int paramId, double value);
-bool hasPendingWrite();
-bool matchPendingWrite(uint16_t respIndex, uint8_t respSubIndex, bool isAbort, uint32_t errorCode,
-                       int& outParamId, double& outValue, SetValueResult& outResult);
-bool checkPendingWriteTimeout(int& outParamId, double& outValue, SetValueResult& outResult);
-void clearPendingWrite();
+// Result of a parameter write (abort code ERR_RANGE = out of range, other aborts = unknown index)
+SetValueResult toSetValueResult(const SdoCompletion& completion);
 
 }  // namespace SDOProtocol
@@ -0,0 +1,117 @@
+#include "sdo_rtt_estimator.h"
+
+SdoRttEstimator& SdoRttEstimator::instance() {
+  static SdoRttEstimator instance;
+  return instance;
+}
+
+void SdoRttEstimator::update(Estimate& estimate, uint32_t rttUs) {
+  if (estimate.samples == 0) {
+    estimate.srttUs = rttUs;
+    estimate.rttVarUs = rttUs / 2;
+    estimate.minRttUs = rttUs;
+    estimate.maxRttUs = rttUs;
+  } else {
+    // RTTVAR first, from the SRTT before this sample (alpha = 1/8, beta = 1/4)
+    uint32_t deviation = rttUs > estimate.srttUs ? rttUs - estimate.srttUs : estimate.srttUs - rttUs;
+    estimate.rttVarUs = (3 * estimate.rttVarUs + deviation) / 4;
+    estimate.srttUs = (7 * estimate.srttUs + rttUs) / 8;
+    estimate.minRttUs = rttUs < estimate.minRttUs ? rttUs : estimate.minRttUs;
+    estimate.maxRttUs = rttUs > estimate.maxRttUs ? rttUs : estimate.maxRttUs;
+  }
+  estimate.lastRttUs = rttUs;
+  estimate.samples++;
+}
+
+uint32_t SdoRttEstimator::timeoutMs(const Estimate& estimate, uint8_t backoff) {
+  uint32_t rtoMs = SDO_RTO_INITIAL_MS;
+  if (estimate.samples > 0) {
+    uint32_t varianceUs = 4 * estimate.rttVarUs;
+    if (varianceUs < SDO_RTT_GRANULARITY_US) {
+      varianceUs = SDO_RTT_GRANULARITY_US;
+    }
+    rtoMs = (estimate.srttUs + varianceUs + 999) / 1000;
+    if (rtoMs < SDO_RTO_MIN_MS) {
+      rtoMs = SDO_RTO_MIN_MS;
+    }
+  }
+  rtoMs <<= backoff;
+  return rtoMs > SDO_RTO_MAX_MS ? SDO_RTO_MAX_MS : rtoMs;
+}
+
+// A node that never answered borrows the bus-wide estimate
+const SdoRttEstimator::Estimate& SdoRttEstimator::baseLocked(uint8_t nodeId) const {
+  return nodes_[nodeId].samples > 0 ? nodes_[nodeId] : bus_;
+}
+
+void SdoRttEstimator::addSample(uint8_t nodeId, uint32_t rttUs) {
+  if (nodeId >= NODE_COUNT) {
+    return;
+  }
+  portENTER_CRITICAL(&mux_);
+  update(nodes_[nodeId], rttUs);
+  nodes_[nodeId].backoff = 0;
+  update(bus_, rttUs);
+  portEXIT_CRITICAL(&mux_);
+}
+
+void SdoRttEstimator::onTimeout(uint8_t nodeId) {
+  if (nodeId >= NODE_COUNT) {
+    return;
+  }
+  portENTER_CRITICAL(&mux_);
+  Estimate& node = nodes_[nodeId];
+  node.timeouts++;
+  if (node.backoff < SDO_RTO_MAX_BACKOFF) {
+    node.backoff++;
+  }
+  bus_.timeouts++;
+  portEXIT_CRITICAL(&mux_);
+}
+
+uint32_t SdoRttEstimator::getTimeoutMs(uint8_t nodeId) const {
+  if (nodeId >= NODE_COUNT) {
+    return SDO_RTO_INITIAL_MS;
+  }
+  portENTER_CRITICAL(&mux_);
+  uint32_t rtoMs = timeoutMs(baseLocked(nodeId), nodes_[nodeId].backoff);
+  portEXIT_CRITICAL(&mux_);
+  return rtoMs;
+}
+
+TickType_t SdoRttEstimator::getTimeoutTicks(uint8_t nodeId) const {
+  TickType_t ticks = pdMS_TO_TICKS(getTimeoutMs(nodeId));
+  return ticks > 0 ? ticks : 1;
+}
+
+SdoRttStats SdoRttEstimator::toStats(const Estimate& estimate, uint8_t backoff, uint32_t rtoMs) {
+  SdoRttStats stats;
+  stats.samples = estimate.samples;
+  stats.srttUs = estimate.srttUs;
+  stats.rttVarUs = estimate.rttVarUs;
+  stats.lastRttUs = estimate.lastRttUs;
+  stats.minRttUs = estimate.minRttUs;
+  stats.maxRttUs = estimate.maxRttUs;
+  stats.timeouts = estimate.timeouts;
+  stats.backoff = backoff;
+  stats.rtoMs = rtoMs;
+  return stats;
+}
+
+SdoRttStats SdoRttEstimator::getStats(uint8_t nodeId) const {
+  if (nodeId >= NODE_COUNT) {
+    return SdoRttStats();
+  }
+  portENTER_CRITICAL(&mux_);
+  const Estimate& node = nodes_[nodeId];
+  SdoRttStats stats = toStats(node, node.backoff, timeoutMs(baseLocked(nodeId), node.backoff));
+  portEXIT_CRITICAL(&mux_);
+  return stats;
+}
+
+SdoRttStats SdoRttEstimator::getBusStats() const {
+  portENTER_CRITICAL(&mux_);
+  SdoRttStats stats = toStats(bus_, 0, timeoutMs(bus_, 0));
+  portEXIT_CRITICAL(&mux_);
+  return stats;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+#include "freertos/FreeRTOS.h"
+
+// Retransmission timeout (RTO) bounds, and the RTO used before any round trip was measured
+#define SDO_RTO_MIN_MS 5
+#define SDO_RTO_MAX_MS 1000
+#define SDO_RTO_INITIAL_MS 100
+// Consecutive timeouts that each double a node's RTO (up to x16)
+#define SDO_RTO_MAX_BACKOFF 4
+// Lower bound of the variance term, so a perfectly steady RTT still leaves scheduling slack
+#define SDO_RTT_GRANULARITY_US 1000
+
+struct SdoRttStats {
+  uint32_t samples = 0;
+  uint32_t srttUs = 0;    // Smoothed round-trip time
+  uint32_t rttVarUs = 0;  // Smoothed mean deviation
+  uint32_t lastRttUs = 0;
+  uint32_t minRttUs = 0;
+  uint32_t maxRttUs = 0;
+  uint32_t timeouts = 0;
+  uint8_t backoff = 0;  // RTO doublings currently applied
+  uint32_t rtoMs = 0;   // Timeout in use, backoff included
+};
+
+/**
+ * Per-node SDO round-trip time estimator (RFC 6298 style).
+ *
+ * Each answered request that was sent exactly once adds a sample (Karn's algorithm: a
+ * response to a repeated request could belong to either copy, so callers must not sample
+ * those). From the samples it keeps a smoothed RTT and mean deviation and derives the
+ * timeout as SRTT + 4 * RTTVAR, clamped to [SDO_RTO_MIN_MS, SDO_RTO_MAX_MS]. Every timeout
+ * doubles the node's RTO until the next valid sample.
+ *
+ * All samples also feed a bus-wide estimate, used for nodes that have never answered
+ * (e.g. while scanning).
+ *
+ * Safe to call from any task, including the RX task.
+ */
+class SdoRttEstimator {
+public:
+  static SdoRttEstimator& instance();
+
+  void addSample(uint8_t nodeId, uint32_t rttUs);
+  void onTimeout(uint8_t nodeId);
+
+  uint32_t getTimeoutMs(uint8_t nodeId) const;
+  TickType_t getTimeoutTicks(uint8_t nodeId) const;  // At least one tick
+
+  SdoRttStats getStats(uint8_t nodeId) const;
+  SdoRttStats getBusStats() const;
+
+private:
+  SdoRttEstimator() = default;
+  SdoRttEstimator(const SdoRttEstimator&) = delete;
+  SdoRttEstimator& operator=(const SdoRttEstimator&) = delete;
+
+  static const uint8_t NODE_COUNT = 128;  // CANopen node IDs 1-127 (0 unused)
+
+  struct Estimate {
+    uint32_t samples = 0;
+    uint32_t srttUs = 0;
+    uint32_t rttVarUs = 0;
+    uint32_t lastRttUs = 0;
+    uint32_t minRttUs = 0;
+    uint32_t maxRttUs = 0;
+    uint16_t timeouts = 0;
+    uint8_t backoff = 0;
+  };
+
+  static void update(Estimate& estimate, uint32_t rttUs);
+  static uint32_t timeoutMs(const Estimate& estimate, uint8_t backoff);
+  static SdoRttStats toStats(const Estimate& estimate, uint8_t backoff, uint32_t rtoMs);
+  const Estimate& baseLocked(uint8_t nodeId) const;
+
+  Estimate nodes_[NODE_COUNT];
+  Estimate bus_;
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
@@ -0,0 +1,267 @@
+#include "sdo_transaction_table.h"
+
+#include <Arduino.h>
+
+#include <cstring>
+
+#include "can_task.h"
+
+#include "protocols/sdo_protocol.h"
+#include "protocols/sdo_rtt_estimator.h"
+#include "utils/can_queue.h"
+#include "utils/can_router.h"
+#include "utils/deadline.h"
+
+#define DBG_OUTPUT_PORT Serial
+
+SdoTransactionTable& SdoTransactionTable::instance() {
+  static SdoTransactionTable instance;
+  return instance;
+}
+
+void SdoTransactionTable::registerCanRoutes() {
+  CanRouter::instance().addSdoMatcher([this](const twai_message_t& frame) { return matchResponse(frame); });
+}
+
+bool SdoTransactionTable::startRead(uint8_t nodeId, uint16_t index, uint8_t subIndex, CompletionCallback onComplete,
+                                    uint32_t timeoutMs, CanTxPriority priority) {
+  return start(nodeId, index, subIndex, false, 0, onComplete, timeoutMs, priority);
+}
+
+bool SdoTransactionTable::startWrite(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value,
+                                     CompletionCallback onComplete, uint32_t timeoutMs, CanTxPriority priority) {
+  return start(nodeId, index, subIndex, true, value, onComplete, timeoutMs, priority);
+}
+
+int SdoTransactionTable::findLocked(uint8_t nodeId, uint16_t index, uint8_t subIndex) const {
+  for (int i = 0; i < SDO_MAX_TRANSACTIONS; i++) {
+    const Slot& slot = slots_[i];
+    if (slot.state != SLOT_FREE && slot.nodeId == nodeId && slot.index == index && slot.subIndex == subIndex) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool SdoTransactionTable::start(uint8_t nodeId, uint16_t index, uint8_t subIndex, bool isWrite, uint32_t value,
+                                CompletionCallback onComplete, uint32_t timeoutMs, CanTxPriority priority) {
+  // Reserve a slot under the lock; the callback is filled in outside it
+  int free = -1;
+  portENTER_CRITICAL(&mux_);
+  if (findLocked(nodeId, index, subIndex) < 0) {
+    for (int i = 0; i < SDO_MAX_TRANSACTIONS && free < 0; i++) {
+      if (slots_[i].state == SLOT_FREE) {
+        free = i;
+      }
+    }
+  }
+  if (free >= 0) {
+    Slot& slot = slots_[free];
+    slot.state = SLOT_RESERVED;
+    slot.nodeId = nodeId;
+    slot.index = index;
+    slot.subIndex = subIndex;
+    slot.isWrite = isWrite;
+  }
+  portEXIT_CRITICAL(&mux_);
+
+  if (free < 0) {
+    return false;
+  }
+
+  Slot& slot = slots_[free];
+  slot.onComplete = onComplete;
+  slot.adaptive = timeoutMs == SDO_TIMEOUT_ADAPTIVE;
+  slot.timeoutMs = slot.adaptive ? SdoRttEstimator::instance().getTimeoutMs(nodeId) : timeoutMs;
+  slot.status = SDO_OK;
+  slot.data = 0;
+
+  twai_message_t frame;
+  frame.extd = false;
+  frame.rtr = false;
+  frame.identifier = SDO_REQUEST_BASE_ID | nodeId;
+  frame.data_length_code = 8;
+  frame.data[0] = isWrite ? SDOProtocol::WRITE : SDOProtocol::READ;
+  frame.data[1] = index & 0xFF;
+  frame.data[2] = index >> 8;
+  frame.data[3] = subIndex;
+  memcpy(&frame.data[4], &value, sizeof(value));
+
+  // Pending before the frame leaves, so a fast response cannot beat the matcher. While
+  // queueing, canTask neither times the slot out nor completes it, so it stays ours to free.
+  portENTER_CRITICAL(&mux_);
+  slot.startMs = millis();
+  slot.startUs = micros();
+  slot.queueing = true;
+  slot.state = SLOT_PENDING;
+  portEXIT_CRITICAL(&mux_);
+
+  // Background polling tries again on its next round rather than wait for queue space
+  TickType_t wait = priority == CAN_TX_BACKGROUND ? 0 : pdMS_TO_TICKS(10);
+  if (!canQueueTransmit(&frame, wait, priority)) {
+    // Never sent: anything matched meanwhile answered an earlier request on the key
+    portENTER_CRITICAL(&mux_);
+    slot.state = SLOT_RESERVED;
+    slot.queueing = false;
+    portEXIT_CRITICAL(&mux_);
+    slot.onComplete = nullptr;
+    portENTER_CRITICAL(&mux_);
+    slot.state = SLOT_FREE;
+    portEXIT_CRITICAL(&mux_);
+    return false;
+  }
+
+  // Time from here, so RTT samples and the timeout leave out waiting in the TX queue
+  portENTER_CRITICAL(&mux_);
+  if (slot.state == SLOT_PENDING) {
+    slot.startMs = millis();
+    slot.startUs = micros();
+  }
+  slot.queueing = false;
+  portEXIT_CRITICAL(&mux_);
+
+  canTaskWake();  // New deadline for canTask
+  return true;
+}
+
+bool SdoTransactionTable::matchResponse(const twai_message_t& frame) {
+  uint8_t nodeId = frame.identifier - SDO_RESPONSE_BASE_ID;
+  uint16_t index = frame.data[1] | (frame.data[2] << 8);
+  uint8_t subIndex = frame.data[3];
+  uint8_t command = frame.data[0];
+
+  bool isAbort = command == SDOProtocol::ABORT;
+  bool isUpload = (command & 0xE0) == SDOProtocol::RESPONSE_UPLOAD;
+  bool isDownload = command == SDOProtocol::WRITE_REPLY;
+  if (!isAbort && !isUpload && !isDownload) {
+    return false;  // Segment responses carry no index
+  }
+
+  bool matched = false;
+  bool sample = false;
+  uint32_t rttUs = 0;
+  portENTER_CRITICAL(&mux_);
+  int i = findLocked(nodeId, index, subIndex);
+  if (i >= 0 && slots_[i].state == SLOT_PENDING && (isAbort || isDownload == slots_[i].isWrite)) {
+    Slot& slot = slots_[i];
+    slot.status = isAbort ? SDO_ABORTED : SDO_OK;
+    memcpy(&slot.data, &frame.data[4], sizeof(slot.data));
+    if (slot.isWrite && !isAbort) {
+      slot.data = 0;
+    }
+    slot.doneMs = millis();
+    slot.state = SLOT_DONE;
+    matched = true;
+    sample = slot.adaptive;
+    rttUs = micros() - slot.startUs;
+  }
+  portEXIT_CRITICAL(&mux_);
+
+  if (matched) {
+    if (sample) {
+      SdoRttEstimator::instance().addSample(nodeId, rttUs);  // Requests are never repeated, so always valid
+    }
+    canTaskWake();
+  }
+  return matched;
+}
+
+bool SdoTransactionTable::isPending(uint8_t nodeId, uint16_t index, uint8_t subIndex) const {
+  portENTER_CRITICAL(&mux_);
+  bool pending = findLocked(nodeId, index, subIndex) >= 0;
+  portEXIT_CRITICAL(&mux_);
+  return pending;
+}
+
+uint8_t SdoTransactionTable::pendingCount() const {
+  uint8_t count = 0;
+  portENTER_CRITICAL(&mux_);
+  for (const Slot& slot : slots_) {
+    if (slot.state != SLOT_FREE) {
+      count++;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  return count;
+}
+
+void SdoTransactionTable::process(uint32_t now) {
+  for (Slot& slot : slots_) {
+    // Claim answered or expired slots; the callback runs outside the lock
+    bool finished = false;
+    portENTER_CRITICAL(&mux_);
+    if (!slot.queueing && slot.state == SLOT_PENDING && msRemaining(slot.startMs, slot.timeoutMs, now) == 0) {
+      slot.status = SDO_TIMEOUT;
+      slot.data = 0;
+      slot.doneMs = now;
+      slot.state = SLOT_DONE;
+    }
+    if (!slot.queueing && slot.state == SLOT_DONE) {
+      slot.state = SLOT_RESERVED;
+      finished = true;
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    if (!finished) {
+      continue;
+    }
+
+    SdoCompletion completion = {slot.nodeId,  slot.index, slot.subIndex, slot.isWrite,
+                                slot.status, slot.data,  slot.doneMs - slot.startMs};
+    bool adaptive = slot.adaptive;
+    CompletionCallback onComplete = std::move(slot.onComplete);
+    slot.onComplete = nullptr;
+
+    // Free before calling back so the callback can start a follow-up on the same key
+    portENTER_CRITICAL(&mux_);
+    slot.state = SLOT_FREE;
+    portEXIT_CRITICAL(&mux_);
+
+    if (completion.status == SDO_TIMEOUT) {
+      if (adaptive) {
+        SdoRttEstimator::instance().onTimeout(completion.nodeId);
+      }
+      DBG_OUTPUT_PORT.printf("[SDO] %s 0x%04X/%d on node %d timed out\n", completion.isWrite ? "Write" : "Read",
+                             completion.index, completion.subIndex, completion.nodeId);
+    }
+    if (onComplete) {
+      onComplete(completion);
+    }
+  }
+}
+
+uint32_t SdoTransactionTable::getMsUntilNextTimeout(uint32_t now) const {
+  uint32_t waitMs = NO_DEADLINE;
+  portENTER_CRITICAL(&mux_);
+  for (const Slot& slot : slots_) {
+    if (slot.queueing) {
+      continue;  // start*() wakes canTask once it is queued
+    } else if (slot.state == SLOT_DONE) {
+      waitMs = 0;
+    } else if (slot.state == SLOT_PENDING) {
+      uint32_t remaining = msRemaining(slot.startMs, slot.timeoutMs, now);
+      waitMs = remaining < waitMs ? remaining : waitMs;
+    }
+  }
+  portEXIT_CRITICAL(&mux_);
+  return waitMs;
+}
+
+void SdoTransactionTable::cancelAll() {
+  for (Slot& slot : slots_) {
+    bool cancelled = false;
+    portENTER_CRITICAL(&mux_);
+    if (!slot.queueing && (slot.state == SLOT_PENDING || slot.state == SLOT_DONE)) {
+      slot.state = SLOT_RESERVED;
+      cancelled = true;
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    if (cancelled) {
+      slot.onComplete = nullptr;
+      portENTER_CRITICAL(&mux_);
+      slot.state = SLOT_FREE;
+      portEXIT_CRITICAL(&mux_);
+    }
+  }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+
+#include "models/can_types.h"
+
+// Concurrent expedited SDO transactions: the spot value window (SPOT_VALUES_WINDOW_MAX)
+// plus as many for interactive requests
+#define SDO_MAX_TRANSACTIONS 16
+// Transaction timeout argument: use the node's RTO from SdoRttEstimator
+#define SDO_TIMEOUT_ADAPTIVE 0
+
+enum SdoStatus : uint8_t {
+  SDO_OK,       // Response received; data holds the value read (writes: 0)
+  SDO_ABORTED,  // Node answered with an abort; data holds the abort code
+  SDO_TIMEOUT   // No response within the transaction timeout
+};
+
+struct SdoCompletion {
+  uint8_t nodeId;
+  uint16_t index;
+  uint8_t subIndex;
+  bool isWrite;
+  SdoStatus status;
+  uint32_t data;
+  uint32_t elapsedMs;  // Request queued to completion
+};
+
+/**
+ * Table of outstanding expedited SDO reads and writes, keyed by (node, index, subindex).
+ *
+ * A CANopen expedited response carries the index and subindex of its request, so several
+ * transactions to different entries can be in flight at once and each response (or abort)
+ * goes back to the transaction that asked for it. Only one transaction per key may be
+ * outstanding - two would be indistinguishable on the bus.
+ *
+ * start*() may be called from any task. Responses are claimed inline in the RX task (an
+ * SDO matcher ahead of the capture and keyed routes); completion callbacks and timeouts run
+ * in canTask from process(), so callbacks may touch manager state.
+ */
+class SdoTransactionTable {
+public:
+  using CompletionCallback = std::function<void(const SdoCompletion& completion)>;
+
+  static SdoTransactionTable& instance();
+
+  // Register the response matcher with CanRouter (once, before the CAN tasks start)
+  void registerCanRoutes();
+
+  // Queue the request and track it. False if the key is already pending, the table is
+  // full or the request could not be queued; the callback is not called in that case.
+  // With an adaptive timeout the outcome also updates the node's RTT estimate.
+  bool startRead(uint8_t nodeId, uint16_t index, uint8_t subIndex, CompletionCallback onComplete,
+                 uint32_t timeoutMs = SDO_TIMEOUT_ADAPTIVE, CanTxPriority priority = CAN_TX_SDO);
+  bool startWrite(uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t value, CompletionCallback onComplete,
+                  uint32_t timeoutMs = SDO_TIMEOUT_ADAPTIVE, CanTxPriority priority = CAN_TX_SDO);
+
+  bool isPending(uint8_t nodeId, uint16_t index, uint8_t subIndex) const;
+  uint8_t pendingCount() const;
+
+  // canTask: fire callbacks for answered and timed-out transactions
+  void process(uint32_t now);
+  uint32_t getMsUntilNextTimeout(uint32_t now) const;  // NO_DEADLINE when nothing is pending
+
+  // Drop every transaction without calling back (e.g. on disconnect). One still being
+  // queued by start*() is left to it.
+  void cancelAll();
+
+private:
+  SdoTransactionTable() = default;
+  SdoTransactionTable(const SdoTransactionTable&) = delete;
+  SdoTransactionTable& operator=(const SdoTransactionTable&) = delete;
+
+  enum SlotState : uint8_t {
+    SLOT_FREE,
+    SLOT_RESERVED,  // Being filled in by start*()
+    SLOT_PENDING,   // Request queued, waiting for the response
+    SLOT_DONE       // Response stored by the RX task, callback not run yet
+  };
+
+  struct Slot {
+    SlotState state = SLOT_FREE;
+    uint8_t nodeId = 0;
+    uint16_t index = 0;
+    uint8_t subIndex = 0;
+    bool isWrite = false;
+    SdoStatus status = SDO_OK;
+    uint32_t data = 0;
+    uint32_t startMs = 0;
+    uint32_t startUs = 0;
+    uint32_t timeoutMs = 0;
+    bool adaptive = false;  // Timeout taken from (and outcome fed to) SdoRttEstimator
+    bool queueing = false;  // start*() is still queueing the request; canTask leaves the slot alone
+    uint32_t doneMs = 0;
+    CompletionCallback onComplete;  // Owned by start*() while reserved, then by canTask
+  };
+
+  bool start(uint8_t nodeId, uint16_t index, uint8_t subIndex, bool isWrite, uint32_t value,
+             CompletionCallback onComplete, uint32_t timeoutMs, CanTxPriority priority);
+  bool matchResponse(const twai_message_t& frame);
+  int findLocked(uint8_t nodeId, uint16_t index, uint8_t subIndex) const;
+
+  Slot slots_[SDO_MAX_TRANSACTIONS];
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
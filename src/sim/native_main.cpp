@@ -0,0 +1,492 @@
+/**
+ * Host-native entry point (env:native, env:native-socketcan)
+ *
+ * Runs the real CAN stack (can_task.cpp, oi_can.cpp, DeviceConnection, SpotValuesManager)
+ * and reports end-to-end latency and throughput. This thread plays the part of the web
+ * server task: it posts commands to canCommandQueue and reads canEventQueue.
+ *
+ * native:           program [responseDelayUs] [spotSeconds]
+ *                   Simulated node on the in-process bus.
+ * native-socketcan: program bench [nodeId] [spotSeconds]   benchmarks against a node on the interface
+ *                   program node [nodeId] [responseDelayUs] serve a simulated node on the interface
+ *                   program rx [seconds]                    sustained RX rate (drive with cangen)
+ *                   program tx [seconds] [canId]            sustained TX rate (watch with candump)
+ */
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "can_task.h"
+#include "config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "oi_can.h"
+#include "sim_bus.h"
+#include "sim_node.h"
+
+#include "managers/device_connection.h"
+#include "managers/spot_value_slots.h"
+#include "managers/spot_values_manager.h"
+#include "models/can_command.h"
+#include "models/can_event.h"
+#include "models/spot_value_frame.h"
+#include "protocols/sdo_rtt_estimator.h"
+#include "utils/can_queue.h"
+#include "utils/string_utils.h"
+
+#ifdef CAN_HAL_SOCKETCAN
+  #include "socketcan_node.h"
+
+  #include "hal/can_hal.h"
+#endif
+
+#define DBG_OUTPUT_PORT Serial
+
+// Globals normally defined in main.cpp
+QueueHandle_t canCommandQueue = nullptr;
+QueueHandle_t canEventQueue = nullptr;
+Config config;
+
+static const uint8_t SIM_NODE_ID = 1;
+static const uint32_t SIM_SERIAL[4] = {0x87654321, 0x0BADCAFE, 0x12345678, 0x00C0FFEE};
+static const int BENCH_REPEAT = 5;
+static const uint32_t EVENT_TIMEOUT_MS = 5000;
+static const uint32_t ROUTING_FRAMES = 200000;
+
+// Latency samples in microseconds
+struct LatencyStats {
+  std::vector<uint32_t> samples;
+
+  void add(uint32_t us) { samples.push_back(us); }
+
+  void print(const char* label) {
+    if (samples.empty()) {
+      DBG_OUTPUT_PORT.printf("%-22s no samples\n", label);
+      return;
+    }
+    std::sort(samples.begin(), samples.end());
+    uint64_t total = 0;
+    for (uint32_t us : samples) {
+      total += us;
+    }
+    DBG_OUTPUT_PORT.printf("%-22s n=%-4u min %7lu us  avg %7lu us  p50 %7lu us  max %7lu us\n", label,
+                           (unsigned)samples.size(), (unsigned long)samples.front(),
+                           (unsigned long)(total / samples.size()), (unsigned long)samples[samples.size() / 2],
+                           (unsigned long)samples.back());
+  }
+};
+
+static void sendCommand(const CANCommand& cmd) {
+  xQueueSend(canCommandQueue, &cmd, portMAX_DELAY);
+  canTaskWake();
+}
+
+// Wait for an event of the given type, discarding others. Returns false on timeout.
+static bool waitForEvent(CANEventType type, CANEvent* out, uint32_t timeoutMs = EVENT_TIMEOUT_MS) {
+  uint32_t start = millis();
+  uint32_t elapsed;
+  while ((elapsed = millis() - start) < timeoutMs) {
+    if (xQueueReceive(canEventQueue, out, pdMS_TO_TICKS(timeoutMs - elapsed)) != pdTRUE) {
+      continue;
+    }
+    if (out->type == type) {
+      return true;
+    }
+    releaseEventPayload(*out);
+  }
+  return false;
+}
+
+static bool benchConnect(uint8_t nodeId) {
+  LatencyStats stats;
+  CANEvent evt;
+
+  for (int i = 0; i < BENCH_REPEAT; i++) {
+    CANCommand cmd = {};
+    cmd.type = CMD_CONNECT;
+    cmd.data.connect.nodeId = nodeId;
+
+    uint32_t start = micros();
+    sendCommand(cmd);
+    if (!waitForEvent(EVT_CONNECTED, &evt)) {
+      DBG_OUTPUT_PORT.println("[Native] Connect timed out");
+      return false;
+    }
+    stats.add(micros() - start);
+  }
+
+  DBG_OUTPUT_PORT.printf("[Native] Connected to node %d, serial %s\n", evt.data.connected.nodeId,
+                         evt.data.connected.serial);
+  stats.print("connect");
+  return true;
+}
+
+static bool benchJsonDownload(bool blockUpload) {
+  LatencyStats stats;
+  CANEvent evt;
+  DeviceConnection& conn = DeviceConnection::instance();
+  conn.setBlockUploadEnabled(blockUpload);
+
+  for (int i = 0; i < BENCH_REPEAT; i++) {
+    uint32_t start = micros();
+    if (!conn.startJsonDownloadAsync(1)) {
+      DBG_OUTPUT_PORT.println("[Native] JSON download refused (not idle)");
+      return false;
+    }
+    if (!waitForEvent(EVT_JSON_READY, &evt) || !evt.data.jsonReady.success) {
+      DBG_OUTPUT_PORT.println("[Native] JSON download failed");
+      return false;
+    }
+    stats.add(micros() - start);
+  }
+
+  const JsonDownloadStats& download = conn.getJsonDownloadStats();
+  const char* label = blockUpload ? "json download (block)" : "json download (seg)";
+  stats.print(label);
+  uint32_t avgUs = 0;
+  for (uint32_t us : stats.samples) {
+    avgUs += us / stats.samples.size();
+  }
+  DBG_OUTPUT_PORT.printf("%-22s %lu bytes, %.0f bytes/s via %s%s, %lu round trips, %lu retransmits\n", "",
+                         (unsigned long)download.bytes, avgUs > 0 ? download.bytes * 1e6 / avgUs : 0.0,
+                         download.blockMode ? "block" : "segmented", download.fellBack ? " (fallback)" : "",
+                         (unsigned long)download.roundTrips, (unsigned long)download.retransmits);
+  conn.setBlockUploadEnabled(true);
+  return true;
+}
+
+// periods: per-parameter read periods (empty = every parameter at the interval)
+static void benchSpotValues(const std::vector<int>& paramIds, uint32_t seconds, uint8_t window,
+                            const std::vector<uint16_t>& periods = {}) {
+  int paramCount = std::min((int)paramIds.size(), MAX_PARAM_IDS);
+  uint32_t timeoutsBefore = SpotValuesManager::instance().getRequestTimeouts();
+
+  CANCommand cmd = {};
+  cmd.type = CMD_START_SPOT_VALUES;
+  cmd.data.spotValues.interval = SPOT_VALUES_INTERVAL_MIN_MS;
+  cmd.data.spotValues.paramCount = paramCount;
+  cmd.data.spotValues.window = window;
+  std::copy(paramIds.begin(), paramIds.begin() + paramCount, cmd.data.spotValues.paramIds);
+  for (int i = 0; i < paramCount && i < (int)periods.size(); i++) {
+    cmd.data.spotValues.periods[i] = periods[i];
+  }
+  sendCommand(cmd);
+
+  uint32_t batches = 0;
+  uint32_t values = 0;
+  uint32_t start = millis();
+  CANEvent evt;
+  while (millis() - start < seconds * 1000) {
+    if (xQueueReceive(canEventQueue, &evt, pdMS_TO_TICKS(100)) != pdTRUE) {
+      continue;
+    }
+    if (evt.type == EVT_SPOT_VALUES) {
+      SpotValueFrameHeader header;
+      memcpy(&header, evt.data.spotValues.frame, sizeof(header));
+      batches++;
+      values += header.count;
+    }
+    releaseEventPayload(evt);
+  }
+  uint32_t elapsedMs = millis() - start;
+
+  cmd = {};
+  cmd.type = CMD_STOP_SPOT_VALUES;
+  sendCommand(cmd);
+  waitForEvent(EVT_SPOT_VALUES_STATUS, &evt, 1000);
+
+  DBG_OUTPUT_PORT.printf("%-22s %d params @ %d ms%s, window %d: %lu batches, %lu values, %.0f values/s\n",
+                         "spot values", paramCount, SPOT_VALUES_INTERVAL_MIN_MS, periods.empty() ? "" : " (mixed)",
+                         window, (unsigned long)batches, (unsigned long)values, values * 1000.0 / elapsedMs);
+  DBG_OUTPUT_PORT.printf("%-22s lag %lu ms, %lu timeouts\n", "",
+                         (unsigned long)SpotValuesManager::instance().getLastLagMs(),
+                         (unsigned long)(SpotValuesManager::instance().getRequestTimeouts() - timeoutsBefore));
+}
+
+// Round trip of one device operation command to its result event
+static bool timeOperation(const CANCommand& cmd, CANEventType resultType, LatencyStats& stats) {
+  CANEvent evt;
+  uint32_t start = micros();
+  sendCommand(cmd);
+  bool received = waitForEvent(resultType, &evt);
+  if (received) {
+    stats.add(micros() - start);
+    releaseEventPayload(evt);
+  }
+  return received;
+}
+
+static void benchDeviceOperations() {
+  LatencyStats mapping, mappingCached, errors, errorsIncremental, setValue, snapshot, restore;
+
+  for (int i = 0; i < BENCH_REPEAT; i++) {
+    CANCommand cmd = {};
+    cmd.type = CMD_GET_CAN_MAPPINGS;
+    cmd.data.getCanMappings.refresh = true;
+    timeOperation(cmd, EVT_CAN_MAPPINGS_RECEIVED, mapping);
+    cmd.data.getCanMappings.refresh = false;
+    timeOperation(cmd, EVT_CAN_MAPPINGS_RECEIVED, mappingCached);
+
+    cmd = {};
+    cmd.type = CMD_LIST_ERRORS;
+    timeOperation(cmd, EVT_ERRORS_LISTED, errors);
+    cmd.data.listErrors.incremental = true;
+    timeOperation(cmd, EVT_ERRORS_LISTED, errorsIncremental);
+
+    cmd = {};
+    cmd.type = CMD_SET_VALUE;
+    cmd.data.setValue.paramId = 1;
+    cmd.data.setValue.value = 1700 + i;
+    timeOperation(cmd, EVT_VALUE_SET, setValue);
+
+    cmd = {};
+    cmd.type = CMD_SNAPSHOT_PARAMS;
+    timeOperation(cmd, EVT_PARAMS_SNAPSHOT, snapshot);
+    cmd.type = CMD_RESTORE_PARAMS;
+    timeOperation(cmd, EVT_PARAMS_RESTORED, restore);
+  }
+
+  mapping.print("CAN mappings");
+  mappingCached.print("CAN mappings (cache)");
+  errors.print("list errors");
+  errorsIncremental.print("list errors (incr)");
+  setValue.print("set value");
+  snapshot.print("param snapshot");
+  restore.print("param restore");
+}
+
+static void printCanStats() {
+  for (int i = 0; i < CAN_TX_PRIORITY_COUNT; i++) {
+    CanTxStats tx = getCanTxStats((CanTxPriority)i);
+    DBG_OUTPUT_PORT.printf("TX %-10s queued %lu sent %lu dropped %lu failed %lu high water %lu\n",
+                           canTxClassName((CanTxPriority)i),
+                           (unsigned long)tx.queued, (unsigned long)tx.sent, (unsigned long)tx.dropped,
+                           (unsigned long)tx.failed, (unsigned long)tx.highWater);
+  }
+
+  CanRxStats rx = getCanRxStats();
+  DBG_OUTPUT_PORT.printf("RX received %lu missed %lu overrun %lu budget exhausted %lu\n",
+                         (unsigned long)rx.framesReceived, (unsigned long)rx.rxMissed, (unsigned long)rx.rxOverrun,
+                         (unsigned long)rx.budgetExhausted);
+
+  CanBusStatus bus = getCanBusStatus();
+  DBG_OUTPUT_PORT.printf("Bus %s TEC %lu REC %lu bus-off %lu recoveries %lu arb lost %lu bus errors %lu\n",
+                         canBusStateName(bus.state), (unsigned long)bus.txErrorCounter,
+                         (unsigned long)bus.rxErrorCounter, (unsigned long)bus.busOffCount,
+                         (unsigned long)bus.recoveries, (unsigned long)bus.arbLost, (unsigned long)bus.busErrors);
+
+  SdoRttStats rtt = SdoRttEstimator::instance().getBusStats();
+  DBG_OUTPUT_PORT.printf("SDO RTT n=%lu srtt %lu us var %lu us min %lu us max %lu us timeouts %lu rto %lu ms\n",
+                         (unsigned long)rtt.samples, (unsigned long)rtt.srttUs, (unsigned long)rtt.rttVarUs,
+                         (unsigned long)rtt.minRttUs, (unsigned long)rtt.maxRttUs, (unsigned long)rtt.timeouts,
+                         (unsigned long)rtt.rtoMs);
+}
+
+// Same start-up sequence as setup() in main.cpp, minus WiFi and the web server
+static void startCanStack() {
+  LittleFS.begin();
+  config.load();
+
+  OICan::InitCAN(config.getBaudRateEnum(), config.getCanTXPin(), config.getCanRXPin());
+
+  canCommandQueue = xQueueCreate(10, sizeof(CANCommand));
+  canEventQueue = xQueueCreate(20, sizeof(CANEvent));
+
+  DeviceConnection::instance().setConnectionReadyCallback([](uint8_t nodeId, const char* serial) {
+    CANEvent evt;
+    evt.type = EVT_CONNECTED;
+    evt.data.connected.nodeId = nodeId;
+    safeCopyString(evt.data.connected.serial, serial);
+    xQueueSend(canEventQueue, &evt, 0);
+  });
+
+  initCanQueues();
+  startCanTasks();
+}
+
+// Per-frame cost of routing a spot value response (ID lookup, store, batch bookkeeping),
+// against the previous layout: a linear scan of the monitored IDs and std::map batch/cache
+static void benchSpotValueRouting() {
+  volatile double sink = 0;
+  for (int count : {10, 100, 500}) {
+    std::vector<int> ids(count);
+    for (int i = 0; i < count; i++) {
+      ids[i] = 2000 + i * 3;
+    }
+
+    SpotValueSlots slots;
+    slots.assign(ids.data(), count);
+    uint32_t start = micros();
+    for (uint32_t i = 0; i < ROUTING_FRAMES; i++) {
+      int slot = slots.find(ids[i % count]);
+      if (slot >= 0) {
+        slots.store(slot, i, start);
+      }
+      if (slots.batchSize() == (size_t)count) {
+        slots.clearBatch();
+      }
+    }
+    double slotsNs = (micros() - start) * 1000.0 / ROUTING_FRAMES;
+    sink = sink + slots.valueAt(0);
+
+    std::map<int, double> batch, latest;
+    start = micros();
+    for (uint32_t i = 0; i < ROUTING_FRAMES; i++) {
+      int paramId = ids[i % count];
+      if (std::find(ids.begin(), ids.end(), paramId) != ids.end()) {
+        batch[paramId] = i;
+        latest[paramId] = i;
+      }
+      if (batch.size() == (size_t)count) {
+        batch.clear();
+      }
+    }
+    double mapNs = (micros() - start) * 1000.0 / ROUTING_FRAMES;
+    sink = sink + latest.begin()->second;
+
+    DBG_OUTPUT_PORT.printf("%-22s %3d params: %.0f ns/frame (scan + map: %.0f ns)\n", "spot value routing", count,
+                           slotsNs, mapNs);
+  }
+}
+
+static bool runBenchmarks(uint8_t nodeId, uint32_t spotSeconds) {
+  benchSpotValueRouting();
+
+  if (!benchConnect(nodeId) || !benchJsonDownload(false) || !benchJsonDownload(true)) {
+    return false;
+  }
+
+  // Spot values: every spot value the node reports
+  std::vector<int> spotIds;
+  JsonObject params = DeviceConnection::instance().getCachedJson().as<JsonObject>();
+  for (JsonPair param : params) {
+    if (!param.value()["isparam"].as<bool>()) {
+      spotIds.push_back(param.value()["id"].as<int>());
+    }
+  }
+  for (uint8_t window : {1, SPOT_VALUES_WINDOW_DEFAULT, SPOT_VALUES_WINDOW_MAX}) {
+    benchSpotValues(spotIds, spotSeconds, window);
+  }
+
+  // A few fast parameters (currents) among slow ones (temperatures)
+  std::vector<uint16_t> periods(spotIds.size(), 5000);
+  std::fill_n(periods.begin(), std::min<size_t>(periods.size(), 4), SPOT_VALUES_PERIOD_MIN_MS);
+  benchSpotValues(spotIds, spotSeconds, SPOT_VALUES_WINDOW_DEFAULT, periods);
+  benchDeviceOperations();
+  return true;
+}
+
+#ifdef CAN_HAL_SOCKETCAN
+
+// Frames the RX task takes from the interface. SDO response IDs go through the full
+// routing path, e.g. cangen vcan0 -I 5FF -L 8 -g 0
+static void benchRxRate(uint32_t seconds) {
+  DBG_OUTPUT_PORT.printf("[Native] Counting received frames for %lu s\n", (unsigned long)seconds);
+
+  CanRxStats before = getCanRxStats();
+  uint32_t start = millis();
+  for (uint32_t i = 1; i <= seconds; i++) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    CanRxStats now = getCanRxStats();
+    DBG_OUTPUT_PORT.printf("%3lu s  %lu frames/s  missed %lu\n", (unsigned long)i,
+                           (unsigned long)(now.framesReceived - before.framesReceived),
+                           (unsigned long)(now.rxMissed - before.rxMissed));
+    before = now;
+  }
+  CanRxStats total = getCanRxStats();
+  DBG_OUTPUT_PORT.printf("%-22s %.0f frames/s\n", "rx", total.framesReceived * 1000.0 / (millis() - start));
+}
+
+// Keep the background TX class full for the whole run and count what reaches the interface
+static void benchTxRate(uint32_t seconds, uint32_t canId) {
+  DBG_OUTPUT_PORT.printf("[Native] Sending 0x%03lX as fast as possible for %lu s\n", (unsigned long)canId,
+                         (unsigned long)seconds);
+
+  twai_message_t frame = {};
+  frame.identifier = canId;
+  frame.data_length_code = 8;
+
+  uint32_t counter = 0;
+  uint32_t start = millis();
+  while (millis() - start < seconds * 1000) {
+    memcpy(frame.data, &counter, sizeof(counter));
+    if (canQueueTransmit(&frame, pdMS_TO_TICKS(10), CAN_TX_BACKGROUND)) {
+      counter++;
+    }
+  }
+  uint32_t elapsedMs = millis() - start;
+
+  CanTxStats tx = getCanTxStats(CAN_TX_BACKGROUND);
+  DBG_OUTPUT_PORT.printf("%-22s %.0f frames/s (%lu sent, %lu failed)\n", "tx", tx.sent * 1000.0 / elapsedMs,
+                         (unsigned long)tx.sent, (unsigned long)tx.failed);
+}
+
+  #ifndef PIO_UNIT_TESTING  // pio test -e native links the sources with the test's own main()
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : "bench";
+  uint32_t arg2 = argc > 2 ? strtoul(argv[2], nullptr, 0) : 0;
+  uint32_t arg3 = argc > 3 ? strtoul(argv[3], nullptr, 0) : 0;
+
+  if (strcmp(mode, "node") == 0) {
+    SimNode node(arg2 > 0 ? arg2 : SIM_NODE_ID, SIM_SERIAL);
+    node.loadDefaultDevice();
+    node.setResponseDelayUs(argc > 3 ? arg3 : 100);
+    return runSocketCanNode(node, canHalSocketCanInterface());
+  }
+
+  startCanStack();
+  DBG_OUTPUT_PORT.printf("[Native] SocketCAN interface %s\n", canHalSocketCanInterface());
+
+  bool ok = true;
+  if (strcmp(mode, "rx") == 0) {
+    benchRxRate(arg2 > 0 ? arg2 : 10);
+  } else if (strcmp(mode, "tx") == 0) {
+    benchTxRate(arg2 > 0 ? arg2 : 10, arg3 > 0 ? arg3 : 0x123);
+  } else if (strcmp(mode, "bench") == 0) {
+    ok = runBenchmarks(arg2 > 0 ? arg2 : SIM_NODE_ID, arg3 > 0 ? arg3 : 5);
+  } else {
+    DBG_OUTPUT_PORT.printf("Unknown mode %s (bench, node, rx, tx)\n", mode);
+    return 2;
+  }
+
+  printCanStats();
+  return ok ? 0 : 1;
+}
+  #endif
+
+#else
+
+  #ifndef PIO_UNIT_TESTING
+int main(int argc, char** argv) {
+  uint32_t responseDelayUs = argc > 1 ? strtoul(argv[1], nullptr, 0) : 100;
+  uint32_t spotSeconds = argc > 2 ? strtoul(argv[2], nullptr, 0) : 5;
+
+  SimNode node(SIM_NODE_ID, SIM_SERIAL);
+  node.loadDefaultDevice();
+  node.setResponseDelayUs(responseDelayUs);
+  simBusAttach(&node);
+
+  startCanStack();
+  DBG_OUTPUT_PORT.printf("[Native] Simulated node %d, response delay %lu us\n", SIM_NODE_ID,
+                         (unsigned long)responseDelayUs);
+
+  bool ok = runBenchmarks(SIM_NODE_ID, spotSeconds);
+
+  printCanStats();
+  SimBusStats bus = simBusGetStats();
+  DBG_OUTPUT_PORT.printf("Bus host->node %lu node->host %lu unacked %lu busy %.1f ms, node saw %lu requests\n",
+                         (unsigned long)bus.framesFromHost, (unsigned long)bus.framesToHost,
+                         (unsigned long)bus.unacknowledged, bus.busyUs / 1000.0,
+                         (unsigned long)node.getRequestCount());
+  return ok ? 0 : 1;
+}
+  #endif
+
+#endif
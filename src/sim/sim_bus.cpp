@@ -0,0 +1,162 @@
+#include "sim_bus.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct WireFrame {
+  Clock::time_point due;  // End of the frame on the wire
+  uint64_t sequence;      // Keeps same-time frames in order
+  twai_message_t frame;
+  bool fromHost;
+
+  bool operator>(const WireFrame& other) const {
+    return due != other.due ? due > other.due : sequence > other.sequence;
+  }
+};
+
+std::mutex busLock;
+std::condition_variable busChanged;
+std::priority_queue<WireFrame, std::vector<WireFrame>, std::greater<WireFrame>> wire;
+std::vector<SimBusDevice*> devices;
+const SimBusHost* host = nullptr;
+uint32_t bitrate = 500000;
+uint64_t nextSequence = 0;
+Clock::time_point busFreeAt;
+SimBusStats stats;
+bool threadStarted = false;
+
+// Reserve the next free slot on the wire. Call with busLock held.
+void scheduleLocked(const twai_message_t& frame, bool fromHost, Clock::time_point ready) {
+  uint32_t frameUs = simBusFrameTimeUs(frame, bitrate);
+  Clock::time_point start = std::max(ready, busFreeAt);
+  busFreeAt = start + std::chrono::microseconds(frameUs);
+  stats.busyUs += frameUs;
+  wire.push({busFreeAt, nextSequence++, frame, fromHost});
+}
+
+void busThread() {
+  std::unique_lock<std::mutex> lock(busLock);
+  while (true) {
+    if (wire.empty()) {
+      busChanged.wait(lock);
+      continue;
+    }
+    Clock::time_point due = wire.top().due;
+    if (Clock::now() < due) {
+      busChanged.wait_until(lock, due);
+      continue;
+    }
+
+    WireFrame item = wire.top();
+    wire.pop();
+    const SimBusHost* currentHost = host;
+
+    if (!item.fromHost) {
+      stats.framesToHost++;
+      lock.unlock();
+      if (currentHost != nullptr) {
+        currentHost->onReceive(item.frame);
+      }
+      lock.lock();
+      continue;
+    }
+
+    stats.framesFromHost++;
+    bool ack = !devices.empty();
+    if (!ack) {
+      stats.unacknowledged++;
+    }
+
+    // Devices answer after their processing delay; replies queue up behind other traffic
+    std::vector<SimBusDevice*> listeners = devices;
+    lock.unlock();
+    if (currentHost != nullptr) {
+      currentHost->onTransmitDone(item.frame, ack);
+    }
+    for (SimBusDevice* device : listeners) {
+      std::vector<twai_message_t> replies;
+      device->onFrame(item.frame, replies);
+      if (!replies.empty()) {
+        Clock::time_point ready = Clock::now() + std::chrono::microseconds(device->getResponseDelayUs());
+        std::lock_guard<std::mutex> guard(busLock);
+        for (const twai_message_t& reply : replies) {
+          scheduleLocked(reply, false, ready);
+        }
+      }
+    }
+    lock.lock();
+  }
+}
+
+void ensureThreadLocked() {
+  if (!threadStarted) {
+    threadStarted = true;
+    busFreeAt = Clock::now();
+    std::thread(busThread).detach();
+  }
+}
+
+}  // namespace
+
+uint32_t simBusFrameTimeUs(const twai_message_t& frame, uint32_t bitsPerSecond) {
+  // SOF..EOF + intermission: 47 bits (standard) or 67 bits (extended) plus data,
+  // with up to one stuff bit per four bits of the stuffable region
+  uint32_t dataBits = 8 * std::min<uint32_t>(frame.data_length_code, 8);
+  uint32_t overheadBits = frame.extd ? 67 : 47;
+  uint32_t stuffableBits = (frame.extd ? 54 : 34) + dataBits;
+  uint32_t bits = overheadBits + dataBits + (stuffableBits - 1) / 4;
+  return (uint32_t)(((uint64_t)bits * 1000000 + bitsPerSecond - 1) / bitsPerSecond);
+}
+
+void simBusAttach(SimBusDevice* device) {
+  std::lock_guard<std::mutex> guard(busLock);
+  devices.push_back(device);
+}
+
+void simBusDetach(SimBusDevice* device) {
+  std::lock_guard<std::mutex> guard(busLock);
+  devices.erase(std::remove(devices.begin(), devices.end(), device), devices.end());
+}
+
+void simBusSetHost(const SimBusHost* newHost) {
+  std::lock_guard<std::mutex> guard(busLock);
+  host = newHost;
+}
+
+void simBusSetBitrate(uint32_t bitsPerSecond) {
+  std::lock_guard<std::mutex> guard(busLock);
+  if (bitsPerSecond > 0) {
+    bitrate = bitsPerSecond;
+  }
+}
+
+void simBusTransmit(const twai_message_t& frame) {
+  {
+    std::lock_guard<std::mutex> guard(busLock);
+    ensureThreadLocked();
+    scheduleLocked(frame, true, Clock::now());
+  }
+  busChanged.notify_one();
+}
+
+void simBusInject(const twai_message_t& frame, uint32_t delayUs) {
+  {
+    std::lock_guard<std::mutex> guard(busLock);
+    ensureThreadLocked();
+    scheduleLocked(frame, false, Clock::now() + std::chrono::microseconds(delayUs));
+  }
+  busChanged.notify_one();
+}
+
+SimBusStats simBusGetStats() {
+  std::lock_guard<std::mutex> guard(busLock);
+  return stats;
+}
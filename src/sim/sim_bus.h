@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "driver/twai.h"
+
+/**
+ * In-process simulated CAN bus (native build only)
+ *
+ * One host controller (hal/can_hal_sim.cpp) and any number of simulated devices share
+ * the bus. Frames occupy the wire for their bit time at the configured bitrate and are
+ * delivered one after another, so throughput and latency behave like a real bus with a
+ * single fast peer. A bus thread does the delivery; devices are called from that thread.
+ */
+
+// Something attached to the bus that answers frames (e.g. SimNode)
+class SimBusDevice {
+public:
+  virtual ~SimBusDevice() {}
+
+  // Called for every frame the host sends. Append any replies to `replies`.
+  virtual void onFrame(const twai_message_t& frame, std::vector<twai_message_t>& replies) = 0;
+
+  // Processing time before the replies start on the wire
+  virtual uint32_t getResponseDelayUs() const { return 0; }
+};
+
+// Host controller side
+struct SimBusHost {
+  void (*onReceive)(const twai_message_t& frame);                // Frame from a device arrived
+  void (*onTransmitDone)(const twai_message_t& frame, bool ack);  // Host frame left the wire
+};
+
+struct SimBusStats {
+  uint32_t framesFromHost = 0;
+  uint32_t framesToHost = 0;
+  uint32_t unacknowledged = 0;  // Host frames no device was attached to acknowledge
+  uint64_t busyUs = 0;          // Total wire time used
+};
+
+void simBusAttach(SimBusDevice* device);
+void simBusDetach(SimBusDevice* device);
+void simBusSetHost(const SimBusHost* host);
+void simBusSetBitrate(uint32_t bitsPerSecond);
+
+// Put a host frame on the wire (called by the host controller)
+void simBusTransmit(const twai_message_t& frame);
+
+// Put a device frame on the wire without a request (e.g. unsolicited periodic traffic)
+void simBusInject(const twai_message_t& frame, uint32_t delayUs = 0);
+
+SimBusStats simBusGetStats();
+
+// Wire time of a frame including worst-case bit stuffing
+uint32_t simBusFrameTimeUs(const twai_message_t& frame, uint32_t bitsPerSecond);
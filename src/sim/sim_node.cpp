@@ -0,0 +1,563 @@
+#include "sim_node.h"
+
+#include <Arduino.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "models/can_types.h"
+#include "protocols/sdo_protocol.h"
+
+using namespace SDOProtocol;
+
+// Abort code for a segmented upload with a wrong toggle bit (CiA 301)
+static const uint32_t ERR_TOGGLE = 0x05030000;
+
+SimNode::SimNode(uint8_t nodeId, const uint32_t serial[4]) : nodeId_(nodeId) {
+  memcpy(serial_, serial, sizeof(serial_));
+}
+
+void SimNode::addParameter(const char* name, int id, double value, double minimum, double maximum, const char* unit,
+                           const char* category) {
+  std::lock_guard<std::mutex> guard(lock_);
+  Value& entry = values_[id];
+  entry.name = name;
+  entry.unit = unit;
+  entry.category = category;
+  entry.isParam = true;
+  entry.value = value;
+  entry.defaultValue = value;
+  entry.minimum = minimum;
+  entry.maximum = maximum;
+}
+
+void SimNode::addSpotValue(const char* name, int id, const char* unit,
+                           std::function<double(uint32_t nowMs)> generator) {
+  std::lock_guard<std::mutex> guard(lock_);
+  Value& entry = values_[id];
+  entry.name = name;
+  entry.unit = unit;
+  entry.isParam = false;
+  entry.generator = generator;
+}
+
+void SimNode::addError(uint32_t errorNum, uint32_t errorTime) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (errors_.size() >= ERROR_BUFFER_SIZE) {
+    errors_.erase(errors_.begin());
+  }
+  errors_.push_back({errorNum, errorTime});
+}
+
+void SimNode::addCanMapping(bool isRx, uint32_t cobId, uint16_t paramId, uint8_t position, int8_t length,
+                            double gain, int8_t offset) {
+  std::lock_guard<std::mutex> guard(lock_);
+  std::vector<MappingMessage>& messages = isRx ? rxMappings_ : txMappings_;
+  MappingItem item = {paramId, position, length, (int32_t)lround(gain * 1000), offset};
+
+  for (MappingMessage& message : messages) {
+    if (message.cobId == cobId) {
+      message.items.push_back(item);
+      return;
+    }
+  }
+  if ((int)messages.size() < MAX_MAPPING_MESSAGES) {
+    messages.push_back({cobId, {item}});
+  }
+}
+
+void SimNode::loadDefaultDevice() {
+  struct ParamSpec {
+    const char* name;
+    int id;
+    double value, minimum, maximum;
+    const char* unit;
+    const char* category;
+  };
+  static const ParamSpec params[] = {
+      {"boost", 1, 1700, 0, 37813, "dig", "Motor"},
+      {"fweak", 2, 90, 0, 400, "Hz", "Motor"},
+      {"fslipmin", 4, 1.5, 0.3, 10, "Hz", "Motor"},
+      {"fslipmax", 5, 3, 0, 10, "Hz", "Motor"},
+      {"polepairs", 32, 2, 1, 16, "", "Motor"},
+      {"respolepairs", 93, 1, 1, 16, "", "Motor"},
+      {"pwmfrq", 13, 1, 0, 4, "0=17.6kHz, 1=8.8kHz, 2=4.4KHz, 3=2.2kHz, 4=1.1kHz", "Inverter"},
+      {"deadtime", 14, 28, 0, 255, "dig", "Inverter"},
+      {"ocurlim", 22, -100, -65536, 65536, "A", "Inverter"},
+      {"minpulse", 24, 1000, 0, 4095, "dig", "Inverter"},
+      {"potmin", 41, 0, 0, 4095, "dig", "Throttle"},
+      {"potmax", 42, 4095, 0, 4095, "dig", "Throttle"},
+      {"throtmax", 97, 100, 0, 100, "%", "Throttle"},
+      {"throtmin", 98, -100, -100, 0, "%", "Throttle"},
+      {"brknompedal", 38, -50, -100, 0, "%", "Regen"},
+      {"brkmax", 49, -30, -100, 0, "%", "Regen"},
+      {"regenramp", 90, 10, 0.1, 100, "%/10ms", "Regen"},
+      {"udcmin", 45, 450, 0, 1000, "V", "Contactor Control"},
+      {"udcmax", 46, 520, 0, 1000, "V", "Contactor Control"},
+      {"udclim", 48, 540, 0, 1000, "V", "Contactor Control"},
+      {"canspeed", 83, 2, 0, 3, "0=125k, 1=250k, 2=500k, 3=1M", "Communication"},
+      {"canperiod", 82, 0, 0, 1, "0=100ms, 1=10ms", "Communication"},
+      {"nodeid", 129, 1, 1, 63, "", "Communication"},
+  };
+  for (const ParamSpec& p : params) {
+    addParameter(p.name, p.id, p.value, p.minimum, p.maximum, p.unit, p.category);
+  }
+
+  // Slowly varying analog values: base + amplitude * sin(2*pi*t/period)
+  struct WaveSpec {
+    const char* name;
+    int id;
+    const char* unit;
+    double base, amplitude;
+    uint32_t periodMs;
+  };
+  static const WaveSpec waves[] = {
+      {"udc", 2001, "V", 385, 12, 7000},         {"udc2", 2002, "V", 384, 12, 7100},
+      {"deltaudc", 2003, "V", 1, 0.5, 3000},     {"idc", 2004, "A", 40, 35, 5000},
+      {"il1", 2005, "A", 0, 120, 250},           {"il2", 2006, "A", 0, 120, 260},
+      {"ilmax", 2007, "A", 130, 10, 4000},       {"uac", 2008, "V", 230, 5, 9000},
+      {"fstat", 2009, "Hz", 80, 60, 11000},      {"speed", 2010, "rpm", 2400, 1800, 11000},
+      {"amp", 2011, "dig", 20000, 8000, 6000},   {"angle", 2012, "dig", 32768, 32767, 50},
+      {"pot", 2013, "dig", 1800, 1200, 8000},    {"pot2", 2014, "dig", 1790, 1200, 8000},
+      {"potbrake", 2015, "dig", 200, 150, 9000}, {"potnom", 2016, "%", 40, 35, 8000},
+      {"heatsinkt", 2017, "°C", 45, 8, 60000},   {"tmpm", 2018, "°C", 60, 10, 90000},
+      {"tmphs", 2019, "°C", 44, 8, 61000},       {"uaux", 2020, "V", 13.8, 0.3, 20000},
+      {"pilim", 2021, "%", 80, 20, 15000},       {"tempmod", 2022, "°C", 50, 10, 70000},
+      {"cpuload", 2023, "%", 35, 10, 3000},      {"turns", 2024, "", 1000, 1000, 100000},
+      {"cruisespeed", 2025, "rpm", 0, 0, 1000},  {"ifw", 2026, "A", 0, 20, 4000},
+      {"id", 2027, "A", 5, 20, 4000},            {"iq", 2028, "A", 60, 50, 5000},
+      {"ud", 2029, "dig", 0, 3000, 4500},        {"uq", 2030, "dig", 12000, 4000, 5500},
+  };
+  for (const WaveSpec& w : waves) {
+    double base = w.base, amplitude = w.amplitude;
+    uint32_t periodMs = w.periodMs;
+    addSpotValue(w.name, w.id, w.unit, [base, amplitude, periodMs](uint32_t nowMs) {
+      return base + amplitude * sin(2 * M_PI * (double)(nowMs % periodMs) / periodMs);
+    });
+  }
+
+  // Digital inputs and status words
+  static const char* const digitalInputs[] = {"din_cruise", "din_start", "din_brake",    "din_mprot",
+                                              "din_forward", "din_reverse", "din_emcystop", "din_bms"};
+  for (int i = 0; i < 8; i++) {
+    int level = (i == 3 || i == 4) ? 1 : 0;
+    addSpotValue(digitalInputs[i], 2040 + i, "0=Off, 1=On", [level](uint32_t) { return level; });
+  }
+  addSpotValue("opmode", 2000, "0=Off, 1=Run, 2=ManualRun, 3=Boost, 4=Buck, 5=Sine, 6=AcHeat",
+               [](uint32_t) { return 1; });
+  addSpotValue("version", 2039, "", [](uint32_t) { return 5.35; });
+  addSpotValue("status", 2048, "0=None, 1=UdcLow, 2=UdcHigh, 4=UdcBelowUdcSw, 8=UdcLim, 16=EmcyStop, 32=MProt",
+               [](uint32_t) { return 0; });
+  addSpotValue("uptime", 2049, "sec", [](uint32_t nowMs) { return nowMs / 1000; });
+
+  setErrorDescriptions("0=NONE, 1=OVERCURRENT, 2=THROTTLE1, 3=THROTTLE2, 4=CANTIMEOUT, 5=EMCYSTOP, 6=MPROT, "
+                       "7=DESAT, 8=OVERVOLTAGE, 9=ENCODER, 10=PRECHARGE, 11=TMPHSMAX, 12=CURRENTLIMIT");
+  addSpotValue("lasterr", 2038, "", [this](uint32_t) {
+    // Called with lock_ held
+    return errors_.empty() ? 0 : errors_.back().first;
+  });
+  addError(5, 12);
+  addError(10, 340);
+  addError(8, 1024);
+
+  addCanMapping(false, 0x101, 2001, 0, 16, 1, 0);
+  addCanMapping(false, 0x101, 2010, 16, 16, 1, 0);
+  addCanMapping(false, 0x102, 2017, 0, 8, 1, 40);
+  addCanMapping(true, 0x201, 97, 0, 8, 1, 0);
+}
+
+uint32_t SimNode::getRequestCount() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return requestCount_;
+}
+
+std::string SimNode::getJson() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return buildJsonLocked(millis());
+}
+
+// ============================================================================
+// Frame handling
+// ============================================================================
+
+void SimNode::onFrame(const twai_message_t& frame, std::vector<twai_message_t>& replies) {
+  if (frame.extd || frame.identifier != (uint32_t)(SDO_REQUEST_BASE_ID | nodeId_) || frame.data_length_code < 8) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  requestCount_++;
+
+  uint8_t command = frame.data[0];
+  uint16_t index = frame.data[1] | (frame.data[2] << 8);
+  uint8_t subIndex = frame.data[3];
+  uint32_t data;
+  memcpy(&data, &frame.data[4], sizeof(data));
+
+  uint8_t specifier = command & 0xE0;
+  if (specifier == REQUEST_UPLOAD) {
+    handleRead(index, subIndex, replies);
+  } else if (specifier == REQUEST_DOWNLOAD) {
+    handleWrite(index, subIndex, data, replies);
+  } else if (specifier == REQUEST_SEGMENT) {
+    handleSegment(command, replies);
+  } else if (specifier == REQUEST_BLOCK_UPLOAD) {
+    handleBlockUpload(frame, replies);
+  } else {
+    // Client abort or unsupported command specifier
+    upload_.clear();
+  }
+}
+
+twai_message_t SimNode::makeReply(uint8_t command, uint16_t index, uint8_t subIndex, uint32_t data) const {
+  twai_message_t reply = {};
+  reply.identifier = SDO_RESPONSE_BASE_ID | nodeId_;
+  reply.data_length_code = 8;
+  reply.data[0] = command;
+  reply.data[1] = index & 0xFF;
+  reply.data[2] = index >> 8;
+  reply.data[3] = subIndex;
+  memcpy(&reply.data[4], &data, sizeof(data));
+  return reply;
+}
+
+twai_message_t SimNode::makeAbort(uint16_t index, uint8_t subIndex, uint32_t code) const {
+  return makeReply(ABORT, index, subIndex, code);
+}
+
+void SimNode::handleRead(uint16_t index, uint8_t subIndex, std::vector<twai_message_t>& replies) {
+  uint32_t nowMs = millis();
+
+  if (index == INDEX_SERIAL && subIndex < 4) {
+    replies.push_back(makeReply(READ_REPLY, index, subIndex, serial_[subIndex]));
+  } else if (index == INDEX_STRINGS && subIndex == 0) {
+    // Segmented upload: size in the initiate reply, data follows on segment requests
+    upload_ = buildJsonLocked(nowMs);
+    uploadOffset_ = 0;
+    uploadToggle_ = false;
+    replies.push_back(makeReply(RESPONSE_UPLOAD | SIZE_SPECIFIED, index, subIndex, (uint32_t)upload_.size()));
+  } else if ((index & 0xFF00) == INDEX_PARAM_UID) {
+    int paramId = ((index & 0xFF) << 8) | subIndex;
+    auto entry = values_.find(paramId);
+    if (entry == values_.end()) {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+      return;
+    }
+    Value& value = entry->second;
+    double current = value.generator ? value.generator(nowMs) : value.value;
+    replies.push_back(makeReply(READ_REPLY, index, subIndex, (uint32_t)(int32_t)lround(current * 32)));
+  } else if (index == INDEX_ERROR_NUM || index == INDEX_ERROR_TIME) {
+    if (subIndex >= ERROR_BUFFER_SIZE) {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+      return;
+    }
+    uint32_t data = 0;
+    if (subIndex < errors_.size()) {
+      data = index == INDEX_ERROR_NUM ? errors_[subIndex].first : errors_[subIndex].second;
+    }
+    replies.push_back(makeReply(READ_REPLY, index, subIndex, data));
+  } else if (index >= INDEX_MAP_RD && index < INDEX_MAP_RD + 2 * MAX_MAPPING_MESSAGES) {
+    uint32_t data;
+    if (readMapping(index, subIndex, data)) {
+      replies.push_back(makeReply(READ_REPLY, index, subIndex, data));
+    } else {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+    }
+  } else {
+    replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+  }
+}
+
+void SimNode::handleWrite(uint16_t index, uint8_t subIndex, uint32_t data, std::vector<twai_message_t>& replies) {
+  if ((index & 0xFF00) == INDEX_PARAM_UID) {
+    int paramId = ((index & 0xFF) << 8) | subIndex;
+    auto entry = values_.find(paramId);
+    if (entry == values_.end() || !entry->second.isParam) {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+      return;
+    }
+    double value = (int32_t)data / 32.0;
+    if (value < entry->second.minimum || value > entry->second.maximum) {
+      replies.push_back(makeAbort(index, subIndex, ERR_RANGE));
+      return;
+    }
+    entry->second.value = value;
+  } else if (index == INDEX_COMMANDS) {
+    if (subIndex == CMD_DEFAULTS) {
+      restoreDefaults();
+    } else if (subIndex == CMD_RESET) {
+      upload_.clear();
+    } else if (subIndex != CMD_SAVE && subIndex != CMD_LOAD && subIndex != CMD_START && subIndex != CMD_STOP) {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+      return;
+    }
+  } else if (index == INDEX_MAP_TX || index == INDEX_MAP_RX) {
+    // Three writes per item: COB ID, then param/position/length, then gain/offset commits it
+    if (subIndex == 0) {
+      pendingMappingCobId_ = data;
+    } else if (subIndex == 1) {
+      pendingMapping_.paramId = data & 0xFFFF;
+      pendingMapping_.position = (data >> 16) & 0xFF;
+      pendingMapping_.length = (int8_t)(data >> 24);
+    } else if (subIndex == 2) {
+      int32_t gain = (int32_t)((data & 0xFFFFFF) << 8) >> 8;
+      std::vector<MappingMessage>& messages = index == INDEX_MAP_RX ? rxMappings_ : txMappings_;
+      MappingItem item = pendingMapping_;
+      item.gainFixed = gain;
+      item.offset = (int8_t)(data >> 24);
+
+      bool added = false;
+      for (MappingMessage& message : messages) {
+        if (message.cobId == pendingMappingCobId_) {
+          message.items.push_back(item);
+          added = true;
+          break;
+        }
+      }
+      if (!added) {
+        if ((int)messages.size() >= MAX_MAPPING_MESSAGES || pendingMappingCobId_ > 0x7FF) {
+          replies.push_back(makeAbort(index, subIndex, ERR_RANGE));
+          return;
+        }
+        messages.push_back({pendingMappingCobId_, {item}});
+      }
+    } else {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+      return;
+    }
+  } else if (index >= INDEX_MAP_RD && index < INDEX_MAP_RD + 2 * MAX_MAPPING_MESSAGES) {
+    if (!removeMapping(index, subIndex)) {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+      return;
+    }
+  } else {
+    replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+    return;
+  }
+
+  replies.push_back(makeReply(WRITE_REPLY, index, subIndex, 0));
+}
+
+void SimNode::handleSegment(uint8_t command, std::vector<twai_message_t>& replies) {
+  bool toggle = (command & TOGGLE_BIT) != 0;
+  if (upload_.empty() && uploadOffset_ == 0) {
+    replies.push_back(makeAbort(INDEX_STRINGS, 0, ERR_GENERAL));
+    return;
+  }
+  if (toggle != uploadToggle_) {
+    replies.push_back(makeAbort(INDEX_STRINGS, 0, ERR_TOGGLE));
+    upload_.clear();
+    uploadOffset_ = 0;
+    return;
+  }
+
+  size_t remaining = upload_.size() - uploadOffset_;
+  size_t count = remaining < 7 ? remaining : 7;
+  bool last = remaining <= 7;
+
+  twai_message_t reply = {};
+  reply.identifier = SDO_RESPONSE_BASE_ID | nodeId_;
+  reply.data_length_code = 8;
+  reply.data[0] = (toggle ? TOGGLE_BIT : 0) | (last ? (((7 - count) << 1) | SIZE_SPECIFIED) : 0);
+  memcpy(&reply.data[1], upload_.data() + uploadOffset_, count);
+  replies.push_back(reply);
+
+  uploadOffset_ += count;
+  uploadToggle_ = !uploadToggle_;
+  if (last) {
+    upload_.clear();
+    uploadOffset_ = 0;
+  }
+}
+
+void SimNode::handleBlockUpload(const twai_message_t& frame, std::vector<twai_message_t>& replies) {
+  uint8_t subCommand = frame.data[0] & 0x03;
+  uint16_t index = frame.data[1] | (frame.data[2] << 8);
+  uint8_t subIndex = frame.data[3];
+
+  if (subCommand == 0) {
+    // Initiate: only the parameter JSON is offered as a block upload
+    if (!blockUploadSupported_) {
+      replies.push_back(makeAbort(index, subIndex, ERR_COMMAND));
+      return;
+    }
+    if (index != INDEX_STRINGS || subIndex != 0 || frame.data[4] == 0 || frame.data[4] > 127) {
+      replies.push_back(makeAbort(index, subIndex, ERR_INVIDX));
+      return;
+    }
+    upload_ = buildJsonLocked(millis());
+    uploadOffset_ = 0;
+    blockSize_ = frame.data[4];
+    replies.push_back(makeReply(RESPONSE_BLOCK_UPLOAD | BLOCK_CRC_SUPPORTED | BLOCK_SIZE_INDICATED, index, subIndex,
+                                (uint32_t)upload_.size()));
+    return;
+  }
+
+  if (upload_.empty()) {
+    if (subCommand != BLOCK_UPLOAD_END) {
+      replies.push_back(makeAbort(INDEX_STRINGS, 0, ERR_GENERAL));
+    }
+    return;
+  }
+
+  if (subCommand == BLOCK_UPLOAD_START) {
+    sendBlock(replies);
+  } else if (subCommand == BLOCK_UPLOAD_ACK) {
+    // Everything up to the acknowledged segment arrived; continue (or resend) after it
+    size_t acked = blockStart_ + (size_t)frame.data[1] * 7;
+    uploadOffset_ = acked < upload_.size() ? acked : upload_.size();
+    if (frame.data[2] > 0 && frame.data[2] <= 127) {
+      blockSize_ = frame.data[2];
+    }
+
+    if (uploadOffset_ < upload_.size()) {
+      sendBlock(replies);
+    } else {
+      // End: unused bytes of the last segment, CRC over all data in bytes 1-2
+      uint8_t unused = (7 - upload_.size() % 7) % 7;
+      uint16_t crc = blockCrc((const uint8_t*)upload_.data(), upload_.size());
+      replies.push_back(makeReply(RESPONSE_BLOCK_UPLOAD | (unused << 2) | BLOCK_UPLOAD_END, crc, 0, 0));
+    }
+  } else {
+    // Client's end response
+    upload_.clear();
+    uploadOffset_ = 0;
+  }
+}
+
+void SimNode::sendBlock(std::vector<twai_message_t>& replies) {
+  blockStart_ = uploadOffset_;
+  size_t offset = uploadOffset_;
+  for (uint8_t sequence = 1; sequence <= blockSize_ && offset < upload_.size(); sequence++) {
+    size_t remaining = upload_.size() - offset;
+    size_t count = remaining < 7 ? remaining : 7;
+    bool last = remaining <= 7;
+
+    twai_message_t reply = {};
+    reply.identifier = SDO_RESPONSE_BASE_ID | nodeId_;
+    reply.data_length_code = 8;
+    reply.data[0] = sequence | (last ? BLOCK_LAST_SEGMENT : 0);
+    memcpy(&reply.data[1], upload_.data() + offset, count);
+    replies.push_back(reply);
+    offset += count;
+  }
+}
+
+bool SimNode::readMapping(uint16_t index, uint8_t subIndex, uint32_t& data) {
+  bool isRx = index >= INDEX_MAP_RD + MAX_MAPPING_MESSAGES;
+  const std::vector<MappingMessage>& messages = isRx ? rxMappings_ : txMappings_;
+  size_t messageIndex = index - INDEX_MAP_RD - (isRx ? MAX_MAPPING_MESSAGES : 0);
+  if (messageIndex >= messages.size()) {
+    return false;
+  }
+
+  const MappingMessage& message = messages[messageIndex];
+  if (subIndex == 0) {
+    data = message.cobId;
+    return true;
+  }
+
+  // Odd subindexes: param/position/length, even: gain/offset
+  size_t itemIndex = (subIndex - 1) / 2;
+  if (itemIndex >= message.items.size()) {
+    return false;
+  }
+  const MappingItem& item = message.items[itemIndex];
+  if (subIndex % 2 == 1) {
+    data = item.paramId | ((uint32_t)item.position << 16) | ((uint32_t)(uint8_t)item.length << 24);
+  } else {
+    data = ((uint32_t)item.gainFixed & 0xFFFFFF) | ((uint32_t)(uint8_t)item.offset << 24);
+  }
+  return true;
+}
+
+bool SimNode::removeMapping(uint16_t index, uint8_t subIndex) {
+  bool isRx = index >= INDEX_MAP_RD + MAX_MAPPING_MESSAGES;
+  std::vector<MappingMessage>& messages = isRx ? rxMappings_ : txMappings_;
+  size_t messageIndex = index - INDEX_MAP_RD - (isRx ? MAX_MAPPING_MESSAGES : 0);
+  if (messageIndex >= messages.size()) {
+    return false;
+  }
+
+  MappingMessage& message = messages[messageIndex];
+  if (subIndex == 0) {
+    messages.erase(messages.begin() + messageIndex);
+    return true;
+  }
+
+  size_t itemIndex = (subIndex - 1) / 2;
+  if (itemIndex >= message.items.size()) {
+    return false;
+  }
+  message.items.erase(message.items.begin() + itemIndex);
+  if (message.items.empty()) {
+    messages.erase(messages.begin() + messageIndex);
+  }
+  return true;
+}
+
+void SimNode::restoreDefaults() {
+  for (auto& entry : values_) {
+    if (entry.second.isParam) {
+      entry.second.value = entry.second.defaultValue;
+    }
+  }
+}
+
+// ============================================================================
+// Parameter JSON (same layout as the OpenInverter firmware)
+// ============================================================================
+
+static void appendJsonString(std::string& out, const std::string& value) {
+  out += '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+static void appendJsonNumber(std::string& out, double value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.6g", value);
+  out += buf;
+}
+
+std::string SimNode::buildJsonLocked(uint32_t nowMs) {
+  std::string json = "{";
+  bool first = true;
+
+  for (auto& entry : values_) {
+    const Value& value = entry.second;
+    if (!first) {
+      json += ",";
+    }
+    first = false;
+
+    appendJsonString(json, value.name);
+    json += ":{\"unit\":";
+    appendJsonString(json, value.name == "lasterr" ? errorDescriptions_ : value.unit);
+    json += ",\"value\":";
+    appendJsonNumber(json, value.generator ? value.generator(nowMs) : value.value);
+    json += value.isParam ? ",\"isparam\":true" : ",\"isparam\":false";
+    if (value.isParam) {
+      json += ",\"minimum\":";
+      appendJsonNumber(json, value.minimum);
+      json += ",\"maximum\":";
+      appendJsonNumber(json, value.maximum);
+      json += ",\"default\":";
+      appendJsonNumber(json, value.defaultValue);
+      json += ",\"category\":";
+      appendJsonString(json, value.category);
+    }
+    json += ",\"id\":";
+    json += std::to_string(entry.first);
+    json += "}";
+  }
+
+  json += "}";
+  return json;
+}
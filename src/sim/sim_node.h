@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sim_bus.h"
+
+/**
+ * Simulated OpenInverter node (native build only)
+ *
+ * Answers the SDO traffic the web interface generates: serial number (0x5000), parameter
+ * and spot value reads/writes by UID (0x21xx), segmented or block upload of the parameter
+ * JSON (0x5001), commands (0x5002), error log (0x5003/0x5004) and CAN mappings (0x3000/0x3001
+ * writes, 0x3100/0x3180 reads and removals). Values use the firmware's x32 fixed point.
+ */
+class SimNode : public SimBusDevice {
+public:
+  SimNode(uint8_t nodeId, const uint32_t serial[4]);
+
+  // Device content (set up before the bus is used; safe to call later)
+  void addParameter(const char* name, int id, double value, double minimum, double maximum, const char* unit,
+                    const char* category);
+  void addSpotValue(const char* name, int id, const char* unit, std::function<double(uint32_t nowMs)> generator);
+  void addError(uint32_t errorNum, uint32_t errorTime);
+  void addCanMapping(bool isRx, uint32_t cobId, uint16_t paramId, uint8_t position, int8_t length, double gain,
+                     int8_t offset);
+  void setErrorDescriptions(const char* unitString) { errorDescriptions_ = unitString; }
+
+  // Populate a representative inverter: ~20 parameters, ~40 spot values, a few errors and mappings
+  void loadDefaultDevice();
+
+  void setResponseDelayUs(uint32_t delayUs) { responseDelayUs_ = delayUs; }
+  uint32_t getResponseDelayUs() const override { return responseDelayUs_; }
+
+  // Answer block upload requests with an abort, like firmware without block transfer support
+  void setBlockUploadSupported(bool supported) { blockUploadSupported_ = supported; }
+
+  uint8_t getNodeId() const { return nodeId_; }
+  uint32_t getRequestCount() const;
+  std::string getJson();
+
+  void onFrame(const twai_message_t& frame, std::vector<twai_message_t>& replies) override;
+
+private:
+  struct Value {
+    std::string name;
+    std::string unit;
+    std::string category;
+    bool isParam = false;
+    double value = 0;
+    double defaultValue = 0;
+    double minimum = 0;
+    double maximum = 0;
+    std::function<double(uint32_t)> generator;
+  };
+
+  struct MappingItem {
+    uint16_t paramId;
+    uint8_t position;
+    int8_t length;
+    int32_t gainFixed;  // Gain x1000, 24-bit signed on the wire
+    int8_t offset;
+  };
+
+  struct MappingMessage {
+    uint32_t cobId;
+    std::vector<MappingItem> items;
+  };
+
+  static const uint8_t ERROR_BUFFER_SIZE = 16;
+  static const int MAX_MAPPING_MESSAGES = 0x80;  // Per direction (0x3100-0x317F / 0x3180-0x31FF)
+
+  twai_message_t makeReply(uint8_t command, uint16_t index, uint8_t subIndex, uint32_t data) const;
+  twai_message_t makeAbort(uint16_t index, uint8_t subIndex, uint32_t code) const;
+
+  void handleRead(uint16_t index, uint8_t subIndex, std::vector<twai_message_t>& replies);
+  void handleWrite(uint16_t index, uint8_t subIndex, uint32_t data, std::vector<twai_message_t>& replies);
+  void handleSegment(uint8_t command, std::vector<twai_message_t>& replies);
+  void handleBlockUpload(const twai_message_t& frame, std::vector<twai_message_t>& replies);
+  void sendBlock(std::vector<twai_message_t>& replies);
+
+  bool readMapping(uint16_t index, uint8_t subIndex, uint32_t& data);
+  bool removeMapping(uint16_t index, uint8_t subIndex);
+  void restoreDefaults();
+  std::string buildJsonLocked(uint32_t nowMs);
+
+  uint8_t nodeId_;
+  uint32_t serial_[4];
+  uint32_t responseDelayUs_ = 100;
+  bool blockUploadSupported_ = true;
+
+  mutable std::mutex lock_;
+  std::map<int, Value> values_;                        // By parameter UID
+  std::vector<std::pair<uint32_t, uint32_t>> errors_;  // (number, time), oldest first
+  std::string errorDescriptions_;
+  std::vector<MappingMessage> txMappings_;
+  std::vector<MappingMessage> rxMappings_;
+  MappingItem pendingMapping_ = {};
+  uint32_t pendingMappingCobId_ = 0;
+  uint32_t requestCount_ = 0;
+
+  // Segmented or block upload in progress
+  std::string upload_;
+  size_t uploadOffset_ = 0;
+  bool uploadToggle_ = false;
+  uint8_t blockSize_ = 0;  // Segments per block, as asked for by the client
+  size_t blockStart_ = 0;  // Offset of the current block's first segment
+};
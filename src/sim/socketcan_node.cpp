@@ -0,0 +1,73 @@
+#include "socketcan_node.h"
+
+#include <Arduino.h>
+
+#include <cstring>
+#include <vector>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "models/can_types.h"
+
+#define DBG_OUTPUT_PORT Serial
+
+int runSocketCanNode(SimNode& node, const char* interfaceName) {
+  int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  ifreq ifr = {};
+  strncpy(ifr.ifr_name, interfaceName, IFNAMSIZ - 1);
+  if (fd < 0 || ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+    DBG_OUTPUT_PORT.printf("[SimNode] Interface %s not available\n", interfaceName);
+    return 1;
+  }
+
+  sockaddr_can addr = {};
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    DBG_OUTPUT_PORT.printf("[SimNode] Cannot bind to %s\n", interfaceName);
+    close(fd);
+    return 1;
+  }
+
+  // Only SDO requests for this node
+  can_filter filter = {(canid_t)(SDO_REQUEST_BASE_ID | node.getNodeId()), CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG};
+  setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
+
+  DBG_OUTPUT_PORT.printf("[SimNode] Node %d serving on %s\n", node.getNodeId(), interfaceName);
+
+  std::vector<twai_message_t> replies;
+  while (true) {
+    can_frame in;
+    if (read(fd, &in, sizeof(in)) != sizeof(in)) {
+      DBG_OUTPUT_PORT.println("[SimNode] Socket read failed");
+      close(fd);
+      return 1;
+    }
+
+    twai_message_t request = {};
+    request.identifier = in.can_id & CAN_SFF_MASK;
+    request.data_length_code = in.can_dlc;
+    memcpy(request.data, in.data, sizeof(request.data));
+
+    replies.clear();
+    node.onFrame(request, replies);
+    if (!replies.empty() && node.getResponseDelayUs() > 0) {
+      delayMicroseconds(node.getResponseDelayUs());
+    }
+
+    for (const twai_message_t& reply : replies) {
+      can_frame out = {};
+      out.can_id = reply.identifier;
+      out.can_dlc = reply.data_length_code;
+      memcpy(out.data, reply.data, sizeof(out.data));
+      if (write(fd, &out, sizeof(out)) != sizeof(out)) {
+        DBG_OUTPUT_PORT.println("[SimNode] Reply dropped (interface TX queue full)");
+      }
+    }
+  }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "sim_node.h"
+
+// Serve a simulated node on a SocketCAN interface until the process is stopped (native-socketcan).
+// Lets the CAN stack in another process - or real tooling such as cansend - talk to it over vcan0.
+// Returns only on socket errors, with a non-zero exit code.
+int runSocketCanNode(SimNode& node, const char* interfaceName);
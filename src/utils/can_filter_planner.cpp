@@ -0,0 +1,156 @@
+#include "can_filter_planner.h"
+
+#include <bitset>
+
+namespace {
+
+const uint32_t STANDARD_ID_COUNT = 0x800;
+const uint16_t STANDARD_ID_MASK = 0x7FF;
+
+// Above this many blocks the split search (2^(n-1) candidates) is preceded by greedy merging
+const size_t MAX_EXHAUSTIVE_BLOCKS = 12;
+
+// IDs matching code on every bit that is 0 in mask (TWAI convention: mask bit 1 = don't care)
+struct IdCube {
+  uint16_t code;
+  uint16_t mask;
+};
+
+uint32_t cubeSize(const IdCube& cube) {
+  return 1u << __builtin_popcount(cube.mask);
+}
+
+IdCube mergeCubes(const IdCube& a, const IdCube& b) {
+  uint16_t mask = a.mask | b.mask | (a.code ^ b.code);
+  return {(uint16_t)(a.code & ~mask), mask};
+}
+
+uint32_t overlapSize(const IdCube& a, const IdCube& b) {
+  if ((a.code ^ b.code) & ~a.mask & ~b.mask & STANDARD_ID_MASK) {
+    return 0;
+  }
+  return 1u << __builtin_popcount(a.mask & b.mask);
+}
+
+bool containsCube(const IdCube& outer, const IdCube& inner) {
+  return (inner.mask & ~outer.mask) == 0 && ((inner.code ^ outer.code) & ~outer.mask) == 0;
+}
+
+// Split a range into maximal aligned power-of-two blocks, each an exact cube
+void addRangeBlocks(uint16_t first, uint16_t last, std::vector<IdCube>& blocks) {
+  uint32_t id = first;
+  while (id <= last) {
+    uint32_t size = id == 0 ? STANDARD_ID_COUNT : (id & -id);
+    while (id + size - 1 > last) {
+      size >>= 1;
+    }
+    blocks.push_back({(uint16_t)id, (uint16_t)(size - 1)});
+    id += size;
+  }
+}
+
+void removeContainedBlocks(std::vector<IdCube>& blocks) {
+  for (size_t i = 0; i < blocks.size();) {
+    bool contained = false;
+    for (size_t j = 0; j < blocks.size() && !contained; j++) {
+      contained = j != i && containsCube(blocks[j], blocks[i]) &&
+                  (!containsCube(blocks[i], blocks[j]) || j < i);  // Identical blocks: keep the first
+    }
+    if (contained) {
+      blocks.erase(blocks.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+// Merge the pair whose combined cube is smallest until the split search is cheap enough
+void reduceBlocks(std::vector<IdCube>& blocks) {
+  while (blocks.size() > MAX_EXHAUSTIVE_BLOCKS) {
+    size_t bestA = 0, bestB = 1;
+    uint32_t bestSize = UINT32_MAX;
+    for (size_t a = 0; a < blocks.size(); a++) {
+      for (size_t b = a + 1; b < blocks.size(); b++) {
+        uint32_t size = cubeSize(mergeCubes(blocks[a], blocks[b]));
+        if (size < bestSize) {
+          bestSize = size;
+          bestA = a;
+          bestB = b;
+        }
+      }
+    }
+    blocks[bestA] = mergeCubes(blocks[bestA], blocks[bestB]);
+    blocks.erase(blocks.begin() + bestB);
+    removeContainedBlocks(blocks);
+  }
+}
+
+}  // namespace
+
+CanFilterPlan planAcceptanceFilter(const std::vector<CanIdRange>& wanted) {
+  CanFilterPlan plan;
+  plan.config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+  plan.acceptedIds = STANDARD_ID_COUNT;
+
+  std::bitset<STANDARD_ID_COUNT> wantedSet;
+  std::vector<IdCube> blocks;
+  for (const CanIdRange& range : wanted) {
+    uint16_t last = range.last > STANDARD_ID_MASK ? STANDARD_ID_MASK : range.last;
+    if (range.first > last) {
+      continue;
+    }
+    for (uint32_t id = range.first; id <= last; id++) {
+      wantedSet.set(id);
+    }
+    addRangeBlocks(range.first, last, blocks);
+  }
+
+  plan.wantedIds = wantedSet.count();
+  if (blocks.empty()) {
+    plan.falseAcceptRatio = 1.0f;
+    return plan;
+  }
+
+  removeContainedBlocks(blocks);
+  reduceBlocks(blocks);
+
+  // Block 0 always goes to the first filter, so each split is tried once
+  IdCube bestFirst = blocks[0], bestSecond = blocks[0];
+  uint32_t bestAccepted = UINT32_MAX;
+  uint32_t splits = 1u << (blocks.size() - 1);
+  for (uint32_t split = 0; split < splits; split++) {
+    IdCube first = blocks[0];
+    IdCube second = {0, 0};
+    bool secondUsed = false;
+    for (size_t i = 1; i < blocks.size(); i++) {
+      if (split & (1u << (i - 1))) {
+        second = secondUsed ? mergeCubes(second, blocks[i]) : blocks[i];
+        secondUsed = true;
+      } else {
+        first = mergeCubes(first, blocks[i]);
+      }
+    }
+    if (!secondUsed) {
+      second = first;
+    }
+
+    uint32_t accepted = cubeSize(first) + cubeSize(second) - overlapSize(first, second);
+    if (accepted < bestAccepted) {
+      bestAccepted = accepted;
+      bestFirst = first;
+      bestSecond = second;
+    }
+  }
+
+  // Dual filter layout for standard frames: filter 1 compares bits 31:21 (ID), 20 (RTR)
+  // and data byte 0 in 19:16 + 3:0; filter 2 compares bits 15:5 (ID) and 4 (RTR).
+  // RTR and data are always don't-care.
+  plan.config.acceptance_code = ((uint32_t)bestFirst.code << 21) | ((uint32_t)bestSecond.code << 5);
+  plan.config.acceptance_mask = ((uint32_t)bestFirst.mask << 21) | (0x1Fu << 16) | ((uint32_t)bestSecond.mask << 5) |
+                                0x1Fu;
+  plan.config.single_filter = false;
+
+  plan.acceptedIds = bestAccepted;
+  plan.falseAcceptRatio = (float)(bestAccepted - plan.wantedIds) / bestAccepted;
+  return plan;
+}
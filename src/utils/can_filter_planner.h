@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "driver/twai.h"
+
+#include "models/can_types.h"
+
+/**
+ * Plans the TWAI acceptance filter for a set of wanted standard (11-bit) IDs.
+ *
+ * Each hardware filter is an ID code/mask pair and accepts a "cube": every ID that
+ * matches the code on the bits the mask cares about. Dual filter mode gives two cubes,
+ * single filter mode only one, so dual mode is never worse for standard frames and is
+ * always used. The planner splits the wanted IDs into at most two groups, covers each
+ * with its smallest cube and keeps the split that accepts the fewest IDs overall.
+ *
+ * Extended frames are not planned for: dual mode compares their ID bits 28:13 with the
+ * same codes, so a few may still be accepted (CanRouter ignores them).
+ */
+struct CanFilterPlan {
+  twai_filter_config_t config;
+  uint16_t wantedIds = 0;        // Distinct standard IDs requested
+  uint16_t acceptedIds = 0;      // Standard IDs the filter lets through
+  float falseAcceptRatio = 0.0f;  // Share of accepted IDs nobody asked for
+};
+
+// An empty set plans an accept-all filter
+CanFilterPlan planAcceptanceFilter(const std::vector<CanIdRange>& wanted);
@@ -1,10 +1,63 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+
 #include "can_task.h"
 #include "driver/twai.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
+/**
+ * Lock-free single-producer/single-consumer ring buffer
+ *
+ * For hand-offs where exactly one task pushes and exactly one task pops (e.g. RX task ->
+ * canTask). Neither side blocks or enters a critical section, and each item is copied once
+ * in and once out. Head and tail are free-running counters, so all Capacity slots are usable.
+ * Capacity must be a power of two.
+ *
+ * Not safe with more than one producer or more than one consumer - use a FreeRTOS queue there.
+ */
+template <typename T, uint32_t Capacity> class SpscRing {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+  // Producer side. Returns false (item not stored) when full.
+  bool push(const T& item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= Capacity) {
+      return false;
+    }
+    items_[head & (Capacity - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool pop(T* item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) {
+      return false;
+    }
+    *item = items_[tail & (Capacity - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Discards everything currently queued.
+  void clear() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+  // Either side; a snapshot that may be stale by the time it is used
+  uint32_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+  bool empty() const { return size() == 0; }
+  static constexpr uint32_t capacity() { return Capacity; }
+
+private:
+  T items_[Capacity];
+  std::atomic<uint32_t> head_{0};  // Written by the producer only
+  std::atomic<uint32_t> tail_{0};  // Written by the consumer only
+};
+
 // Queue-based CAN I/O functions for SDO protocol layer
 // These replace direct twai_transmit/twai_receive calls
 
@@ -12,13 +65,12 @@
  * Transmit a CAN frame via the TX queue
  * @param frame Pointer to the frame to transmit
  * @param timeout Ticks to wait if queue is full
+ * @param priority TX class; higher classes are always sent first
  * @return true if frame was queued successfully
  */
-inline bool canQueueTransmit(const twai_message_t* frame, TickType_t timeout = pdMS_TO_TICKS(10)) {
-  if (canTxQueue == nullptr) {
-    return false;
-  }
-  return xQueueSend(canTxQueue, frame, timeout) == pdTRUE;
+inline bool canQueueTransmit(const twai_message_t* frame, TickType_t timeout = pdMS_TO_TICKS(10),
+                             CanTxPriority priority = CAN_TX_SDO) {
+  return canTxEnqueue(frame, timeout, priority);
 }
 
 /**
@@ -0,0 +1,162 @@
+#include "can_queue_benchmark.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "can_queue.h"
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#define DBG_OUTPUT_PORT Serial
+
+#define BENCH_DEPTH 32               // Matches the CanRouter deferred ring
+#define BENCH_COST_ITERATIONS 20000  // Enqueue/dequeue pairs per cost run
+#define BENCH_LATENCY_SAMPLES 200    // Cross-task hand-offs per latency run
+
+typedef SpscRing<twai_message_t, BENCH_DEPTH> BenchRing;
+
+struct LatencyResult {
+  uint32_t minUs = UINT32_MAX;
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+  uint32_t samples = 0;
+
+  void add(uint32_t us) {
+    minUs = std::min(minUs, us);
+    maxUs = std::max(maxUs, us);
+    totalUs += us;
+    samples++;
+  }
+};
+
+// Shared with the producer task for the latency runs
+static BenchRing* benchRing = nullptr;
+static QueueHandle_t benchQueue = nullptr;
+static TaskHandle_t benchConsumer = nullptr;
+static volatile bool benchUseRing = false;
+
+static twai_message_t makeBenchFrame() {
+  twai_message_t frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.identifier = 0x581;
+  frame.data_length_code = 8;
+  return frame;
+}
+
+// Average cost of one enqueue + dequeue pair in the calling task, in nanoseconds
+static uint32_t measureRingCostNs(BenchRing& ring) {
+  twai_message_t in = makeBenchFrame();
+  twai_message_t out;
+
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < BENCH_COST_ITERATIONS; i++) {
+    in.data[0] = (uint8_t)i;
+    ring.push(in);
+    ring.pop(&out);
+  }
+  return (uint32_t)(((uint64_t)(micros() - start) * 1000) / BENCH_COST_ITERATIONS);
+}
+
+static uint32_t measureQueueCostNs(QueueHandle_t queue) {
+  twai_message_t in = makeBenchFrame();
+  twai_message_t out;
+
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < BENCH_COST_ITERATIONS; i++) {
+    in.data[0] = (uint8_t)i;
+    xQueueSend(queue, &in, 0);
+    xQueueReceive(queue, &out, 0);
+  }
+  return (uint32_t)(((uint64_t)(micros() - start) * 1000) / BENCH_COST_ITERATIONS);
+}
+
+// Producer: stamps each frame with micros() and hands it over the same way the RX task
+// does in production (ring + task notification, or a plain queue send)
+static void benchProducerTask(void* parameter) {
+  twai_message_t frame = makeBenchFrame();
+
+  for (uint32_t i = 0; i < BENCH_LATENCY_SAMPLES; i++) {
+    vTaskDelay(1);
+    uint32_t now = micros();
+    memcpy(frame.data, &now, sizeof(now));
+    if (benchUseRing) {
+      benchRing->push(frame);
+      xTaskNotifyGive(benchConsumer);
+    } else {
+      xQueueSend(benchQueue, &frame, portMAX_DELAY);
+    }
+  }
+  vTaskDelete(nullptr);
+}
+
+static LatencyResult measureLatency(bool useRing) {
+  LatencyResult result;
+  benchUseRing = useRing;
+  benchConsumer = xTaskGetCurrentTaskHandle();
+
+  // Producer above the consumer, as the RX task is above canTask
+  xTaskCreate(benchProducerTask, "QBench", 2048, nullptr, uxTaskPriorityGet(nullptr) + 1, nullptr);
+
+  twai_message_t frame;
+  while (result.samples < BENCH_LATENCY_SAMPLES) {
+    bool received;
+    if (useRing) {
+      received = benchRing->pop(&frame);
+      if (!received) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        continue;
+      }
+    } else {
+      received = xQueueReceive(benchQueue, &frame, pdMS_TO_TICKS(100)) == pdTRUE;
+    }
+    if (!received) {
+      break;  // Producer stalled - report what we have
+    }
+
+    uint32_t sentUs;
+    memcpy(&sentUs, frame.data, sizeof(sentUs));
+    result.add(micros() - sentUs);
+  }
+  return result;
+}
+
+static void printLatency(const char* name, const LatencyResult& result) {
+  if (result.samples == 0) {
+    DBG_OUTPUT_PORT.printf("[QBench] %-14s latency: no samples\n", name);
+    return;
+  }
+  DBG_OUTPUT_PORT.printf("[QBench] %-14s latency: min %lu us, avg %lu us, max %lu us (%lu samples)\n", name,
+                         (unsigned long)result.minUs, (unsigned long)(result.totalUs / result.samples),
+                         (unsigned long)result.maxUs, (unsigned long)result.samples);
+}
+
+void runCanQueueBenchmark() {
+  BenchRing* ring = new BenchRing();
+  QueueHandle_t queue = xQueueCreate(BENCH_DEPTH, sizeof(twai_message_t));
+  if (queue == nullptr) {
+    DBG_OUTPUT_PORT.println("[QBench] Failed to create queue");
+    delete ring;
+    return;
+  }
+  benchRing = ring;
+  benchQueue = queue;
+
+  DBG_OUTPUT_PORT.printf("[QBench] %u-byte frames, depth %u\n", (unsigned)sizeof(twai_message_t), BENCH_DEPTH);
+  DBG_OUTPUT_PORT.printf("[QBench] SpscRing       enqueue+dequeue: %lu ns\n", (unsigned long)measureRingCostNs(*ring));
+  DBG_OUTPUT_PORT.printf("[QBench] FreeRTOS queue enqueue+dequeue: %lu ns\n",
+                         (unsigned long)measureQueueCostNs(queue));
+
+  printLatency("SpscRing", measureLatency(true));
+  printLatency("FreeRTOS queue", measureLatency(false));
+
+  // Let the producer task finish deleting itself before the buffers go away
+  vTaskDelay(pdMS_TO_TICKS(10));
+  benchRing = nullptr;
+  benchQueue = nullptr;
+  vQueueDelete(queue);
+  delete ring;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Microbenchmark comparing SpscRing against a FreeRTOS queue for twai_message_t hand-offs.
+// Called from setup() when built with -DCAN_QUEUE_BENCHMARK (see [env:queue-benchmark]); prints to Serial.
+// Run before the CAN tasks start so they do not skew the numbers.
+void runCanQueueBenchmark();
@@ -0,0 +1,204 @@
+#include "can_router.h"
+
+#include <Arduino.h>
+
+#include <cstring>
+
+#include "can_task.h"
+
+#define DBG_OUTPUT_PORT Serial
+
+CanRouter& CanRouter::instance() {
+  static CanRouter instance;
+  return instance;
+}
+
+CanRouter::CanRouter() {
+  memset(idRoutes_, NO_ROUTE, sizeof(idRoutes_));
+  memset(sdoBlockRoutes_, NO_ROUTE, sizeof(sdoBlockRoutes_));
+
+  // The SDO response range is always handled by the second-stage SDO dispatcher
+  registerIdRange(SDO_RESPONSE_BASE_ID, SDO_RESPONSE_MAX_ID,
+                  [this](const twai_message_t& frame) { return dispatchSdo(frame); });
+}
+
+uint8_t CanRouter::addHandler(FrameHandler handler) {
+  if (handlers_.size() >= 255) {
+    DBG_OUTPUT_PORT.println("[CanRouter] Handler table full");
+    return NO_ROUTE;
+  }
+  handlers_.push_back(handler);
+  return (uint8_t)handlers_.size();
+}
+
+bool CanRouter::invoke(uint8_t slot, const twai_message_t& frame) const {
+  return slot != NO_ROUTE && handlers_[slot - 1](frame);
+}
+
+bool CanRouter::registerId(uint32_t canId, FrameHandler handler) {
+  return registerIdRange(canId, canId, handler);
+}
+
+bool CanRouter::registerIdRange(uint32_t firstId, uint32_t lastId, FrameHandler handler) {
+  if (firstId > lastId || lastId >= STANDARD_ID_COUNT) {
+    return false;
+  }
+  for (uint32_t id = firstId; id <= lastId; id++) {
+    if (idRoutes_[id] != NO_ROUTE) {
+      DBG_OUTPUT_PORT.printf("[CanRouter] ID 0x%03lX already routed\n", (unsigned long)id);
+      return false;
+    }
+  }
+
+  uint8_t slot = addHandler(handler);
+  if (slot == NO_ROUTE) {
+    return false;
+  }
+  for (uint32_t id = firstId; id <= lastId; id++) {
+    idRoutes_[id] = slot;
+  }
+  return true;
+}
+
+void CanRouter::getRoutedIds(std::vector<CanIdRange>& ranges) const {
+  uint32_t id = 0;
+  while (id < STANDARD_ID_COUNT) {
+    uint8_t slot = idRoutes_[id];
+    uint32_t first = id;
+    while (id < STANDARD_ID_COUNT && idRoutes_[id] == slot) {
+      id++;
+    }
+    if (slot != NO_ROUTE) {
+      ranges.push_back({(uint16_t)first, (uint16_t)(id - 1)});
+    }
+  }
+}
+
+void CanRouter::addSdoObserver(FrameHandler handler) {
+  sdoObservers_.push_back(handler);
+}
+
+void CanRouter::addSdoMatcher(FrameHandler handler) {
+  sdoMatchers_.push_back(handler);
+}
+
+void CanRouter::setSdoCapture(FrameHandler handler) {
+  sdoCapture_ = handler;
+}
+
+bool CanRouter::registerSdoEntry(uint16_t index, uint8_t subIndex, FrameHandler handler) {
+  uint32_t key = ((uint32_t)index << 8) | subIndex;
+  if (sdoEntryRoutes_.count(key) > 0) {
+    return false;
+  }
+  uint8_t slot = addHandler(handler);
+  if (slot == NO_ROUTE) {
+    return false;
+  }
+  sdoEntryRoutes_[key] = slot;
+  return true;
+}
+
+bool CanRouter::registerSdoIndex(uint16_t index, FrameHandler handler) {
+  if (sdoIndexRoutes_.count(index) > 0) {
+    return false;
+  }
+  uint8_t slot = addHandler(handler);
+  if (slot == NO_ROUTE) {
+    return false;
+  }
+  sdoIndexRoutes_[index] = slot;
+  return true;
+}
+
+bool CanRouter::registerSdoIndexBlock(uint8_t indexHighByte, FrameHandler handler) {
+  if (sdoBlockRoutes_[indexHighByte] != NO_ROUTE) {
+    return false;
+  }
+  uint8_t slot = addHandler(handler);
+  if (slot == NO_ROUTE) {
+    return false;
+  }
+  sdoBlockRoutes_[indexHighByte] = slot;
+  return true;
+}
+
+void CanRouter::setSdoFallback(FrameHandler handler) {
+  sdoFallback_ = handler;
+}
+
+bool CanRouter::dispatch(const twai_message_t& frame) {
+  if (frame.extd || frame.identifier >= STANDARD_ID_COUNT) {
+    return false;
+  }
+  return invoke(idRoutes_[frame.identifier], frame);
+}
+
+bool CanRouter::dispatchSdo(const twai_message_t& frame) {
+  for (const auto& observer : sdoObservers_) {
+    observer(frame);
+  }
+
+  for (const auto& matcher : sdoMatchers_) {
+    if (matcher(frame)) {
+      return true;
+    }
+  }
+
+  if (sdoCapture_ && sdoCapture_(frame)) {
+    return true;
+  }
+
+  // Keyed routes, most specific first
+  uint16_t index = frame.data[1] | (frame.data[2] << 8);
+  uint8_t subIndex = frame.data[3];
+
+  if (!sdoEntryRoutes_.empty()) {
+    auto entry = sdoEntryRoutes_.find(((uint32_t)index << 8) | subIndex);
+    if (entry != sdoEntryRoutes_.end() && invoke(entry->second, frame)) {
+      return true;
+    }
+  }
+  if (!sdoIndexRoutes_.empty()) {
+    auto route = sdoIndexRoutes_.find(index);
+    if (route != sdoIndexRoutes_.end() && invoke(route->second, frame)) {
+      return true;
+    }
+  }
+  if (invoke(sdoBlockRoutes_[index >> 8], frame)) {
+    return true;
+  }
+
+  return sdoFallback_ && sdoFallback_(frame);
+}
+
+CanRouter::FrameHandler CanRouter::deferred(FrameHandler handler) {
+  uint8_t index = (uint8_t)deferredHandlers_.size();
+  deferredHandlers_.push_back(handler);
+
+  return [this, index](const twai_message_t& frame) {
+    DeferredFrame item;
+    item.handler = index;
+    item.frame = frame;
+    if (!deferredRing_.push(item)) {
+      deferredDrops_++;
+    }
+    canTaskWake();
+    return true;
+  };
+}
+
+bool CanRouter::hasDeferred() const {
+  return !deferredRing_.empty();
+}
+
+void CanRouter::processDeferred() {
+  DeferredFrame item;
+  while (deferredRing_.pop(&item)) {
+    bool consumed = deferredHandlers_[item.handler](item.frame);
+    bool isSdo = item.frame.identifier >= SDO_RESPONSE_BASE_ID && item.frame.identifier <= SDO_RESPONSE_MAX_ID;
+    if (!consumed && isSdo && sdoFallback_) {
+      sdoFallback_(item.frame);
+    }
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "can_queue.h"
+#include "driver/twai.h"
+
+#include "models/can_types.h"
+
+/**
+ * Routes received CAN frames to registered consumers in constant time.
+ *
+ * Frame level: a slot table indexed by the 11-bit standard ID.
+ * SDO responses (0x580 + node) go through a second stage:
+ *   1. observers    - see every response, never consume (e.g. last-seen tracking)
+ *   2. matchers     - outstanding-request matching (e.g. SdoTransactionTable)
+ *   3. capture      - takes everything while active (e.g. segmented JSON upload)
+ *   4. keyed routes - exact index/subindex, then index, then index high byte
+ *   5. fallback     - anything left (sdoResponseQueue for blocking callers)
+ * A handler returns false to pass the frame on to the next stage.
+ *
+ * dispatch() runs in the CAN RX task, so inline handlers must be cheap and
+ * thread-safe. Handlers that touch manager state are wrapped with deferred():
+ * the RX task only pushes the frame into a lock-free SPSC ring (RX task is the sole
+ * producer, canTask the sole consumer) and canTask runs the handler from
+ * processDeferred(). A deferred handler returning false hands an SDO frame to
+ * the fallback route.
+ *
+ * Routes are registered once at startup (before the CAN tasks run) and are
+ * not safe to modify afterwards.
+ */
+class CanRouter {
+public:
+  using FrameHandler = std::function<bool(const twai_message_t& frame)>;
+
+  static CanRouter& instance();
+
+  // Frame-level routes
+  bool registerId(uint32_t canId, FrameHandler handler);
+  bool registerIdRange(uint32_t firstId, uint32_t lastId, FrameHandler handler);
+
+  // SDO response routes
+  void addSdoObserver(FrameHandler handler);
+  void addSdoMatcher(FrameHandler handler);
+  void setSdoCapture(FrameHandler handler);
+  bool registerSdoEntry(uint16_t index, uint8_t subIndex, FrameHandler handler);
+  bool registerSdoIndex(uint16_t index, FrameHandler handler);
+  bool registerSdoIndexBlock(uint8_t indexHighByte, FrameHandler handler);  // All indexes 0xHH00-0xHHFF
+  void setSdoFallback(FrameHandler handler);
+
+  // Wrap a handler so it runs in canTask instead of the RX task (always consumes inline)
+  FrameHandler deferred(FrameHandler handler);
+
+  // Append the routed standard IDs as runs sharing a handler (input for the acceptance filter)
+  void getRoutedIds(std::vector<CanIdRange>& ranges) const;
+
+  // Dispatch a received frame (RX task). Returns false if nothing consumed it.
+  bool dispatch(const twai_message_t& frame);
+
+  // Run queued deferred handlers (canTask)
+  void processDeferred();
+  bool hasDeferred() const;
+  uint32_t getDeferredDrops() const { return deferredDrops_; }
+
+private:
+  CanRouter();
+  CanRouter(const CanRouter&) = delete;
+  CanRouter& operator=(const CanRouter&) = delete;
+
+  static const uint32_t STANDARD_ID_COUNT = 0x800;
+  static const uint8_t NO_ROUTE = 0;
+  static const uint32_t DEFERRED_QUEUE_SIZE = 32;  // Power of two (SpscRing)
+
+  struct DeferredFrame {
+    uint8_t handler;  // Index into deferredHandlers_
+    twai_message_t frame;
+  };
+
+  uint8_t addHandler(FrameHandler handler);
+  bool dispatchSdo(const twai_message_t& frame);
+  bool invoke(uint8_t slot, const twai_message_t& frame) const;
+
+  // Handler storage; slot N lives at handlers_[N - 1] so 0 can mean "no route"
+  std::vector<FrameHandler> handlers_;
+
+  uint8_t idRoutes_[STANDARD_ID_COUNT];
+  uint8_t sdoBlockRoutes_[256];
+  std::unordered_map<uint16_t, uint8_t> sdoIndexRoutes_;
+  std::unordered_map<uint32_t, uint8_t> sdoEntryRoutes_;  // (index << 8) | subIndex
+
+  std::vector<FrameHandler> sdoObservers_;
+  std::vector<FrameHandler> sdoMatchers_;
+  FrameHandler sdoCapture_;
+  FrameHandler sdoFallback_;
+
+  std::vector<FrameHandler> deferredHandlers_;
+  SpscRing<DeferredFrame, DEFERRED_QUEUE_SIZE> deferredRing_;
+  volatile uint32_t deferredDrops_ = 0;
+};
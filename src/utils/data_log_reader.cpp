@@ -0,0 +1,185 @@
+#include "data_log_reader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char CSV_HEADER[] = "time_ms,param_id,value\n";
+
+// Exact decimal of a value scaled by 32: at most five fraction digits
+static int formatFixed32(char* out, size_t size, int32_t value) {
+  uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  uint32_t fraction = (magnitude & 31) * 3125;  // 1/32 = 0.03125
+  if (fraction == 0) {
+    return snprintf(out, size, "%s%u", value < 0 ? "-" : "", (unsigned)(magnitude >> 5));
+  }
+  int digits = 5;
+  while (fraction % 10 == 0) {
+    fraction /= 10;
+    digits--;
+  }
+  return snprintf(out, size, "%s%u.%0*u", value < 0 ? "-" : "", (unsigned)(magnitude >> 5), digits,
+                  (unsigned)fraction);
+}
+
+bool DataLogReader::begin() {
+  if (!file_) {
+    return false;
+  }
+  DataLogFileHeader header;
+  fileSize_ = file_.size();
+  if (file_.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || header.magic != DATA_LOG_MAGIC ||
+      header.version != DATA_LOG_VERSION) {
+    return false;
+  }
+  nodeId_ = header.nodeId;
+  paramIds_.resize(header.paramCount);
+  size_t idsLength = header.paramCount * sizeof(uint16_t);
+  if (file_.read((uint8_t*)paramIds_.data(), idsLength) != idsLength) {
+    return false;
+  }
+  previous_.assign(paramIds_.size(), 0);
+  dataOffset_ = sizeof(header) + idsLength;
+
+  nextOffset_ = findStartOffset();
+  memcpy(line_, CSV_HEADER, sizeof(CSV_HEADER) - 1);
+  lineLength_ = sizeof(CSV_HEADER) - 1;
+  return true;
+}
+
+bool DataLogReader::readBlockHeader(uint32_t offset, DataLogBlockHeader& header) {
+  return offset + sizeof(header) <= fileSize_ && file_.seek(offset) &&
+         file_.read((uint8_t*)&header, sizeof(header)) == sizeof(header);
+}
+
+uint32_t DataLogReader::findStartOffset() {
+  if (fromMs_ == 0) {
+    return dataOffset_;
+  }
+
+  // Closed file: the trailer points at the last index block
+  DataLogTrailer trailer;
+  if (fileSize_ >= dataOffset_ + sizeof(trailer) && file_.seek(fileSize_ - sizeof(trailer)) &&
+      file_.read((uint8_t*)&trailer, sizeof(trailer)) == sizeof(trailer) && trailer.magic == DATA_LOG_TRAILER_MAGIC) {
+    return findStartInIndex(trailer.lastIndexOffset);
+  }
+
+  // Otherwise step over the blocks; only their headers are read
+  uint32_t start = dataOffset_;
+  DataLogBlockHeader header;
+  for (uint32_t offset = dataOffset_; readBlockHeader(offset, header); offset += sizeof(header) + header.length) {
+    if (header.type == DATA_LOG_BLOCK_DATA) {
+      if (header.timeMs > fromMs_) {
+        break;
+      }
+      start = offset;
+    }
+  }
+  return start;
+}
+
+uint32_t DataLogReader::findStartInIndex(uint32_t indexOffset) {
+  // Index blocks chain backwards, each listing the data blocks since the one before it
+  DataLogBlockHeader header;
+  while (indexOffset >= dataOffset_ && readBlockHeader(indexOffset, header) && header.type == DATA_LOG_BLOCK_INDEX &&
+         header.length == sizeof(uint32_t) + header.count * sizeof(DataLogIndexEntry) &&
+         header.length <= sizeof(block_) && file_.read(block_, header.length) == header.length) {
+    uint32_t previousIndex;
+    memcpy(&previousIndex, block_, sizeof(previousIndex));
+    const uint8_t* entries = block_ + sizeof(previousIndex);
+    for (int i = header.count - 1; i >= 0; i--) {
+      DataLogIndexEntry entry;
+      memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+      if (entry.timeMs <= fromMs_) {
+        return entry.offset;
+      }
+    }
+    if (previousIndex >= indexOffset) {
+      break;  // Chains only go back; anything else is corrupt
+    }
+    indexOffset = previousIndex;
+  }
+  return dataOffset_;
+}
+
+bool DataLogReader::loadNextBlock() {
+  DataLogBlockHeader header;
+  while (readBlockHeader(nextOffset_, header)) {
+    if (header.type == DATA_LOG_BLOCK_DATA && header.timeMs > toMs_) {
+      return false;
+    }
+    if (header.type != DATA_LOG_BLOCK_DATA) {
+      nextOffset_ += sizeof(header) + header.length;
+      continue;
+    }
+    if (header.length > sizeof(block_) || file_.read(block_, header.length) != header.length) {
+      return false;  // Corrupt, or cut short by a reset while it was written
+    }
+    nextOffset_ += sizeof(header) + header.length;
+    blockLength_ = header.length;
+    blockPosition_ = 0;
+    rowsLeft_ = header.count;
+    rowMs_ = header.timeMs;
+    memset(previous_.data(), 0, previous_.size() * sizeof(int32_t));
+    return true;
+  }
+  return false;
+}
+
+bool DataLogReader::nextLine() {
+  while (!done_) {
+    if (rowsLeft_ == 0 && !loadNextBlock()) {
+      done_ = true;
+      break;
+    }
+
+    uint32_t column;
+    uint32_t deltaMs;
+    uint32_t change;
+    const uint8_t* in = block_ + blockPosition_;
+    const uint8_t* end = block_ + blockLength_;
+    size_t length = dataLogGetVarint(in, end, column);
+    size_t length2 = length > 0 ? dataLogGetVarint(in + length, end, deltaMs) : 0;
+    size_t length3 = length2 > 0 ? dataLogGetVarint(in + length + length2, end, change) : 0;
+    if (length3 == 0 || column >= paramIds_.size()) {
+      rowsLeft_ = 0;  // Corrupt block: skip the rest of it
+      continue;
+    }
+    blockPosition_ += length + length2 + length3;
+    rowsLeft_--;
+
+    rowMs_ += deltaMs;
+    int32_t value = (int32_t)((uint32_t)previous_[column] + (uint32_t)dataLogUnzigzag(change));
+    previous_[column] = value;
+    if (rowMs_ < fromMs_) {
+      continue;
+    }
+    if (rowMs_ > toMs_) {
+      done_ = true;
+      break;
+    }
+
+    int prefix = snprintf(line_, sizeof(line_), "%u,%u,", (unsigned)rowMs_, (unsigned)paramIds_[column]);
+    int number = formatFixed32(line_ + prefix, sizeof(line_) - prefix - 1, value);
+    lineLength_ = prefix + number;
+    line_[lineLength_++] = '\n';
+    linePosition_ = 0;
+    return true;
+  }
+  return false;
+}
+
+size_t DataLogReader::read(uint8_t* buffer, size_t maxLength) {
+  size_t length = 0;
+  while (length < maxLength) {
+    if (linePosition_ == lineLength_ && !nextLine()) {
+      break;
+    }
+    size_t count = lineLength_ - linePosition_;
+    count = count < maxLength - length ? count : maxLength - length;
+    memcpy(buffer + length, line_ + linePosition_, count);
+    linePosition_ += count;
+    length += count;
+  }
+  return length;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <FS.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "models/data_log_format.h"
+
+/**
+ * Decodes a data log file (models/data_log_format.h) to CSV a buffer at a time, for the
+ * chunked HTTP download: "time_ms,param_id,value" lines, values in engineering units.
+ *
+ * begin() starts at the last data block at or before fromMs: it follows the index chain
+ * back from the trailer, or for a file still being written (or cut short) steps over the
+ * block headers. Holds one block in memory whatever the file size.
+ */
+class DataLogReader {
+public:
+  DataLogReader(File file, uint32_t fromMs, uint32_t toMs) : file_(file), fromMs_(fromMs), toMs_(toMs) {}
+
+  bool begin();  // False if not a data log of a version this reader knows
+
+  // Up to maxLength bytes of CSV, header line first; 0 once every row is out
+  size_t read(uint8_t* buffer, size_t maxLength);
+
+  uint8_t getNodeId() const { return nodeId_; }
+  const std::vector<uint16_t>& getParamIds() const { return paramIds_; }
+
+private:
+  uint32_t findStartOffset();
+  uint32_t findStartInIndex(uint32_t indexOffset);
+  bool readBlockHeader(uint32_t offset, DataLogBlockHeader& header);
+  bool loadNextBlock();
+  bool nextLine();  // Formats the next row in range into line_
+
+  File file_;
+  uint32_t fromMs_;
+  uint32_t toMs_;
+  uint8_t nodeId_ = 0;
+  std::vector<uint16_t> paramIds_;
+  uint32_t dataOffset_ = 0;  // First block
+  uint32_t fileSize_ = 0;
+
+  // Decoding
+  uint32_t nextOffset_ = 0;  // Header of the block after the loaded one
+  uint8_t block_[DATA_LOG_BLOCK_SIZE];
+  size_t blockLength_ = 0;
+  size_t blockPosition_ = 0;
+  uint16_t rowsLeft_ = 0;
+  uint32_t rowMs_ = 0;
+  std::vector<int32_t> previous_;
+  bool done_ = false;
+
+  // Output
+  char line_[48];
+  size_t lineLength_ = 0;
+  size_t linePosition_ = 0;
+};
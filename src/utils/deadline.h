@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Sentinel returned by "ms until next work" queries when nothing is scheduled
+#define NO_DEADLINE UINT32_MAX
+
+// Milliseconds left until (startMs + durationMs), or 0 if already due.
+// Wrap-safe for millis() rollover.
+inline uint32_t msRemaining(uint32_t startMs, uint32_t durationMs, uint32_t nowMs) {
+  uint32_t elapsed = nowMs - startMs;
+  return elapsed >= durationMs ? 0 : durationMs - elapsed;
+}
+
+// Milliseconds left until the absolute time dueMs, or 0 if already due.
+// Wrap-safe while dueMs is within 2^31 ms of nowMs.
+inline uint32_t msUntil(uint32_t dueMs, uint32_t nowMs) {
+  int32_t left = (int32_t)(dueMs - nowMs);
+  return left > 0 ? left : 0;
+}
@@ -4,16 +4,18 @@
 #include <string>
 #include <vector>
 
+#include "event_processor.h"
 #include "main.h"
 #include "oi_can.h"
 
 #include "managers/can_interval_manager.h"
 #include "managers/client_lock_manager.h"
+#include "managers/data_logger.h"
 #include "managers/device_cache.h"
 #include "managers/device_connection.h"
 #include "managers/device_discovery.h"
 #include "managers/spot_values_manager.h"
-#include "protocols/sdo_protocol.h"
+#include "models/spot_value_frame.h"
 #include "utils/string_utils.h"
 #include "utils/websocket_helpers.h"
 
@@ -71,6 +73,10 @@ static const std::map<std::string, WebSocketHandler> wsHandlers = {{"startScan",
                                                                    {"setNodeId", handleSetNodeId},
                                                                    {"startSpotValues", handleStartSpotValues},
                                                                    {"stopSpotValues", handleStopSpotValues},
+                                                                   {"setSpotValuesFormat", handleSetSpotValuesFormat},
+                                                                   {"getSpotValueHistory", handleGetSpotValueHistory},
+                                                                   {"startDataLog", handleStartDataLog},
+                                                                   {"stopDataLog", handleStopDataLog},
                                                                    {"updateParam", handleUpdateParam},
                                                                    {"getParamSchema", handleGetParamSchema},
                                                                    {"getParamValues", handleGetParamValues},
@@ -80,18 +86,23 @@ static const std::map<std::string, WebSocketHandler> wsHandlers = {{"startScan",
                                                                    {"getCanMappings", handleGetCanMappings},
                                                                    {"addCanMapping", handleAddCanMapping},
                                                                    {"removeCanMapping", handleRemoveCanMapping},
+                                                                   {"clearCanMap", handleClearCanMap},
+                                                                   {"importCanMap", handleImportCanMap},
                                                                    {"saveToFlash", handleSaveToFlash},
                                                                    {"loadFromFlash", handleLoadFromFlash},
                                                                    {"loadDefaults", handleLoadDefaults},
                                                                    {"startDevice", handleStartDevice},
                                                                    {"stopDevice", handleStopDevice},
                                                                    {"listErrors", handleListErrors},
+                                                                   {"snapshotParams", handleSnapshotParams},
+                                                                   {"restoreParams", handleRestoreParams},
                                                                    {"sendCanMessage", handleSendCanMessage},
                                                                    {"startCanInterval", handleStartCanInterval},
                                                                    {"stopCanInterval", handleStopCanInterval},
                                                                    {"startCanIoInterval", handleStartCanIoInterval},
                                                                    {"stopCanIoInterval", handleStopCanIoInterval},
-                                                                   {"updateCanIoFlags", handleUpdateCanIoFlags}};
+                                                                   {"updateCanIoFlags", handleUpdateCanIoFlags},
+                                                                   {"getCanStatus", handleGetCanStatus}};
 
 // Main dispatch function
 void dispatchWebSocketMessage(AsyncWebSocketClient* client, JsonDocument& doc) {
@@ -105,6 +116,24 @@ void dispatchWebSocketMessage(AsyncWebSocketClient* client, JsonDocument& doc) {
   }
 }
 
+// Queue a device operation for canTask. The result event goes back to this client only
+// (see EventProcessor); errorEvent is also used if the operation cannot be queued.
+static bool queueDeviceOperation(AsyncWebSocketClient* client, CANCommand& cmd, const char* commandName,
+                                 const char* errorEvent) {
+  if (!DeviceConnection::instance().isIdle()) {
+    DBG_OUTPUT_PORT.printf("[WebSocket] ERROR: Cannot run %s - device busy\n", commandName);
+    sendDeviceBusyError(client, errorEvent);
+    return false;
+  }
+
+  cmd.clientId = client->id();
+  if (!queueCanCommand(cmd, commandName)) {
+    sendWebSocketError(client, errorEvent, "Command queue full");
+    return false;
+  }
+  return true;
+}
+
 // Handler implementations
 void handleStartScan(AsyncWebSocketClient* client, JsonDocument& doc) {
   uint8_t start = doc["start"] | 1;
@@ -211,6 +240,18 @@ void handleGetNodeId(AsyncWebSocketClient* client, JsonDocument& doc) {
   queueCanCommand(cmd, "Get node ID");
 }
 
+// Bus health is read from counters, not the bus, so answer directly instead of queueing a command
+void handleGetCanStatus(AsyncWebSocketClient* client, JsonDocument& doc) {
+  JsonDocument response;
+  response["event"] = "canStatus";
+  JsonObject data = response["data"].to<JsonObject>();
+  EventProcessor::serializeCanStatus(data);
+
+  String output;
+  serializeJson(response, output);
+  client->text(output);
+}
+
 void handleSetNodeId(AsyncWebSocketClient* client, JsonDocument& doc) {
   int id = doc["id"];
 
@@ -352,9 +393,16 @@ void handleStartSpotValues(AsyncWebSocketClient* client, JsonDocument& doc) {
 
   if (doc.containsKey("paramIds")) {
     JsonArray paramIds = doc["paramIds"].as<JsonArray>();
+    JsonArray periods = doc["periods"].as<JsonArray>();  // Optional, ms per entry of paramIds (0 = interval)
     cmd.data.spotValues.paramCount = 0;
     for (JsonVariant id : paramIds) {
       if (cmd.data.spotValues.paramCount < MAX_PARAM_IDS) {
+        uint32_t period = periods[cmd.data.spotValues.paramCount] | 0;
+        if (period != 0 && period < SPOT_VALUES_PERIOD_MIN_MS)
+          period = SPOT_VALUES_PERIOD_MIN_MS;
+        if (period > SPOT_VALUES_PERIOD_MAX_MS)
+          period = SPOT_VALUES_PERIOD_MAX_MS;
+        cmd.data.spotValues.periods[cmd.data.spotValues.paramCount] = period;
         cmd.data.spotValues.paramIds[cmd.data.spotValues.paramCount++] = id.as<int>();
       }
     }
@@ -370,6 +418,13 @@ void handleStartSpotValues(AsyncWebSocketClient* client, JsonDocument& doc) {
     cmd.data.spotValues.interval = 1000;
   }
 
+  int window = doc.containsKey("window") ? doc["window"].as<int>() : SPOT_VALUES_WINDOW_DEFAULT;
+  if (window < 1)
+    window = 1;
+  if (window > SPOT_VALUES_WINDOW_MAX)
+    window = SPOT_VALUES_WINDOW_MAX;
+  cmd.data.spotValues.window = window;
+
   queueCanCommand(cmd, "Start spot values");
 }
 
@@ -380,6 +435,81 @@ void handleStopSpotValues(AsyncWebSocketClient* client, JsonDocument& doc) {
   queueCanCommand(cmd, "Stop spot values");
 }
 
+void handleSetSpotValuesFormat(AsyncWebSocketClient* client, JsonDocument& doc) {
+  String format = doc["format"] | "json";
+  if (format != "json" && format != "binary") {
+    sendWebSocketError(client, "spotValuesFormatError", "Unknown format");
+    return;
+  }
+
+  // Binary needs the client to know this frame version; otherwise it stays on JSON
+  bool wantBinary = format == "binary" && (doc["version"] | SPOT_VALUE_FRAME_VERSION) == SPOT_VALUE_FRAME_VERSION;
+  bool binary = EventProcessor::setSpotValuesBinary(client->id(), wantBinary) && wantBinary;
+
+  JsonDocument response;
+  response["event"] = "spotValuesFormat";
+  response["data"]["format"] = binary ? "binary" : "json";
+  if (binary) {
+    response["data"]["version"] = SPOT_VALUE_FRAME_VERSION;
+  }
+  String output;
+  serializeJson(response, output);
+  client->text(output);
+}
+
+void handleGetSpotValueHistory(AsyncWebSocketClient* client, JsonDocument& doc) {
+  CANCommand cmd;
+  cmd.type = CMD_GET_SPOT_HISTORY;
+  cmd.clientId = client->id();
+
+  SpotHistoryCommand& query = cmd.data.spotHistory;
+  query.paramCount = 0;
+  for (JsonVariant id : doc["paramIds"].as<JsonArray>()) {
+    if (query.paramCount < MAX_PARAM_IDS) {
+      query.paramIds[query.paramCount++] = id.as<int>();
+    }
+  }
+  query.fromMs = doc["from"] | 0;
+  query.toMs = doc["to"] | 0;
+  query.durationMs = doc["duration"] | 0;
+  query.resolutionMs = doc["resolution"] | 0;
+
+  // Reads only RAM in canTask, so it runs whether or not the device is busy
+  if (!queueCanCommand(cmd, "Get spot value history")) {
+    sendWebSocketError(client, "spotValueHistoryError", "Command queue full");
+  }
+}
+
+void handleStartDataLog(AsyncWebSocketClient* client, JsonDocument& doc) {
+  CANCommand cmd;
+  cmd.type = CMD_START_DATA_LOG;
+
+  // Logs the listed parameters as the spot value stream reads them (all monitored ones if none)
+  DataLogCommand& request = cmd.data.dataLog;
+  request.paramCount = 0;
+  for (JsonVariant id : doc["paramIds"].as<JsonArray>()) {
+    if (request.paramCount < MAX_PARAM_IDS) {
+      request.paramIds[request.paramCount++] = id.as<int>();
+    }
+  }
+  request.budgetBytes = doc["budget"] | DATA_LOG_BUDGET_DEFAULT;
+  if (request.budgetBytes < DATA_LOG_BUDGET_MIN)
+    request.budgetBytes = DATA_LOG_BUDGET_MIN;
+
+  if (!queueCanCommand(cmd, "Start data log")) {
+    sendWebSocketError(client, "dataLogError", "Command queue full");
+  }
+}
+
+void handleStopDataLog(AsyncWebSocketClient* client, JsonDocument& doc) {
+  CANCommand cmd;
+  cmd.type = CMD_STOP_DATA_LOG;
+
+  if (!queueCanCommand(cmd, "Stop data log")) {
+    sendWebSocketError(client, "dataLogError", "Command queue full");
+  }
+}
+
 void handleUpdateParam(AsyncWebSocketClient* client, JsonDocument& doc) {
   int paramId = doc["paramId"];
   double value = doc["value"];
@@ -399,38 +529,12 @@ void handleUpdateParam(AsyncWebSocketClient* client, JsonDocument& doc) {
     return;
   }
 
-  // Check if there's already a pending write
-  if (SDOProtocol::hasPendingWrite()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Another parameter update is in progress");
-    JsonDocument errorDoc;
-    errorDoc["event"] = "paramUpdateError";
-    errorDoc["data"]["paramId"] = paramId;
-    errorDoc["data"]["error"] = "Another update in progress";
-    String errorOutput;
-    serializeJson(errorDoc, errorOutput);
-    client->text(errorOutput);
-    return;
-  }
-
-  // Temporarily pause spot values if active to avoid conflicts
-  bool wasSpotValuesActive = SpotValuesManager::instance().isActive();
-  if (wasSpotValuesActive) {
-    DBG_OUTPUT_PORT.println("[WebSocket] Temporarily pausing spot values for parameter write");
-    SpotValuesManager::instance().stop();
-  }
-
-  // Send the write asynchronously - response will come via EVT_VALUE_SET event
-  uint8_t nodeId = DeviceConnection::instance().getNodeId();
-  DBG_OUTPUT_PORT.printf("[WebSocket] Sending parameter update to nodeId=%d\n", nodeId);
-  if (!SDOProtocol::setValueAsync(nodeId, paramId, value)) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Failed to queue parameter update");
-
-    // Resume spot values if we paused it
-    if (wasSpotValuesActive) {
-      // Note: Cannot resume here without knowing original params/interval
-      // The client will need to restart spot values after the error
-    }
-
+  // Coalesced per parameter in canTask (ParamWriteQueue); spot values keep running
+  CANCommand cmd;
+  cmd.type = CMD_UPDATE_PARAM;
+  cmd.data.setValue.paramId = paramId;
+  cmd.data.setValue.value = value;
+  if (!queueCanCommand(cmd, "Update param")) {
     JsonDocument errorDoc;
     errorDoc["event"] = "paramUpdateError";
     errorDoc["data"]["paramId"] = paramId;
@@ -441,10 +545,7 @@ void handleUpdateParam(AsyncWebSocketClient* client, JsonDocument& doc) {
     return;
   }
 
-  DBG_OUTPUT_PORT.printf("[WebSocket] Parameter %d update queued (value=%f)\n", paramId, value);
-
-  // Note: Spot values will be restarted by the UI after receiving paramUpdateResult
-  // Response will be sent when EVT_VALUE_SET event is processed by event_processor
+  // The result (with the value the node ends up with) arrives as paramUpdateResult
 }
 
 void handleReloadParams(AsyncWebSocketClient* client, JsonDocument& doc) {
@@ -473,21 +574,9 @@ void handleReloadParams(AsyncWebSocketClient* client, JsonDocument& doc) {
 void handleResetDevice(AsyncWebSocketClient* client, JsonDocument& doc) {
   DBG_OUTPUT_PORT.println("[WebSocket] Reset device request");
 
-  bool success = OICan::ResetDevice();
-
-  JsonDocument responseDoc;
-  if (success) {
-    responseDoc["event"] = "deviceReset";
-    responseDoc["data"]["message"] = "Device reset command sent";
-  } else {
-    responseDoc["event"] = "deviceResetError";
-    responseDoc["data"]["error"] = "Device busy or not connected";
-  }
-
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
-  DBG_OUTPUT_PORT.printf("[WebSocket] Sent reset response (success=%d)\n", success);
+  CANCommand cmd;
+  cmd.type = CMD_RESET_DEVICE;
+  queueDeviceOperation(client, cmd, "Reset device", "deviceResetError");
 }
 
 void handleGetParamSchema(AsyncWebSocketClient* client, JsonDocument& doc) {
@@ -552,17 +641,17 @@ void handleGetParamValues(AsyncWebSocketClient* client, JsonDocument& doc) {
       // Fall through to start async download
     } else {
       // Update with latest spot values
-      const auto& latestSpotValues = SpotValuesManager::instance().getLatestValues();
-      if (!latestSpotValues.empty()) {
+      SpotValuesManager& spotValues = SpotValuesManager::instance();
+      if (spotValues.isActive()) {
         JsonDocument paramsDoc;
         DeserializationError error = deserializeJson(paramsDoc, json);
         if (!error) {
-          for (const auto& pair : latestSpotValues) {
-            String paramId = String(pair.first);
+          spotValues.forEachLatestValue([&paramsDoc](int id, double value) {
+            String paramId = String(id);
             if (paramsDoc.containsKey(paramId)) {
-              paramsDoc[paramId]["value"] = pair.second;
+              paramsDoc[paramId]["value"] = value;
             }
-          }
+          });
           json = "";
           serializeJson(paramsDoc, json);
         }
@@ -664,287 +753,238 @@ void handleDisconnect(AsyncWebSocketClient* client, JsonDocument& doc) {
 void handleGetCanMappings(AsyncWebSocketClient* client, JsonDocument& doc) {
   DBG_OUTPUT_PORT.println("[WebSocket] Get CAN mappings request");
 
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot get mappings - device busy");
-    sendDeviceBusyError(client, "canMappingsError");
-    return;
-  }
-
-  String mappingsJson = OICan::GetCanMapping();
-
-  JsonDocument responseDoc;
-  responseDoc["event"] = "canMappingsData";
-
-  JsonDocument mappingsArrayDoc;
-  deserializeJson(mappingsArrayDoc, mappingsJson);
-  responseDoc["data"]["mappings"] = mappingsArrayDoc;
-
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
-  DBG_OUTPUT_PORT.printf("[WebSocket] Sent CAN mappings data (%d bytes)\n", output.length());
+  CANCommand cmd;
+  cmd.type = CMD_GET_CAN_MAPPINGS;
+  cmd.data.getCanMappings.refresh = doc["refresh"] | false;
+  queueDeviceOperation(client, cmd, "Get CAN mappings", "canMappingsError");
 }
 
 void handleAddCanMapping(AsyncWebSocketClient* client, JsonDocument& doc) {
   DBG_OUTPUT_PORT.println("[WebSocket] Add CAN mapping request");
 
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot add mapping - device busy");
-    sendDeviceBusyError(client, "canMappingError");
-    return;
-  }
-
-  JsonDocument mappingDoc;
-  mappingDoc["isrx"] = doc["isrx"];
-  mappingDoc["id"] = doc["id"];
-  mappingDoc["paramid"] = doc["paramid"];
-  mappingDoc["position"] = doc["position"];
-  mappingDoc["length"] = doc["length"];
-  mappingDoc["gain"] = doc["gain"];
-  mappingDoc["offset"] = doc["offset"];
-
-  String mappingJson;
-  serializeJson(mappingDoc, mappingJson);
-
-  OICan::SetResult result = OICan::AddCanMapping(mappingJson);
-
-  JsonDocument responseDoc;
-  if (result == OICan::Ok) {
-    responseDoc["event"] = "canMappingAdded";
-    responseDoc["data"]["success"] = true;
-    DBG_OUTPUT_PORT.println("[WebSocket] CAN mapping added successfully");
-  } else {
+  if (doc["isrx"].isNull() || doc["id"].isNull() || doc["paramid"].isNull() || doc["position"].isNull() ||
+      doc["length"].isNull() || doc["gain"].isNull() || doc["offset"].isNull()) {
+    DBG_OUTPUT_PORT.println("[WebSocket] Add: Missing argument");
+    JsonDocument responseDoc;
     responseDoc["event"] = "canMappingError";
     responseDoc["data"]["success"] = false;
-
-    if (result == OICan::UnknownIndex) {
-      responseDoc["data"]["error"] = "Invalid mapping parameters";
-    } else if (result == OICan::CommError) {
-      responseDoc["data"]["error"] = "Communication error";
-    } else {
-      responseDoc["data"]["error"] = "Unknown error";
-    }
-    DBG_OUTPUT_PORT.printf("[WebSocket] CAN mapping add failed: %d\n", result);
+    responseDoc["data"]["error"] = "Invalid mapping parameters";
+    String output;
+    serializeJson(responseDoc, output);
+    client->text(output);
+    return;
   }
 
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
+  CANCommand cmd;
+  cmd.type = CMD_ADD_CAN_MAPPING;
+  cmd.data.addCanMapping.isRx = doc["isrx"];
+  cmd.data.addCanMapping.canId = doc["id"].as<uint32_t>();
+  cmd.data.addCanMapping.paramId = doc["paramid"].as<uint32_t>();
+  cmd.data.addCanMapping.position = doc["position"].as<uint8_t>();
+  cmd.data.addCanMapping.length = doc["length"].as<int8_t>();
+  cmd.data.addCanMapping.gain = doc["gain"].as<float>();
+  cmd.data.addCanMapping.offset = doc["offset"].as<int8_t>();
+  queueDeviceOperation(client, cmd, "Add CAN mapping", "canMappingError");
 }
 
 void handleRemoveCanMapping(AsyncWebSocketClient* client, JsonDocument& doc) {
   DBG_OUTPUT_PORT.println("[WebSocket] Remove CAN mapping request");
 
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot remove mapping - device busy");
-    sendDeviceBusyError(client, "canMappingError");
+  if (doc["index"].isNull() || doc["subindex"].isNull()) {
+    DBG_OUTPUT_PORT.println("[WebSocket] Remove: Missing argument");
+    JsonDocument responseDoc;
+    responseDoc["event"] = "canMappingError";
+    responseDoc["data"]["success"] = false;
+    responseDoc["data"]["error"] = "Invalid index or subindex";
+    String output;
+    serializeJson(responseDoc, output);
+    client->text(output);
     return;
   }
 
-  JsonDocument mappingDoc;
-  mappingDoc["index"] = doc["index"];
-  mappingDoc["subindex"] = doc["subindex"];
+  CANCommand cmd;
+  cmd.type = CMD_REMOVE_CAN_MAPPING;
+  cmd.data.removeCanMapping.index = doc["index"].as<uint32_t>();
+  cmd.data.removeCanMapping.subIndex = doc["subindex"].as<uint8_t>();
+  queueDeviceOperation(client, cmd, "Remove CAN mapping", "canMappingError");
+}
 
-  String mappingJson;
-  serializeJson(mappingDoc, mappingJson);
+void handleClearCanMap(AsyncWebSocketClient* client, JsonDocument& doc) {
+  DBG_OUTPUT_PORT.println("[WebSocket] Clear CAN map request");
 
-  OICan::SetResult result = OICan::RemoveCanMapping(mappingJson);
+  CANCommand cmd;
+  cmd.type = CMD_CLEAR_CAN_MAP;
+  cmd.data.clearCanMap.isRx = doc["isrx"] | false;
+  queueDeviceOperation(client, cmd, "Clear CAN map", "canMapClearError");
+}
 
-  JsonDocument responseDoc;
-  if (result == OICan::Ok) {
-    responseDoc["event"] = "canMappingRemoved";
-    responseDoc["data"]["success"] = true;
-    DBG_OUTPUT_PORT.println("[WebSocket] CAN mapping removed successfully");
-  } else {
-    responseDoc["event"] = "canMappingError";
-    responseDoc["data"]["success"] = false;
+void handleImportCanMap(AsyncWebSocketClient* client, JsonDocument& doc) {
+  DBG_OUTPUT_PORT.println("[WebSocket] Import CAN map request");
 
-    if (result == OICan::UnknownIndex) {
-      responseDoc["data"]["error"] = "Invalid index or subindex";
-    } else if (result == OICan::CommError) {
-      responseDoc["data"]["error"] = "Communication error";
-    } else {
-      responseDoc["data"]["error"] = "Unknown error";
-    }
-    DBG_OUTPUT_PORT.printf("[WebSocket] CAN mapping remove failed: %d\n", result);
+  JsonArray mappings = doc["mappings"].as<JsonArray>();
+  if (mappings.isNull()) {
+    sendWebSocketError(client, "canMapImportError", "Missing mappings array");
+    return;
+  }
+  if (mappings.size() > MAX_CAN_MAP_IMPORT) {
+    sendWebSocketError(client, "canMapImportError", "Too many mappings");
+    return;
   }
 
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
-}
-
-void handleSaveToFlash(AsyncWebSocketClient* client, JsonDocument& doc) {
-  DBG_OUTPUT_PORT.println("[WebSocket] Save to flash request");
-
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot save to flash - device busy");
-    sendDeviceBusyError(client, "saveToFlashError");
+  CanMappingData* items = (CanMappingData*)malloc(sizeof(CanMappingData) * (mappings.size() + 1));
+  if (items == nullptr) {
+    sendWebSocketError(client, "canMapImportError", "Out of memory");
     return;
   }
 
-  bool success = OICan::SaveToFlash();
+  // Same fields as addCanMapping and the canMappingsData export
+  uint16_t count = 0;
+  for (JsonVariant m : mappings) {
+    if (m["isrx"].isNull() || m["id"].isNull() || m["paramid"].isNull() || m["position"].isNull() ||
+        m["length"].isNull() || m["gain"].isNull() || m["offset"].isNull()) {
+      DBG_OUTPUT_PORT.printf("[WebSocket] Import: Mapping %d incomplete\n", count);
+      free(items);
+      sendWebSocketError(client, "canMapImportError", "Invalid mapping parameters");
+      return;
+    }
+    CanMappingData& item = items[count++];
+    item.isRx = m["isrx"].as<bool>();
+    item.cobId = m["id"].as<int>();
+    item.paramId = m["paramid"].as<int>();
+    item.position = m["position"].as<uint8_t>();
+    item.length = m["length"].as<int8_t>();
+    item.gain = m["gain"].as<float>();
+    item.offset = m["offset"].as<int8_t>();
+    item.sdoIndex = 0;
+    item.sdoSubIndex = 0;
+  }
 
-  JsonDocument responseDoc;
-  if (success) {
-    responseDoc["event"] = "saveToFlashSuccess";
-    responseDoc["data"]["message"] = "Parameters saved to flash";
-    DBG_OUTPUT_PORT.println("[WebSocket] Parameters saved to flash successfully");
-  } else {
-    responseDoc["event"] = "saveToFlashError";
-    responseDoc["data"]["error"] = "Failed to save parameters";
-    DBG_OUTPUT_PORT.println("[WebSocket] Failed to save parameters to flash");
+  CANCommand cmd;
+  cmd.type = CMD_IMPORT_CAN_MAP;
+  cmd.data.importCanMap.mappings = items;
+  cmd.data.importCanMap.count = count;
+  if (!queueDeviceOperation(client, cmd, "Import CAN map", "canMapImportError")) {
+    releaseCommandPayload(cmd);
   }
+}
 
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
+void handleSaveToFlash(AsyncWebSocketClient* client, JsonDocument& doc) {
+  DBG_OUTPUT_PORT.println("[WebSocket] Save to flash request");
+
+  CANCommand cmd;
+  cmd.type = CMD_SAVE_TO_FLASH;
+  queueDeviceOperation(client, cmd, "Save to flash", "saveToFlashError");
 }
 
 void handleLoadFromFlash(AsyncWebSocketClient* client, JsonDocument& doc) {
   DBG_OUTPUT_PORT.println("[WebSocket] Load from flash request");
 
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot load from flash - device busy");
-    sendDeviceBusyError(client, "loadFromFlashError");
-    return;
-  }
-
-  bool success = OICan::LoadFromFlash();
-
-  JsonDocument responseDoc;
-  if (success) {
-    responseDoc["event"] = "loadFromFlashSuccess";
-    responseDoc["data"]["message"] = "Parameters loaded from flash";
-    DBG_OUTPUT_PORT.println("[WebSocket] Parameters loaded from flash successfully");
-  } else {
-    responseDoc["event"] = "loadFromFlashError";
-    responseDoc["data"]["error"] = "Failed to load parameters";
-    DBG_OUTPUT_PORT.println("[WebSocket] Failed to load parameters from flash");
-  }
-
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
+  CANCommand cmd;
+  cmd.type = CMD_LOAD_FROM_FLASH;
+  queueDeviceOperation(client, cmd, "Load from flash", "loadFromFlashError");
 }
 
 void handleLoadDefaults(AsyncWebSocketClient* client, JsonDocument& doc) {
   DBG_OUTPUT_PORT.println("[WebSocket] Load defaults request");
 
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot load defaults - device busy");
-    sendDeviceBusyError(client, "loadDefaultsError");
-    return;
-  }
-
-  bool success = OICan::LoadDefaults();
-
-  JsonDocument responseDoc;
-  if (success) {
-    responseDoc["event"] = "loadDefaultsSuccess";
-    responseDoc["data"]["message"] = "Default parameters loaded";
-    DBG_OUTPUT_PORT.println("[WebSocket] Default parameters loaded successfully");
-  } else {
-    responseDoc["event"] = "loadDefaultsError";
-    responseDoc["data"]["error"] = "Failed to load defaults";
-    DBG_OUTPUT_PORT.println("[WebSocket] Failed to load default parameters");
-  }
-
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
+  CANCommand cmd;
+  cmd.type = CMD_LOAD_DEFAULTS;
+  queueDeviceOperation(client, cmd, "Load defaults", "loadDefaultsError");
 }
 
 void handleStartDevice(AsyncWebSocketClient* client, JsonDocument& doc) {
   DBG_OUTPUT_PORT.println("[WebSocket] Start device request");
 
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot start device - device busy");
-    sendDeviceBusyError(client, "startDeviceError");
-    return;
-  }
+  CANCommand cmd;
+  cmd.type = CMD_START_DEVICE;
+  cmd.data.startDevice.mode = doc.containsKey("mode") ? doc["mode"].as<uint32_t>() : 0;
+  queueDeviceOperation(client, cmd, "Start device", "startDeviceError");
+}
 
-  uint32_t mode = doc.containsKey("mode") ? doc["mode"].as<uint32_t>() : 0;
+void handleStopDevice(AsyncWebSocketClient* client, JsonDocument& doc) {
+  DBG_OUTPUT_PORT.println("[WebSocket] Stop device request");
 
-  bool success = OICan::StartDevice(mode);
+  CANCommand cmd;
+  cmd.type = CMD_STOP_DEVICE;
+  queueDeviceOperation(client, cmd, "Stop device", "stopDeviceError");
+}
 
-  JsonDocument responseDoc;
-  if (success) {
-    responseDoc["event"] = "startDeviceSuccess";
-    responseDoc["data"]["message"] = "Device started";
-    DBG_OUTPUT_PORT.println("[WebSocket] Device started successfully");
-  } else {
-    responseDoc["event"] = "startDeviceError";
-    responseDoc["data"]["error"] = "Failed to start device";
-    DBG_OUTPUT_PORT.println("[WebSocket] Failed to start device");
-  }
+void handleListErrors(AsyncWebSocketClient* client, JsonDocument& doc) {
+  DBG_OUTPUT_PORT.println("[WebSocket] List errors request");
 
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
+  CANCommand cmd;
+  cmd.type = CMD_LIST_ERRORS;
+  cmd.data.listErrors.incremental = doc["incremental"] | true;  // Set false to re-read every slot
+  queueDeviceOperation(client, cmd, "List errors", "listErrorsError");
 }
 
-void handleStopDevice(AsyncWebSocketClient* client, JsonDocument& doc) {
-  DBG_OUTPUT_PORT.println("[WebSocket] Stop device request");
-
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot stop device - device busy");
-    sendDeviceBusyError(client, "stopDeviceError");
-    return;
-  }
+void handleSnapshotParams(AsyncWebSocketClient* client, JsonDocument& doc) {
+  DBG_OUTPUT_PORT.println("[WebSocket] Snapshot params request");
 
-  bool success = OICan::StopDevice();
+  CANCommand cmd;
+  cmd.type = CMD_SNAPSHOT_PARAMS;
+  queueDeviceOperation(client, cmd, "Snapshot params", "paramsSnapshotError");
+}
 
-  JsonDocument responseDoc;
-  if (success) {
-    responseDoc["event"] = "stopDeviceSuccess";
-    responseDoc["data"]["message"] = "Device stopped";
-    DBG_OUTPUT_PORT.println("[WebSocket] Device stopped successfully");
-  } else {
-    responseDoc["event"] = "stopDeviceError";
-    responseDoc["data"]["error"] = "Failed to stop device";
-    DBG_OUTPUT_PORT.println("[WebSocket] Failed to stop device");
-  }
+void handleRestoreParams(AsyncWebSocketClient* client, JsonDocument& doc) {
+  DBG_OUTPUT_PORT.println("[WebSocket] Restore params request");
 
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
+  CANCommand cmd;
+  cmd.type = CMD_RESTORE_PARAMS;
+  safeCopyString(cmd.data.restoreParams.serial, doc["serial"] | "");  // Another device's snapshot (cloning)
+  queueDeviceOperation(client, cmd, "Restore params", "paramsRestoreError");
 }
 
-void handleListErrors(AsyncWebSocketClient* client, JsonDocument& doc) {
-  DBG_OUTPUT_PORT.println("[WebSocket] List errors request");
+// ============================================================================
+// WebSocket Event Handler
+// ============================================================================
 
-  if (!DeviceConnection::instance().isIdle()) {
-    DBG_OUTPUT_PORT.println("[WebSocket] ERROR: Cannot list errors - device busy");
-    sendDeviceBusyError(client, "listErrorsError");
+// Messages larger than one frame or TCP packet (e.g. a CAN map import) arrive in pieces and
+// are collected per client up to this size
+static const size_t MAX_WS_MESSAGE_SIZE = 32768;
+static std::map<uint32_t, String> partialMessages;
+
+static void handleTextMessage(AsyncWebSocketClient* client, const String& message) {
+  DBG_OUTPUT_PORT.printf("WebSocket message: %s\n", message.c_str());
+
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, message);
+  if (error) {
+    DBG_OUTPUT_PORT.printf("JSON parse error: %s\n", error.c_str());
     return;
   }
 
-  String errorsJson = OICan::ListErrors();
-
-  JsonDocument responseDoc;
-  responseDoc["event"] = "listErrorsSuccess";
+  // Dispatch to WebSocket handler
+  dispatchWebSocketMessage(client, doc);
+}
 
-  JsonDocument errorsArray;
-  DeserializationError error = deserializeJson(errorsArray, errorsJson);
+static void handleMessagePiece(AsyncWebSocketClient* client, AwsFrameInfo* info, uint8_t* data, size_t len) {
+  if (info->message_opcode != WS_TEXT) {
+    return;
+  }
 
-  if (!error) {
-    responseDoc["data"]["errors"] = errorsArray.as<JsonArray>();
-    DBG_OUTPUT_PORT.printf("[WebSocket] Listed errors successfully (%d bytes)\n", errorsJson.length());
-  } else {
-    responseDoc["data"]["errors"] = JsonArray();
-    DBG_OUTPUT_PORT.printf("[WebSocket] Failed to parse errors JSON: %s\n", error.c_str());
+  uint32_t clientId = client->id();
+  if (info->num == 0 && info->index == 0) {
+    partialMessages[clientId] = "";
+  }
+  auto it = partialMessages.find(clientId);
+  if (it == partialMessages.end()) {
+    return;  // Start was missed or the message was dropped
+  }
+  if (it->second.length() + len > MAX_WS_MESSAGE_SIZE) {
+    DBG_OUTPUT_PORT.printf("WebSocket message from client #%lu too large, dropped\n", (unsigned long)clientId);
+    partialMessages.erase(it);
+    return;
   }
+  it->second.concat((const char*)data, len);
 
-  String output;
-  serializeJson(responseDoc, output);
-  client->text(output);
+  if (info->final && info->index + len == info->len) {
+    String message = it->second;
+    partialMessages.erase(it);
+    handleTextMessage(client, message);
+  }
 }
 
-// ============================================================================
-// WebSocket Event Handler
-// ============================================================================
-
 void onWebSocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data,
                       size_t len) {
   ClientLockManager& lockMgr = ClientLockManager::instance();
@@ -974,6 +1014,8 @@ void onWebSocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsE
 
   } else if (type == WS_EVT_DISCONNECT) {
     DBG_OUTPUT_PORT.printf("WebSocket client #%lu disconnected\n", (unsigned long)client->id());
+    partialMessages.erase(client->id());
+    EventProcessor::setSpotValuesBinary(client->id(), false);
 
     // Release any device lock held by this client
     uint32_t clientId = client->id();
@@ -994,19 +1036,9 @@ void onWebSocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsE
     AwsFrameInfo* info = (AwsFrameInfo*)arg;
     if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
       data[len] = 0;  // null terminate
-      String message = (char*)data;
-
-      DBG_OUTPUT_PORT.printf("WebSocket message: %s\n", message.c_str());
-
-      JsonDocument doc;
-      DeserializationError error = deserializeJson(doc, message);
-      if (error) {
-        DBG_OUTPUT_PORT.printf("JSON parse error: %s\n", error.c_str());
-        return;
-      }
-
-      // Dispatch to WebSocket handler
-      dispatchWebSocketMessage(client, doc);
+      handleTextMessage(client, String((char*)data));
+    } else {
+      handleMessagePiece(client, info, data, len);
     }
   }
 }
@@ -37,6 +37,10 @@ void handleGetNodeId(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleSetNodeId(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStartSpotValues(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStopSpotValues(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleSetSpotValuesFormat(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleGetSpotValueHistory(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleStartDataLog(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleStopDataLog(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleUpdateParam(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleGetParamSchema(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleGetParamValues(AsyncWebSocketClient* client, JsonDocument& doc);
@@ -46,15 +50,20 @@ void handleDisconnect(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleGetCanMappings(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleAddCanMapping(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleRemoveCanMapping(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleClearCanMap(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleImportCanMap(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleSaveToFlash(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleLoadFromFlash(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleLoadDefaults(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStartDevice(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStopDevice(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleListErrors(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleSnapshotParams(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleRestoreParams(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleSendCanMessage(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStartCanInterval(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStopCanInterval(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStartCanIoInterval(AsyncWebSocketClient* client, JsonDocument& doc);
 void handleStopCanIoInterval(AsyncWebSocketClient* client, JsonDocument& doc);
-void handleUpdateCanIoFlags(AsyncWebSocketClient* client, JsonDocument& doc);
\ No newline at end of file
+void handleUpdateCanIoFlags(AsyncWebSocketClient* client, JsonDocument& doc);
+void handleGetCanStatus(AsyncWebSocketClient* client, JsonDocument& doc);
\ No newline at end of file
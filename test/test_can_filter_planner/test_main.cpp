@@ -0,0 +1,103 @@
+// TWAI acceptance filter plans for the ID sets can_task installs (pio test -e native)
+#include <unity.h>
+
+#include <vector>
+
+#include "models/can_types.h"
+#include "utils/can_filter_planner.h"
+
+// Whether the planned dual filter lets a standard ID through (layout in planAcceptanceFilter)
+static bool accepts(const CanFilterPlan& plan, uint16_t id) {
+  uint32_t code = plan.config.acceptance_code;
+  uint32_t mask = plan.config.acceptance_mask;
+  if (plan.config.single_filter) {
+    return ((id ^ (code >> 21)) & ~(mask >> 21) & 0x7FF) == 0;
+  }
+  bool first = ((id ^ (code >> 21)) & ~(mask >> 21) & 0x7FF) == 0;
+  bool second = ((id ^ (code >> 5)) & ~(mask >> 5) & 0x7FF) == 0;
+  return first || second;
+}
+
+static void assertAcceptedIds(const CanFilterPlan& plan, const std::vector<CanIdRange>& wanted) {
+  uint16_t accepted = 0;
+  for (uint16_t id = 0; id < 0x800; id++) {
+    accepted += accepts(plan, id);
+  }
+  TEST_ASSERT_EQUAL_UINT16(plan.acceptedIds, accepted);
+  for (const CanIdRange& range : wanted) {
+    for (uint16_t id = range.first; id <= range.last; id++) {
+      TEST_ASSERT_TRUE(accepts(plan, id));
+    }
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_connected_node() {
+  // Node 1's SDO responses and the bootloader: one exact filter each
+  std::vector<CanIdRange> wanted = {{SDO_RESPONSE_BASE_ID + 1, SDO_RESPONSE_BASE_ID + 1},
+                                    {BOOTLOADER_RESPONSE_ID, BOOTLOADER_RESPONSE_ID}};
+  CanFilterPlan plan = planAcceptanceFilter(wanted);
+
+  TEST_ASSERT_FALSE(plan.config.single_filter);
+  TEST_ASSERT_EQUAL_HEX32(0xB020FBC0, plan.config.acceptance_code);  // 0x581 << 21 | 0x7DE << 5
+  TEST_ASSERT_EQUAL_HEX32(0x001F001F, plan.config.acceptance_mask);  // Only RTR and data don't care
+  TEST_ASSERT_EQUAL_UINT16(2, plan.wantedIds);
+  TEST_ASSERT_EQUAL_UINT16(2, plan.acceptedIds);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, plan.falseAcceptRatio);
+  assertAcceptedIds(plan, wanted);
+}
+
+void test_scan_range() {
+  // Every node's SDO responses while scanning: 0x580-0x5FF is one aligned block
+  std::vector<CanIdRange> wanted = {{SDO_RESPONSE_BASE_ID, SDO_RESPONSE_MAX_ID},
+                                    {BOOTLOADER_RESPONSE_ID, BOOTLOADER_RESPONSE_ID}};
+  CanFilterPlan plan = planAcceptanceFilter(wanted);
+
+  TEST_ASSERT_FALSE(plan.config.single_filter);
+  TEST_ASSERT_EQUAL_HEX32(0xB000FBC0, plan.config.acceptance_code);  // 0x580 << 21 | 0x7DE << 5
+  TEST_ASSERT_EQUAL_HEX32(0x0FFF001F, plan.config.acceptance_mask);  // Low 7 ID bits free in filter 1
+  TEST_ASSERT_EQUAL_UINT16(129, plan.wantedIds);
+  TEST_ASSERT_EQUAL_UINT16(129, plan.acceptedIds);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, plan.falseAcceptRatio);
+  assertAcceptedIds(plan, wanted);
+}
+
+void test_three_ids_share_two_filters() {
+  // 0x581 and 0x100 differ in three bits, the cheapest pair to merge: 8 + 1 IDs accepted
+  std::vector<CanIdRange> wanted = {{0x581, 0x581}, {BOOTLOADER_RESPONSE_ID, BOOTLOADER_RESPONSE_ID}, {0x100, 0x100}};
+  CanFilterPlan plan = planAcceptanceFilter(wanted);
+
+  TEST_ASSERT_EQUAL_HEX32(0x2000FBC0, plan.config.acceptance_code);  // 0x100 << 21 | 0x7DE << 5
+  TEST_ASSERT_EQUAL_HEX32(0x903F001F, plan.config.acceptance_mask);  // 0x481 << 21 | RTR and data
+  TEST_ASSERT_EQUAL_UINT16(3, plan.wantedIds);
+  TEST_ASSERT_EQUAL_UINT16(9, plan.acceptedIds);
+  TEST_ASSERT_EQUAL_FLOAT(6.0f / 9.0f, plan.falseAcceptRatio);
+  assertAcceptedIds(plan, wanted);
+}
+
+void test_empty_set() {
+  // Nothing wanted (or only out-of-range IDs): accept everything rather than go deaf
+  std::vector<CanIdRange> sets[] = {{}, {{0x900, 0x9FF}}};
+  for (const std::vector<CanIdRange>& wanted : sets) {
+    CanFilterPlan plan = planAcceptanceFilter(wanted);
+
+    TEST_ASSERT_TRUE(plan.config.single_filter);
+    TEST_ASSERT_EQUAL_HEX32(0, plan.config.acceptance_code);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, plan.config.acceptance_mask);
+    TEST_ASSERT_EQUAL_UINT16(0, plan.wantedIds);
+    TEST_ASSERT_EQUAL_UINT16(0x800, plan.acceptedIds);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, plan.falseAcceptRatio);
+    assertAcceptedIds(plan, wanted);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_connected_node);
+  RUN_TEST(test_scan_range);
+  RUN_TEST(test_three_ids_share_two_filters);
+  RUN_TEST(test_empty_set);
+  return UNITY_END();
+}
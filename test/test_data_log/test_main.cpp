@@ -0,0 +1,281 @@
+// Data log encoding, DataLogger -> DataLogReader round trip, range seeks and damaged files
+// (pio test -e native)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "managers/data_logger.h"
+#include "models/data_log_format.h"
+#include "utils/data_log_reader.h"
+
+struct Row {
+  uint32_t timeMs;
+  int paramId;
+  int32_t value;
+};
+
+struct BlockAt {
+  uint32_t offset;
+  DataLogBlockHeader header;
+};
+
+static const int PARAM_IDS[] = {2001, 2002, 2003};
+static const int PARAM_COUNT = 3;
+static const int ROW_COUNT = 20000;  // About 25 data blocks: several index blocks
+
+static std::vector<Row> rows;
+static std::string logPath;
+
+// Same text as DataLogReader: value / 32, exact in a double, without trailing zeros
+static std::string formatValue(int32_t value) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.5f", value / 32.0);
+  std::string result = text;
+  while (result.back() == '0') {
+    result.pop_back();
+  }
+  if (result.back() == '.') {
+    result.pop_back();
+  }
+  return result;
+}
+
+static std::string expectedCsv(uint32_t fromMs, uint32_t toMs, size_t rowLimit = SIZE_MAX) {
+  std::string csv = "time_ms,param_id,value\n";
+  for (size_t i = 0; i < rows.size() && i < rowLimit; i++) {
+    const Row& row = rows[i];
+    if (row.timeMs >= fromMs && row.timeMs <= toMs) {
+      csv += std::to_string(row.timeMs) + "," + std::to_string(row.paramId) + "," + formatValue(row.value) + "\n";
+    }
+  }
+  return csv;
+}
+
+// Small odd reads, so lines are split across them
+static std::string readCsv(const std::string& path, uint32_t fromMs, uint32_t toMs) {
+  DataLogReader reader(LittleFS.open(path.c_str(), "r"), fromMs, toMs);
+  TEST_ASSERT_TRUE(reader.begin());
+  std::string csv;
+  uint8_t buffer[61];
+  size_t length;
+  while ((length = reader.read(buffer, sizeof(buffer))) > 0) {
+    csv.append((const char*)buffer, length);
+  }
+  return csv;
+}
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+  File file = LittleFS.open(path.c_str(), "r");
+  std::vector<uint8_t> data(file.size());
+  file.read(data.data(), data.size());
+  return data;
+}
+
+static std::string writeCopy(const std::vector<uint8_t>& data, size_t length) {
+  std::string path = "/copy.oil";
+  File file = LittleFS.open(path.c_str(), "w");
+  file.write(data.data(), length);
+  file.close();
+  return path;
+}
+
+// Every complete block, walking the headers from the first
+static std::vector<BlockAt> listBlocks(const std::vector<uint8_t>& data, size_t length) {
+  DataLogFileHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  std::vector<BlockAt> blocks;
+  size_t offset = sizeof(header) + header.paramCount * sizeof(uint16_t);
+  while (offset + sizeof(DataLogBlockHeader) <= length) {
+    BlockAt block;
+    block.offset = offset;
+    memcpy(&block.header, data.data() + offset, sizeof(block.header));
+    if (offset + sizeof(block.header) + block.header.length > length) {
+      break;
+    }
+    blocks.push_back(block);
+    offset += sizeof(block.header) + block.header.length;
+  }
+  return blocks;
+}
+
+static void waitFor(bool (*condition)()) {
+  for (int i = 0; i < 200 && !condition(); i++) {
+    delay(10);
+  }
+  TEST_ASSERT_TRUE(condition());
+}
+
+static bool fileOpen() {
+  return DataLogger::instance().getFileNumber() != 0;
+}
+
+static bool fileClosed() {
+  return DataLogger::instance().getFileNumber() == 0;
+}
+
+// Logs ROW_COUNT rows of random walks (with jumps across the int32 range) to one file,
+// which the tests after it read back
+void test_write_log() {
+  DataLogger& logger = DataLogger::instance();
+  TEST_ASSERT_TRUE(logger.begin());
+  TEST_ASSERT_TRUE(logger.start(1, PARAM_IDS, PARAM_COUNT, DATA_LOG_BUDGET_DEFAULT));
+  waitFor(fileOpen);
+  char name[16];
+  DataLogger::formatFileName(name, sizeof(name), logger.getFileNumber());
+  logPath = std::string(DATA_LOG_DIR "/") + name;
+
+  uint32_t seed = 1;
+  auto next = [&seed](uint32_t range) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % range;
+  };
+  int32_t values[PARAM_COUNT] = {0, 3200, -17};
+  uint32_t timeMs = 1000;
+  rows.clear();
+  for (int i = 0; i < ROW_COUNT; i++) {
+    int column = next(PARAM_COUNT);
+    timeMs += next(4);
+    if (i == ROW_COUNT / 2) {
+      values[column] = INT32_MIN + 5;
+    } else if (i == ROW_COUNT / 2 + 1) {
+      values[column] = INT32_MAX - 3;
+    } else {
+      values[column] = (int32_t)((uint32_t)values[column] + next(41) - 20);  // Wraps like the logger
+    }
+    logger.record(PARAM_IDS[column], values[column], timeMs);
+    logger.record(9999, 1, timeMs);  // Not logged
+    logger.process(timeMs);
+    rows.push_back({timeMs, PARAM_IDS[column], values[column]});
+    if (i % 200 == 0) {
+      delay(1);  // Let the writer keep up
+    }
+  }
+  logger.stop();
+  waitFor(fileClosed);
+  TEST_ASSERT_EQUAL_UINT32(0, logger.getDropped());
+  TEST_ASSERT_FALSE(logger.hasWriteError());
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_varint_round_trip() {
+  const uint32_t values[] = {0, 1, 127, 128, 300, 16383, 16384, 0x0FFFFFFF, 0x10000000, UINT32_MAX};
+  for (uint32_t value : values) {
+    uint8_t buffer[5];
+    size_t length = dataLogPutVarint(buffer, value);
+    uint32_t decoded;
+    TEST_ASSERT_EQUAL_UINT32(length, dataLogGetVarint(buffer, buffer + length, decoded));
+    TEST_ASSERT_EQUAL_UINT32(value, decoded);
+    // Cut short: nothing decoded
+    TEST_ASSERT_EQUAL_UINT32(0, dataLogGetVarint(buffer, buffer + length - 1, decoded));
+  }
+
+  // More than five bytes is not a varint of this format
+  const uint8_t tooLong[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+  uint32_t decoded;
+  TEST_ASSERT_EQUAL_UINT32(0, dataLogGetVarint(tooLong, tooLong + sizeof(tooLong), decoded));
+}
+
+void test_zigzag_round_trip() {
+  const int32_t values[] = {0, 1, -1, 2, -2, 1000, -1000, INT32_MAX, INT32_MIN};
+  for (int32_t value : values) {
+    TEST_ASSERT_EQUAL_INT32(value, dataLogUnzigzag(dataLogZigzag(value)));
+  }
+  // Small changes either way stay small
+  TEST_ASSERT_EQUAL_UINT32(0, dataLogZigzag(0));
+  TEST_ASSERT_EQUAL_UINT32(1, dataLogZigzag(-1));
+  TEST_ASSERT_EQUAL_UINT32(2, dataLogZigzag(1));
+}
+
+void test_log_round_trip() {
+  TEST_ASSERT_TRUE(expectedCsv(0, UINT32_MAX) == readCsv(logPath, 0, UINT32_MAX));
+}
+
+void test_range_closed_file() {
+  std::vector<uint8_t> data = readFile(logPath);
+  DataLogTrailer trailer;
+  memcpy(&trailer, data.data() + data.size() - sizeof(trailer), sizeof(trailer));
+  TEST_ASSERT_EQUAL_HEX32(DATA_LOG_TRAILER_MAGIC, trailer.magic);
+
+  uint32_t firstMs = rows.front().timeMs;
+  uint32_t lastMs = rows.back().timeMs;
+  uint32_t ranges[][2] = {{firstMs + (lastMs - firstMs) / 3, firstMs + 2 * (lastMs - firstMs) / 3},
+                          {lastMs - 50, UINT32_MAX},
+                          {firstMs + 1, firstMs + 40},
+                          {0, firstMs - 1},
+                          {lastMs + 1, UINT32_MAX}};
+  for (auto& range : ranges) {
+    TEST_ASSERT_TRUE(expectedCsv(range[0], range[1]) == readCsv(logPath, range[0], range[1]));
+  }
+}
+
+void test_range_unclosed_file() {
+  // As if the device reset while logging: no closing index block, no trailer
+  std::vector<uint8_t> data = readFile(logPath);
+  std::vector<BlockAt> blocks = listBlocks(data, data.size() - sizeof(DataLogTrailer));
+  TEST_ASSERT_EQUAL(DATA_LOG_BLOCK_INDEX, blocks.back().header.type);
+  std::string path = writeCopy(data, blocks.back().offset);
+
+  uint32_t firstMs = rows.front().timeMs;
+  uint32_t lastMs = rows.back().timeMs;
+  uint32_t fromMs = firstMs + (lastMs - firstMs) / 2;
+  TEST_ASSERT_TRUE(expectedCsv(fromMs, fromMs + 500) == readCsv(path, fromMs, fromMs + 500));
+  TEST_ASSERT_TRUE(expectedCsv(fromMs, UINT32_MAX) == readCsv(path, fromMs, UINT32_MAX));
+}
+
+void test_truncated_blocks() {
+  std::vector<uint8_t> data = readFile(logPath);
+  std::vector<BlockAt> blocks = listBlocks(data, data.size());
+
+  // The file cut inside a data block's payload, then inside its header
+  const BlockAt* last = nullptr;
+  size_t rowsBefore = 0;
+  for (const BlockAt& block : blocks) {
+    if (block.header.type != DATA_LOG_BLOCK_DATA) {
+      continue;
+    }
+    if (last != nullptr) {
+      rowsBefore += last->header.count;
+    }
+    last = &block;
+  }
+  TEST_ASSERT_NOT_NULL(last);
+  size_t cuts[] = {last->offset + sizeof(DataLogBlockHeader) + last->header.length / 2, last->offset + 5};
+  for (size_t cut : cuts) {
+    std::string path = writeCopy(data, cut);
+    // Rows of the complete blocks come out; the damaged one is left out
+    TEST_ASSERT_TRUE(expectedCsv(0, UINT32_MAX, rowsBefore) == readCsv(path, 0, UINT32_MAX));
+    uint32_t fromMs = rows[rowsBefore / 2].timeMs;
+    TEST_ASSERT_TRUE(expectedCsv(fromMs, UINT32_MAX, rowsBefore) == readCsv(path, fromMs, UINT32_MAX));
+  }
+}
+
+int main(int argc, char** argv) {
+  LittleFS.setRoot(".pio/test_data_log_fs");  // Inside the build directory
+  LittleFS.begin();
+  File dir = LittleFS.open(DATA_LOG_DIR);
+  std::vector<std::string> stale;
+  for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+    stale.push_back(std::string(DATA_LOG_DIR "/") + entry.name());
+  }
+  for (const std::string& path : stale) {
+    LittleFS.remove(path.c_str());
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(test_varint_round_trip);
+  RUN_TEST(test_zigzag_round_trip);
+  RUN_TEST(test_write_log);
+  RUN_TEST(test_log_round_trip);
+  RUN_TEST(test_range_closed_file);
+  RUN_TEST(test_range_unclosed_file);
+  RUN_TEST(test_truncated_blocks);
+  return UNITY_END();
+}
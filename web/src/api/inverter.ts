@@ -207,6 +207,25 @@ class InverterAPI {
     return response.json()
   }
 
+  /**
+   * Get the data log files recorded on the device (oldest first)
+   */
+  async getDataLogs(): Promise<DataLogsResponse> {
+    const response = await fetch('/logs')
+    return response.json()
+  }
+
+  /**
+   * Download URL of a data log file, decoded to CSV or as stored
+   */
+  getDataLogUrl(name: string, format: 'csv' | 'raw' = 'csv'): string {
+    const params = new URLSearchParams({ file: name })
+    if (format === 'csv') {
+      params.set('format', 'csv')
+    }
+    return `/logs/download?${params}`
+  }
+
 }
 
 // Device management type definitions
@@ -226,6 +245,19 @@ export interface SavedDevicesResponse {
   devices: Record<string, SavedDevice> // Serial -> Device mapping
 }
 
+export interface DataLogFile {
+  name: string
+  size: number
+  writing: boolean
+}
+
+export interface DataLogsResponse {
+  active: boolean
+  totalBytes: number
+  usedBytes: number
+  files: DataLogFile[]
+}
+
 export interface DeviceSettings {
   canRXPin: number
   canTXPin: number
@@ -36,8 +36,9 @@ export default function ParameterInput({
         if (message.data.paramId === paramId && pendingUpdate !== null) {
           if (message.data.success) {
             showSuccess(content.parameterUpdatedSuccess({ paramName: displayName }))
-            // Update local parameter value without full reload
-            onUpdate(paramId, pendingUpdate)
+            // Update local parameter value without full reload. Rapid updates are coalesced,
+            // so use the value the device ended up with.
+            onUpdate(paramId, message.data.value ?? pendingUpdate)
           } else {
             showError(content.failedToUpdateParam({ paramName: displayName }) + ': ' + message.data.error)
           }
@@ -83,6 +83,29 @@ const spotValuesContent = {
     clearHistory: t({
       en: 'Clear History',
     }),
+    startDataLog: t({
+      en: 'Record to Flash',
+    }),
+    stopDataLog: t({
+      en: 'Stop Recording',
+    }),
+    dataLogStatus: insert(
+      t({
+        en: 'Recording {{count}} parameters: {{samples}} samples, {{dropped}} dropped',
+      })
+    ),
+    dataLogError: t({
+      en: 'Recording failed: flash is full, or a recorded parameter is not being monitored',
+    }),
+    dataLogFiles: t({
+      en: 'Recorded logs',
+    }),
+    downloadCsv: t({
+      en: 'CSV',
+    }),
+    downloadRaw: t({
+      en: 'Raw',
+    }),
     back: t({
       en: 'Back',
     }),
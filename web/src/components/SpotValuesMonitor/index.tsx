@@ -1,4 +1,4 @@
-import { useEffect } from 'preact/hooks'
+import { useEffect, useState } from 'preact/hooks'
 import { useIntlayer } from 'preact-intlayer'
 import { useParamSchema } from '@hooks/useParamSchema'
 import { useWebSocketContext } from '@contexts/WebSocketContext'
@@ -7,6 +7,7 @@ import MultiLineChart from '@components/MultiLineChart'
 import { LoadingSpinner } from '@components/LoadingSpinner'
 import { convertSpotValue } from '@utils/spotValueConversions'
 import { formatParameterValue } from '@utils/parameterDisplay'
+import { api, DataLogFile } from '@api/inverter'
 
 const MAX_HISTORY_POINTS = 100
 
@@ -61,6 +62,20 @@ export default function SpotValuesMonitor({
   // WebSocket connection
   const { isConnected, sendMessage, subscribe } = useWebSocketContext()
 
+  // Recording to the device's flash (DataLogger), and the files recorded so far
+  const [dataLog, setDataLog] = useState<{ active: boolean, error?: boolean, paramCount?: number, samples?: number, dropped?: number }>({ active: false })
+  const [dataLogFiles, setDataLogFiles] = useState<DataLogFile[]>([])
+
+  const refreshDataLogFiles = () => {
+    api.getDataLogs()
+      .then(logs => setDataLogFiles(logs.files))
+      .catch(error => console.warn('[SpotValuesMonitor] Failed to list data logs:', error))
+  }
+
+  useEffect(() => {
+    refreshDataLogFiles()
+  }, [])
+
   // Helper function to get consistent color for a parameter
   const getColorForParam = (key: string): string => {
     // Simple hash function to generate consistent RGB color
@@ -103,8 +118,54 @@ export default function SpotValuesMonitor({
           // Clear historical data when stopping
           if (!message.data.active) {
             clearHistoricalData()
+          } else {
+            // Fill the chart from the history the device keeps instead of waiting for live samples
+            const resolution = message.data.interval || interval
+            sendMessage('getSpotValueHistory', { duration: MAX_HISTORY_POINTS * resolution, resolution })
+          }
+          break
+
+        case 'dataLogStatus':
+          setDataLog(message.data)
+          refreshDataLogFiles()
+          break
+
+        case 'spotValueHistory': {
+          if (normalizeSerial(connectedSerial) !== normalizeSerial(serial)) {
+            return
           }
+
+          // { now, resolution, scale, series: [{ id, start, min: [], max: [], mean: [] }] }, null = no samples
+          const { resolution, scale, series } = message.data.history
+          setHistoricalData(prev => {
+            const updated = { ...prev }
+
+            series.forEach((entry: { id: number, start: number, mean: (number | null)[] }) => {
+              const paramId = entry.id.toString()
+              const param = params && Object.values(params).find(p =>
+                p.id?.toString() === paramId || p.i?.toString() === paramId
+              )
+
+              // Only what is older than the first live sample
+              const live = updated[paramId] || []
+              const firstLive = live.length > 0 ? live[0].timestamp : Infinity
+              const points: { timestamp: number, value: number }[] = []
+              entry.mean.forEach((mean, i) => {
+                const timestamp = entry.start + i * resolution
+                if (mean === null || timestamp >= firstLive) {
+                  return
+                }
+                const value = mean / scale
+                points.push({ timestamp, value: param?.unit ? convertSpotValue(value, param.unit).value : value })
+              })
+
+              updated[paramId] = [...points, ...live].slice(-MAX_HISTORY_POINTS)
+            })
+
+            return updated
+          })
           break
+        }
 
         case 'spotValues':
           // CRITICAL: Only process spot values if they're from the device we're monitoring
@@ -206,6 +267,19 @@ export default function SpotValuesMonitor({
     clearHistoricalData()
   }
 
+  const handleDataLogToggle = () => {
+    if (dataLog.active) {
+      sendMessage('stopDataLog', {})
+      return
+    }
+
+    // Record the charted parameters, or everything monitored if none is charted
+    const paramIds = Array.from(selectedParams)
+      .map(key => params?.[key]?.id || params?.[key]?.i)
+      .filter(id => id !== undefined) as number[]
+    sendMessage('startDataLog', { paramIds })
+  }
+
   const handleIntervalChange = (newInterval: number) => {
     setInterval(newInterval)
 
@@ -318,9 +392,35 @@ export default function SpotValuesMonitor({
           <button class="btn-secondary" onClick={handleClearData}>
             Clear Data
           </button>
+          <button class={dataLog.active ? 'btn-danger' : 'btn-secondary'} onClick={handleDataLogToggle} disabled={!streaming}>
+            {dataLog.active ? content.stopDataLog : content.startDataLog}
+          </button>
         </div>
       </div>
 
+      {(dataLog.active || dataLog.error) && (
+        <div class="streaming-indicator">
+          {dataLog.error
+            ? content.dataLogError
+            : content.dataLogStatus({ count: dataLog.paramCount ?? 0, samples: dataLog.samples ?? 0, dropped: dataLog.dropped ?? 0 })}
+        </div>
+      )}
+
+      {dataLogFiles.length > 0 && (
+        <div class="data-log-files">
+          <h3 class="category-title">{content.dataLogFiles}</h3>
+          <ul>
+            {dataLogFiles.map(file => (
+              <li key={file.name}>
+                {file.name} ({Math.round(file.size / 1024)} KB){' '}
+                <a href={api.getDataLogUrl(file.name, 'csv')}>{content.downloadCsv}</a>{' '}
+                <a href={api.getDataLogUrl(file.name, 'raw')}>{content.downloadRaw}</a>
+              </li>
+            ))}
+          </ul>
+        </div>
+      )}
+
       {/* Spot Values Grid */}
       <div class="spot-values-categories">
         {Array.from(categories.entries()).map(([category, categoryParams]) => (
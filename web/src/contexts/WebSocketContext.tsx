@@ -16,6 +16,44 @@ export interface WebSocketContextValue {
 
 const WebSocketContext = createContext<WebSocketContextValue | null>(null)
 
+// Binary spot value frame (src/models/spot_value_frame.h): an 8-byte header
+// (type, version, count, timestamp) then 8-byte records (paramId, ageMs, value * 32)
+const SPOT_VALUE_FRAME_TYPE = 0x01
+const SPOT_VALUE_FRAME_VERSION = 1
+const SPOT_VALUE_HEADER_SIZE = 8
+const SPOT_VALUE_RECORD_SIZE = 8
+
+/**
+ * Decode a binary spot value frame into the same message the JSON spotValues event
+ * carries, plus the time each value arrived. Returns null for anything else.
+ */
+export function decodeSpotValuesFrame(buffer: ArrayBuffer): WebSocketMessage | null {
+  if (buffer.byteLength < SPOT_VALUE_HEADER_SIZE) {
+    return null
+  }
+  const view = new DataView(buffer)
+  if (view.getUint8(0) !== SPOT_VALUE_FRAME_TYPE || view.getUint8(1) !== SPOT_VALUE_FRAME_VERSION) {
+    return null
+  }
+
+  const count = view.getUint16(2, true)
+  const timestamp = view.getUint32(4, true)
+  if (buffer.byteLength < SPOT_VALUE_HEADER_SIZE + count * SPOT_VALUE_RECORD_SIZE) {
+    return null
+  }
+
+  const values: Record<string, number> = {}
+  const timestamps: Record<string, number> = {}
+  for (let i = 0; i < count; i++) {
+    const offset = SPOT_VALUE_HEADER_SIZE + i * SPOT_VALUE_RECORD_SIZE
+    const paramId = view.getUint16(offset, true)
+    timestamps[paramId] = timestamp - view.getUint16(offset + 2, true)
+    values[paramId] = view.getInt32(offset + 4, true) / 32
+  }
+
+  return { event: 'spotValues', data: { timestamp, values, timestamps } }
+}
+
 interface WebSocketProviderProps {
   children: ComponentChildren
   url: string
@@ -43,12 +81,17 @@ export function WebSocketProvider({ children, url }: WebSocketProviderProps) {
       setIsConnected(false)
 
       const ws = new WebSocket(wsUrl)
+      ws.binaryType = 'arraybuffer'
 
       ws.onopen = () => {
         console.log('WebSocket connected')
         setIsConnecting(false)
         setIsConnected(true)
         setIsRetrying(false) // Reset retry flag on successful connection
+
+        // Ask for spot values as binary frames; the server answers spotValuesFormat
+        // and keeps sending JSON if it cannot
+        ws.send(JSON.stringify({ action: 'setSpotValuesFormat', format: 'binary', version: SPOT_VALUE_FRAME_VERSION }))
       }
 
       ws.onclose = (event) => {
@@ -76,24 +119,36 @@ export function WebSocketProvider({ children, url }: WebSocketProviderProps) {
       }
 
       ws.onmessage = (event) => {
-        try {
-          const message: WebSocketMessage = JSON.parse(event.data)
-          // Don't log spot values to reduce console noise
-          if (message.event !== 'spotValues') {
-            console.log('WebSocket message:', message)
+        let message: WebSocketMessage | null
+        if (event.data instanceof ArrayBuffer) {
+          message = decodeSpotValuesFrame(event.data)
+          if (!message) {
+            console.error('Unknown binary WebSocket message')
+            return
+          }
+        } else {
+          try {
+            message = JSON.parse(event.data) as WebSocketMessage
+          } catch (error) {
+            console.error('Failed to parse WebSocket message:', error)
+            return
           }
+        }
 
-          // Notify all subscribers
-          subscribersRef.current.forEach(handler => {
-            try {
-              handler(message)
-            } catch (error) {
-              console.error('Error in WebSocket message handler:', error)
-            }
-          })
-        } catch (error) {
-          console.error('Failed to parse WebSocket message:', error)
+        // Don't log spot values to reduce console noise
+        if (message.event !== 'spotValues') {
+          console.log('WebSocket message:', message)
         }
+
+        // Notify all subscribers
+        const received = message
+        subscribersRef.current.forEach(handler => {
+          try {
+            handler(received)
+          } catch (error) {
+            console.error('Error in WebSocket message handler:', error)
+          }
+        })
       }
 
       wsRef.current = ws